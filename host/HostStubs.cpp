@@ -0,0 +1,268 @@
+// Pi1541 - A Commodore 1541 disk drive emulator
+// Copyright(C) 2018 Stephen White
+//
+// This file is part of Pi1541.
+//
+// Pi1541 is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Pi1541 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
+
+// What the emulation core expects main.cpp, the hardware and FatFs to provide when it is built for a PC.
+
+extern "C"
+{
+#include "rpi-gpio.h"
+#include "rpiHardware.h"
+}
+#include "HostStubs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Pi1541.h"
+#include "Pi1581.h"
+#include "ROMs.h"
+#include "options.h"
+#include "InputMappings.h"
+#include "iec_bus.h"
+#include "ff.h"
+
+u32 hostGPLEV0 = 0xffffffff;	// Nothing pulling any line low
+static u32 hostTimer = 0;
+
+u8 s_u8Memory[0xc000];
+Pi1541 pi1541;
+#if defined(PI1581SUPPORT)
+Pi1581 pi1581;
+#endif
+ROMs roms;
+Options options;
+
+u8 InputMappings::INPUT_BUTTON_ENTER = 0;
+u8 InputMappings::INPUT_BUTTON_UP = 1;
+u8 InputMappings::INPUT_BUTTON_DOWN = 2;
+u8 InputMappings::INPUT_BUTTON_BACK = 3;
+u8 InputMappings::INPUT_BUTTON_INSERT = 4;
+
+extern "C"
+{
+u32 HostRead32(unsigned int nAddress)
+{
+	if (nAddress == ARM_GPIO_GPLEV0)
+		return hostGPLEV0;
+	// Anything waiting on the system timer sees it move.
+	if (nAddress == ARM_SYSTIMER_CLO)
+		return ++hostTimer;
+	return 0;
+}
+
+void HostWrite32(unsigned int, u32)
+{
+}
+
+void SetACTLed(int)
+{
+}
+
+void RPI_SetGpioInput(rpi_gpio_pin_t)
+{
+}
+}
+
+// The same FNV-1a as main.cpp
+u32 HashBuffer(const void* pBuffer, u32 length)
+{
+	const u8* pu8Buffer = (const u8*)pBuffer;
+	u32 hash = 0x811c9dc5U;
+
+	while (length)
+	{
+		hash ^= *pu8Buffer++;
+		hash *= 16777619U;
+		--length;
+	}
+	return hash;
+}
+
+u8* HostLoadFile(const char* path, u32& size)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == 0)
+		return 0;
+
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	u8* data = length >= 0 ? (u8*)malloc(length + 1) : 0;
+	if (data && fread(data, 1, length, file) != (size_t)length)
+	{
+		free(data);
+		data = 0;
+	}
+	fclose(file);
+	size = (u32)length;
+	return data;
+}
+
+bool HostOpenImage(DiskImage* diskImage, const char* path, FILINFO* fileInfo)
+{
+	u32 size;
+	u8* data = HostLoadFile(path, size);
+	if (data == 0 || size > READBUFFER_SIZE)
+	{
+		free(data);
+		return false;
+	}
+
+	const char* name = strrchr(path, '/');
+	name = name ? name + 1 : path;
+	memset(fileInfo, 0, sizeof(FILINFO));
+	strncpy(fileInfo->fname, name, sizeof(fileInfo->fname) - 1);
+	fileInfo->fsize = size;
+
+	// Open* may convert in place, as they do with DiskImage::readBuffer on the Pi.
+	memcpy(DiskImage::readBuffer, data, size);
+	free(data);
+
+	bool success;
+	unsigned char* buffer = DiskImage::readBuffer;
+	switch (DiskImage::GetDiskImageTypeViaExtention(fileInfo->fname))
+	{
+		case DiskImage::D64:
+			success = diskImage->OpenD64(fileInfo, buffer, size);
+			break;
+		case DiskImage::G64:
+			success = diskImage->OpenG64(fileInfo, buffer, size);
+			break;
+		case DiskImage::NIB:
+			success = diskImage->OpenNIB(fileInfo, buffer, size);
+			diskImage->SetReadOnly(true);
+			break;
+		case DiskImage::NBZ:
+			success = diskImage->OpenNBZ(fileInfo, buffer, size);
+			diskImage->SetReadOnly(true);
+			break;
+		case DiskImage::D81:
+			success = diskImage->OpenD81(fileInfo, buffer, size);
+			break;
+		case DiskImage::T64:
+			success = diskImage->OpenT64(fileInfo, buffer, size);
+			break;
+		case DiskImage::PRG:
+			success = diskImage->OpenPRG(fileInfo, buffer, size);
+			break;
+		default:
+			success = false;
+			break;
+	}
+
+	// Weak regions, as DiskCaddy::Insert reads them.
+	if (success)
+	{
+		char weakPath[1024];
+		snprintf(weakPath, sizeof(weakPath), "%s.weak", path);
+		u8* text = HostLoadFile(weakPath, size);
+		if (text)
+		{
+			text[size] = 0;
+			diskImage->LoadWeakRegions((char*)text);
+			free(text);
+		}
+	}
+	return success;
+}
+
+bool HostLoadROM(const char* path)
+{
+	u32 size;
+	u8* data = HostLoadFile(path, size);
+	if (data == 0 || size != ROMs::ROM_SIZE)
+	{
+		free(data);
+		return false;
+	}
+	memcpy(roms.ROMImages[0], data, ROMs::ROM_SIZE);
+	free(data);
+	const char* name = strrchr(path, '/');
+	strncpy(roms.ROMNames[0], name ? name + 1 : path, sizeof(roms.ROMNames[0]) - 1);
+	roms.ROMValid[0] = true;
+	roms.currentROMIndex = 0;
+	return true;
+}
+
+extern u8 read6502(u16 address);
+extern u8 read6502ExtraRAM(u16 address);
+extern void write6502(u16 address, const u8 value);
+extern void write6502ExtraRAM(u16 address, const u8 value);
+
+void HostReset1541(DiskImage* diskImage, bool extraRAM)
+{
+	pi1541.Initialise();
+	pi1541.drive.SetVIA(&pi1541.VIA[1]);
+	pi1541.VIA[0].GetPortB()->SetPortOut(0, IEC_Bus::PortB_OnPortOut);
+	pi1541.drive.Insert(diskImage);
+	pi1541.m6502.SetBusFunctions(extraRAM ? read6502ExtraRAM : read6502, extraRAM ? write6502ExtraRAM : write6502);
+
+	IEC_Bus::VIA = &pi1541.VIA[0];
+	IEC_Bus::port = pi1541.VIA[0].GetPortB();
+	pi1541.Reset();
+	IEC_Bus::LetSRQBePulledHigh();
+}
+
+// FatFs on top of stdio so the core can read and write files the way it does on the SD card.
+// Paths are relative to the current directory, which stands in for the root of the card.
+static FILE* HostFile(FIL* fp)
+{
+	FILE* file;
+	memcpy(&file, fp->buf, sizeof(file));
+	return file;
+}
+
+FRESULT f_open(FIL* fp, const TCHAR* path, BYTE mode)
+{
+	const char* fopenMode = "rb";
+
+	if (mode & FA_CREATE_ALWAYS)
+		fopenMode = "w+b";
+	else if (mode & FA_WRITE)
+		fopenMode = "r+b";
+
+	while (*path == '/')
+		path++;
+	FILE* file = fopen(path, fopenMode);
+	memset(fp, 0, sizeof(FIL));
+	memcpy(fp->buf, &file, sizeof(file));
+	return file ? FR_OK : FR_NO_FILE;
+}
+
+FRESULT f_close(FIL* fp)
+{
+	FILE* file = HostFile(fp);
+	if (file == 0)
+		return FR_INVALID_OBJECT;
+	fclose(file);
+	memset(fp->buf, 0, sizeof(file));
+	return FR_OK;
+}
+
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br)
+{
+	FILE* file = HostFile(fp);
+	*br = file ? fread(buff, 1, btr, file) : 0;
+	return file && !ferror(file) ? FR_OK : FR_DISK_ERR;
+}
+
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw)
+{
+	FILE* file = HostFile(fp);
+	*bw = file ? fwrite(buff, 1, btw, file) : 0;
+	return file && *bw == btw ? FR_OK : FR_DISK_ERR;
+}
@@ -0,0 +1,39 @@
+// Pi1541 - A Commodore 1541 disk drive emulator
+// Copyright(C) 2018 Stephen White
+//
+// This file is part of Pi1541.
+//
+// Pi1541 is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Pi1541 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HostStubs_H
+#define HostStubs_H
+
+#include "types.h"
+#include "DiskImage.h"
+
+// What ReadEmulationMode1541 sees on the GPIO pins.
+extern u32 hostGPLEV0;
+
+extern u32 HashBuffer(const void* pBuffer, u32 length);
+
+// Reads a whole file into memory. Returns 0 if it can not; free() the result.
+u8* HostLoadFile(const char* path, u32& size);
+// Opens a disk image file the way DiskCaddy::Insert does. fileInfo must outlive the image.
+bool HostOpenImage(DiskImage* diskImage, const char* path, FILINFO* fileInfo);
+// Loads a 16K 1541 ROM into the first ROM slot.
+bool HostLoadROM(const char* path);
+// Connects and resets pi1541 with diskImage inserted, the way Emulate1541 does before it starts the CPU.
+void HostReset1541(DiskImage* diskImage, bool extraRAM);
+
+#endif
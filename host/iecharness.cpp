@@ -0,0 +1,436 @@
+// Pi1541 - A Commodore 1541 disk drive emulator
+// Copyright(C) 2018 Stephen White
+//
+// This file is part of Pi1541.
+//
+// Pi1541 is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Pi1541 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
+
+// Loads files from disk images through the emulated 1541 with a C64 on the other end of the bus, no Pi and no C64 needed.
+// The C64 side is the Kernal's serial bus code modelled with the timings from the Commodore serial bus specification.
+// Every byte that arrives is compared with the file as read straight out of the image, and for each load the
+// smallest margin the drive left before one of the Kernal's timeouts is reported as the slack.
+//
+// iecharness [-v] [-l list] rom [image[:name]]...
+//	name is the file to load (in PETSCII as it is in the directory), the first file if it is left out.
+//	list holds one image[:name] per line.
+// Prints a line per load and exits with 1 if any of them failed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "HostStubs.h"
+#include "IECRecorder.h"
+#include "iec_bus.h"
+#include "Pi1541.h"
+
+extern Pi1541 pi1541;
+
+#define FAST_BOOT_CYCLES 1003061	// As main.cpp
+
+// Serial bus timings in microseconds (drive cycles)
+#define T_AT 1000		// Device must respond to ATN
+#define T_NE 200		// Talker must start a byte this soon after the listener is ready or it is an EOI
+#define T_EI 60			// Listener's EOI acknowledge
+#define T_S 70			// Talker's bit set up
+#define T_V 20			// Talker's bit valid
+#define T_F 1000		// Listener must accept a byte
+#define T_R 20			// Frame to release of ATN
+#define T_BB 100		// Between bytes
+#define T_YE 250		// Talker's EOI signal
+#define T_HUNG 10000000	// The Kernal waits forever for some things;- treat this long as hung
+
+#define MAX_FILE_SIZE (64 * 1024)
+
+static DiskImage diskImage;
+static FILINFO diskImageFileInfo;
+static bool verbose = false;
+
+// The lines the C64 is pulling low
+static u8 c64Lines;
+static u32 cycles;
+static int slack;
+static const char* slackWhere;
+
+// One cycle of Emulate1541's main loop.
+static void StepDrive()
+{
+	u8 pulled = c64Lines | IEC_Bus::GetOutputLines();
+	hostGPLEV0 = IEC_Bus::GetGPLEV0ForInputLines(~pulled & (IECRecorder::LINE_ATN | IECRecorder::LINE_DATA | IECRecorder::LINE_CLOCK | IECRecorder::LINE_SRQ | IECRecorder::LINE_RESET));
+	IEC_Bus::ReadEmulationMode1541();
+	pi1541.m6502.Step();
+	IEC_Bus::RefreshOuts1541();
+	pi1541.Update();
+	cycles++;
+}
+
+static bool Released(u8 line)
+{
+	return ((c64Lines | IEC_Bus::GetOutputLines()) & line) == 0;
+}
+
+static void Pull(u8 line)
+{
+	c64Lines |= line;
+}
+
+static void Release(u8 line)
+{
+	c64Lines &= ~line;
+}
+
+static void Wait(u32 time)
+{
+	while (time--)
+		StepDrive();
+}
+
+// Runs the drive until line is released (or pulled). Returns how long it took or -1 if it did not happen within timeout.
+static int WaitFor(u8 line, bool released, u32 timeout)
+{
+	for (u32 time = 0; time <= timeout; ++time)
+	{
+		if (Released(line) == released)
+			return time;
+		StepDrive();
+	}
+	return -1;
+}
+
+static bool Timeout(const char* where)
+{
+	slack = -1;
+	slackWhere = where;
+	return false;
+}
+
+// Keeps track of the closest the drive came to a timeout.
+static bool Deadline(int time, int limit, const char* where)
+{
+	if (time < 0)
+		return Timeout(where);
+	if (limit - time < slack)
+	{
+		slack = limit - time;
+		slackWhere = where;
+	}
+	return true;
+}
+
+// Kernal as talker (CIOUT). The C64 is already pulling CLOCK.
+static bool SendByte(u8 data, bool EOI)
+{
+	Release(IECRecorder::LINE_CLOCK);
+	if (WaitFor(IECRecorder::LINE_DATA, true, T_HUNG) < 0)
+		return Timeout("listener ready");
+	if (EOI)
+	{
+		if (WaitFor(IECRecorder::LINE_DATA, false, T_HUNG) < 0 || WaitFor(IECRecorder::LINE_DATA, true, T_HUNG) < 0)
+			return Timeout("EOI acknowledge");
+	}
+	Pull(IECRecorder::LINE_CLOCK);
+	for (int bit = 0; bit < 8; ++bit)
+	{
+		if (data & (1 << bit))
+			Release(IECRecorder::LINE_DATA);
+		else
+			Pull(IECRecorder::LINE_DATA);
+		Wait(T_S);
+		Release(IECRecorder::LINE_CLOCK);
+		Wait(T_V);
+		Pull(IECRecorder::LINE_CLOCK);
+		Release(IECRecorder::LINE_DATA);
+	}
+	if (!Deadline(WaitFor(IECRecorder::LINE_DATA, false, T_F), T_F, "frame handshake"))
+		return false;
+	Wait(T_BB);
+	return true;
+}
+
+// Kernal as listener (ACPTR). Returns -1 on a timeout.
+static int ReceiveByte(bool& EOI)
+{
+	u8 data = 0;
+
+	EOI = false;
+	if (WaitFor(IECRecorder::LINE_CLOCK, true, T_HUNG) < 0)
+	{
+		Timeout("talker ready");
+		return -1;
+	}
+	Release(IECRecorder::LINE_DATA);
+	int time = WaitFor(IECRecorder::LINE_CLOCK, false, T_NE);
+	if (time < 0)
+	{
+		EOI = true;
+		Pull(IECRecorder::LINE_DATA);
+		Wait(T_EI);
+		Release(IECRecorder::LINE_DATA);
+		if (!Deadline(WaitFor(IECRecorder::LINE_CLOCK, false, T_YE), T_YE, "byte after EOI"))
+			return -1;
+	}
+	else
+	{
+		Deadline(time, T_NE, "byte start");
+	}
+	for (int bit = 0; bit < 8; ++bit)
+	{
+		if (WaitFor(IECRecorder::LINE_CLOCK, true, T_HUNG) < 0)
+		{
+			Timeout("bit valid");
+			return -1;
+		}
+		if (Released(IECRecorder::LINE_DATA))
+			data |= 1 << bit;
+		if (WaitFor(IECRecorder::LINE_CLOCK, false, T_HUNG) < 0)
+		{
+			Timeout("bit end");
+			return -1;
+		}
+	}
+	Pull(IECRecorder::LINE_DATA);
+	return data;
+}
+
+// LISTEN, TALK, SECOND, TKSA, UNLISTEN and UNTALK are sent under ATN.
+// After TALK the C64 turns around to be the listener, pulling DATA before it releases ATN.
+static bool SendCommand(const u8* command, int length, bool turnAround = false)
+{
+	Pull(IECRecorder::LINE_ATN | IECRecorder::LINE_CLOCK);
+	Release(IECRecorder::LINE_DATA);
+	if (!Deadline(WaitFor(IECRecorder::LINE_DATA, false, T_AT), T_AT, "ATN response"))
+		return false;
+	for (int index = 0; index < length; ++index)
+	{
+		if (!SendByte(command[index], false))
+			return false;
+	}
+	Wait(T_R);
+	if (turnAround)
+	{
+		Pull(IECRecorder::LINE_DATA);
+		Release(IECRecorder::LINE_ATN);
+		Release(IECRecorder::LINE_CLOCK);
+	}
+	else
+	{
+		Release(IECRecorder::LINE_ATN);
+	}
+	return true;
+}
+
+static bool Unlisten()
+{
+	u8 command[] = { 0x3f };
+	bool sent = SendCommand(command, sizeof(command));
+	Release(IECRecorder::LINE_CLOCK | IECRecorder::LINE_DATA);
+	return sent;
+}
+
+// LOAD"name",8 as the Kernal does it;- OPEN, TALK and read to EOI, CLOSE.
+static int Load(const u8* name, int nameLength, u8* data)
+{
+	int length = 0;
+	bool EOI = false;
+	u8 open[] = { 0x28, 0xf0 };
+	u8 talk[] = { 0x48, 0x60 };
+	u8 untalk[] = { 0x5f };
+	u8 close[] = { 0x28, 0xe0 };
+
+	if (!SendCommand(open, sizeof(open)))
+		return -1;
+	for (int index = 0; index < nameLength; ++index)
+	{
+		if (!SendByte(name[index], index == nameLength - 1))
+			return -1;
+	}
+	if (!Unlisten())
+		return -1;
+
+	if (!SendCommand(talk, sizeof(talk), true))
+		return -1;
+	if (!Deadline(WaitFor(IECRecorder::LINE_CLOCK, false, T_AT), T_AT, "talk turn around"))
+		return -1;
+	while (!EOI)
+	{
+		int byte = ReceiveByte(EOI);
+		if (byte < 0)
+			return -1;
+		if (length < MAX_FILE_SIZE)
+			data[length] = byte;
+		length++;
+	}
+	Wait(T_BB);
+	if (!SendCommand(untalk, sizeof(untalk)))
+		return -1;
+	Release(IECRecorder::LINE_CLOCK | IECRecorder::LINE_DATA);
+	Wait(T_BB);
+
+	if (!SendCommand(close, sizeof(close)) || !Unlisten())
+		return -1;
+	return length;
+}
+
+// Finds the file in the directory and reads its chain of sectors straight from the GCR. Returns the file's length or -1.
+static int ReadFile(u8* name, int& nameLength, u8* data)
+{
+	u8 sector[256];
+	u32 directoryTrack = 18;
+	u32 directorySector = 1;
+	int directorySectors = 0;
+
+	while (directoryTrack != 0 && directorySectors++ < 18)
+	{
+		if (!diskImage.GetDecodedSector(directoryTrack, directorySector, sector))
+			return -1;
+		for (int entry = 0; entry < 8; ++entry)
+		{
+			const u8* dirEntry = sector + entry * 32;
+			if ((dirEntry[2] & 0x87) != 0x82)	// Closed PRG
+				continue;
+			int entryNameLength = 0;
+			while (entryNameLength < 16 && dirEntry[5 + entryNameLength] != 0xa0)
+				entryNameLength++;
+			if (nameLength != 0 && (nameLength != entryNameLength || memcmp(name, dirEntry + 5, nameLength) != 0))
+				continue;
+			memcpy(name, dirEntry + 5, entryNameLength);
+			nameLength = entryNameLength;
+
+			int length = 0;
+			u32 track = dirEntry[3];
+			u32 fileSector = dirEntry[4];
+			while (track != 0)
+			{
+				if (!diskImage.GetDecodedSector(track, fileSector, sector) || length + 254 > MAX_FILE_SIZE)
+					return -1;
+				int bytes = sector[0] ? 254 : sector[1] - 1;
+				memcpy(data + length, sector + 2, bytes);
+				length += bytes;
+				track = sector[0];
+				fileSector = sector[1];
+			}
+			return length;
+		}
+		directoryTrack = sector[0];
+		directorySector = sector[1];
+	}
+	return -1;
+}
+
+// Returns true if the file loaded byte for byte.
+static bool Test(const char* image)
+{
+	static u8 expected[MAX_FILE_SIZE];
+	static u8 loaded[MAX_FILE_SIZE];
+	char path[256];
+	u8 name[17];
+	int nameLength = 0;
+
+	strncpy(path, image, sizeof(path) - 1);
+	path[sizeof(path) - 1] = 0;
+	char* colon = strrchr(path, ':');
+	if (colon)
+	{
+		*colon++ = 0;
+		nameLength = strlen(colon) < 16 ? strlen(colon) : 16;
+		memcpy(name, colon, nameLength);
+	}
+
+	if (!HostOpenImage(&diskImage, path, &diskImageFileInfo))
+	{
+		printf("FAIL %s can not open\n", path);
+		return false;
+	}
+	int expectedLength = ReadFile(name, nameLength, expected);
+	name[nameLength] = 0;
+	if (expectedLength < 0)
+	{
+		printf("FAIL %s no file %s in the directory\n", path, nameLength ? (char*)name : "");
+		return false;
+	}
+
+	c64Lines = 0;
+	cycles = 0;
+	slack = T_HUNG;
+	slackWhere = "";
+	HostReset1541(&diskImage, false);
+	Wait(FAST_BOOT_CYCLES);
+	u32 startCycles = cycles;
+	int length = Load(name, nameLength, loaded);
+
+	int mismatch = -1;
+	if (length == expectedLength)
+	{
+		for (int index = 0; index < length && mismatch < 0; ++index)
+		{
+			if (loaded[index] != expected[index])
+				mismatch = index;
+		}
+	}
+	bool passed = length == expectedLength && mismatch < 0;
+
+	printf("%s %s:%s %d/%d bytes %u cycles slack %d (%s)", passed ? "PASS" : "FAIL", path, name, length, expectedLength, cycles - startCycles, slack, slackWhere);
+	if (mismatch >= 0)
+		printf(" byte %d is %02x not %02x", mismatch, loaded[mismatch], expected[mismatch]);
+	if (length < 0 || verbose)
+		printf(" PC %04x track %d.%d", pi1541.m6502.GetPC(), pi1541.drive.Track() >> 1, pi1541.drive.Track() & 1 ? 5 : 0);
+	printf("\n");
+	return passed;
+}
+
+int main(int argc, char** argv)
+{
+	const char* list = 0;
+	int arg = 1;
+	int failed = 0;
+
+	for (; arg < argc && argv[arg][0] == '-'; ++arg)
+	{
+		if (strcmp(argv[arg], "-v") == 0)
+			verbose = true;
+		else if (strcmp(argv[arg], "-l") == 0 && arg + 1 < argc)
+			list = argv[++arg];
+	}
+	if (arg >= argc || (arg + 1 >= argc && list == 0))
+	{
+		printf("usage: iecharness [-v] [-l list] rom [image[:name]]...\n");
+		return 2;
+	}
+	if (!HostLoadROM(argv[arg]))
+	{
+		printf("%s is not a 16K 1541 ROM\n", argv[arg]);
+		return 2;
+	}
+
+	for (++arg; arg < argc; ++arg)
+		failed += !Test(argv[arg]);
+
+	if (list)
+	{
+		FILE* file = fopen(list, "r");
+		char line[256];
+		if (file == 0)
+		{
+			printf("Can not open %s\n", list);
+			return 2;
+		}
+		while (fgets(line, sizeof(line), file))
+		{
+			line[strcspn(line, "\r\n")] = 0;
+			if (line[0] && line[0] != '#')
+				failed += !Test(line);
+		}
+		fclose(file);
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,308 @@
+// Pi1541 - A Commodore 1541 disk drive emulator
+// Copyright(C) 2018 Stephen White
+//
+// This file is part of Pi1541.
+//
+// Pi1541 is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Pi1541 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
+
+// Replays an iec_recording.bin (RecordIEC = 1) through the same emulation core, feeding the drive the recorded bus inputs
+// cycle for cycle, and reports the first cycle where what the drive put on the bus differs from the recording.
+//
+// iecreplay [-v] [-c cycles] iec_recording.bin rom image...
+//	the images are given in caddy order
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "HostStubs.h"
+#include "IECRecorder.h"
+#include "iec_bus.h"
+#include "Pi1541.h"
+#include "ROMs.h"
+#include "options.h"
+
+extern Pi1541 pi1541;
+extern ROMs roms;
+extern Options options;
+
+static IECRecorder replay;
+static Snapshot startState;
+static DiskImage images[IECRecorder::MAX_IMAGES];
+static FILINFO imageFileInfos[IECRecorder::MAX_IMAGES];
+
+static IECRecorder::Header header;
+static const IECRecorder::Event* events;
+static u32 eventsToCheck;		// Events from cycles that were recorded completely
+static u32 eventsChecked = 0;
+static u32 nextInput = 0;
+static u32 nextInsert = 0;
+static u32 reads = 0;
+static bool verbose = false;
+
+static const char* EventName(u8 type)
+{
+	switch (type)
+	{
+		case IECRecorder::EVENT_INPUT: return "in";
+		case IECRecorder::EVENT_OUTPUT: return "out";
+		case IECRecorder::EVENT_INSERT: return "insert";
+	}
+	return "?";
+}
+
+static void PrintLines(const char* prefix, const IECRecorder::Event& event)
+{
+	if (event.type == IECRecorder::EVENT_INSERT)
+	{
+		printf("%s%10u insert %d\n", prefix, event.cycle, event.value);
+		return;
+	}
+	printf("%s%10u %-3s %s%s%s%s%s\n", prefix, event.cycle, EventName(event.type),
+		event.value & IECRecorder::LINE_ATN ? " ATN" : "",
+		event.value & IECRecorder::LINE_DATA ? " DATA" : "",
+		event.value & IECRecorder::LINE_CLOCK ? " CLOCK" : "",
+		event.value & IECRecorder::LINE_SRQ ? " SRQ" : "",
+		event.value & IECRecorder::LINE_RESET ? " RESET" : "");
+}
+
+// Sets the pins to what the drive read on the cycle it is about to emulate.
+static void ReadEmulationMode1541()
+{
+	while (nextInput < header.eventCount && events[nextInput].cycle <= reads)
+	{
+		if (events[nextInput].type == IECRecorder::EVENT_INPUT)
+			hostGPLEV0 = IEC_Bus::GetGPLEV0ForInputLines(events[nextInput].value);
+		nextInput++;
+	}
+	IEC_Bus::ReadEmulationMode1541();
+	reads++;
+}
+
+// The disk swaps recorded at the end of this cycle.
+static bool InsertDisks()
+{
+	while (nextInsert < header.eventCount && events[nextInsert].cycle <= replay.Cycle())
+	{
+		const IECRecorder::Event& event = events[nextInsert++];
+		if (event.type != IECRecorder::EVENT_INSERT)
+			continue;
+		if (event.value >= header.imageCount)
+		{
+			printf("Recording inserts image %d but only %d were recorded\n", event.value, header.imageCount);
+			return false;
+		}
+		pi1541.drive.Insert(&images[event.value]);
+		replay.Insert(event.value);
+	}
+	return true;
+}
+
+// Returns false at the first event that differs from the recording.
+static bool Check()
+{
+	while (eventsChecked < replay.EventCount() && eventsChecked < eventsToCheck)
+	{
+		const IECRecorder::Event& event = replay.GetEvent(eventsChecked);
+		const IECRecorder::Event& expected = events[eventsChecked];
+		if (verbose)
+			PrintLines("", event);
+		if (event.cycle != expected.cycle || event.type != expected.type || event.value != expected.value)
+		{
+			printf("Diverged at event %u, PC %04x track %d.%d\n", eventsChecked, pi1541.m6502.GetPC(), pi1541.drive.Track() >> 1, pi1541.drive.Track() & 1 ? 5 : 0);
+			PrintLines("  recorded ", expected);
+			PrintLines("  replayed ", event);
+			return false;
+		}
+		eventsChecked++;
+	}
+	return true;
+}
+
+static bool LoadRecording(const char* path)
+{
+	u32 size;
+	u8* data = HostLoadFile(path, size);
+	if (data == 0 || size < sizeof(header))
+	{
+		printf("Can not read %s\n", path);
+		return false;
+	}
+
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != IECRecorder::MAGIC || header.version != IECRecorder::VERSION)
+	{
+		printf("%s is not a version %d IEC recording\n", path, IECRecorder::VERSION);
+		return false;
+	}
+	if (size != sizeof(header) + header.startStateSize + header.eventCount * sizeof(IECRecorder::Event) || !startState.Load(data + sizeof(header), header.startStateSize))
+	{
+		printf("%s is truncated\n", path);
+		return false;
+	}
+	events = (const IECRecorder::Event*)(data + sizeof(header) + header.startStateSize);
+
+	for (eventsToCheck = 0; eventsToCheck < header.eventCount; ++eventsToCheck)
+	{
+		if (events[eventsToCheck].cycle >= header.cycles)
+			break;
+	}
+
+#if defined(EXPERIMENTALZERO)
+	if ((header.flags & IECRecorder::FLAG_INTEGER_DRIVE_MODEL) == 0)
+#else
+	if ((header.flags & IECRecorder::FLAG_INTEGER_DRIVE_MODEL) != 0)
+#endif
+		printf("Warning: recorded with the other drive model (make MODEL=%s)\n", (header.flags & IECRecorder::FLAG_INTEGER_DRIVE_MODEL) ? "zero" : "float");
+	if (header.flags & IECRecorder::FLAG_TRUNCATED)
+		printf("Warning: the recording filled up at cycle %u\n", header.cycles);
+	return true;
+}
+
+static bool LoadROM(const char* path)
+{
+	if (!HostLoadROM(path))
+	{
+		printf("%s is not a %d byte ROM\n", path, ROMs::ROM_SIZE);
+		return false;
+	}
+	if (HashBuffer(roms.ROMImages[0], ROMs::ROM_SIZE) != header.ROMHash)
+	{
+		printf("%s is not the ROM that was recorded (%s)\n", path, header.ROMName);
+		return false;
+	}
+	return true;
+}
+
+static bool LoadImages(char** paths, u32 count)
+{
+	if (count != header.imageCount)
+	{
+		printf("Recorded with %d images in the caddy:\n", header.imageCount);
+		for (u32 index = 0; index < header.imageCount; ++index)
+			printf("  %s\n", header.imageNames[index]);
+		return false;
+	}
+	for (u32 index = 0; index < count; ++index)
+	{
+		if (!HostOpenImage(&images[index], paths[index], &imageFileInfos[index]))
+		{
+			printf("Can not open %s\n", paths[index]);
+			return false;
+		}
+		if (images[index].HashTracks() != header.imageHashes[index])
+		{
+			printf("%s is not the image that was recorded (%s)\n", paths[index], header.imageNames[index]);
+			return false;
+		}
+		images[index].SetReadOnly((header.readOnlyImages & (1 << index)) != 0);
+	}
+	return true;
+}
+
+// Sets up the 1541 the way main.cpp's Emulate1541 does and then puts it in the state it was recorded from.
+static bool Reset()
+{
+	char optionsText[256];
+	bool extraRAM = (header.flags & IECRecorder::FLAG_EXTRA_RAM) != 0;
+
+	snprintf(optionsText, sizeof(optionsText), "extraRAM = %d\nRAMBOard = %d\n", extraRAM, (header.flags & IECRecorder::FLAG_RAM_BOARD) != 0);
+	options.Process(optionsText);
+	IEC_Bus::SetInvertIECInputs((header.flags & IECRecorder::FLAG_INVERT_IEC_INPUTS) != 0);
+	IEC_Bus::SetIgnoreReset((header.flags & IECRecorder::FLAG_IGNORE_RESET) != 0);
+	hostGPLEV0 = IEC_Bus::GetGPLEV0ForInputLines(events[0].value);
+
+	HostReset1541(&images[header.firstImage], extraRAM);
+
+	if (!startState.BeginRestore(Snapshot::MACHINE_1541))
+		return false;
+	pi1541.SerialiseState(startState, false);
+	if (!startState.End())
+	{
+		printf("The recording's start state does not match this build\n");
+		return false;
+	}
+	return replay.Begin(header, startState);
+}
+
+int main(int argc, char** argv)
+{
+	u32 stopCycle = 0xffffffff;
+	int arg = 1;
+
+	for (; arg < argc && argv[arg][0] == '-'; ++arg)
+	{
+		if (strcmp(argv[arg], "-v") == 0)
+			verbose = true;
+		else if (strcmp(argv[arg], "-c") == 0 && arg + 1 < argc)
+			stopCycle = strtoul(argv[++arg], 0, 0);
+	}
+	if (argc - arg < 3)
+	{
+		printf("usage: iecreplay [-v] [-c cycles] iec_recording.bin rom image...\n");
+		return 2;
+	}
+
+	if (!LoadRecording(argv[arg]) || !LoadROM(argv[arg + 1]) || !LoadImages(argv + arg + 2, argc - arg - 2))
+		return 2;
+	if (header.eventCount == 0 || header.firstImage >= header.imageCount || !Reset())
+		return 2;
+	if (stopCycle > header.cycles)
+		stopCycle = header.cycles;
+
+	IEC_Bus::recorder = &replay;
+	bool refreshOutsAfterCPUStep = (header.flags & IECRecorder::FLAG_REFRESH_OUTS_AFTER_CPU_STEP) != 0;
+	bool matched = true;
+
+	while (matched && reads < header.fastBootCycles && reads < stopCycle)
+	{
+		ReadEmulationMode1541();
+		pi1541.m6502.SYNC();
+		pi1541.m6502.Step();
+		pi1541.Update();
+		matched = Check();
+	}
+
+	while (matched && reads < stopCycle)
+	{
+		if (refreshOutsAfterCPUStep)
+			ReadEmulationMode1541();
+
+		pi1541.m6502.Step();
+
+		if (refreshOutsAfterCPUStep)
+			IEC_Bus::RefreshOuts1541();
+
+		IEC_Bus::OutputLED = pi1541.drive.IsLEDOn();
+		pi1541.Update();
+
+		if (!refreshOutsAfterCPUStep)
+		{
+			ReadEmulationMode1541();
+			IEC_Bus::RefreshOuts1541();
+		}
+		matched = InsertDisks() && Check();
+	}
+	IEC_Bus::recorder = 0;
+
+	if (!matched)
+		return 1;
+	if (stopCycle == header.cycles && eventsChecked < eventsToCheck)
+	{
+		printf("Replay is missing events from event %u\n", eventsChecked);
+		PrintLines("  recorded ", events[eventsChecked]);
+		return 1;
+	}
+	printf("%u cycles and %u events replayed as recorded\n", reads, eventsChecked);
+	return 0;
+}
@@ -0,0 +1,599 @@
+// Pi1541 - A Commodore 1541 disk drive emulator
+// Copyright(C) 2018 Stephen White
+//
+// This file is part of Pi1541.
+//
+// Pi1541 is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Pi1541 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
+
+// Checks and converts disk images with the same DiskImage and gcr.cpp code the Pi uses, so a collection can be
+// sorted out before it goes onto the SD card. Each image is opened as Pi1541 would open it and every 1541 track is
+// checked for CBM DOS errors and bad GCR, and for the longest run of 0 bits the drive's noise model goes by. When
+// converting, the new image is read back and every sector that decoded from the original has to decode the same from
+// the copy (and a G64's tracks have to be identical).
+//
+// imagetool [-j jobs] [-t d64|g64|nib|nbz] [-o dir] [-e] [-l list] image...
+//	-t	convert each image to this type, next to the original or under dir (keeping the path the image was given by)
+//	-e	write D64s with error info
+//	-j	images are shared out between this many processes, one per core by default
+//	-l	list holds one image per line ("-" for stdin)
+// Prints a JSON object per image on its own line and exits with 1 if any image could not be read, converted or verified.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "HostStubs.h"
+#include "DiskImage.h"
+#include "gcr.h"
+
+struct Image
+{
+	char* path;		// Absolute, as the worker runs from /
+	char* relative;	// Where a converted copy goes under the output directory
+};
+
+static Image* images = 0;
+static int imageCount = 0;
+static DiskImage::DiskType convertTo = DiskImage::NONE;
+static const char* outputDirectory = 0;
+static bool errorInfo = false;
+
+static DiskImage source;
+static DiskImage copy;
+static FILINFO sourceInfo;
+static FILINFO copyInfo;
+
+// Grows as needed; a report with an error string for every track can be long.
+struct Report
+{
+	char* text;
+	size_t length;
+	size_t capacity;
+};
+
+static void Append(Report& report, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+static void Append(Report& report, const char* format, ...)
+{
+	va_list args;
+
+	for (;;)
+	{
+		va_start(args, format);
+		int length = vsnprintf(report.text + report.length, report.capacity - report.length, format, args);
+		va_end(args);
+		if (length < 0)
+			return;
+		if (report.length + length < report.capacity)
+		{
+			report.length += length;
+			return;
+		}
+		report.capacity = (report.capacity + length) * 2;
+		report.text = (char*)realloc(report.text, report.capacity);
+	}
+}
+
+static void AppendString(Report& report, const char* string)
+{
+	Append(report, "\"");
+	for (; *string; ++string)
+	{
+		unsigned char c = *string;
+		if (c == '"' || c == '\\')
+			Append(report, "\\%c", c);
+		else if (c < 0x20)
+			Append(report, "\\u%04x", c);
+		else
+			Append(report, "%c", c);
+	}
+	Append(report, "\"");
+}
+
+static const char* TypeName(DiskImage::DiskType type)
+{
+	switch (type)
+	{
+		case DiskImage::D64: return "D64";
+		case DiskImage::G64: return "G64";
+		case DiskImage::NIB: return "NIB";
+		case DiskImage::NBZ: return "NBZ";
+		case DiskImage::D71: return "D71";
+		case DiskImage::D81: return "D81";
+		case DiskImage::T64: return "T64";
+		case DiskImage::PRG: return "PRG";
+		default: return "unknown";
+	}
+}
+
+static const char* Extension(DiskImage::DiskType type)
+{
+	switch (type)
+	{
+		case DiskImage::D64: return "d64";
+		case DiskImage::G64: return "g64";
+		case DiskImage::NIB: return "nib";
+		case DiskImage::NBZ: return "nbz";
+		default: return 0;
+	}
+}
+
+static bool MakeParentDirectories(char* path)
+{
+	for (char* slash = strchr(path + 1, '/'); slash; slash = strchr(slash + 1, '/'))
+	{
+		*slash = 0;
+		bool made = mkdir(path, 0777) == 0 || errno == EEXIST;
+		*slash = '/';
+		if (!made)
+			return false;
+	}
+	return true;
+}
+
+// Half track index (0 is track 1) as a track number the way nibtools prints them.
+static void AppendTrack(Report& report, unsigned halfTrack)
+{
+	Append(report, "\"%d%s\"", (halfTrack >> 1) + 1, halfTrack & 1 ? ".5" : "");
+}
+
+// Checks every 1541 track for DOS errors and bad GCR. Returns the number of sectors with errors on DOS tracks.
+static int CheckTracks(Report& report)
+{
+	BYTE id[3] = { 0 };
+	char errors[1024];
+	int sectorErrors = 0;
+	int badGCRTotal = 0;
+	int tracks = 0;
+	int halfTracks = 0;
+	int nonDOSTracks = 0;
+	bool first = true;
+
+	extract_id(source.TrackData(34), id);
+
+	Append(report, ",\"problems\":[");
+	for (unsigned halfTrack = 0; halfTrack < HALF_TRACK_COUNT; ++halfTrack)
+	{
+		if (!source.IsTrackUsed(halfTrack) || source.TrackLength(halfTrack) == 0)
+			continue;
+
+		BYTE* data = source.TrackData(halfTrack);
+		int length = source.TrackLength(halfTrack);
+		int badGCR = check_bad_gcr(data, length, 0);
+		int errorCount = 0;
+		bool nonDOS = false;
+
+		badGCRTotal += badGCR;
+		if (halfTrack & 1)
+			halfTracks++;
+		else
+		{
+			tracks++;
+			// check_errors numbers half tracks from 2 for track 1.
+			errorCount = check_errors(data, length, halfTrack + 2, id, errors);
+			nonDOS = errorCount == sector_map_1541[(halfTrack >> 1) + 1];
+			if (nonDOS)
+				nonDOSTracks++;
+			else
+				sectorErrors += errorCount;
+		}
+
+		if (badGCR == 0 && errorCount == 0)
+			continue;
+
+		Append(report, "%s{\"track\":", first ? "" : ",");
+		AppendTrack(report, halfTrack);
+		Append(report, ",\"length\":%d,\"density\":%d,\"badGCR\":%d", length, source.TrackDensity(halfTrack), badGCR);
+		if (nonDOS)
+			Append(report, ",\"nonDOS\":true");
+		else if (errorCount)
+		{
+			Append(report, ",\"errors\":");
+			AppendString(report, errors);
+		}
+		Append(report, "}");
+		first = false;
+	}
+	Append(report, "],\"tracks\":%d,\"halfTracks\":%d,\"nonDOSTracks\":%d,\"sectorErrors\":%d,\"badGCR\":%d", tracks, halfTracks, nonDOSTracks, sectorErrors, badGCRTotal);
+	return sectorErrors;
+}
+
+// The drive skips modelling flux noise on a track by its longest run of 0 bits so DiskImage's table driven count
+// is checked against one done a bit at a time. Returns the number of tracks where they differ.
+static int CheckZeroRuns(Report& report)
+{
+	int mismatches = 0;
+	bool first = true;
+
+	Append(report, ",\"zeroRunMismatches\":[");
+	for (unsigned halfTrack = 0; halfTrack < HALF_TRACK_COUNT; ++halfTrack)
+	{
+		const BYTE* data = source.TrackData(halfTrack);
+		unsigned length = source.TrackLength(halfTrack);
+		unsigned run = 0;
+		unsigned longest = 0;
+
+		// Twice round, as DiskImage does, so a run across the end of the track is counted whole.
+		for (unsigned bit = 0; bit < length * 16; ++bit)
+		{
+			if (data[(bit >> 3) % length] & (0x80 >> (bit & 7)))
+			{
+				if (run > longest)
+					longest = run;
+				run = 0;
+			}
+			else
+				run++;
+		}
+		if (run > longest || longest > 255 || length == 0)
+			longest = 255;
+
+		if (source.LongestZeroRun(halfTrack) == longest)
+			continue;
+
+		Append(report, "%s{\"track\":", first ? "" : ",");
+		AppendTrack(report, halfTrack);
+		Append(report, ",\"zeroRun\":%d,\"expected\":%d}", source.LongestZeroRun(halfTrack), longest);
+		first = false;
+		mismatches++;
+	}
+	Append(report, "]");
+	return mismatches;
+}
+
+// Every sector that decodes from the source has to decode to the same data from the copy.
+// Returns the number of sectors and tracks that did not.
+static int Verify(Report& report)
+{
+	u8 expected[256];
+	u8 actual[256];
+	int mismatches = 0;
+	bool first = true;
+
+	Append(report, ",\"mismatches\":[");
+	for (unsigned halfTrack = 0; halfTrack < 40 * 2; halfTrack += 2)
+	{
+		if (!source.IsTrackUsed(halfTrack))
+			continue;
+
+		unsigned sectors = DiskImage::SectorsPerTrackD64(halfTrack >> 1);
+		for (unsigned sector = 0; sector < sectors; ++sector)
+		{
+			if (source.DecodeSector(halfTrack, sector, expected) != SECTOR_OK)
+				continue;
+			if (copy.IsTrackUsed(halfTrack) && copy.DecodeSector(halfTrack, sector, actual) == SECTOR_OK && memcmp(expected, actual, sizeof(actual)) == 0)
+				continue;
+
+			Append(report, "%s{\"track\":", first ? "" : ",");
+			AppendTrack(report, halfTrack);
+			Append(report, ",\"sector\":%d}", sector);
+			first = false;
+			mismatches++;
+		}
+	}
+
+	// A G64 keeps the tracks exactly as they are in memory.
+	if (convertTo == DiskImage::G64)
+	{
+		for (unsigned halfTrack = 0; halfTrack < HALF_TRACK_COUNT; ++halfTrack)
+		{
+			if (!source.IsTrackUsed(halfTrack) || source.TrackLength(halfTrack) == 0)
+				continue;
+			if (copy.TrackLength(halfTrack) == source.TrackLength(halfTrack) && memcmp(copy.TrackData(halfTrack), source.TrackData(halfTrack), source.TrackLength(halfTrack)) == 0)
+				continue;
+
+			Append(report, "%s{\"track\":", first ? "" : ",");
+			AppendTrack(report, halfTrack);
+			Append(report, "}");
+			first = false;
+			mismatches++;
+		}
+	}
+	Append(report, "]");
+	return mismatches;
+}
+
+// Returns why the image could not be converted, or 0 if it was and the copy checked out.
+static const char* Convert(const Image& image, Report& report)
+{
+	char outputPath[PATH_MAX];
+	const char* name = outputDirectory ? image.relative : image.path;
+	const char* extension = strrchr(name, '.');
+	int nameLength = extension && !strchr(extension, '/') ? extension - name : strlen(name);
+
+	if (outputDirectory)
+		snprintf(outputPath, sizeof(outputPath), "%s/%.*s.%s", outputDirectory, nameLength, name, Extension(convertTo));
+	else
+		snprintf(outputPath, sizeof(outputPath), "%.*s.%s", nameLength, name, Extension(convertTo));
+	Append(report, ",\"output\":");
+	AppendString(report, outputPath);
+
+	if (!MakeParentDirectories(outputPath))
+		return "can not make the output directory";
+
+	bool written = false;
+	source.SetReadOnly(false);
+	switch (convertTo)
+	{
+		case DiskImage::D64: written = source.WriteD64(outputPath, errorInfo); break;
+		case DiskImage::G64: written = source.WriteG64(outputPath); break;
+		case DiskImage::NIB: written = source.WriteNIB(outputPath); break;
+		case DiskImage::NBZ: written = source.WriteNBZ(outputPath); break;
+		default: break;
+	}
+	if (!written)
+		return convertTo == DiskImage::D64 ? "no directory track or can not write" : "can not write";
+
+	if (!HostOpenImage(&copy, outputPath, &copyInfo))
+		return "can not read the output back";
+	int mismatches = Verify(report);
+	copy.Close();
+
+	Append(report, ",\"verified\":%s", mismatches ? "false" : "true");
+	return mismatches ? "the output does not match" : 0;
+}
+
+// Appends one image's JSON object to the report. Returns false if it could not be read, converted or verified.
+static bool Process(const Image& image, Report& report)
+{
+	DiskImage::DiskType type = DiskImage::GetDiskImageTypeViaExtention(image.path);
+	const char* failure = 0;
+	int sectorErrors = 0;
+
+	Append(report, "{\"image\":");
+	AppendString(report, image.path);
+	Append(report, ",\"type\":\"%s\"", TypeName(type));
+
+	if (!HostOpenImage(&source, image.path, &sourceInfo))
+	{
+		Append(report, ",\"status\":\"unreadable\"}\n");
+		return false;
+	}
+	Append(report, ",\"hash\":\"%08x\",\"tracksHash\":\"%08x\"", source.GetHash(), source.HashTracks());
+
+	// D71s and D81s are not 1541 GCR images.
+	if (source.IsD71() || source.IsD81())
+	{
+		if (convertTo != DiskImage::NONE)
+			failure = "only 1541 images can be converted";
+	}
+	else
+	{
+		// A .weak file decides where the noise is instead.
+		if (!source.HasWeakMap() && CheckZeroRuns(report))
+			failure = "longest zero runs measured wrongly";
+		sectorErrors = CheckTracks(report);
+		if (failure == 0 && convertTo != DiskImage::NONE)
+			failure = Convert(image, report);
+	}
+
+	if (failure)
+	{
+		Append(report, ",\"status\":\"failed\",\"reason\":");
+		AppendString(report, failure);
+		Append(report, "}\n");
+	}
+	else
+		Append(report, ",\"status\":\"%s\"}\n", sectorErrors ? "errors" : "ok");
+
+	// Nothing is dirty so closing does not write the source back.
+	source.Close();
+	return failure == 0;
+}
+
+static int Work(int worker, int workers, FILE* output)
+{
+	Report report = { 0, 0, 0 };
+	int failed = 0;
+
+	for (int index = worker; index < imageCount; index += workers)
+	{
+		report.length = 0;
+		failed += !Process(images[index], report);
+		fwrite(report.text, 1, report.length, output);
+		fflush(output);
+	}
+	free(report.text);
+	return failed;
+}
+
+// Each worker writes to its own pipe and whole lines are passed on so the output never interleaves.
+static int RunWorkers(int workers)
+{
+	pid_t* pids = (pid_t*)calloc(workers, sizeof(pid_t));
+	struct pollfd* fds = (struct pollfd*)calloc(workers, sizeof(struct pollfd));
+	Report* pending = (Report*)calloc(workers, sizeof(Report));
+	int failed = 0;
+
+	fflush(stdout);
+	for (int worker = 0; worker < workers; ++worker)
+	{
+		int pipeFds[2];
+		if (pipe(pipeFds) != 0)
+		{
+			perror("pipe");
+			return 2;
+		}
+		pids[worker] = fork();
+		if (pids[worker] == 0)
+		{
+			close(pipeFds[0]);
+			FILE* output = fdopen(pipeFds[1], "w");
+			_exit(Work(worker, workers, output) ? 1 : 0);
+		}
+		close(pipeFds[1]);
+		fds[worker].fd = pipeFds[0];
+		fds[worker].events = POLLIN;
+	}
+
+	int open = workers;
+	while (open)
+	{
+		if (poll(fds, workers, -1) < 0 && errno != EINTR)
+			break;
+
+		for (int worker = 0; worker < workers; ++worker)
+		{
+			if (fds[worker].fd < 0 || fds[worker].revents == 0)
+				continue;
+
+			char buffer[4096];
+			ssize_t bytes = read(fds[worker].fd, buffer, sizeof(buffer));
+			if (bytes <= 0)
+			{
+				close(fds[worker].fd);
+				fds[worker].fd = -1;
+				open--;
+				continue;
+			}
+
+			Report& lines = pending[worker];
+			Append(lines, "%.*s", (int)bytes, buffer);
+			char* end = (char*)memrchr(lines.text, '\n', lines.length);
+			if (end)
+			{
+				size_t complete = end + 1 - lines.text;
+				fwrite(lines.text, 1, complete, stdout);
+				memmove(lines.text, end + 1, lines.length - complete);
+				lines.length -= complete;
+			}
+		}
+	}
+	fflush(stdout);
+
+	for (int worker = 0; worker < workers; ++worker)
+	{
+		int status;
+		if (waitpid(pids[worker], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			failed++;
+		free(pending[worker].text);
+	}
+	free(pending);
+	free(fds);
+	free(pids);
+	return failed;
+}
+
+static void AddImage(const char* path)
+{
+	char resolved[PATH_MAX];
+
+	images = (Image*)realloc(images, (imageCount + 1) * sizeof(Image));
+	Image& image = images[imageCount++];
+
+	// The workers run from / so FatFs paths (f_open drops a leading /) are absolute paths.
+	image.path = strdup(realpath(path, resolved) ? resolved : path);
+	if (path[0] == '/')
+	{
+		const char* name = strrchr(path, '/');
+		image.relative = strdup(name + 1);
+	}
+	else
+	{
+		while (strncmp(path, "./", 2) == 0)
+			path += 2;
+		image.relative = strdup(path);
+	}
+}
+
+static DiskImage::DiskType ParseType(const char* name)
+{
+	if (strcasecmp(name, "d64") == 0) return DiskImage::D64;
+	if (strcasecmp(name, "g64") == 0) return DiskImage::G64;
+	if (strcasecmp(name, "nib") == 0) return DiskImage::NIB;
+	if (strcasecmp(name, "nbz") == 0) return DiskImage::NBZ;
+	return DiskImage::NONE;
+}
+
+int main(int argc, char** argv)
+{
+	const char* list = 0;
+	int workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	char resolvedOutput[PATH_MAX];
+	int arg = 1;
+
+	for (; arg < argc && argv[arg][0] == '-' && argv[arg][1]; ++arg)
+	{
+		if (strcmp(argv[arg], "-e") == 0)
+			errorInfo = true;
+		else if (strcmp(argv[arg], "-j") == 0 && arg + 1 < argc)
+			workers = atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc)
+		{
+			convertTo = ParseType(argv[++arg]);
+			if (convertTo == DiskImage::NONE)
+			{
+				fprintf(stderr, "Can only convert to d64, g64, nib or nbz\n");
+				return 2;
+			}
+		}
+		else if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc)
+			outputDirectory = argv[++arg];
+		else if (strcmp(argv[arg], "-l") == 0 && arg + 1 < argc)
+			list = argv[++arg];
+	}
+	if (arg >= argc && list == 0)
+	{
+		fprintf(stderr, "usage: imagetool [-j jobs] [-t d64|g64|nib|nbz] [-o dir] [-e] [-l list] image...\n");
+		return 2;
+	}
+
+	if (outputDirectory)
+	{
+		mkdir(outputDirectory, 0777);
+		if (realpath(outputDirectory, resolvedOutput) == 0)
+		{
+			fprintf(stderr, "Can not make %s\n", outputDirectory);
+			return 2;
+		}
+		outputDirectory = resolvedOutput;
+	}
+
+	for (; arg < argc; ++arg)
+		AddImage(argv[arg]);
+
+	if (list)
+	{
+		FILE* file = strcmp(list, "-") == 0 ? stdin : fopen(list, "r");
+		char line[PATH_MAX];
+		if (file == 0)
+		{
+			fprintf(stderr, "Can not open %s\n", list);
+			return 2;
+		}
+		while (fgets(line, sizeof(line), file))
+		{
+			line[strcspn(line, "\r\n")] = 0;
+			if (line[0] && line[0] != '#')
+				AddImage(line);
+		}
+		if (file != stdin)
+			fclose(file);
+	}
+
+	if (chdir("/") != 0)
+		return 2;
+	if (workers > imageCount)
+		workers = imageCount;
+	if (workers <= 1)
+		return Work(0, 1, stdout) ? 1 : 0;
+	return RunWorkers(workers) ? 1 : 0;
+}
@@ -0,0 +1,539 @@
+// Pi1541 - A Commodore 1541 disk drive emulator
+// Copyright(C) 2018 Stephen White
+//
+// This file is part of Pi1541.
+//
+// Pi1541 is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Pi1541 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
+
+// Serves a folder of disk images to Pi1541s on the LAN (NetDiskServer in options.txt), so one collection can be kept
+// on a PC instead of on every SD card. Images are opened with the same DiskImage code the Pi uses and handed out as GCR
+// tracks, which the Pi fetches as its drive needs them. Tracks the drive wrote to come back when the Pi closes the
+// image and are written into the image file (through a temporary file, so a failed write leaves the original).
+//
+// netdiskd [-p port] [-w] folder
+//	-p	UDP port to listen on, 6464 by default
+//	-w	take writes; without it every image is read only
+// netdiskd -n cards folder
+//	writes a .net file under cards for every D64, G64, NIB and NBZ under folder, to copy onto the SD card
+// netdiskd -t
+//	self test;- serves a blank G64 from a temporary folder, writes to it as a Pi would and checks the change was saved
+//
+// The protocol is described in src/net-disk.h. Replies are remembered per client so a request the Pi sends again
+// (because the reply was lost) gets the same reply rather than being done twice.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include "HostStubs.h"
+#include "DiskImage.h"
+
+// From src/net-disk.h
+enum Opcode { OP_MOUNT = 1, OP_READ = 2, OP_WRITE = 3, OP_CLOSE = 4 };
+enum Status { STATUS_OK = 0, STATUS_NOT_FOUND = 1, STATUS_READ_ONLY = 2, STATUS_BAD_REQUEST = 3, STATUS_IO_ERROR = 4 };
+static const u8 FLAG_READ_ONLY = 1 << 0;
+static const unsigned HEADER_LENGTH = 12;
+static const unsigned CHUNK_SIZE = 1024;
+static const unsigned DEFAULT_PORT = 6464;
+
+static const unsigned MAX_OPEN = 64;
+static const unsigned MAX_CLIENTS = 16;
+static const unsigned MAX_PACKET = 1500;
+
+struct Header
+{
+	u8 opcode;
+	u8 status;
+	u16 sequence;
+	u16 handle;
+	u8 track;
+	u8 flags;
+	u16 offset;
+	u16 length;
+};
+
+struct Open
+{
+	DiskImage* image;	// 0 for a free slot
+	FILINFO fileInfo;
+	DiskImage::DiskType type;
+	char path[PATH_MAX];
+	bool readOnly;
+	bool written;
+	u8 generation;		// Part of the handle, so a stale one is turned away
+	unsigned long lastUsed;
+};
+
+// The last reply sent to each client
+struct Client
+{
+	sockaddr_in address;
+	u16 sequence;
+	u8 opcode;
+	u8 reply[MAX_PACKET];
+	unsigned replyLength;
+	unsigned long lastUsed;
+};
+
+static const char* root;
+static bool allowWrites = false;
+static Open opens[MAX_OPEN];
+static Client clients[MAX_CLIENTS];
+static unsigned long useCounter = 0;
+
+static void ReadHeader(const u8* buffer, Header& header)
+{
+	header.opcode = buffer[0];
+	header.status = buffer[1];
+	header.sequence = buffer[2] << 8 | buffer[3];
+	header.handle = buffer[4] << 8 | buffer[5];
+	header.track = buffer[6];
+	header.flags = buffer[7];
+	header.offset = buffer[8] << 8 | buffer[9];
+	header.length = buffer[10] << 8 | buffer[11];
+}
+
+static void WriteHeader(u8* buffer, const Header& header)
+{
+	buffer[0] = header.opcode;
+	buffer[1] = header.status;
+	buffer[2] = header.sequence >> 8;
+	buffer[3] = header.sequence;
+	buffer[4] = header.handle >> 8;
+	buffer[5] = header.handle;
+	buffer[6] = header.track;
+	buffer[7] = header.flags;
+	buffer[8] = header.offset >> 8;
+	buffer[9] = header.offset;
+	buffer[10] = header.length >> 8;
+	buffer[11] = header.length;
+}
+
+static bool IsServedType(DiskImage::DiskType type)
+{
+	return type == DiskImage::D64 || type == DiskImage::G64 || type == DiskImage::NIB || type == DiskImage::NBZ;
+}
+
+// Names are relative to the folder and may not climb out of it.
+static bool IsSafeName(const char* name)
+{
+	if (name[0] == 0 || name[0] == '/')
+		return false;
+	for (const char* part = name; part; part = strchr(part, '/'))
+	{
+		if (*part == '/')
+			part++;
+		if (strncmp(part, "..", 2) == 0 && (part[2] == '/' || part[2] == 0))
+			return false;
+	}
+	return true;
+}
+
+static Open* FindOpen(u16 handle)
+{
+	unsigned slot = handle & 0xff;
+	if (slot >= MAX_OPEN || opens[slot].image == 0 || opens[slot].generation != handle >> 8)
+		return 0;
+	opens[slot].lastUsed = ++useCounter;
+	return &opens[slot];
+}
+
+static bool WriteBack(Open& open)
+{
+	char temporary[PATH_MAX + 8];
+	snprintf(temporary, sizeof(temporary), "%s.tmp", open.path);
+
+	bool written = false;
+	bool errorInfo = open.fileInfo.fsize % 257 == 0;
+	open.image->SetReadOnly(false);
+	switch (open.type)
+	{
+		case DiskImage::D64: written = open.image->WriteD64(temporary, errorInfo); break;
+		case DiskImage::G64: written = open.image->WriteG64(temporary); break;
+		case DiskImage::NIB: written = open.image->WriteNIB(temporary); break;
+		case DiskImage::NBZ: written = open.image->WriteNBZ(temporary); break;
+		default: break;
+	}
+	if (written && rename(temporary, open.path) != 0)
+		written = false;
+	if (!written)
+		unlink(temporary);
+	return written;
+}
+
+static bool CloseOpen(Open& open)
+{
+	bool written = true;
+	if (open.written)
+	{
+		written = WriteBack(open);
+		fprintf(stderr, "%s %s\n", written ? "wrote" : "failed to write", open.path);
+	}
+	open.image->Close();
+	delete open.image;
+	open.image = 0;
+	open.generation++;
+	return written;
+}
+
+static u8 Mount(const char* name, Header& reply, u8* data)
+{
+	if (!IsSafeName(name))
+		return STATUS_BAD_REQUEST;
+
+	DiskImage::DiskType type = DiskImage::GetDiskImageTypeViaExtention(name);
+	if (!IsServedType(type))
+		return STATUS_NOT_FOUND;
+
+	char path[PATH_MAX];
+	if (snprintf(path, sizeof(path), "%s/%s", root, name) >= (int)sizeof(path))
+		return STATUS_BAD_REQUEST;
+
+	// Make room by closing the image that has gone longest without a request.
+	Open* open = 0;
+	for (unsigned slot = 0; slot < MAX_OPEN; ++slot)
+	{
+		if (opens[slot].image == 0)
+		{
+			open = &opens[slot];
+			break;
+		}
+		if (open == 0 || opens[slot].lastUsed < open->lastUsed)
+			open = &opens[slot];
+	}
+	if (open->image)
+		CloseOpen(*open);
+
+	strcpy(open->path, path);
+	open->image = new DiskImage();
+	if (!HostOpenImage(open->image, open->path, &open->fileInfo))
+	{
+		delete open->image;
+		open->image = 0;
+		return STATUS_NOT_FOUND;
+	}
+	open->type = type;
+	open->readOnly = !allowWrites || access(open->path, W_OK) != 0;
+	open->written = false;
+	open->lastUsed = ++useCounter;
+	fprintf(stderr, "mounted %s%s\n", open->path, open->readOnly ? " (read only)" : "");
+
+	reply.handle = open->generation << 8 | (open - opens);
+	reply.flags = open->readOnly ? FLAG_READ_ONLY : 0;
+
+	u32 hash = open->image->GetHash();
+	u8* out = data;
+	*out++ = hash >> 24;
+	*out++ = hash >> 16;
+	*out++ = hash >> 8;
+	*out++ = hash;
+	for (unsigned track = 0; track < HALF_TRACK_COUNT; ++track)
+	{
+		unsigned length = open->image->TrackLength(track);
+		*out++ = length >> 8;
+		*out++ = length;
+		*out++ = open->image->TrackDensity(track);
+		*out++ = open->image->IsTrackUsed(track);
+	}
+	reply.length = out - data;
+	return STATUS_OK;
+}
+
+// Fills in the reply to a request and returns its length.
+static unsigned Handle(const u8* packet, unsigned size, u8* replyPacket)
+{
+	Header request;
+	ReadHeader(packet, request);
+	const u8* data = packet + HEADER_LENGTH;
+
+	Header reply = request;
+	reply.length = 0;
+	u8* replyData = replyPacket + HEADER_LENGTH;
+
+	// A read's length is what it wants back, so only mounts and writes carry data.
+	if (request.opcode != OP_READ && request.length > size - HEADER_LENGTH)
+		reply.status = STATUS_BAD_REQUEST;
+	else if (request.opcode == OP_MOUNT)
+	{
+		char name[PATH_MAX];
+		unsigned length = request.length < sizeof(name) - 1 ? request.length : sizeof(name) - 1;
+		memcpy(name, data, length);
+		name[length] = 0;
+		reply.status = Mount(name, reply, replyData);
+		if (reply.status != STATUS_OK)
+			fprintf(stderr, "can not mount %s\n", name);
+	}
+	else
+	{
+		Open* open = FindOpen(request.handle);
+		bool inTrack = request.track < HALF_TRACK_COUNT && request.length <= CHUNK_SIZE && request.offset + request.length <= MAX_TRACK_LENGTH;
+		if (open == 0)
+			reply.status = STATUS_BAD_REQUEST;
+		else if (request.opcode == OP_READ && inTrack)
+		{
+			memcpy(replyData, open->image->TrackData(request.track) + request.offset, request.length);
+			reply.length = request.length;
+		}
+		else if (request.opcode == OP_WRITE && inTrack)
+		{
+			if (open->readOnly)
+				reply.status = STATUS_READ_ONLY;
+			else
+			{
+				memcpy(open->image->TrackData(request.track) + request.offset, data, request.length);
+				open->written = true;
+				reply.length = request.length;
+			}
+		}
+		else if (request.opcode == OP_CLOSE)
+			reply.status = CloseOpen(*open) ? STATUS_OK : STATUS_IO_ERROR;
+		else
+			reply.status = STATUS_BAD_REQUEST;
+	}
+
+	WriteHeader(replyPacket, reply);
+	// A write's reply says how much was written but doesn't carry it back.
+	return HEADER_LENGTH + (request.opcode == OP_WRITE ? 0 : reply.length);
+}
+
+static Client* FindClient(const sockaddr_in& address)
+{
+	Client* oldest = &clients[0];
+	for (unsigned index = 0; index < MAX_CLIENTS; ++index)
+	{
+		Client& client = clients[index];
+		if (client.address.sin_addr.s_addr == address.sin_addr.s_addr && client.address.sin_port == address.sin_port)
+			return &client;
+		if (client.lastUsed < oldest->lastUsed)
+			oldest = &client;
+	}
+	memset(oldest, 0, sizeof(Client));
+	oldest->address = address;
+	return oldest;
+}
+
+static int Serve(unsigned port)
+{
+	int sock = socket(AF_INET, SOCK_DGRAM, 0);
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (sock < 0 || bind(sock, (sockaddr*)&address, sizeof(address)) != 0)
+	{
+		fprintf(stderr, "Can not listen on port %u: %s\n", port, strerror(errno));
+		return 1;
+	}
+	fprintf(stderr, "Serving %s on port %u%s\n", root, port, allowWrites ? "" : " (read only)");
+
+	for (;;)
+	{
+		u8 packet[MAX_PACKET];
+		sockaddr_in from;
+		socklen_t fromLength = sizeof(from);
+		ssize_t size = recvfrom(sock, packet, sizeof(packet), 0, (sockaddr*)&from, &fromLength);
+		if (size < (ssize_t)HEADER_LENGTH)
+			continue;
+
+		Client* client = FindClient(from);
+		client->lastUsed = ++useCounter;
+		u16 sequence = packet[2] << 8 | packet[3];
+		if (client->replyLength == 0 || client->sequence != sequence || client->opcode != packet[0])
+		{
+			client->sequence = sequence;
+			client->opcode = packet[0];
+			client->replyLength = Handle(packet, (unsigned)size, client->reply);
+		}
+		sendto(sock, client->reply, client->replyLength, 0, (sockaddr*)&from, fromLength);
+	}
+}
+
+// FatFs paths on the host drop a leading / (see HostStubs.cpp), so run from / with the folder made absolute.
+static bool SetRoot(const char* folder)
+{
+	static char resolved[PATH_MAX];
+	if (realpath(folder, resolved) == 0 || chdir("/") != 0)
+	{
+		fprintf(stderr, "Can not find %s\n", folder);
+		return false;
+	}
+	root = resolved;
+	return true;
+}
+
+// Sends a request through Handle as if it had come from a Pi.
+static u8 Request(u8 opcode, u16 handle, u8 track, u16 offset, const u8* data, u16 length, Header& reply, u8* replyData)
+{
+	u8 packet[MAX_PACKET];
+	u8 replyPacket[MAX_PACKET];
+	Header request;
+	memset(&request, 0, sizeof(request));
+	request.opcode = opcode;
+	request.handle = handle;
+	request.track = track;
+	request.offset = offset;
+	request.length = length;
+	WriteHeader(packet, request);
+	if (data)
+		memcpy(packet + HEADER_LENGTH, data, length);
+	unsigned replyLength = Handle(packet, HEADER_LENGTH + (data ? length : 0), replyPacket);
+	ReadHeader(replyPacket, reply);
+	if (replyData)
+		memcpy(replyData, replyPacket + HEADER_LENGTH, replyLength - HEADER_LENGTH);
+	return reply.status;
+}
+
+static const unsigned D64_SIZE = 174848;	// 35 tracks, no error info
+
+static int SelfTest()
+{
+	const char* name = "test.g64";
+	const unsigned track = 34;	// Track 18
+	const u16 offset = 100;
+	char folder[] = "/tmp/netdiskd-XXXXXX";
+	char path[PATH_MAX];
+	u8 written[64];
+	u8 replyData[MAX_PACKET];
+	Header reply;
+	bool passed = false;
+
+	if (mkdtemp(folder) == 0 || !SetRoot(folder))
+		return 2;
+	snprintf(path, sizeof(path), "%s/%s", root, name);
+
+	// A blank disk, saved as a G64 so any bytes written to a track come back as they were.
+	{
+		static unsigned char d64[D64_SIZE];
+		FILINFO fileInfo;
+		memset(&fileInfo, 0, sizeof(fileInfo));
+		strcpy(fileInfo.fname, "test.d64");
+		fileInfo.fsize = sizeof(d64);
+		DiskImage* image = new DiskImage();
+		bool created = image->OpenD64(&fileInfo, d64, fileInfo.fsize) && image->WriteG64(path);
+		delete image;
+		if (!created)
+		{
+			fprintf(stderr, "Can not create %s\n", path);
+			unlink(path);
+			rmdir(folder);
+			return 2;
+		}
+	}
+
+	allowWrites = true;
+	for (unsigned index = 0; index < sizeof(written); ++index)
+		written[index] = 0x52 + index;
+
+	if (Request(OP_MOUNT, 0, 0, 0, (const u8*)name, strlen(name), reply, replyData) != STATUS_OK)
+		fprintf(stderr, "FAIL mount\n");
+	else
+	{
+		u16 handle = reply.handle;
+		if (Request(OP_WRITE, handle, track, offset, written, sizeof(written), reply, 0) != STATUS_OK)
+			fprintf(stderr, "FAIL write\n");
+		else if (Request(OP_CLOSE, handle, 0, 0, 0, 0, reply, 0) != STATUS_OK)
+			fprintf(stderr, "FAIL close (the change was not saved)\n");
+		else
+		{
+			DiskImage* image = new DiskImage();
+			FILINFO fileInfo;
+			if (!HostOpenImage(image, path, &fileInfo))
+				fprintf(stderr, "FAIL reopen\n");
+			else if (memcmp(image->TrackData(track) + offset, written, sizeof(written)) != 0)
+				fprintf(stderr, "FAIL the saved image does not hold what was written\n");
+			else
+				passed = true;
+			delete image;
+		}
+	}
+
+	unlink(path);
+	rmdir(folder);
+	printf("%s\n", passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
+
+static const char* cards;
+static int result;
+
+// Writes a .net file under cards for an image found by nftw, keeping the folder layout.
+static int MakePointer(const char* path, const struct stat*, int flag, FTW* ftw)
+{
+	if (ftw->level == 0)
+		return 0;
+	const char* name = path + strlen(root) + 1;
+	char pointer[PATH_MAX];
+	if (flag == FTW_D)
+	{
+		snprintf(pointer, sizeof(pointer), "%s/%s", cards, name);
+		mkdir(pointer, 0777);
+	}
+	else if (flag == FTW_F && IsServedType(DiskImage::GetDiskImageTypeViaExtention(path + ftw->base)))
+	{
+		snprintf(pointer, sizeof(pointer), "%s/%s.net", cards, name);
+		FILE* file = fopen(pointer, "w");
+		if (file == 0 || fprintf(file, "%s\r\n", name) < 0 || fclose(file) != 0)
+		{
+			fprintf(stderr, "Can not write %s\n", pointer);
+			result = 1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned port = DEFAULT_PORT;
+	int arg = 1;
+
+	for (; arg < argc && argv[arg][0] == '-' && argv[arg][1]; ++arg)
+	{
+		if (strcmp(argv[arg], "-w") == 0)
+			allowWrites = true;
+		else if (strcmp(argv[arg], "-p") == 0 && arg + 1 < argc)
+			port = atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc)
+			cards = argv[++arg];
+		else if (strcmp(argv[arg], "-t") == 0)
+			return SelfTest();
+	}
+	if (arg + 1 != argc)
+	{
+		fprintf(stderr, "usage: netdiskd [-p port] [-w] folder\n       netdiskd -n cards folder\n       netdiskd -t\n");
+		return 2;
+	}
+	root = argv[arg];
+
+	if (cards)
+	{
+		mkdir(cards, 0777);
+		if (nftw(root, MakePointer, 16, 0) != 0)
+		{
+			fprintf(stderr, "Can not read %s\n", root);
+			return 1;
+		}
+		return result;
+	}
+	if (!SetRoot(root))
+		return 1;
+	return Serve(port);
+}
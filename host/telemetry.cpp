@@ -0,0 +1,268 @@
+// Pi1541 - A Commodore 1541 disk drive emulator
+// Copyright(C) 2018 Stephen White
+//
+// This file is part of Pi1541.
+//
+// Pi1541 is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Pi1541 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
+
+// Listens for the telemetry Pi1541s send (TelemetryHost in options.txt) and shows every unit
+// on one screen, refreshed each second. Rates are worked out between a unit's last two
+// datagrams; totals are since the unit powered on.
+//
+// telemetry [-p port] [-l]
+//	-p	UDP port to listen on, 6541 by default
+//	-l	print a line per datagram instead of the table, for logging to a file
+//
+// The datagram is described in src/net-telemetry.h.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+typedef unsigned char u8;
+typedef unsigned int u32;
+
+// From src/net-telemetry.h
+static const u8 TELEMETRY_VERSION = 1;
+static const u8 FLAG_MOTOR = 1 << 0;
+static const u8 FLAG_LED = 1 << 1;
+static const u8 FLAG_1541 = 1 << 2;
+static const u8 FLAG_1581 = 1 << 3;
+static const unsigned STATUS_LENGTH = 44;
+static const unsigned DEFAULT_PORT = 6541;
+
+static const unsigned MAX_UNITS = 256;
+// A unit that has sent nothing for this long is shown as silent.
+static const double SILENT_SECONDS = 5.0;
+
+struct Status
+{
+	u8 version;
+	u8 flags;
+	u8 deviceId;
+	u8 track;
+	u32 sequence;
+	u32 uptime;
+	u32 imageHash;
+	u32 cycles;
+	u32 lostCycles;
+	u32 atnChanges;
+	u32 clockChanges;
+	u32 dataChanges;
+	u32 sdBytes;
+	u32 sdRate;
+};
+
+struct Unit
+{
+	in_addr_t address;	// Network order
+	Status last;
+	Status previous;
+	bool hasPrevious;
+	unsigned missed;	// Datagrams lost on the way, from gaps in the sequence
+	double lastSeen;
+};
+
+static Unit units[MAX_UNITS];
+static unsigned unitCount = 0;
+
+static double Now()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static u32 Read32(const u8* buffer)
+{
+	return (u32)buffer[0] << 24 | buffer[1] << 16 | buffer[2] << 8 | buffer[3];
+}
+
+static bool Parse(const u8* buffer, unsigned size, Status& status)
+{
+	if (size < STATUS_LENGTH || buffer[0] != TELEMETRY_VERSION)
+		return false;
+
+	status.version = buffer[0];
+	status.flags = buffer[1];
+	status.deviceId = buffer[2];
+	status.track = buffer[3];
+	status.sequence = Read32(buffer + 4);
+	status.uptime = Read32(buffer + 8);
+	status.imageHash = Read32(buffer + 12);
+	status.cycles = Read32(buffer + 16);
+	status.lostCycles = Read32(buffer + 20);
+	status.atnChanges = Read32(buffer + 24);
+	status.clockChanges = Read32(buffer + 28);
+	status.dataChanges = Read32(buffer + 32);
+	status.sdBytes = Read32(buffer + 36);
+	status.sdRate = Read32(buffer + 40);
+	return true;
+}
+
+static Unit* FindUnit(in_addr_t address)
+{
+	for (unsigned index = 0; index < unitCount; ++index)
+	{
+		if (units[index].address == address)
+			return &units[index];
+	}
+	if (unitCount == MAX_UNITS)
+		return 0;
+
+	Unit* unit = &units[unitCount++];
+	memset(unit, 0, sizeof(Unit));
+	unit->address = address;
+	return unit;
+}
+
+static void Receive(Unit& unit, const Status& status, double now)
+{
+	if (unit.lastSeen != 0 && status.uptime >= unit.last.uptime)
+	{
+		unit.missed += status.sequence - unit.last.sequence - 1;
+		unit.previous = unit.last;
+		unit.hasPrevious = true;
+	}
+	else
+	{
+		// First datagram, or the unit restarted.
+		unit.hasPrevious = false;
+	}
+	unit.last = status;
+	unit.lastSeen = now;
+}
+
+// Per second between the last two datagrams.
+static double Rate(const Unit& unit, u32 Status::* field)
+{
+	if (!unit.hasPrevious || unit.last.uptime == unit.previous.uptime)
+		return 0;
+	return (u32)(unit.last.*field - unit.previous.*field) * 1000.0 / (unit.last.uptime - unit.previous.uptime);
+}
+
+static const char* Drive(const Status& status, char* buffer, size_t size)
+{
+	if (status.flags & FLAG_1541)
+		snprintf(buffer, size, "1541 %2d.%d", (status.track >> 1) + 1, status.track & 1 ? 5 : 0);
+	else if (status.flags & FLAG_1581)
+		snprintf(buffer, size, "1581 %2d  ", status.track + 1);
+	else
+		snprintf(buffer, size, "browsing ");
+	return buffer;
+}
+
+static void PrintLine(const Unit& unit)
+{
+	char drive[16];
+	const Status& status = unit.last;
+	printf("%-15s %2d %s %c%c %08x %7.0f %9u %5.0f %5.0f %5.0f %10u %6u %5u\n",
+		inet_ntoa(*(in_addr*)&unit.address), status.deviceId, Drive(status, drive, sizeof(drive)),
+		status.flags & FLAG_MOTOR ? 'M' : '-', status.flags & FLAG_LED ? 'L' : '-',
+		status.imageHash, Rate(unit, &Status::cycles) / 1000, status.lostCycles,
+		Rate(unit, &Status::atnChanges), Rate(unit, &Status::clockChanges), Rate(unit, &Status::dataChanges),
+		status.sdBytes / 1024, status.sdRate, unit.missed);
+}
+
+static void PrintHeading()
+{
+	printf("%-15s %2s %-9s %2s %-8s %7s %9s %5s %5s %5s %10s %6s %5s\n",
+		"Unit", "ID", "Drive", "", "Image", "kcyc/s", "lost", "ATN/s", "CLK/s", "DAT/s", "SD KB", "KB/s", "missed");
+}
+
+static void Draw(double now)
+{
+	// Clear the terminal and home the cursor.
+	printf("\033[H\033[2J");
+	PrintHeading();
+	for (unsigned index = 0; index < unitCount; ++index)
+	{
+		const Unit& unit = units[index];
+		if (now - unit.lastSeen > SILENT_SECONDS)
+			printf("%-15s silent for %.0fs\n", inet_ntoa(*(in_addr*)&unit.address), now - unit.lastSeen);
+		else
+			PrintLine(unit);
+	}
+	fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned port = DEFAULT_PORT;
+	bool lines = false;
+
+	for (int arg = 1; arg < argc; ++arg)
+	{
+		if (strcmp(argv[arg], "-l") == 0)
+			lines = true;
+		else if (strcmp(argv[arg], "-p") == 0 && arg + 1 < argc)
+			port = atoi(argv[++arg]);
+		else
+		{
+			fprintf(stderr, "usage: telemetry [-p port] [-l]\n");
+			return 2;
+		}
+	}
+
+	int sock = socket(AF_INET, SOCK_DGRAM, 0);
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (sock < 0 || bind(sock, (sockaddr*)&address, sizeof(address)) != 0)
+	{
+		fprintf(stderr, "Can not listen on port %u: %s\n", port, strerror(errno));
+		return 1;
+	}
+
+	if (lines)
+		PrintHeading();
+	double lastDrawn = 0;
+	for (;;)
+	{
+		pollfd fd = { sock, POLLIN, 0 };
+		if (poll(&fd, 1, 1000) > 0)
+		{
+			u8 buffer[1500];
+			sockaddr_in from;
+			socklen_t fromLength = sizeof(from);
+			ssize_t size = recvfrom(sock, buffer, sizeof(buffer), 0, (sockaddr*)&from, &fromLength);
+			Status status;
+			Unit* unit;
+			if (size > 0 && Parse(buffer, (unsigned)size, status) && (unit = FindUnit(from.sin_addr.s_addr)))
+			{
+				Receive(*unit, status, Now());
+				if (lines)
+				{
+					PrintLine(*unit);
+					fflush(stdout);
+				}
+			}
+		}
+
+		double now = Now();
+		if (!lines && now - lastDrawn >= 1.0)
+		{
+			Draw(now);
+			lastDrawn = now;
+		}
+	}
+}
@@ -18,6 +18,7 @@
 
 #include "DiskCaddy.h"
 #include "debug.h"
+#include "net-disk.h"
 #include <string.h>
 #include <stdlib.h>
 #include "ff.h"
@@ -118,6 +119,32 @@ bool DiskCaddy::Empty()
 	return anyDirty;
 }
 
+// Reads the image's .weak file, if it has one, into its weak regions (see DiskImage::LoadWeakRegions).
+static void LoadWeakRegions(DiskImage* diskImage, const char* imageName)
+{
+	static char text[4096];
+	char name[256];
+	FIL fp;
+	u32 bytesRead = 0;
+
+	snprintf(name, sizeof(name), "%s.weak", imageName);
+	if (f_open(&fp, name, FA_READ) != FR_OK)
+		return;
+	if (f_size(&fp) > sizeof(text) - 1)
+		DEBUG_LOG("%s is too long, only the first %d bytes are used\r\n", name, (int)sizeof(text) - 1);
+	FRESULT res = f_read(&fp, text, sizeof(text) - 1, &bytesRead);
+	f_close(&fp);
+	if (res != FR_OK)
+	{
+		DEBUG_LOG("Failed to read %s\r\n", name);
+		return;
+	}
+	text[bytesRead] = 0;
+
+	if (diskImage->LoadWeakRegions(text))
+		DEBUG_LOG("Weak regions from %s\r\n", name);
+}
+
 bool DiskCaddy::Insert(const FILINFO* fileInfo, bool readOnly)
 {
 	int x;
@@ -185,12 +212,17 @@ bool DiskCaddy::Insert(const FILINFO* fileInfo, bool readOnly)
 			case DiskImage::PRG:
 				success = InsertPRG(fileInfo, (unsigned char*)DiskImage::readBuffer, bytesRead, readOnly);
 				break;
+			case DiskImage::NET:
+				success = InsertNET(fileInfo, (unsigned char*)DiskImage::readBuffer, bytesRead, readOnly);
+				break;
 			default:
 				success = false;
 				break;
 		}
 		if (success)
 		{
+			if (diskType == DiskImage::D64 || diskType == DiskImage::G64 || diskType == DiskImage::NIB || diskType == DiskImage::NBZ)
+				LoadWeakRegions(disks.back(), fileInfo->fname);
 			DEBUG_LOG("Mounted into caddy %s - %d\r\n", fileInfo->fname, bytesRead);
 		}
 	}
@@ -306,6 +338,42 @@ bool DiskCaddy::InsertPRG(const FILINFO* fileInfo, unsigned char* diskImageData,
 	return false;
 }
 
+// A .net file holds the name of an image on the network disk server.
+bool DiskCaddy::InsertNET(const FILINFO* fileInfo, unsigned char* diskImageData, unsigned size, bool readOnly)
+{
+#if defined(EXPERIMENTALZERO)
+	// There is no second core running the network to fetch the tracks.
+	DEBUG_LOG("Network disks need a Pi 3\r\n");
+	return false;
+#else
+	char name[Net::Disk::NET_DISK_MAX_NAME_LENGTH];
+	unsigned length = 0;
+	while (length < size && length < sizeof(name) - 1 && diskImageData[length] != '\r' && diskImageData[length] != '\n')
+	{
+		name[length] = diskImageData[length];
+		length++;
+	}
+	while (length > 0 && (name[length - 1] == ' ' || name[length - 1] == '\t'))
+		length--;
+	name[length] = 0;
+	if (length == 0)
+		return false;
+
+	DiskImage* diskImage = new DiskImage();
+	bool serverReadOnly;
+	if (Net::Disk::Mount(diskImage, fileInfo, name, serverReadOnly))
+	{
+		diskImage->SetReadOnly(readOnly || serverReadOnly);
+		disks.push_back(diskImage);
+		selectedIndex = disks.size() - 1;
+		return true;
+	}
+	diskImage->Close();
+	delete diskImage;
+	return false;
+#endif
+}
+
 void DiskCaddy::Display()
 {
 	unsigned numberOfImages = GetNumberOfImages();
@@ -315,6 +383,9 @@ void DiskCaddy::Display()
 #if not defined(EXPERIMENTALZERO)
 	if (screen)
 	{
+		// Compose the caddy list off screen; it is cleared and redrawn line by line.
+		screen->BeginFrame();
+
 		x = screen->ScaleX(screenPosXCaddySelections);
 		y = screen->ScaleY(screenPosYCaddySelections);
 
@@ -343,6 +414,10 @@ void DiskCaddy::Display()
 	}
 #endif
 	ShowSelectedImage(0);
+#if not defined(EXPERIMENTALZERO)
+	if (screen)
+		screen->EndFrame();
+#endif
 }
 
 void DiskCaddy::ShowSelectedImage(u32 index)
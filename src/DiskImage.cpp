@@ -22,7 +22,10 @@
 #include "DiskImage.h"
 #include "gcr.h"
 #include "debug.h"
+#include "options.h"
 #include <string.h>
+#include <strings.h>
+#include <stdlib.h>
 #include <ctype.h>
 #include "lz.h"
 #include "Petscii.h"
@@ -144,13 +147,21 @@ DiskImage::DiskImage()
 	, dirty(false)
 	, attachedImageSize(0)
 	, fileInfo(0)
+	, weakMap(0)
+	, journal(0)
+	, journaling(false)
+	, trackSource(0)
 {
 	memset(tracks, 0x55, sizeof(tracks));
 	memset(trackUsed, 0, sizeof(trackUsed));
+	memset(trackLongestZeroRun, 255, sizeof(trackLongestZeroRun));
+	memset(trackWeakRegions, 0, sizeof(trackWeakRegions));
 }
 
 void DiskImage::Close()
 {
+	EndJournal();
+
 	switch (diskType)
 	{
 		case D64:
@@ -181,17 +192,222 @@ void DiskImage::Close()
 			CloseT64();
 			memset(tracks, 0x55, sizeof(tracks));
 		break;
+		case NET:
+			CloseRemote();
+			memset(tracks, 0x55, sizeof(tracks));
+		break;
 		default:
 			memset(tracks, 0x55, sizeof(tracks));
 		break;
 	}
 	memset(trackLengths, 0, sizeof(trackLengths));
 	memset(trackUsed, 0, sizeof(trackUsed));
+	memset(trackLongestZeroRun, 255, sizeof(trackLongestZeroRun));
+	memset(trackWeakRegions, 0, sizeof(trackWeakRegions));
+	if (weakMap)
+	{
+		free(weakMap);
+		weakMap = 0;
+	}
+	if (journal)
+	{
+		free(journal);
+		journal = 0;
+	}
 	diskType = NONE;
 	fileInfo = 0;
 	hash = 0;
 }
 
+// The longest run of 0 bits between two 1 bits inside each byte (eg 0x81 has 6).
+static const unsigned char innerZeroRun[256] =
+{
+	0, 0, 0, 0, 0, 1, 0, 0, 0, 2, 1, 1, 0, 1, 0, 0,
+	0, 3, 2, 2, 1, 1, 1, 1, 0, 2, 1, 1, 0, 1, 0, 0,
+	0, 4, 3, 3, 2, 2, 2, 2, 1, 2, 1, 1, 1, 1, 1, 1,
+	0, 3, 2, 2, 1, 1, 1, 1, 0, 2, 1, 1, 0, 1, 0, 0,
+	0, 5, 4, 4, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2,
+	1, 3, 2, 2, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1,
+	0, 4, 3, 3, 2, 2, 2, 2, 1, 2, 1, 1, 1, 1, 1, 1,
+	0, 3, 2, 2, 1, 1, 1, 1, 0, 2, 1, 1, 0, 1, 0, 0,
+	0, 6, 5, 5, 4, 4, 4, 4, 3, 3, 3, 3, 3, 3, 3, 3,
+	2, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+	1, 4, 3, 3, 2, 2, 2, 2, 1, 2, 1, 1, 1, 1, 1, 1,
+	1, 3, 2, 2, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1,
+	0, 5, 4, 4, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2,
+	1, 3, 2, 2, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1,
+	0, 4, 3, 3, 2, 2, 2, 2, 1, 2, 1, 1, 1, 1, 1, 1,
+	0, 3, 2, 2, 1, 1, 1, 1, 0, 2, 1, 1, 0, 1, 0, 0,
+};
+
+void DiskImage::MeasureZeroRun(unsigned track)
+{
+	unsigned length = trackLengths[track];
+	const unsigned char* data = TrackData(track);
+	unsigned run = 0;
+	unsigned longest = 0;
+
+	// Twice round so a run across the end of the track is counted whole.
+	for (unsigned index = 0; index < length * 2 && longest < 255; ++index)
+	{
+		unsigned char byte = data[index < length ? index : index - length];
+		if (byte == 0)
+		{
+			run += 8;
+			continue;
+		}
+		// The leading 0s finish the run coming into the byte and the trailing ones start the next.
+		run += __builtin_clz(byte) - 24;
+		if (run > longest)
+			longest = run;
+		if (innerZeroRun[byte] > longest)
+			longest = innerZeroRun[byte];
+		run = __builtin_ctz(byte);
+	}
+	if (run > longest || length == 0)
+		longest = 255;	// No 1s at all
+	trackLongestZeroRun[track] = longest < 255 ? longest : 255;
+}
+
+void DiskImage::MeasureZeroRuns()
+{
+	for (unsigned track = 0; track < HALF_TRACK_COUNT; ++track)
+		MeasureZeroRun(track);
+}
+
+// text is modified.
+bool DiskImage::LoadWeakRegions(char* text)
+{
+	if (IsD81() || IsD71())
+		return false;
+
+	TextParser parser;
+	parser.SetData(text);
+
+	char* pOption;
+	while ((pOption = parser.GetToken()) != 0)
+	{
+		/*char* equals = */parser.GetToken();
+		char* pValue = parser.GetToken();
+		if (pValue == 0)
+			break;
+		if (strcasecmp(pOption, "Weak") != 0)
+			continue;
+
+		char* end;
+		unsigned track = (strtoul(pValue, &end, 10) - 1) * 2;
+		if (end[0] == '.' && end[1] == '5')
+		{
+			track++;
+			end += 2;
+		}
+		if (track >= HALF_TRACK_COUNT || trackLengths[track] == 0)
+		{
+			DEBUG_LOG("Weak region %s ignored\r\n", pValue);
+			continue;
+		}
+
+		unsigned first = 0;
+		unsigned last = trackLengths[track] - 1;
+		if (*end == ':')
+		{
+			first = strtoul(end + 1, &end, 0);
+			if (*end == '-')
+				last = strtoul(end + 1, &end, 0);
+			else
+				last = first;
+		}
+		if (last >= trackLengths[track])
+			last = trackLengths[track] - 1;
+		if (first > last)
+		{
+			DEBUG_LOG("Weak region %s ignored\r\n", pValue);
+			continue;
+		}
+
+		if (weakMap == 0)
+		{
+			weakMap = (unsigned char*)malloc(HALF_TRACK_COUNT * WEAK_MAP_TRACK_SIZE);
+			if (weakMap == 0)
+				return false;
+			memset(weakMap, 0, HALF_TRACK_COUNT * WEAK_MAP_TRACK_SIZE);
+		}
+		unsigned char* map = weakMap + track * WEAK_MAP_TRACK_SIZE;
+		for (unsigned byteOffset = first; byteOffset <= last; ++byteOffset)
+			map[byteOffset >> 3] |= 1 << (byteOffset & 7);
+		trackWeakRegions[track] = true;
+	}
+
+	if (weakMap == 0)
+		return false;
+
+	// The file says where the noise is so the zero runs no longer decide.
+	memset(trackLongestZeroRun, 0, sizeof(trackLongestZeroRun));
+	return true;
+}
+
+unsigned char* DiskImage::TrackData(u32 track)
+{
+	if (IsD81())
+		return tracksD81[track][0];
+#if defined(EXPERIMENTALZERO)
+	return &tracks[track << 13];
+#else
+	return tracks[track];
+#endif
+}
+
+// The journal is allocated up front, once per mounted image, so journaling a track while emulating is only a copy.
+bool DiskImage::BeginJournal()
+{
+	if (journal == 0)
+	{
+		journal = (unsigned char*)malloc(HALF_TRACK_COUNT * JournalTrackSize());
+		if (journal == 0)
+			return false;
+	}
+	journaling = true;
+	memset(journalTracks, 0, sizeof(journalTracks));
+	memcpy(journalTrackDirty, trackDirty, sizeof(trackDirty));
+	memcpy(journalTrackUsed, trackUsed, sizeof(trackUsed));
+	memcpy(journalTrackLongestZeroRun, trackLongestZeroRun, sizeof(trackLongestZeroRun));
+	memcpy(journalTrackWeakRegions, trackWeakRegions, sizeof(trackWeakRegions));
+	journalDirty = dirty;
+	return true;
+}
+
+void DiskImage::JournalTrack(u32 track)
+{
+	unsigned trackSize = JournalTrackSize();
+	memcpy(journal + track * trackSize, TrackData(track), trackSize);
+	journalTracks[track] = true;
+}
+
+// The journal is kept so the same snapshot can be restored again.
+void DiskImage::RollbackJournal()
+{
+	if (!journaling)
+		return;
+
+	unsigned trackSize = JournalTrackSize();
+	for (unsigned track = 0; track < HALF_TRACK_COUNT; ++track)
+	{
+		if (journalTracks[track])
+			memcpy(TrackData(track), journal + track * trackSize, trackSize);
+	}
+	memcpy(trackDirty, journalTrackDirty, sizeof(trackDirty));
+	memcpy(trackUsed, journalTrackUsed, sizeof(trackUsed));
+	// A write gives up on a track's zero run and weak regions so they go back with its data.
+	memcpy(trackLongestZeroRun, journalTrackLongestZeroRun, sizeof(trackLongestZeroRun));
+	memcpy(trackWeakRegions, journalTrackWeakRegions, sizeof(trackWeakRegions));
+	dirty = journalDirty;
+}
+
+void DiskImage::EndJournal()
+{
+	journaling = false;
+}
+
 void DiskImage::DumpTrack(unsigned track)
 {
 
@@ -221,6 +437,7 @@ bool DiskImage::OpenD64(const FILINFO* fileInfo, unsigned char* diskImage, unsig
 	Close();
 
 	this->fileInfo = fileInfo;
+	hash = HashBuffer(diskImage, size);
 
 	unsigned offset = 0;
 
@@ -263,6 +480,7 @@ bool DiskImage::OpenD64(const FILINFO* fileInfo, unsigned char* diskImage, unsig
 #endif
 
 	trackLengths[halfTrackIndex] = trackSize[GetSpeedZoneIndexD64(track)];
+		trackDensity[halfTrackIndex] = GetSpeedZoneIndexD64(track);
 
 		if ((halfTrackIndex & 1) == 0)
 		{
@@ -295,11 +513,12 @@ bool DiskImage::OpenD64(const FILINFO* fileInfo, unsigned char* diskImage, unsig
 		}
 	}
 
+	MeasureZeroRuns();
 	diskType = D64;
 	return true;
 }
 
-bool DiskImage::WriteD64(char* name)
+bool DiskImage::WriteD64(char* name, bool errorInfo)
 {
 	BYTE id[3];
 
@@ -313,14 +532,15 @@ bool DiskImage::WriteD64(char* name)
 	}
 
 	FIL fp;
-	FRESULT res = f_open(&fp, fileInfo ? fileInfo->fname : name, FA_CREATE_ALWAYS | FA_WRITE);
+	FRESULT res = f_open(&fp, name ? name : fileInfo->fname, FA_CREATE_ALWAYS | FA_WRITE);
 	if (res == FR_OK)
 	{
 		u32 bytesToWrite;
 		u32 bytesWritten;
 
 		unsigned track, sector, sectors;
-		BYTE d64data[MAXBLOCKSONDISK * 256], *d64ptr;
+		BYTE d64data[MAXBLOCKSONDISK * 257], *d64ptr;
+		BYTE errors[MAXBLOCKSONDISK];
 		int blocks_to_save = 0;
 
 		DEBUG_LOG("Writing D64 file...\r\n");
@@ -328,7 +548,7 @@ bool DiskImage::WriteD64(char* name)
 		memset(d64data, 0, sizeof(d64data));
 
 		d64ptr = d64data;
-		for (track = 0; track < HALF_TRACK_COUNT; track += 2)
+		for (track = 0; track < 40 * 2; track += 2)	// MAXBLOCKSONDISK has no room for tracks 41 and 42
 		{
 			if (trackUsed[track])
 			{
@@ -337,14 +557,21 @@ bool DiskImage::WriteD64(char* name)
 				sectors = sectorsPerTrack[GetSpeedZoneIndexD64(track >> 1)];
 				for (sector = 0; sector < sectors; sector++)
 				{
-					ConvertSector(track, sector, d64ptr);
+					errors[blocks_to_save] = DecodeSector(track, sector, d64ptr);
 					d64ptr += 256;
 					blocks_to_save++;
 				}
 			}
 		}
 
-		bytesToWrite = blocks_to_save * 256;
+		// The error info follows the sectors, one code per block.
+		if (errorInfo)
+		{
+			memcpy(d64ptr, errors, blocks_to_save);
+			bytesToWrite = blocks_to_save * 257;
+		}
+		else
+			bytesToWrite = blocks_to_save * 256;
 		SetACTLed(true);
 		if (f_write(&fp, d64data, bytesToWrite, &bytesWritten) != FR_OK || bytesToWrite != bytesWritten)
 		{
@@ -365,11 +592,53 @@ bool DiskImage::WriteD64(char* name)
 	}
 	else
 	{
-		DEBUG_LOG("Failed to open %s for write\r\n", fileInfo->fname);
+		DEBUG_LOG("Failed to open %s for write\r\n", name ? name : fileInfo->fname);
 		return false;
 	}
 }
 
+bool DiskImage::OpenRemote(const FILINFO* fileInfo, TrackSource* source, unsigned hash, const unsigned short* lengths, const unsigned char* densities, const bool* used)
+{
+	Close();
+
+	this->fileInfo = fileInfo;
+	this->hash = hash;
+
+	attachedImageSize = 0;
+	for (unsigned track = 0; track < HALF_TRACK_COUNT; ++track)
+	{
+		trackLengths[track] = lengths[track] <= MAX_TRACK_LENGTH ? lengths[track] : MAX_TRACK_LENGTH;
+		trackDensity[track] = densities[track] & 3;
+		trackUsed[track] = used[track];
+		trackDirty[track] = false;
+		// Unused tracks read as the 0x55s Close left, so there is nothing to wait for.
+		trackLoaded[track] = !used[track];
+		attachedImageSize += trackLengths[track];
+	}
+	trackSource = source;
+	dirty = false;
+
+	diskType = NET;
+	return true;
+}
+
+void DiskImage::SetTrackLoaded(unsigned track)
+{
+	MeasureZeroRun(track);
+	// The data has to be seen before the flag by the core running the drive.
+	__sync_synchronize();
+	trackLoaded[track] = true;
+}
+
+void DiskImage::CloseRemote()
+{
+	if (trackSource)
+		trackSource->Release(this);
+	trackSource = 0;
+	dirty = false;
+	attachedImageSize = 0;
+}
+
 void DiskImage::CloseD64()
 {
 	if (dirty)
@@ -393,6 +662,7 @@ bool DiskImage::OpenD71(const FILINFO* fileInfo, unsigned char* diskImage, unsig
 	Close();
 
 	this->fileInfo = fileInfo;
+	hash = HashBuffer(diskImage, size);
 
 	unsigned offset = 0;
 
@@ -554,6 +824,7 @@ bool DiskImage::OpenD81(const FILINFO* fileInfo, unsigned char* diskImage, unsig
 	Close();
 
 	this->fileInfo = fileInfo;
+	hash = HashBuffer(diskImage, size);
 
 	unsigned offsetSource = 0;
 
@@ -902,6 +1173,7 @@ bool DiskImage::OpenG64(const FILINFO* fileInfo, unsigned char* diskImage, unsig
 			}
 		}
 
+		MeasureZeroRuns();
 		diskType = G64;
 		return true;
 	}
@@ -928,7 +1200,7 @@ bool DiskImage::WriteG64(char* name)
 		return true;
 
 	FIL fp;
-	FRESULT res = f_open(&fp, fileInfo ? fileInfo->fname : name, FA_CREATE_ALWAYS | FA_WRITE);
+	FRESULT res = f_open(&fp, name ? name : fileInfo->fname, FA_CREATE_ALWAYS | FA_WRITE);
 	if (res == FR_OK)
 	{
 		u32 bytesToWrite;
@@ -936,8 +1208,8 @@ bool DiskImage::WriteG64(char* name)
 		int track_inc = 1;
 
 		BYTE header[12];
-		DWORD gcr_track_p[MAX_HALFTRACKS_1541] = { 0 };
-		DWORD gcr_speed_p[MAX_HALFTRACKS_1541] = { 0 };
+		u32 gcr_track_p[MAX_HALFTRACKS_1541] = { 0 };
+		u32 gcr_speed_p[MAX_HALFTRACKS_1541] = { 0 };
 		BYTE gcr_track[MAX_TRACK_LENGTH + 2];
 		size_t track_len;
 		int index = 0, track;
@@ -978,8 +1250,8 @@ bool DiskImage::WriteG64(char* name)
 		}
 
 		SetACTLed(true);
-		WriteDwords(&fp, (u32*)gcr_track_p, MAX_HALFTRACKS_1541);
-		WriteDwords(&fp, (u32*)gcr_speed_p, MAX_HALFTRACKS_1541);
+		WriteDwords(&fp, gcr_track_p, MAX_HALFTRACKS_1541);
+		WriteDwords(&fp, gcr_speed_p, MAX_HALFTRACKS_1541);
 		SetACTLed(false);
 
 		for (track = 0; track < MAX_HALFTRACKS_1541; track += track_inc)
@@ -1021,7 +1293,7 @@ bool DiskImage::WriteG64(char* name)
 	}
 	else
 	{
-		DEBUG_LOG("Failed to open %s for write\r\n", fileInfo->fname);
+		DEBUG_LOG("Failed to open %s for write\r\n", name ? name : fileInfo->fname);
 		return false;
 	}
 }
@@ -1043,6 +1315,7 @@ bool DiskImage::OpenNIB(const FILINFO* fileInfo, unsigned char* diskImage, unsig
 	Close();
 
 	this->fileInfo = fileInfo;
+	hash = HashBuffer(diskImage, size);
 
 	attachedImageSize = size;
 
@@ -1087,19 +1360,20 @@ bool DiskImage::OpenNIB(const FILINFO* fileInfo, unsigned char* diskImage, unsig
 
 
 		DEBUG_LOG("Successfully parsed NIB data for %d tracks\n", t_index);
+		MeasureZeroRuns();
 		diskType = NIB;
 		return true;
 	}
 	return false;
 }
 
-bool DiskImage::WriteNIB()
+bool DiskImage::WriteNIB(char* name)
 {
 	if (readOnly)
 		return true;
 
 	FIL fp;
-	FRESULT res = f_open(&fp, fileInfo->fname, FA_CREATE_ALWAYS | FA_WRITE);
+	FRESULT res = f_open(&fp, name ? name : fileInfo->fname, FA_CREATE_ALWAYS | FA_WRITE);
 	if (res == FR_OK)
 	{
 		u32 bytesToWrite;
@@ -1108,6 +1382,7 @@ bool DiskImage::WriteNIB()
 		int track;
 		char header[0x100];
 		int header_entry = 0;
+		unsigned char nibTrack[NIB_TRACK_LENGTH];
 
 		DEBUG_LOG("Converting to NIB format...\n");
 
@@ -1139,11 +1414,15 @@ bool DiskImage::WriteNIB()
 			{
 				if (trackUsed[track])
 				{
-#if defined(EXPERIMENTALZERO)
-					if (f_write(&fp, &tracks[track << 13], bytesToWrite, &bytesWritten) != FR_OK || bytesToWrite != bytesWritten)
-#else
-					if (f_write(&fp, tracks[track], bytesToWrite, &bytesWritten) != FR_OK || bytesToWrite != bytesWritten)
-#endif
+					// A NIB track is a raw read of more than one revolution.
+					// Repeat the revolution we have so extract_GCR_track can find it again when the NIB is opened.
+					unsigned trackLength = trackLengths[track];
+					unsigned offset;
+					memset(nibTrack, 0x55, sizeof(nibTrack));
+					for (offset = 0; trackLength && offset < NIB_TRACK_LENGTH; offset += trackLength)
+						memcpy(nibTrack + offset, TrackData(track), offset + trackLength < NIB_TRACK_LENGTH ? trackLength : NIB_TRACK_LENGTH - offset);
+
+					if (f_write(&fp, nibTrack, bytesToWrite, &bytesWritten) != FR_OK || bytesToWrite != bytesWritten)
 					{
 						DEBUG_LOG("Cannot write track data.\r\n");
 					}
@@ -1160,7 +1439,7 @@ bool DiskImage::WriteNIB()
 	}
 	else
 	{
-		DEBUG_LOG("Failed to open %s for write\r\n", fileInfo->fname);
+		DEBUG_LOG("Failed to open %s for write\r\n", name ? name : fileInfo->fname);
 		return false;
 	}
 }
@@ -1191,29 +1470,32 @@ bool DiskImage::OpenNBZ(const FILINFO* fileInfo, unsigned char* diskImage, unsig
 	return false;
 }
 
-bool DiskImage::WriteNBZ()
+bool DiskImage::WriteNBZ(char* name)
 {
 	bool success = false;
 
 	if (readOnly)
 		return true;
 
+	if (name == 0)
+		name = (char*)fileInfo->fname;
+
 	SetACTLed(true);
-	if (WriteNIB())
+	if (WriteNIB(name))
 	{
 		FIL fp;
-		FRESULT res = f_open(&fp, fileInfo->fname, FA_READ);
+		FRESULT res = f_open(&fp, name, FA_READ);
 		if (res == FR_OK)
 		{
 			u32 bytesRead;
 			f_read(&fp, readBuffer, READBUFFER_SIZE, &bytesRead);
 			f_close(&fp);
-			DEBUG_LOG("Reloaded %s - %d for compression\r\n", fileInfo->fname, bytesRead);
+			DEBUG_LOG("Reloaded %s - %d for compression\r\n", name, bytesRead);
 			bytesRead = LZ_Compress(readBuffer, compressionBuffer, bytesRead);
 
 			if (bytesRead)
 			{
-				res = f_open(&fp, fileInfo->fname, FA_CREATE_ALWAYS | FA_WRITE);
+				res = f_open(&fp, name, FA_CREATE_ALWAYS | FA_WRITE);
 				if (res == FR_OK)
 				{
 					u32 bytesToWrite = bytesRead;
@@ -1411,6 +1693,8 @@ DiskImage::DiskType DiskImage::GetDiskImageTypeViaExtention(const char* diskImag
 			return D81;
 		else if (toupper((char)ext[1]) == 'P' && toupper((char)ext[2]) == 'R' && toupper((char)ext[3]) == 'G')
 			return PRG;
+		else if (toupper((char)ext[1]) == 'N' && toupper((char)ext[2]) == 'E' && toupper((char)ext[3]) == 'T')
+			return NET;
 	}
 	return NONE;
 }
@@ -1461,6 +1745,11 @@ bool DiskImage::IsLSTExtention(const char* diskImageName)
 }
 
 bool DiskImage::ConvertSector(unsigned track, unsigned sector, unsigned char* data)
+{
+	return DecodeSector(track, sector, data) == SECTOR_OK;
+}
+
+unsigned char DiskImage::DecodeSector(unsigned track, unsigned sector, unsigned char* data)
 {
 	unsigned char buffer[SECTOR_LENGTH_WITH_CHECKSUM];
 	unsigned char checkSum;
@@ -1469,11 +1758,11 @@ bool DiskImage::ConvertSector(unsigned track, unsigned sector, unsigned char* da
 
 	bitIndex = FindSectorHeader(track, sector, 0);
 	if (bitIndex < 0)
-		return false;
+		return HEADER_NOT_FOUND;
 
 	bitIndex = FindSync(track, bitIndex, (SECTOR_LENGTH_WITH_CHECKSUM * 2) * 8);
 	if (bitIndex < 0)
-		return false;
+		return SYNC_NOT_FOUND;
 
 	DecodeBlock(track, bitIndex, buffer, SECTOR_LENGTH_WITH_CHECKSUM / 4);
 
@@ -1485,9 +1774,9 @@ bool DiskImage::ConvertSector(unsigned track, unsigned sector, unsigned char* da
 	}
 
 	if (buffer[0] != 0x07)
-		return false;			// No data block
+		return DATA_NOT_FOUND;
 
-	return checkSum == 0;
+	return checkSum == 0 ? SECTOR_OK : BAD_DATA_CHECKSUM;
 }
 
 void DiskImage::DecodeBlock(unsigned track, int bitIndex, unsigned char* buf, int num)
@@ -1636,6 +1925,22 @@ unsigned DiskImage::LastTrackUsed()
 	return lastTrackUsed;
 }
 
+unsigned DiskImage::HashTracks() const
+{
+	unsigned track;
+	unsigned hash = HashBuffer(trackLengths, sizeof(trackLengths));
+
+	for (track = 0; track < HALF_TRACK_COUNT; ++track)
+	{
+#if defined(EXPERIMENTALZERO)
+		hash = hash * 16777619U ^ HashBuffer(&tracks[track << 13], trackLengths[track]);
+#else
+		hash = hash * 16777619U ^ HashBuffer(tracks[track], trackLengths[track]);
+#endif
+	}
+	return hash;
+}
+
 unsigned DiskImage::CreateNewDiskInRAM(const char* filenameNew, const char* ID, unsigned char* destBuffer)
 {
 	unsigned char* dest;
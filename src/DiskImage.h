@@ -42,6 +42,18 @@ static const unsigned short G64_MAX_TRACK_LENGTH = 7928;
 
 static const unsigned short D81_SECTOR_LENGTH = 512;
 
+class DiskImage;
+
+// Where a remote image's tracks come from (see net-disk.h). Both are called on the emulation core.
+class TrackSource
+{
+public:
+	// Waits briefly for the track to arrive. Returns false if it didn't.
+	virtual bool FetchTrack(DiskImage* diskImage, unsigned track) = 0;
+	// Writes back the tracks the drive changed and forgets the image.
+	virtual bool Release(DiskImage* diskImage) = 0;
+};
+
 class DiskImage
 {
 public:
@@ -57,7 +69,8 @@ public:
 		D81,
 		T64,
 		PRG,
-		RAW
+		RAW,
+		NET		// A pointer to an image on a network disk server
 	};
 
 	DiskImage();
@@ -72,6 +85,8 @@ public:
 	bool OpenD81(const FILINFO* fileInfo, unsigned char* diskImage, unsigned size);
 	bool OpenT64(const FILINFO* fileInfo, unsigned char* diskImage, unsigned size);
 	bool OpenPRG(const FILINFO* fileInfo, unsigned char* diskImage, unsigned size);
+	// The track layout of a remote image is known up front but each track's data is left to the source.
+	bool OpenRemote(const FILINFO* fileInfo, TrackSource* source, unsigned hash, const unsigned short* lengths, const unsigned char* densities, const bool* used);
 
 	void Close();
 
@@ -104,6 +119,9 @@ public:
 	{
 		if (attachedImageSize == 0)
 			return;
+		// A remote track still belongs to its source until it is loaded;- what is written there is lost.
+		if (trackSource && !trackLoaded[track])
+			return;
 
 #if defined(EXPERIMENTALZERO)
 		u8 dataOld = tracks[(track << 13) + byte];
@@ -134,6 +152,22 @@ public:
 #endif
 	}
 
+	// A local image has all its tracks. A remote one has those its source has delivered.
+	inline bool IsTrackLoaded(unsigned track) const
+	{
+		if (trackSource == 0)
+			return true;
+		if (!trackLoaded[track])
+			return false;
+		// Pairs with SetTrackLoaded;- the data must not be read before the flag.
+		__sync_synchronize();
+		return true;
+	}
+	inline bool FetchTrack(unsigned track) { return trackSource->FetchTrack(this, track); }
+	// Called by the source once the track's data is in place, maybe from the other core.
+	void SetTrackLoaded(unsigned track);
+	inline bool IsTrackDirty(unsigned track) const { return trackDirty[track]; }
+
 	static const unsigned char SectorsPerTrack[42];
 
 	void DumpTrack(unsigned track);
@@ -142,6 +176,24 @@ public:
 
 	inline unsigned BitsInTrack(unsigned track) const { return trackLengths[track] << 3; }
 	inline unsigned TrackLength(unsigned track) const { return trackLengths[track]; }
+	// The most 0 bits in a row anywhere on the track (going round from its end to its start), up to 255.
+	// Lets the drive skip modelling flux noise on tracks where it can't happen. A track the drive writes to is taken to have any.
+	// An image with weak regions is taken to have none outside them.
+	inline unsigned LongestZeroRun(unsigned track) const { return trackLongestZeroRun[track]; }
+
+	// Protected originals can have regions that read back differently every time; weak bits, or no flux reversals at all.
+	// Neither G64 nor NIB can say where they are so a text file named after the image with .weak added can (eg game.g64.weak);
+	//	Weak = 36				// All of track 36
+	//	Weak = 18.5:0x100-0x17f	// Bytes 256 to 383 of half track 18.5
+	// The drive reads only noise inside a weak region and no noise anywhere else. Writing to a track drops its regions.
+	// Without the file the drive models noise wherever the zero runs are long enough for it.
+	bool LoadWeakRegions(char* text);
+	inline bool HasWeakMap() const { return weakMap != 0; }
+	inline bool HasWeakRegions(unsigned track) const { return trackWeakRegions[track]; }
+	inline bool IsWeak(unsigned track, unsigned byteOffset) const
+	{
+		return (weakMap[track * WEAK_MAP_TRACK_SIZE + (byteOffset >> 3)] & (1 << (byteOffset & 7))) != 0;
+	}
 
 	inline bool IsD81() const { return diskType == D81; }
 	inline bool IsD71() const { return diskType == D71; }
@@ -150,6 +202,8 @@ public:
 	{
 		if (tracksD81[track][headIndex][headPos] != data)
 		{
+			if (journaling && !journalTracks[track])
+				JournalTrack(track);
 			tracksD81[track][headIndex][headPos] = data;
 			trackDirty[track] = true;
 			trackUsed[track] = true;
@@ -183,6 +237,13 @@ public:
 
 	bool IsDirty() const { return dirty; }
 
+	// Save-states roll the disk back with a journal rather than keeping a copy of it.
+	// Once begun, the first write to a track copies that track aside so RollbackJournal can put it back.
+	// The journal's buffer is kept until the image is closed so later saves don't allocate it again.
+	bool BeginJournal();
+	void RollbackJournal();
+	void EndJournal();
+
 	static unsigned char readBuffer[READBUFFER_SIZE];
 
 	static void CRC(unsigned short& runningCRC, unsigned char data);
@@ -197,10 +258,21 @@ public:
 		unsigned char tracksD81[HALF_TRACK_COUNT][2][MAX_TRACK_LENGTH];
 	};
 
-	bool WriteD64(char* name = 0);
+	// name overrides the file the image was opened from (eg to convert it).
+	bool WriteD64(char* name = 0, bool errorInfo = false);
 	bool WriteG64(char* name = 0);
+	bool WriteNIB(char* name = 0);
+	bool WriteNBZ(char* name = 0);
+
+	inline bool IsTrackUsed(unsigned track) const { return trackUsed[track]; }
+	inline unsigned char TrackDensity(unsigned track) const { return trackDensity[track]; }
+	unsigned char* TrackData(u32 track);
+	// Decodes a sector of a 1541 track (a half track index) and returns its SECTOR_OK or error code (see gcr.h).
+	unsigned char DecodeSector(unsigned track, unsigned sector, unsigned char* buffer);
 
 	unsigned GetHash() const { return hash; }
+	// Hash of the GCR tracks as they are now, whatever the image was loaded from. Lets an IEC replay check it has the same disk.
+	unsigned HashTracks() const;
 
 	inline static unsigned GetSpeedZoneIndexD64(unsigned track)
 	{
@@ -217,9 +289,8 @@ private:
 	void CloseD71();
 	void CloseD81();
 	void CloseT64();
+	void CloseRemote();
 
-	bool WriteNIB();
-	bool WriteNBZ();
 	bool WriteD71();
 	bool WriteD81();
 	bool WriteT64(char* name = 0);
@@ -228,12 +299,22 @@ private:
 	{
 		if (isDirty)
 		{
+			if (journaling && !journalTracks[track])
+				JournalTrack(track);
 			trackDirty[track] = true;
 			trackUsed[track] = true;
+			trackLongestZeroRun[track] = 255;
+			trackWeakRegions[track] = false;
 			dirty = true;
 		}
 	}
 
+	void MeasureZeroRun(unsigned track);
+	void MeasureZeroRuns();
+
+	void JournalTrack(u32 track);
+	unsigned JournalTrackSize() const { return IsD81() ? 2 * MAX_TRACK_LENGTH : MAX_TRACK_LENGTH; }
+
 	bool ConvertSector(unsigned track, unsigned sector, unsigned char* buffer);
 	void DecodeBlock(unsigned track, int bitIndex, unsigned char* buf, int num);
 	unsigned GetID(unsigned track, unsigned char* id);
@@ -266,6 +347,24 @@ private:
 	};
 	bool trackDirty[HALF_TRACK_COUNT];
 	bool trackUsed[HALF_TRACK_COUNT];
+	unsigned char trackLongestZeroRun[HALF_TRACK_COUNT];
+
+	// A bit for each byte of each track, only allocated when an image has weak regions.
+	static const unsigned WEAK_MAP_TRACK_SIZE = MAX_TRACK_LENGTH >> 3;
+	unsigned char* weakMap;
+	bool trackWeakRegions[HALF_TRACK_COUNT];
+
+	unsigned char* journal;
+	bool journaling;
+	bool journalTracks[HALF_TRACK_COUNT];
+	bool journalTrackDirty[HALF_TRACK_COUNT];
+	bool journalTrackUsed[HALF_TRACK_COUNT];
+	unsigned char journalTrackLongestZeroRun[HALF_TRACK_COUNT];
+	bool journalTrackWeakRegions[HALF_TRACK_COUNT];
+	bool journalDirty;
+
+	TrackSource* trackSource;
+	volatile bool trackLoaded[HALF_TRACK_COUNT];
 
 	unsigned short crc;
 	static unsigned short CRC1021[256];
@@ -344,22 +344,46 @@ extern "C"
 #define DISK_SWAP_CYCLES_NO_DISK 200000
 #define DISK_SWAP_CYCLES_DISK_INSERTING 400000
 
-Drive::Drive() : m_pVIA(0)
+Drive::Drive() : driveLoop(&Drive::DriveLoop<false, true, false>), diskImage(0), m_pVIA(0)
 {
-	srand(0x811c9dc5U);
-#if defined(EXPERIMENTALZERO)
 	localSeed = 0x811c9dc5U;
-#endif
+	headBitOffset = 0;
+	fluxNoise = true;
+	weakRegions = false;
+	CalculateTrackTimings();
 	Reset();
 }
 
+void Drive::CalculateTrackTimings()
+{
+	// Disk spins at 300rpm = 5rps so to calculate how many 16Mhz cycles one rotation takes;-
+	// 16000000 / 5 = 3200000;
+	static const u32 CYCLES_16Mhz_PER_ROTATION = 3200000;
+
+	for (unsigned halfTrack = 0; halfTrack < HALF_TRACK_COUNT; ++halfTrack)
+	{
+		TrackTiming& timing = trackTimings[halfTrack];
+		u32 bits = diskImage ? diskImage->BitsInTrack(halfTrack) : 0;
+		if (bits == 0)
+			bits = 8;	// An empty track still has to go round.
+
+		// Tracks are at most 64K bits so the remainder can be shifted up 16 bits at a time without a 64 bit divide.
+		u32 cyclesPerBitInt = CYCLES_16Mhz_PER_ROTATION / bits;
+		u32 remainder = CYCLES_16Mhz_PER_ROTATION % bits;
+		u32 fractionHigh = (remainder << 16) / bits;
+		u32 fractionLow = (((remainder << 16) % bits) << 16) / bits;
+
+		timing.bitsInTrack = bits;
+		timing.cyclesPerBitInt = cyclesPerBitInt;
+		timing.cyclesPerBitErrorConstant = (fractionHigh << 16) | fractionLow;
+	}
+}
+
 void Drive::Reset()
 {
-#if defined(EXPERIMENTALZERO)
 	LED = false;
-	cyclesForBit = 0;
 	UE7Counter = 16;
-#endif
+	writeMode = false;
 	headTrackPos = 18*2;		// Start with the head over track 19 (Very later Vorpal ie Cakifornia Games) need to have had the last head movement -ve
 	CLOCK_SEL_AB = 3;		// Track 18 will use speed zone 3 (encoder/decoder (ie UE7Counter) clocked at 1.2307Mhz)
 	UpdateHeadSectorPosition();
@@ -369,23 +393,61 @@ void Drive::Reset()
 	readShiftRegister = 0;
 	writeShiftRegister = 0;
 	UE3Counter = 0;
-#if defined(EXPERIMENTALZERO)
-	ResetEncoderDecoder(18 * 16, 4 * 16);
-	cyclesLeftForBit = ceil(cyclesPerBit - cyclesForBit);
-#else
-	ResetEncoderDecoder(18.0f, 22.0f);
-#endif
+	ResetEncoderDecoder<true>(18 * 16, 4 * 16);
+	cyclesLeftForBit = cyclesPerBitInt + (cyclesPerBitErrorConstant != 0);
 	newDiskImageQueuedCylesRemaining = DISK_SWAP_CYCLES_DISK_EJECTING + DISK_SWAP_CYCLES_NO_DISK + DISK_SWAP_CYCLES_DISK_INSERTING;
-	m_pVIA->InputCA1(true);	// Reset in read mode
-	m_pVIA->InputCB1(true);
-	m_pVIA->InputCA2(true);
-	m_pVIA->InputCB2(true);
+	if (m_pVIA)
+	{
+		m_pVIA->InputCA1(true);	// Reset in read mode
+		m_pVIA->InputCB1(true);
+		m_pVIA->InputCA2(true);
+		m_pVIA->InputCB2(true);
+	}
+}
+
+// The disk image is not part of the state;- insert the image that was in the drive before restoring.
+void Drive::SerialiseState(Snapshot& snapshot)
+{
+	snapshot.Field(localSeed);
+	snapshot.Field(cyclesLeftForBit);
+	snapshot.Field(fluxReversalCyclesLeft);
+	snapshot.Field(cyclesForBitErrorCounter);
+	snapshot.Field(cyclesPerBitErrorConstant);
+	snapshot.Field(cyclesPerBitInt);
+	snapshot.Field(writeMode);
+	snapshot.Field(fluxNoise);
+	snapshot.Field(weakRegions);
+	snapshot.Field(newDiskImageQueuedCylesRemaining);
+	snapshot.Field(UE7Counter);
+	snapshot.Field(writeShiftRegister);
+	snapshot.Field(readShiftRegister);
+	snapshot.Field(headTrackPos);
+	snapshot.Field(headBitOffset);
+	snapshot.Field(UF4Counter);
+	snapshot.Field(UE3Counter);
+	snapshot.Field(CLOCK_SEL_AB);
+	snapshot.Field(SO);
+	snapshot.Field(lastHeadDirection);
+	snapshot.Field(bitsInTrack);
+	snapshot.Field(motor);
+	snapshot.Field(LED);
+
+	cachedheadTrackPos = -1;
+	cachedbyteOffset = -1;
+	SetDriveLoop();
 }
 
 void Drive::Insert(DiskImage* diskImage)
 {
 	Eject();
 	this->diskImage = diskImage;
+	if (diskImage)
+	{
+		CalculateTrackTimings();
+		if (!diskImage->IsTrackLoaded(headTrackPos))
+			diskImage->FetchTrack(headTrackPos);
+		SelectDriveLoop();
+	}
 	newDiskImageQueuedCylesRemaining = DISK_SWAP_CYCLES_DISK_EJECTING + DISK_SWAP_CYCLES_NO_DISK + DISK_SWAP_CYCLES_DISK_INSERTING;
 }
 
@@ -410,6 +472,169 @@ void Drive::OnPortOut(void* pThis, unsigned char status)
 	pDrive->LED = (status & 8) != 0;
 }
 
+// Noise only gets past the valid pulse detector once 18us have gone by without a flux reversal.
+// So a track whose longest gap between 1s is shorter than that never sees any and can be read without modelling it.
+bool Drive::TrackNeedsFluxNoise(unsigned track) const
+{
+	static const unsigned FLUX_NOISE_MIN_CYCLES = 18 * 16;
+
+	if (!diskImage)
+		return true;
+	if (diskImage->HasWeakRegions(track))
+		return true;
+	const TrackTiming& timing = trackTimings[track];
+	return (diskImage->LongestZeroRun(track) + 1) * (timing.cyclesPerBitInt + 1) >= FLUX_NOISE_MIN_CYCLES;
+}
+
+void Drive::SelectDriveLoop()
+{
+	if (!writeMode)
+	{
+		bool noise = TrackNeedsFluxNoise(headTrackPos);
+		// Start timing the noise as if a flux reversal had just been seen.
+		if (noise && !fluxNoise)
+			fluxReversalCyclesLeft = RandomCycles(18 * 16, 2 * 16);
+		fluxNoise = noise;
+		weakRegions = noise && diskImage && diskImage->HasWeakRegions(headTrackPos);
+	}
+	SetDriveLoop();
+}
+
+void Drive::SetDriveLoop()
+{
+	if (writeMode)
+		driveLoop = &Drive::DriveLoop<true, false, false>;	// Nothing is read from the disk so there is no noise to see.
+	else if (weakRegions)
+		driveLoop = &Drive::DriveLoop<false, true, true>;
+	else if (fluxNoise)
+		driveLoop = &Drive::DriveLoop<false, true, false>;
+	else
+		driveLoop = &Drive::DriveLoop<false, false, false>;
+}
+
+// UE6 provides the CPU's clock by dividing the 16Mhz clock by 16.
+// UE7 (a 74ls193 4bit counter) counts up on the falling edge of the 16Mhz clock. UE7 drives the Encoder/Decoder clock.
+// So we need to simulate 16 cycles for every 1 CPU cycle.
+// Rather than step each of them the loop jumps straight to whichever comes next;- UE7's carry, the next bit cell from the disk or a noise flux reversal.
+template <bool Writing, bool FluxNoise, bool WeakRegions>
+void Drive::DriveLoop()
+{
+	unsigned int cycles = 16;
+	while (true)
+	{
+		unsigned int next = UE7Counter;
+		if (!Writing && cyclesLeftForBit < next)
+			next = cyclesLeftForBit;
+		if (FluxNoise && fluxReversalCyclesLeft < next)
+			next = fluxReversalCyclesLeft;
+
+		if (cycles < next)
+		{
+			UE7Counter -= cycles;
+			if (!Writing)
+				cyclesLeftForBit -= cycles;
+			if (FluxNoise)
+				fluxReversalCyclesLeft -= cycles;
+			return;
+		}
+
+		cycles -= next;
+		UE7Counter -= next;
+		if (!Writing)
+			cyclesLeftForBit -= next;
+		if (FluxNoise)
+			fluxReversalCyclesLeft -= next;
+
+		if (!Writing && cyclesLeftForBit == 0)
+		{
+			// The bit cells do not divide into whole cycles so the fraction left over is carried from one to the next.
+			cyclesForBitErrorCounter -= cyclesPerBitErrorConstant;
+			cyclesLeftForBit = cyclesPerBitInt + (cyclesForBitErrorCounter < cyclesPerBitErrorConstant);
+
+			// Any 1 bit coming from the disk will come in the form of a flux reversal. (Non return to zero inverted emulation.)
+			if (GetNextBit<WeakRegions>())
+			{
+				// We have a genuine flux reversal.
+				// Pin 12 of UE5D is the BIT SYNC Input. When a positive pulse is applied to pin 12, the output of UE5D(pin 13) is applied to the load line (of UE7),
+				// causing the encoder/decoder clock to terminate the current cycle early and begin a new one.
+				ResetEncoderDecoder<FluxNoise>(18 * 16, 2 * 16); // Start seeing random flux reversals 18us-20us from now (ie since the last real flux reversal).
+			}
+		}
+
+		// The video amplifiers will often oscillate with no data in, but these oscillations are high enough in frequency that they "seldom" get past the valid pulse detector.
+		// Some do and some copy protections rely on this random behaviour so we need to emultate it.
+		// For example, 720 will read a byte from the disk multiple times and check that the values read each time were infact different. It does not matter what the values are just that they are different.
+		// On a track with weak regions the noise is only let through inside them.
+		if (FluxNoise && fluxReversalCyclesLeft == 0)
+		{
+			if (!WeakRegions || diskImage->IsWeak(headTrackPos, headBitOffset >> 3))
+				ResetEncoderDecoder<FluxNoise>(2 * 16, 23 * 16); // Trigger a random noise generated zero crossing and start seeing more anywhere between 2us and 25us after this one.
+			else
+				fluxReversalCyclesLeft = RandomCycles(2 * 16, 23 * 16);
+		}
+
+		if (UE7Counter == 0) // The count carry (bit 4) clocks UF4.
+		{
+			UE7Counter = 16 - CLOCK_SEL_AB;	// A and B inputs of UE7 come from the VIA's CLOCK SEL A/B outputs (ie PB5/6) ie preload the encoder/decoder clock for the current density settings.
+			// The decoder consists of UF4 and UE5A. The ecoder has two outputs, Pin 1 of UE5A is the serial data output and pin 2 of UF4 (output B) is the serial clock output.
+			++UF4Counter &= 0xf; // Clock and clamp UF4.
+			// The UD2 read shift register is clocked by serial clock (the rising edge of encoder/decoder's UF4 B output (serial clock))
+			//	- ie on counts 2, 6, 10 and 14 (2 is the only count that outputs a 1 into readShiftRegister as the MSB bits of the count NORed together for other values are 0)
+			if ((UF4Counter & 0x3) == 2)
+			{
+				// A bit cell is four encoder/decoder clock pulses wide, as the 2nd bit of UF4 controls the serial clock (and takes 4 cycles to loop a two bit counter).
+				// If a flux reversal (or pulse into the decoder) occurs at the beginning of a cell, that cell is a 1 else that cell is a 0.
+				// If a flux reversal occurs, UF4's counter is cleared and the timing circuit is reset to start the encoder/decoder clock at the beginning of the VIA's current density setting.
+				// Pins 6 (output C) and 7 (output D) of UF4 are low, causing the output of UE5A, the serial data line, to go high.
+				// 2 encoder/decoder clock pulses later, the serial clock(pin 2 of UF4) goes high. When the serial clock line is high, the serial data line is valid and the shift register will shift in the data.
+				// The serial clock line remains high for another clock cycle.
+				// After four encoder/decoder clocks a bit cell is now complete.
+				// At this time, pins 2 (output A) and 3 (output B) of UF4 will again be low but as the count is counting up pin 6 (output C) will now be high.
+				// The high on pin 6 (output C) of UF4 causes the serial data line (pin 1 of UE5A) to go low as this is NORed with the low on pin 7 (output D).
+				// If a flux reversal occurs at the beginning of the next cell then everything resets and again we see a 1 on the serial data line 2 encoder/decoder cycles into that cell.
+				// If no flux reversal occurs at the beginning of the next cell, the serial data line will remain low when the serial clock line goes high again (two encoder/decoder clock cycles into the new cell).
+				// If there are no flux reversals for 2 cells then we see 0 on pin 6 (output C) and 1 on pin 7 (output D) of UF4 and this causes the serial data line (pin 1 of UE5A) to remain at 0.
+				// If there are no flux reversals for 3 cells then we see 1 on pin 6 (output C) and 1 on pin 7 (output D) of UF4 and this causes the serial data line (pin 1 of UE5A) to also remain at 0, after all, UE5A is a NOR gate.
+				// After 4 cells the counter inside UF4 loops back to 0 and we again see 0 on pin 6 (output C) and 0 on pin 7 (output C), causing the output of UE5A, the serial data line, to go to a 1, regardless of a true flux reversal!
+				readShiftRegister <<= 1;
+				readShiftRegister |= (UF4Counter == 2); // Emulate UE5A and only shift in a 1 when pins 6 (output C) and 7 (output D) (bits 2 and 3 of UF4Counter are 0. ie the first count of the bit cell)
+				if (Writing)
+				{
+					SetNextBit((writeShiftRegister & 0x80));
+					writeShiftRegister <<= 1;
+					// Note: SYNC can only trigger during reading as R/!W line is one of UC2's inputs.
+					UE3Counter++;
+				}
+				else
+				{
+					writeShiftRegister <<= 1;
+					bool sync = ((readShiftRegister & 0x3ff) == 0x3ff);	// if the last 10 bits are 1s then SYNC
+					m_pVIA->GetPortB()->SetInput(0x80, !sync);			// PB7 active low SYNC
+					if (sync)
+						UE3Counter = 0;	// Phase lock on to byte boundary
+					else
+						UE3Counter++;
+				}
+			}
+			// UC5B (NOR used to invert UF4's output B serial clock) output high when UF4 counts 0,1,4,5,8,9,12 and 13
+			else if (((UF4Counter & 2) == 0) && (UE3Counter == 8))	// Phase locked on to byte boundary
+			{
+				UE3Counter = 0;
+				SO = (m_pVIA->GetFCR() & m6522::FCR_CA2_OUTPUT_MODE0) != 0;	// bit 2 of the FCR indicates "Byte Ready Active" turned on or not.
+				if (Writing)
+				{
+					writeShiftRegister = m_pVIA->GetPortA()->GetOutput();
+				}
+				else
+				{
+					writeShiftRegister = readShiftRegister & 0xff;
+					m_pVIA->GetPortA()->SetInput(writeShiftRegister);
+				}
+			}
+		}
+	}
+}
+
 bool Drive::Update()
 {
 #if defined(PROFILE)
@@ -466,111 +691,12 @@ bool Drive::Update()
 			dataReady = true;
 			SO = false;
 		}
-		// UE6 provides the CPU's clock by dividing the 16Mhz clock by 16.
-		// UE7 (a 74ls193 4bit counter) counts up on the falling edge of the 16Mhz clock. UE7 drives the Encoder/Decoder clock.
-		// So we need to simulate 16 cycles for every 1 CPU cycle
-#if defined(EXPERIMENTALZERO)
-		if (writing)
-			DriveLoopWrite();
-		else
-		{
-			if (fluxReversalCyclesLeft > 16 && cyclesLeftForBit > 16)
-			{
-				DriveLoopReadNoFluxNoCycles();
-			}
-			else if (fluxReversalCyclesLeft > 16)
-			{
-				DriveLoopReadNoFlux();
-			}
-			else if (cyclesLeftForBit > 16)
-			{
-				DriveLoopReadNoCycles();
-			}
-			else
-			{
-				DriveLoopRead();
-			}
-		}
-#else
-		for (int cycles = 0; cycles < 16; ++cycles)
+		if (writing != writeMode)
 		{
-			if (!writing)
-			{
-				if (++cyclesForBit >= cyclesPerBit)
-				{
-					cyclesForBit -= cyclesPerBit;
-					// Any 1 bit coming from the disk will come in the form of a flux reversal. (Non return to zero inverted emulation.)
-					if (GetNextBit())
-					{
-						// We have a genuine flux reversal.
-						// Pin 12 of UE5D is the BIT SYNC Input. When a positive pulse is applied to pin 12, the output of UE5D(pin 13) is applied to the load line (of UE7),
-						// causing the encoder/decoder clock to terminate the current cycle early and begin a new one.
-						ResetEncoderDecoder(18.0f, 20.0f); // Start seeing random flux reversals 18us-20us from now (ie since the last real flux reversal).
-					}
-				}
-				// The video amplifiers will often oscillate with no data in, but these oscillations are high enough in frequency that they "seldom" get past the valid pulse detector.
-				// Some do and some copy protections rely on this random behaviour so we need to emultate it.
-				// For example, 720 will read a byte from the disk multiple times and check that the values read each time were infact different. It does not matter what the values are just that they are different.
-				randomFluxReversalTime -= 0.0625f;	// One 16th of a micro second.
-				if (randomFluxReversalTime <= 0) ResetEncoderDecoder(2.0f, 25.0f); // Trigger a random noise generated zero crossing and start seeing more anywhere between 2us and 25us after this one.
-			}
-			if (++UE7Counter == 0x10) // The count carry (bit 4) clocks UF4.
-			{
-				UE7Counter = CLOCK_SEL_AB;	// A and B inputs of UE7 come from the VIA's CLOCK SEL A/B outputs (ie PB5/6) ie preload the encoder/decoder clock for the current density settings.
-				// The decoder consists of UF4 and UE5A. The ecoder has two outputs, Pin 1 of UE5A is the serial data output and pin 2 of UF4 (output B) is the serial clock output.
-				++UF4Counter &= 0xf; // Clock and clamp UF4.
-				// The UD2 read shift register is clocked by serial clock (the rising edge of encoder/decoder's UF4 B output (serial clock))
-				//	- ie on counts 2, 6, 10 and 14 (2 is the only count that outputs a 1 into readShiftRegister as the MSB bits of the count NORed together for other values are 0)
-				if ((UF4Counter & 0x3) == 2)
-				{
-					// A bit cell is four encoder/decoder clock pulses wide, as the 2nd bit of UF4 controls the serial clock (and takes 4 cycles to loop a two bit counter).
-					// If a flux reversal (or pulse into the decoder) occurs at the beginning of a cell, that cell is a 1 else that cell is a 0.
-					// If a flux reversal occurs, UF4's counter is cleared and the timing circuit is reset to start the encoder/decoder clock at the beginning of the VIA's current density setting.
-					// Pins 6 (output C) and 7 (output D) of UF4 are low, causing the output of UE5A, the serial data line, to go high.
-					// 2 encoder/decoder clock pulses later, the serial clock(pin 2 of UF4) goes high. When the serial clock line is high, the serial data line is valid and the shift register will shift in the data.
-					// The serial clock line remains high for another clock cycle.
-					// After four encoder/decoder clocks a bit cell is now complete.
-					// At this time, pins 2 (output A) and 3 (output B) of UF4 will again be low but as the count is counting up pin 6 (output C) will now be high.
-					// The high on pin 6 (output C) of UF4 causes the serial data line (pin 1 of UE5A) to go low as this is NORed with the low on pin 7 (output D).
-					// If a flux reversal occurs at the beginning of the next cell then everything resets and again we see a 1 on the serial data line 2 encoder/decoder cycles into that cell.
-					// If no flux reversal occurs at the beginning of the next cell, the serial data line will remain low when the serial clock line goes high again (two encoder/decoder clock cycles into the new cell).
-					// If there are no flux reversals for 2 cells then we see 0 on pin 6 (output C) and 1 on pin 7 (output D) of UF4 and this causes the serial data line (pin 1 of UE5A) to remain at 0.
-					// If there are no flux reversals for 3 cells then we see 1 on pin 6 (output C) and 1 on pin 7 (output D) of UF4 and this causes the serial data line (pin 1 of UE5A) to also remain at 0, after all, UE5A is a NOR gate.
-					// After 4 cells the counter inside UF4 loops back to 0 and we again see 0 on pin 6 (output C) and 0 on pin 7 (output C), causing the output of UE5A, the serial data line, to go to a 1, regardless of a true flux reversal!
-					readShiftRegister <<= 1;
-					readShiftRegister |= (UF4Counter == 2); // Emulate UE5A and only shift in a 1 when pins 6 (output C) and 7 (output D) (bits 2 and 3 of UF4Counter are 0. ie the first count of the bit cell)
-					if (writing) SetNextBit((writeShiftRegister & 0x80));
-					writeShiftRegister <<= 1;
-					// Note: SYNC can only trigger during reading as R/!W line is one of UC2's inputs.
-					if (!writing && ((readShiftRegister & 0x3ff) == 0x3ff))	// if the last 10 bits are 1s then SYNC
-					{
-						UE3Counter = 0;	// Phase lock on to byte boundary
-						m_pVIA->GetPortB()->SetInput(0x80, false);			// PB7 active low SYNC
-					}
-					else
-					{
-						if (!writing) m_pVIA->GetPortB()->SetInput(0x80, true); // SYNC not asserted if not following the SYNC bits
-						UE3Counter++;
-					}
-				}
-				// UC5B (NOR used to invert UF4's output B serial clock) output high when UF4 counts 0,1,4,5,8,9,12 and 13
-				else if (((UF4Counter & 2) == 0) && (UE3Counter == 8))	// Phase locked on to byte boundary
-				{
-					UE3Counter = 0;
-					SO = (m_pVIA->GetFCR() & m6522::FCR_CA2_OUTPUT_MODE0) != 0;	// bit 2 of the FCR indicates "Byte Ready Active" turned on or not.
-					if (writing) 
-					{
-						writeShiftRegister = m_pVIA->GetPortA()->GetOutput();
-					}
-					else
-					{
-						writeShiftRegister = (u8)(readShiftRegister & 0xff);
-						m_pVIA->GetPortA()->SetInput(writeShiftRegister);
-					}
-				}
-			}
+			writeMode = writing;
+			SelectDriveLoop();
 		}
-#endif
+		(this->*driveLoop)();
 	}
 	m_pVIA->InputCA1(!SO);
 
@@ -581,285 +707,3 @@ bool Drive::Update()
 
 	return dataReady;
 }
-
-
-#if defined(EXPERIMENTALZERO)
-#define min(a,b) (((a) < (b)) ? (a) : (b))
-#define max(a,b) (((a) > (b)) ? (a) : (b))
-
-void Drive::DriveLoopReadNoFluxNoCycles()
-{
-	unsigned int cycles = 16;
-	fluxReversalCyclesLeft -= 16;
-	cyclesLeftForBit -= 16;
-	while (true)
-	{
-		if (cycles < UE7Counter)
-		{
-			UE7Counter -= cycles;
-			cycles = 0;
-			return;
-		}
-		cycles -= UE7Counter;
-
-		UE7Counter = 16 - CLOCK_SEL_AB;	// A and B inputs of UE7 come from the VIA's CLOCK SEL A/B outputs (ie PB5/6) ie preload the encoder/decoder clock for the current density settings.
-									// The decoder consists of UF4 and UE5A. The ecoder has two outputs, Pin 1 of UE5A is the serial data output and pin 2 of UF4 (output B) is the serial clock output.
-		++UF4Counter &= 0xf; // Clock and clamp UF4.
-								// The UD2 read shift register is clocked by serial clock (the rising edge of encoder/decoder's UF4 B output (serial clock))
-								//	- ie on counts 2, 6, 10 and 14 (2 is the only count that outputs a 1 into readShiftRegister as the MSB bits of the count NORed together for other values are 0)
-		if ((UF4Counter & 0x3) == 2)
-		{
-			readShiftRegister <<= 1;
-			readShiftRegister |= (UF4Counter == 2); 
-
-			//writeShiftRegister <<= 1;
-			
-			bool resetTime = ((readShiftRegister & 0x3ff) == 0x3ff);
-			m_pVIA->GetPortB()->SetInput(0x80, !resetTime);
-			if (resetTime)	// if the last 10 bits are 1s then SYNC
-				UE3Counter = 0;	// Phase lock on to byte boundary
-			else
-				UE3Counter++;
-		}
-		// UC5B (NOR used to invert UF4's output B serial clock) output high when UF4 counts 0,1,4,5,8,9,12 and 13
-		else if (((UF4Counter & 2) == 0) && (UE3Counter == 8))	// Phase locked on to byte boundary
-		{
-			UE3Counter = 0;
-			SO = (m_pVIA->GetFCR() & m6522::FCR_CA2_OUTPUT_MODE0) != 0;	// bit 2 of the FCR indicates "Byte Ready Active" turned on or not.
-//			writeShiftRegister = readShiftRegister;
-			m_pVIA->GetPortA()->SetInput(readShiftRegister & 0xff);
-		}
-	};
-}
-
-void Drive::DriveLoopReadNoFlux()
-{
-	unsigned int minCycles;
-	unsigned int cycles = 16;
-
-	fluxReversalCyclesLeft -= 16;
-
-	while (true)
-	{
-		minCycles = min(min(cyclesLeftForBit, cycles), UE7Counter);
-		cyclesLeftForBit -= minCycles;
-		cycles -= minCycles;
-		UE7Counter -= minCycles;
-
-		if (cycles == 0)
-			return;
-
-		if (cyclesLeftForBit == 0)
-		{
-			cyclesForBitErrorCounter -= cyclesPerBitErrorConstant;
-			cyclesLeftForBit = cyclesPerBitInt + (cyclesForBitErrorCounter < cyclesPerBitErrorConstant);
-
-			//cyclesForBit -= cyclesPerBit;
-			//cyclesLeftForBit = ceil(cyclesPerBit - cyclesForBit);
-			//cyclesForBit += cyclesLeftForBit;
-
-			if (GetNextBit())
-			{
-				ResetEncoderDecoder(18 * 16, /*20 * 16*/ 2 * 16);
-			}
-			if (cycles < UE7Counter)
-			{
-				UE7Counter -= cycles;
-				cyclesLeftForBit -= cycles;
-				return;
-			}
-			cyclesLeftForBit -= UE7Counter;
-			cycles -= UE7Counter;
-		}
-
-		//if (UE7Counter == 0x0) // The count carry (bit 4) clocks UF4.
-		{
-			UE7Counter = 16 - CLOCK_SEL_AB;	// A and B inputs of UE7 come from the VIA's CLOCK SEL A/B outputs (ie PB5/6) ie preload the encoder/decoder clock for the current density settings.
-										// The decoder consists of UF4 and UE5A. The ecoder has two outputs, Pin 1 of UE5A is the serial data output and pin 2 of UF4 (output B) is the serial clock output.
-			++UF4Counter &= 0xf; // Clock and clamp UF4.
-								 // The UD2 read shift register is clocked by serial clock (the rising edge of encoder/decoder's UF4 B output (serial clock))
-								 //	- ie on counts 2, 6, 10 and 14 (2 is the only count that outputs a 1 into readShiftRegister as the MSB bits of the count NORed together for other values are 0)
-			if ((UF4Counter & 0x3) == 2)
-			{
-				readShiftRegister <<= 1;
-				readShiftRegister |= (UF4Counter == 2);
-
-				//writeShiftRegister <<= 1;
-
-				bool resetTime = ((readShiftRegister & 0x3ff) == 0x3ff);
-				m_pVIA->GetPortB()->SetInput(0x80, !resetTime);
-				if (resetTime)	// if the last 10 bits are 1s then SYNC
-					UE3Counter = 0;	// Phase lock on to byte boundary
-				else
-					UE3Counter++;
-			}
-			// UC5B (NOR used to invert UF4's output B serial clock) output high when UF4 counts 0,1,4,5,8,9,12 and 13
-			else if (((UF4Counter & 2) == 0) && (UE3Counter == 8))	// Phase locked on to byte boundary
-			{
-				UE3Counter = 0;
-				SO = (m_pVIA->GetFCR() & m6522::FCR_CA2_OUTPUT_MODE0) != 0;	// bit 2 of the FCR indicates "Byte Ready Active" turned on or not.
-	//			writeShiftRegister = readShiftRegister;
-				m_pVIA->GetPortA()->SetInput(readShiftRegister & 0xff);
-			}
-		}
-	};
-}
-void Drive::DriveLoopReadNoCycles()
-{
-	unsigned int minCycles;
-	unsigned int cycles = 16;
-
-	cyclesLeftForBit -= 16;
-	while (true)
-	{
-		minCycles = min(cycles, min(UE7Counter, fluxReversalCyclesLeft));
-		fluxReversalCyclesLeft -= minCycles;
-		cycles -= minCycles;
-		UE7Counter -= minCycles;
-
-		if (cycles == 0)
-			return;
-
-		if (fluxReversalCyclesLeft == 0)//Not entirely right, a flux reversal will be skipped if a bit read was going to happen
-		{
-			ResetEncoderDecoder(2 * 16, /*25 * 16*/23 * 16); // Trigger a random noise generated zero crossing and start seeing more anywhere between 2us and 25us after this one.
-		}
-
-		if (UE7Counter == 0x0) // The count carry (bit 4) clocks UF4.
-		{
-			UE7Counter = 16 - CLOCK_SEL_AB;	// A and B inputs of UE7 come from the VIA's CLOCK SEL A/B outputs (ie PB5/6) ie preload the encoder/decoder clock for the current density settings.
-										// The decoder consists of UF4 and UE5A. The ecoder has two outputs, Pin 1 of UE5A is the serial data output and pin 2 of UF4 (output B) is the serial clock output.
-			++UF4Counter &= 0xf; // Clock and clamp UF4.
-								 // The UD2 read shift register is clocked by serial clock (the rising edge of encoder/decoder's UF4 B output (serial clock))
-								 //	- ie on counts 2, 6, 10 and 14 (2 is the only count that outputs a 1 into readShiftRegister as the MSB bits of the count NORed together for other values are 0)
-			if ((UF4Counter & 0x3) == 2)
-			{
-				readShiftRegister <<= 1;
-				readShiftRegister |= (UF4Counter == 2);
-
-				//writeShiftRegister <<= 1;
-
-				bool resetTime = ((readShiftRegister & 0x3ff) == 0x3ff);
-				m_pVIA->GetPortB()->SetInput(0x80, !resetTime);
-				if (resetTime)	// if the last 10 bits are 1s then SYNC
-					UE3Counter = 0;	// Phase lock on to byte boundary
-				else
-					UE3Counter++;
-			}
-			// UC5B (NOR used to invert UF4's output B serial clock) output high when UF4 counts 0,1,4,5,8,9,12 and 13
-			else if (((UF4Counter & 2) == 0) && (UE3Counter == 8))	// Phase locked on to byte boundary
-			{
-				UE3Counter = 0;
-				SO = (m_pVIA->GetFCR() & m6522::FCR_CA2_OUTPUT_MODE0) != 0;	// bit 2 of the FCR indicates "Byte Ready Active" turned on or not.
-	//			writeShiftRegister = readShiftRegister;
-				m_pVIA->GetPortA()->SetInput(readShiftRegister & 0xff);
-			}
-		}
-	};
-}
-
-void Drive::DriveLoopRead()
-{
-	unsigned int minCycles;
-	unsigned int cycles = 16;
-
-	while (true)
-	{
-		minCycles = min(min(cyclesLeftForBit, cycles), min(UE7Counter, fluxReversalCyclesLeft));
-		cyclesLeftForBit -= minCycles;
-		fluxReversalCyclesLeft -= minCycles;
-		cycles -= minCycles;
-		UE7Counter -= minCycles;
-
-		if (cycles == 0)
-			return;
-
-		if (cyclesLeftForBit == 0)
-		{
-			cyclesForBitErrorCounter -= cyclesPerBitErrorConstant;
-			cyclesLeftForBit = cyclesPerBitInt + (cyclesForBitErrorCounter < cyclesPerBitErrorConstant);
-
-			if (GetNextBit())
-			{
-				ResetEncoderDecoder(18 * 16, /*20 * 16*/ 2 * 16);
-			}
-		}
-
-		if (fluxReversalCyclesLeft == 0)//Not entirely right, a flux reversal will be skipped if a bit read was going to happen
-		{
-			ResetEncoderDecoder(2 * 16, /*25 * 16*/23 * 16); // Trigger a random noise generated zero crossing and start seeing more anywhere between 2us and 25us after this one.
-		}
-
-		if (UE7Counter == 0x0) // The count carry (bit 4) clocks UF4.
-		{
-			UE7Counter = 16-CLOCK_SEL_AB;	// A and B inputs of UE7 come from the VIA's CLOCK SEL A/B outputs (ie PB5/6) ie preload the encoder/decoder clock for the current density settings.
-										// The decoder consists of UF4 and UE5A. The ecoder has two outputs, Pin 1 of UE5A is the serial data output and pin 2 of UF4 (output B) is the serial clock output.
-			++UF4Counter &= 0xf; // Clock and clamp UF4.
-								 // The UD2 read shift register is clocked by serial clock (the rising edge of encoder/decoder's UF4 B output (serial clock))
-								 //	- ie on counts 2, 6, 10 and 14 (2 is the only count that outputs a 1 into readShiftRegister as the MSB bits of the count NORed together for other values are 0)
-			if ((UF4Counter & 0x3) == 2)
-			{
-				readShiftRegister <<= 1;
-				readShiftRegister |= (UF4Counter == 2);
-
-				//writeShiftRegister <<= 1;
-
-				bool resetTime = ((readShiftRegister & 0x3ff) == 0x3ff);
-				m_pVIA->GetPortB()->SetInput(0x80, !resetTime);
-				if (resetTime)	// if the last 10 bits are 1s then SYNC
-					UE3Counter = 0;	// Phase lock on to byte boundary
-				else
-					UE3Counter++;
-			}
-			// UC5B (NOR used to invert UF4's output B serial clock) output high when UF4 counts 0,1,4,5,8,9,12 and 13
-			else if (((UF4Counter & 2) == 0) && (UE3Counter == 8))	// Phase locked on to byte boundary
-			{
-				UE3Counter = 0;
-				SO = (m_pVIA->GetFCR() & m6522::FCR_CA2_OUTPUT_MODE0) != 0;	// bit 2 of the FCR indicates "Byte Ready Active" turned on or not.
-	//			writeShiftRegister = readShiftRegister;
-				m_pVIA->GetPortA()->SetInput(readShiftRegister & 0xff);
-			}
-		}
-	};
-}
-
-void Drive::DriveLoopWrite()
-{
-	unsigned int cycles = 16;
-	while(true)
-	{
-		if (cycles < UE7Counter)
-		{
-			UE7Counter -= cycles;
-			cycles = 0;
-			return;
-		}
-		
-		cycles -= UE7Counter;
-
-		UE7Counter = 16 - CLOCK_SEL_AB;	// A and B inputs of UE7 come from the VIA's CLOCK SEL A/B outputs (ie PB5/6) ie preload the encoder/decoder clock for the current density settings.
-									// The decoder consists of UF4 and UE5A. The ecoder has two outputs, Pin 1 of UE5A is the serial data output and pin 2 of UF4 (output B) is the serial clock output.
-		++UF4Counter &= 0xf; // Clock and clamp UF4.
-								// The UD2 read shift register is clocked by serial clock (the rising edge of encoder/decoder's UF4 B output (serial clock))
-								//	- ie on counts 2, 6, 10 and 14 (2 is the only count that outputs a 1 into readShiftRegister as the MSB bits of the count NORed together for other values are 0)
-		if ((UF4Counter & 0x3) == 2)
-		{
-			readShiftRegister <<= 1;
-			readShiftRegister |= (UF4Counter == 2); // Emulate UE5A and only shift in a 1 when pins 6 (output C) and 7 (output D) (bits 2 and 3 of UF4Counter are 0. ie the first count of the bit cell)
-
-			SetNextBit((writeShiftRegister & 0x80));
-
-			writeShiftRegister <<= 1;
-			// Note: SYNC can only trigger during reading as R/!W line is one of UC2's inputs.
-			UE3Counter++;
-		}
-		// UC5B (NOR used to invert UF4's output B serial clock) output high when UF4 counts 0,1,4,5,8,9,12 and 13
-		else if (((UF4Counter & 2) == 0) && (UE3Counter == 8))	// Phase locked on to byte boundary
-		{
-			UE3Counter = 0;
-			SO = (m_pVIA->GetFCR() & m6522::FCR_CA2_OUTPUT_MODE0) != 0;	// bit 2 of the FCR indicates "Byte Ready Active" turned on or not.
-			writeShiftRegister = m_pVIA->GetPortA()->GetOutput();
-		}
-	}
-}
-#endif
\ No newline at end of file
@@ -23,17 +23,6 @@
 #include "DiskImage.h"
 #include <stdlib.h>
 
-#if defined(EXPERIMENTALZERO)
-inline int ceil(float num) {
-	int inum = (int)num;
-	if (num == (float)inum) {
-		return inum;
-	}
-	return inum + 1;
-}
-#endif
-
-
 class Drive
 {
 public:
@@ -48,18 +37,14 @@ public:
 	static void OnPortOut(void*, unsigned char status);
 
 	bool Update();
-#if defined(EXPERIMENTALZERO)
-	void DriveLoopWrite();
-	void DriveLoopRead();
-	void DriveLoopReadNoFluxNoCycles();
-	void DriveLoopReadNoFlux();
-	void DriveLoopReadNoCycles();
-#endif
 
 	void Insert(DiskImage* diskImage);
 	inline const DiskImage* GetDiskImage() const { return diskImage; }
 	void Eject();
 	void Reset();
+	void SerialiseState(Snapshot& snapshot);
+	inline void SetSeed(u32 seed) { localSeed = seed; }
+	inline u32 GetSeed() const { return localSeed; }
 	inline unsigned Track() const { return headTrackPos; }
 	inline unsigned SectorPos() const { return headBitOffset >> 3; }
 	inline unsigned GetHeadBitOffset() const { return headBitOffset; }
@@ -68,40 +53,52 @@ public:
 
 	inline unsigned char GetLastHeadDirection() const { return lastHeadDirection; } // For simulated head movement sounds
 private:
-#if defined(EXPERIMENTALZERO)
-	int32_t localSeed;
-	inline void ResetEncoderDecoder(unsigned int min, unsigned int /*max*/span)
+	// The flux noise has its own generator rather than rand() so a session can be seeded, saved and replayed.
+	u32 localSeed;
+	inline u32 NextRandom()
 	{
-		UE7Counter = 16 - CLOCK_SEL_AB;	// A and B inputs of UE7 come from the VIA's CLOCK SEL A/B outputs (ie PB5/6)
-		UF4Counter = 0;
 		localSeed = ((localSeed * 1103515245) + 12345) & 0x7fffffff;
-		fluxReversalCyclesLeft = (span) * (localSeed >> 11) + min;
+		return localSeed;
+	}
+	// Inputs in 16Mhz cycles. Returns somewhere from min up to min + span.
+	inline u32 RandomCycles(unsigned min, unsigned span)
+	{
+		return min + ((span * (NextRandom() >> 15)) >> 16);
 	}
-#else
-	inline float GenerateRandomFluxReversalTime(float min, float max) { return ((max - min) * ((float)rand() / RAND_MAX)) + min; } // Inputs in micro seconds
 
-	inline void ResetEncoderDecoder(float min, float max)
+	template <bool FluxNoise>
+	inline void ResetEncoderDecoder(unsigned min, unsigned span)
 	{
-		UE7Counter = CLOCK_SEL_AB;	// A and B inputs of UE7 come from the VIA's CLOCK SEL A/B outputs (ie PB5/6)
+		UE7Counter = 16 - CLOCK_SEL_AB;	// A and B inputs of UE7 come from the VIA's CLOCK SEL A/B outputs (ie PB5/6)
 		UF4Counter = 0;
-		randomFluxReversalTime = GenerateRandomFluxReversalTime(min, max);
+		if (FluxNoise)
+			fluxReversalCyclesLeft = RandomCycles(min, span);
 	}
-#endif
+
+	// The drive loop is compiled for each combination of what it has to model so it never checks anything that can not change while it runs.
+	// One is picked whenever that changes: a disk is inserted, the head steps or the VIA switches between reading and writing.
+	template <bool Writing, bool FluxNoise, bool WeakRegions> void DriveLoop();
+	void SelectDriveLoop();
+	void SetDriveLoop();
+	bool TrackNeedsFluxNoise(unsigned track) const;
+	void (Drive::*driveLoop)();
+
+	void CalculateTrackTimings();
+
 	inline void UpdateHeadSectorPosition()
 	{
-		// Disk spins at 300rpm = 5rps so to calculate how many 16Mhz cycles one rotation takes;-
-		// 16000000 / 5 = 3200000;
-		static const float CYCLES_16Mhz_PER_ROTATION = 3200000.0f;
+		const TrackTiming& timing = trackTimings[headTrackPos];
 
-		bitsInTrack = diskImage->BitsInTrack(headTrackPos);
-		headBitOffset %= bitsInTrack;
-		cyclesPerBit = CYCLES_16Mhz_PER_ROTATION / (float)bitsInTrack;
-#if defined(EXPERIMENTALZERO)
-		cyclesPerBitInt = cyclesPerBit;
-		cyclesPerBitErrorConstant = (unsigned int)((cyclesPerBit - ((float)cyclesPerBitInt)) * static_cast<float>(0xffffffff));
-		cyclesForBitErrorCounter = (unsigned int)(((cyclesForBit)-(int)(cyclesForBit)) * static_cast<float>(0xffffffff));
-#endif
+		// A remote image's track may still be on its way.
+		if (diskImage && !diskImage->IsTrackLoaded(headTrackPos))
+			diskImage->FetchTrack(headTrackPos);
 
+		bitsInTrack = timing.bitsInTrack;
+		headBitOffset %= bitsInTrack;
+		cyclesPerBitInt = timing.cyclesPerBitInt;
+		cyclesPerBitErrorConstant = timing.cyclesPerBitErrorConstant;
+		// cyclesForBitErrorCounter carries on;- the fraction of a bit cell already timed is not lost by stepping.
+		SelectDriveLoop();
 	}
 
 	inline void MoveHead(unsigned char headDirection)
@@ -124,7 +121,6 @@ private:
 
 	void DumpTrack(unsigned track); // Used for debugging disk images.
 
-#if defined(EXPERIMENTALZERO)
 	inline u32 AdvanceSectorPosition(int& byteOffset)
 	{
 		if (++headBitOffset == bitsInTrack)
@@ -132,17 +128,10 @@ private:
 		byteOffset = headBitOffset >> 3;
 		return (~headBitOffset) & 7;
 	}
-#else
-	inline u32 AdvanceSectorPosition(int& byteOffset)
-	{
-		++headBitOffset %= bitsInTrack;
-		byteOffset = headBitOffset >> 3;
-		return (~headBitOffset) & 7;
-	}
-#endif
 	unsigned cachedheadTrackPos = -1;
 	int cachedbyteOffset = -1;
 	unsigned char cachedByte = 0;
+	template <bool WeakRegions>
 	inline bool GetNextBit()
 	{
 		int byteOffset;
@@ -152,6 +141,8 @@ private:
 		if (byteOffset != cachedbyteOffset || cachedheadTrackPos != headTrackPos)
 		{
 			cachedByte = diskImage->GetNextByte(headTrackPos, byteOffset);
+			if (WeakRegions && diskImage->IsWeak(headTrackPos, byteOffset))
+				cachedByte = 0;	// No flux reversals of its own so only noise gets through
 			cachedbyteOffset = byteOffset;
 			cachedheadTrackPos = headTrackPos;
 			
@@ -168,6 +159,16 @@ private:
 	}
 
 	DiskImage* diskImage;
+
+	// Worked out for every half track when a disk is inserted so stepping the head only has to look them up.
+	struct TrackTiming
+	{
+		u32 bitsInTrack;
+		unsigned int cyclesPerBitInt;
+		unsigned int cyclesPerBitErrorConstant;	// The fraction of a cycle in 1/2^32ths
+	};
+	TrackTiming trackTimings[HALF_TRACK_COUNT];
+
 	// When swapping disks some code waits for the write protect signal to go high which will happen if a human ejects a disk.
 	// Emulate this by asserting the write protect signal for a few cycles before inserting the new disk image.
 	u32	newDiskImageQueuedCylesRemaining;
@@ -181,7 +182,6 @@ private:
 	// CB2 (output)
 	//	- R/!W
 	m6522* m_pVIA;
-#if defined(EXPERIMENTALZERO)
 	unsigned int cyclesLeftForBit;
 	unsigned int fluxReversalCyclesLeft;
 	unsigned int UE7Counter;
@@ -189,22 +189,18 @@ private:
 	unsigned int cyclesForBitErrorCounter;
 	unsigned int cyclesPerBitErrorConstant;
 	unsigned int cyclesPerBitInt;
-#else
-	int UE7Counter;
-	u8 writeShiftRegister;
-#endif
-	float cyclesForBit;
+	bool writeMode;		// What the drive loop was last picked for
+	bool fluxNoise;
+	bool weakRegions;
 	u32 readShiftRegister;
 	unsigned headTrackPos;
 	u32 headBitOffset;
-	float randomFluxReversalTime;
 	int UF4Counter;
 	int UE3Counter;
 	int CLOCK_SEL_AB;
 	bool SO;
 	unsigned char lastHeadDirection;
 	u32 bitsInTrack;
-	float cyclesPerBit;
 	bool motor;
 	bool LED;
 };
@@ -33,12 +33,15 @@ extern "C"
 }
 
 #include "iec_commands.h"
+#include "emmc.h"
+#include "net.h"
 extern IEC_Commands m_IEC_Commands;
 extern Options options;
+extern CEMMCDevice m_EMMC;
 
 
-#define PNG_WIDTH 320
-#define PNG_HEIGHT 200
+// Icons are only decoded once the highlight has rested this long, so scrolling never waits on stb_image.
+#define ICON_DECODE_DELAY_US 100000
 
 extern void GlobalSetDeviceID(u8 id);
 extern void CheckAutoMountImage(EXIT_TYPE reset_reason , FileBrowser* fileBrowser);
@@ -516,6 +519,8 @@ FileBrowser::FileBrowser(InputMappings* inputMappings, DiskCaddy* diskCaddy, ROM
 	, roms(roms)
 	, deviceID(deviceID)
 	, displayPNGIcons(displayPNGIcons)
+	, iconPending(false)
+	, iconRequestTime(0)
 #if not defined(EXPERIMENTALZERO)
 	, screenMain(screenMain)
 #endif
@@ -523,6 +528,7 @@ FileBrowser::FileBrowser(InputMappings* inputMappings, DiskCaddy* diskCaddy, ROM
 	, scrollHighlightRate(scrollHighlightRate)
 	, displayingDevices(false)
 {
+	folderPath[0] = 0;
 
 	folder.scrollHighlightRate = scrollHighlightRate;
 
@@ -635,12 +641,15 @@ void FileBrowser::RefreshFolderEntries()
 	char* ext;
 
 	folder.Clear();
+	folderPath[0] = 0;
 	if (displayingDevices)
 	{
 		FileBrowser::RefreshDevicesEntries(folder.entries, false);
 	}
 	else
 	{
+		if (f_getcwd(folderPath, sizeof(folderPath)) != FR_OK)
+			folderPath[0] = 0;
 		res = f_opendir(&dir, ".");
 		if (res == FR_OK)
 		{
@@ -800,10 +809,17 @@ void FileBrowser::RefeshDisplay()
 	u32 textColour = Colour(VIC2_COLOUR_INDEX_LGREEN);
 	u32 bgColour = Colour(VIC2_COLOUR_INDEX_GREY);
 	char buffer[1024];
+	screenMain->BeginFrame();
 	if (f_getcwd(buffer, 1024) == FR_OK)
 	{
-		screenMain->DrawRectangle(0, 0, (int)screenMain->Width(), 17, bgColour);
+		// Pad the path to the full width so the title bar is drawn as text cells; unchanged cells are then skipped.
+		u32 columns = Min(screenMain->Width() / 8, sizeof(buffer) - 1);
+		u32 len = strlen(buffer);
+		while (len < columns)
+			buffer[len++] = ' ';
+		buffer[len] = 0;
 		screenMain->PrintText(false, 0, 0, buffer, textColour, bgColour);
+		screenMain->DrawRectangle(0, 16, (int)screenMain->Width(), 17, bgColour);
 	}
 	//u32 offsetX = screenMain->ScaleX(1024 - 320);
 	//RefeshDisplayForBrowsableList(&folder, 0);
@@ -819,6 +835,7 @@ void FileBrowser::RefeshDisplay()
 		u32 y = screenMain->ScaleY(STATUS_BAR_POSITION_Y);
 		screenMain->PrintText(false, 0, y, folder.searchPrefix, textColour, bgColour);
 	}
+	screenMain->EndFrame();
 #else
 	folder.RefreshViews();
 	caddySelections.RefreshViews();
@@ -850,61 +867,75 @@ bool FileBrowser::CheckForPNG(const char* filename, FILINFO& filIcon)
 	return foundValid;
 }
 
-void FileBrowser::DisplayPNG(FILINFO& filIcon, int x, int y)
+// The disk info screen is drawn once, and while emulating nothing services the request queue, so its icon is decoded now.
+void FileBrowser::DisplayPNG(const char* folder, FILINFO& filIcon, int x, int y)
 {
-	if (filIcon.fname[0] != 0)
+#if not defined(EXPERIMENTALZERO)
+	u32* image;
+	if (iconCache.Load(folder, filIcon, image) && image)
+		screenMain->PlotImage(image, x, y, PNG_WIDTH, PNG_HEIGHT);
+#endif
+}
+
+// Only draws the highlighted entry's icon if it is already decoded. Otherwise it is queued (with its neighbours) and UpdateIcons draws it once decoded.
+void FileBrowser::DisplayPNG()
+{
+#if not defined(EXPERIMENTALZERO)
+	if (displayPNGIcons && folder.current)
 	{
-		FIL fp;
-		FRESULT res;
+		FileBrowser::BrowsableList::Entry* current = folder.current;
+		u32* image;
 
-		res = f_open(&fp, filIcon.fname, FA_READ);
-		if (res == FR_OK)
+		iconPending = false;
+		if (iconCache.Find(folderPath, current->filIcon, image))
 		{
-			char* PNG = (char*)malloc(filIcon.fsize);
-			if (PNG)
+			if (image)
 			{
-				u32 bytesRead;
-				SetACTLed(true);
-				f_read(&fp, PNG, filIcon.fsize, &bytesRead);
-				SetACTLed(false);
-				f_close(&fp);
-
-				int w;
-				int h;
-				int channels_in_file;
-				stbi_uc* image = stbi_load_from_memory((stbi_uc const*)PNG, bytesRead, &w, &h, &channels_in_file, 4);
-#if not defined(EXPERIMENTALZERO)
-
-				if (image && (w == PNG_WIDTH && h == PNG_HEIGHT))
-				{
-					//DEBUG_LOG("Opened PNG %s w = %d h = %d cif = %d\r\n", fileName, w, h, channels_in_file);
-					screenMain->PlotImage((u32*)image, x, y, w, h);
-				}
-				else
-				{
-					//DEBUG_LOG("Invalid PNG size %d x %d\r\n", w, h);
-				}
-#endif
-				free(PNG);
+				u32 x = screenMain->ScaleX(1024) - PNG_WIDTH;
+				u32 y = screenMain->ScaleY(616) - PNG_HEIGHT;
+				screenMain->PlotImage(image, x, y, PNG_WIDTH, PNG_HEIGHT);
 			}
 		}
+		else if (current->filIcon.fname[0] != 0)
+		{
+			iconPending = true;
+		}
+		RequestIcons();
 	}
-	else
+#endif
+}
+
+// Queue the highlighted entry's icon first, then the entries either side of it, nearest first.
+void FileBrowser::RequestIcons()
+{
+	iconCache.StartRequests();
+	iconRequestTime = read32(ARM_SYSTIMER_CLO);
+
+	int count = (int)folder.entries.size();
+	int index = (int)folder.currentIndex;
+	iconCache.Request(folderPath, folder.entries[index].filIcon);
+	for (int distance = 1; distance <= IconCache::MAX_REQUESTS / 2; ++distance)
 	{
-		//DEBUG_LOG("Cannot find PNG %s\r\n", fileName);
+		if (index + distance < count)
+			iconCache.Request(folderPath, folder.entries[index + distance].filIcon);
+		if (index - distance >= 0)
+			iconCache.Request(folderPath, folder.entries[index - distance].filIcon);
 	}
+	iconCache.EndRequests();
 }
 
-void FileBrowser::DisplayPNG()
+// Decode one queued icon per call so navigation input is serviced between decodes.
+void FileBrowser::UpdateIcons()
 {
 #if not defined(EXPERIMENTALZERO)
-	if (displayPNGIcons && folder.current)
-	{
-		FileBrowser::BrowsableList::Entry* current = folder.current;
-		u32 x = screenMain->ScaleX(1024) - PNG_WIDTH;
-		u32 y = screenMain->ScaleY(616) - PNG_HEIGHT;
-		DisplayPNG(current->filIcon, x, y);
-	}
+	if (!displayPNGIcons || state != State_Folders || !iconCache.HasRequests())
+		return;
+	if ((read32(ARM_SYSTIMER_CLO) - iconRequestTime) < ICON_DECODE_DELAY_US)
+		return;
+
+	u32* image;
+	if (iconCache.ServiceRequest() && iconPending && folder.current && iconCache.Find(folderPath, folder.current->filIcon, image))
+		DisplayPNG();
 #endif
 }
 
@@ -1028,6 +1059,7 @@ void FileBrowser::Update()
 		UpdateInputFolders();
 
 	UpdateCurrentHighlight();
+	UpdateIcons();
 }
 
 bool FileBrowser::FillCaddyWithSelections()
@@ -1355,7 +1387,7 @@ bool FileBrowser::SelectLST(const char* filenameLST)
 			{
 				//DEBUG_LOG("LST token = %s\r\n", token);
 				diskType = DiskImage::GetDiskImageTypeViaExtention(token);
-				if (diskType == DiskImage::D64 || diskType == DiskImage::G64 || diskType == DiskImage::NIB || diskType == DiskImage::NBZ || diskType == DiskImage::T64)
+				if (diskType == DiskImage::D64 || diskType == DiskImage::G64 || diskType == DiskImage::NIB || diskType == DiskImage::NBZ || diskType == DiskImage::T64 || diskType == DiskImage::NET)
 				{
 					FileBrowser::BrowsableList::Entry* entry = folder.FindEntry(token);
 					if (entry && !(entry->filImage.fattrib & AM_DIR))
@@ -1417,6 +1449,14 @@ void FileBrowser::DisplayStatusBar()
 		snprintf(bufferOut, 128, "LED 0 Motor 0 Track 18.0 ATN 0 DAT 0 CLK 0");
 
 	screenMain->PrintText(false, x, y, bufferOut, RGBA(0, 0, 0, 0xff), RGBA(0xff, 0xff, 0xff, 0xff));
+
+	// SD card bus setup and throughput (main.cpp's UpdateScreen refreshes the KB/s)
+	snprintf(bufferOut, 128, "SD %2dMHz %dbit %5dKB/s", m_EMMC.GetClockRate() / 1000000, m_EMMC.GetBusWidth(), m_EMMC.GetThroughput());
+	screenMain->PrintText(false, 48 * 8, y, bufferOut, RGBA(0, 0, 0, 0xff), RGBA(0xff, 0xff, 0xff, 0xff));
+
+	// Frames received per protocol (main.cpp's UpdateScreen refreshes these too)
+	Net::FormatCounters(bufferOut, 128);
+	screenMain->PrintText(false, STATUS_BAR_NET_X, y, bufferOut, RGBA(0, 0, 0, 0xff), RGBA(0xff, 0xff, 0xff, 0xff));
 #endif
 }
 
@@ -1736,11 +1776,12 @@ void FileBrowser::DisplayDiskInfo(DiskImage* diskImage, const char* filenameForI
 	if (filenameForIcon)
 	{
 		FILINFO filIcon;
-		if (CheckForPNG(filenameForIcon, filIcon))
+		char cwd[IconCache::PATH_SIZE];
+		if (CheckForPNG(filenameForIcon, filIcon) && f_getcwd(cwd, sizeof(cwd)) == FR_OK)
 		{
 			x = screenMain->ScaleX(1024) - 320;
 			y = screenMain->ScaleY(0);
-			DisplayPNG(filIcon, x, y);
+			DisplayPNG(cwd, filIcon, x, y);
 		}
 	}
 #endif
@@ -1779,6 +1820,33 @@ void FileBrowser::SelectAutoMountImage(const char* image)
 	}
 }
 
+// Fills the caddy with images from the current folder for remote control. All of them have to go in.
+bool FileBrowser::SelectImages(const char* const* names, unsigned count)
+{
+	if (displayingDevices)
+		DeviceSwitched();
+	else
+		FolderChanged();
+
+	ClearSelections();
+	for (unsigned index = 0; index < count; ++index)
+	{
+		FileBrowser::BrowsableList::Entry* entry = folder.FindEntry(names[index]);
+		if (entry == 0 || !DiskImage::IsDiskImageExtention(entry->filImage.fname))
+			return false;
+		caddySelections.entries.push_back(*entry);
+	}
+
+	FillCaddyWithSelections();
+	if (caddySelections.entries.size() != count)
+	{
+		diskCaddy->Empty();
+		ClearSelections();
+		return false;
+	}
+	return true;
+}
+
 int FileBrowser::BrowsableList::FindNextAutoName(char* filename)
 {
 	int index;
@@ -27,6 +27,7 @@
 #include "ROMs.h"
 #include "ScreenBase.h"
 #include "InputMappings.h"
+#include "IconCache.h"
 
 #define VIC2_COLOUR_INDEX_BLACK		0
 #define VIC2_COLOUR_INDEX_WHITE		1
@@ -46,6 +47,7 @@
 #define VIC2_COLOUR_INDEX_LGREY		15
 
 #define STATUS_BAR_POSITION_Y (40 * 16 + 10)
+#define STATUS_BAR_NET_X (73 * 8)
 
 #define KEYBOARD_SEARCH_BUFFER_SIZE 512
 
@@ -171,6 +173,7 @@ public:
 	FileBrowser(InputMappings* inputMappings, DiskCaddy* diskCaddy, ROMs* roms, u8* deviceID, bool displayPNGIcons, ScreenBase* screenMain, ScreenBase* screenLCD, float scrollHighlightRate);
 
 	void SelectAutoMountImage(const char* image);
+	bool SelectImages(const char* const* names, unsigned count);
 	void DisplayRoot();
 	void Update();
 
@@ -206,8 +209,10 @@ public:
 
 	void DeviceSwitched();
 
+	bool SelectROMOrDevice(u32 index);
+
 private:
-	void DisplayPNG(FILINFO& filIcon, int x, int y);
+	void DisplayPNG(const char* folder, FILINFO& filIcon, int x, int y);
 	void RefreshFolderEntries();
 
 	void UpdateInputFolders();
@@ -222,8 +227,8 @@ private:
 
 	bool CheckForPNG(const char* filename, FILINFO& filIcon);
 	void DisplayPNG();
-
-	bool SelectROMOrDevice(u32 index);
+	void RequestIcons();
+	void UpdateIcons();
 
 	// returns the volume index if at the root of a volume else -1
 	int IsAtRootOfDevice();
@@ -245,6 +250,11 @@ private:
 	bool displayPNGIcons;
 	bool buttonChangedROMDevice;
 
+	IconCache iconCache;
+	char folderPath[IconCache::PATH_SIZE];	// The directory folder's entries (and their icons) were read from.
+	bool iconPending;	// The highlighted entry's icon is waiting in iconCache's request queue.
+	u32 iconRequestTime;
+
 	BrowsableList caddySelections;
 #if not defined(EXPERIMENTALZERO)
 	ScreenBase* screenMain;
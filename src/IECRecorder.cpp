@@ -0,0 +1,98 @@
+// Pi1541 - A Commodore 1541 disk drive emulator
+// Copyright(C) 2018 Stephen White
+//
+// This file is part of Pi1541.
+//
+// Pi1541 is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Pi1541 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
+
+#include "IECRecorder.h"
+#include <stdlib.h>
+#include <string.h>
+#include "debug.h"
+#include "ff.h"
+extern "C"
+{
+#include "rpi-gpio.h"
+}
+
+IECRecorder::IECRecorder()
+	: events(0)
+	, cycle(0)
+	, lastInput(0xff)
+	, lastOutput(0xff)
+{
+	memset(&header, 0, sizeof(header));
+}
+
+IECRecorder::~IECRecorder()
+{
+	free(events);
+}
+
+bool IECRecorder::Begin(const Header& header, const Snapshot& startState)
+{
+	End(0);
+
+	if (!this->startState.Load(startState.Data(), startState.Size()))
+		return false;
+
+	events = (Event*)malloc(MAX_EVENTS * sizeof(Event));
+	if (events == 0)
+		return false;
+
+	this->header = header;
+	this->header.magic = MAGIC;
+	this->header.version = VERSION;
+	this->header.flags &= ~FLAG_TRUNCATED;
+	this->header.cycles = 0;
+	this->header.eventCount = 0;
+	this->header.startStateSize = startState.Size();
+	// The first Input is cycle 0.
+	cycle = ~0u;
+	lastInput = 0xff;
+	lastOutput = 0xff;
+	return true;
+}
+
+bool IECRecorder::End(const char* fileName)
+{
+	if (events == 0)
+		return false;
+
+	if ((header.flags & FLAG_TRUNCATED) == 0)
+		header.cycles = cycle + 1;
+
+	bool written = false;
+	if (fileName)
+	{
+		FIL fp;
+		u32 bytesWritten;
+
+		SetACTLed(true);
+		if (f_open(&fp, fileName, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK)
+		{
+			written = f_write(&fp, &header, sizeof(header), &bytesWritten) == FR_OK && bytesWritten == sizeof(header);
+			written = written && f_write(&fp, startState.Data(), header.startStateSize, &bytesWritten) == FR_OK && bytesWritten == header.startStateSize;
+			u32 eventBytes = header.eventCount * sizeof(Event);
+			written = written && f_write(&fp, events, eventBytes, &bytesWritten) == FR_OK && bytesWritten == eventBytes;
+			f_close(&fp);
+		}
+		SetACTLed(false);
+		DEBUG_LOG("IEC recording %s %d cycles %d events %s\r\n", fileName, header.cycles, header.eventCount, written ? "written" : "failed");
+	}
+
+	free(events);
+	events = 0;
+	return written;
+}
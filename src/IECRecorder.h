@@ -0,0 +1,154 @@
+// Pi1541 - A Commodore 1541 disk drive emulator
+// Copyright(C) 2018 Stephen White
+//
+// This file is part of Pi1541.
+//
+// Pi1541 is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Pi1541 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef IECRecorder_H
+#define IECRecorder_H
+
+#include "types.h"
+#include "Snapshot.h"
+
+// Records what an emulated 1541 saw on the IEC bus so a loader that fails on real hardware can be replayed off the Pi (see host/iecreplay).
+// The inputs are sampled once per emulated cycle and only the changes are kept, stamped with the cycle they were read on.
+// Everything else the emulation depends on (flux noise seed, options, images, the machine just after reset) goes in the header.
+// The drive's outputs are recorded too so the replay can say where it first went a different way.
+class IECRecorder
+{
+public:
+	// Input events hold the lines whose pins read high, before any inversion.
+	// Output events hold the lines the drive is pulling low.
+	enum Lines
+	{
+		LINE_ATN = 1 << 0,
+		LINE_DATA = 1 << 1,
+		LINE_CLOCK = 1 << 2,
+		LINE_SRQ = 1 << 3,
+		LINE_RESET = 1 << 4
+	};
+
+	enum EventType
+	{
+		EVENT_INPUT,
+		EVENT_OUTPUT,
+		EVENT_INSERT	// value is the caddy index of the image inserted at the end of the cycle
+	};
+
+	enum Flags
+	{
+		FLAG_INTEGER_DRIVE_MODEL = 1 << 0,	// Recorded by an EXPERIMENTALZERO build
+		FLAG_REFRESH_OUTS_AFTER_CPU_STEP = 1 << 1,
+		FLAG_EXTRA_RAM = 1 << 2,
+		FLAG_RAM_BOARD = 1 << 3,
+		FLAG_INVERT_IEC_INPUTS = 1 << 4,
+		FLAG_IGNORE_RESET = 1 << 5,
+		FLAG_TRUNCATED = 1 << 6			// Ran out of room for events; cycles is where it stopped
+	};
+
+	static const u32 MAGIC = 0x52493150;	// "P1IR"
+	static const u32 VERSION = 1;
+	static const u32 MAX_IMAGES = 16;
+	static const u32 NAME_LENGTH = 64;
+	static const u32 MAX_EVENTS = 1024 * 1024;
+
+	// Followed in the file by startStateSize bytes of Snapshot and then eventCount Events.
+	struct Header
+	{
+		u32 magic;
+		u32 version;
+		u32 flags;
+		u32 seed;				// Drive::SetSeed
+		u32 fastBootCycles;
+		u32 cycles;				// Cycles whose events are all in the recording
+		u32 eventCount;
+		u32 startStateSize;		// Pi1541::SerialiseState without the CPU, taken straight after reset
+		u32 ROMHash;
+		u32 imageCount;
+		u32 firstImage;			// Caddy index in the drive when recording began
+		u32 readOnlyImages;		// Bit per caddy index
+		u32 imageHashes[MAX_IMAGES];	// DiskImage::HashTracks
+		char ROMName[NAME_LENGTH];
+		char imageNames[MAX_IMAGES][NAME_LENGTH];
+	};
+
+	struct Event
+	{
+		u32 cycle;
+		u8 type;
+		u8 value;
+		u16 reserved;
+	};
+
+	IECRecorder();
+	~IECRecorder();
+
+	// header describes the session; the counts are filled in as the recording grows.
+	bool Begin(const Header& header, const Snapshot& startState);
+	// Stops recording and writes it to fileName. Pass 0 to just stop.
+	bool End(const char* fileName);
+	bool IsRecording() const { return events != 0; }
+
+	// Called every time the emulation reads the bus, which is once per cycle.
+	inline void Input(u8 lines)
+	{
+		++cycle;
+		if (lines != lastInput)
+		{
+			lastInput = lines;
+			Add(EVENT_INPUT, lines);
+		}
+	}
+	inline void Output(u8 lines)
+	{
+		if (lines != lastOutput)
+		{
+			lastOutput = lines;
+			Add(EVENT_OUTPUT, lines);
+		}
+	}
+	void Insert(u32 caddyIndex) { Add(EVENT_INSERT, (u8)caddyIndex); }
+
+	u32 Cycle() const { return cycle; }
+	u32 EventCount() const { return header.eventCount; }
+	const Event& GetEvent(u32 index) const { return events[index]; }
+
+private:
+	inline void Add(u8 type, u8 value)
+	{
+		if (header.eventCount < MAX_EVENTS)
+		{
+			Event& event = events[header.eventCount++];
+			event.cycle = cycle;
+			event.type = type;
+			event.value = value;
+			event.reserved = 0;
+		}
+		else if ((header.flags & FLAG_TRUNCATED) == 0)
+		{
+			header.flags |= FLAG_TRUNCATED;
+			header.cycles = cycle;
+		}
+	}
+
+	Header header;
+	Snapshot startState;
+	Event* events;
+	u32 cycle;
+	u8 lastInput;
+	u8 lastOutput;
+};
+
+#endif
@@ -19,6 +19,7 @@
 #ifndef IOPort_H
 #define IOPort_H
 #include <assert.h>
+#include "Snapshot.h"
 
 typedef void(*PortOutFn)(void*, unsigned char status);
 
@@ -39,6 +40,8 @@ public:
 	inline unsigned char GetDirection() { return direction; }
 	inline void SetDirection(unsigned char value) { direction = value; if (portOutFn) (portOutFn)(portOutFnThis, stateOut & direction); }
 	inline void SetPortOut(void* data, PortOutFn fn) { portOutFnThis = data; portOutFn = fn; }
+	// The output callback is not called;- the owner restores whatever it drives itself.
+	inline void SerialiseState(Snapshot& snapshot) { snapshot.Field(stateOut); snapshot.Field(stateIn); snapshot.Field(direction); }
 private:
 	unsigned char stateOut;
 	unsigned char stateIn;
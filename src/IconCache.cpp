@@ -0,0 +1,194 @@
+// Pi1541 - A Commodore 1541 disk drive emulator
+// Copyright(C) 2018 Stephen White
+//
+// This file is part of Pi1541.
+//
+// Pi1541 is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Pi1541 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
+
+#include "IconCache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "debug.h"
+#include "stb_image.h"
+extern "C"
+{
+#include "rpi-gpio.h"
+}
+
+IconCache::IconCache()
+	: useCount(0)
+	, requestCount(0)
+	, requestsKept(0)
+{
+	for (int i = 0; i < SLOTS; ++i)
+	{
+		slots[i].image = 0;
+		slots[i].lastUsed = 0;
+		slots[i].used = false;
+	}
+}
+
+bool IconCache::SameIcon(const Icon& a, const Icon& b)
+{
+	return a.filIcon.fsize == b.filIcon.fsize && a.filIcon.fdate == b.filIcon.fdate && a.filIcon.ftime == b.filIcon.ftime && strcmp(a.path, b.path) == 0;
+}
+
+bool IconCache::MakeIcon(Icon& icon, const char* folder, const FILINFO& filIcon)
+{
+	if (filIcon.fname[0] == 0)
+		return false;
+
+	size_t length = strlen(folder);
+	const char* separator = (length && folder[length - 1] != '/') ? "/" : "";
+	if (snprintf(icon.path, sizeof(icon.path), "%s%s%s", folder, separator, filIcon.fname) >= (int)sizeof(icon.path))
+		return false;
+	icon.filIcon = filIcon;
+	return true;
+}
+
+IconCache::Slot* IconCache::FindSlot(const Icon& icon)
+{
+	for (int i = 0; i < SLOTS; ++i)
+	{
+		if (slots[i].used && SameIcon(slots[i].icon, icon))
+		{
+			slots[i].lastUsed = ++useCount;
+			return &slots[i];
+		}
+	}
+	return 0;
+}
+
+bool IconCache::Find(const char* folder, const FILINFO& filIcon, u32*& image)
+{
+	Icon icon;
+	Slot* slot = MakeIcon(icon, folder, filIcon) ? FindSlot(icon) : 0;
+	image = slot ? slot->image : 0;
+	return slot != 0;
+}
+
+bool IconCache::Load(const char* folder, const FILINFO& filIcon, u32*& image)
+{
+	Icon icon;
+	Slot* slot = 0;
+	if (MakeIcon(icon, folder, filIcon))
+	{
+		slot = FindSlot(icon);
+		if (slot == 0)
+			slot = Decode(icon);
+	}
+	image = slot ? slot->image : 0;
+	return slot != 0;
+}
+
+void IconCache::Request(const char* folder, const FILINFO& filIcon)
+{
+	if (requestsKept == MAX_REQUESTS)
+		return;
+
+	Icon icon;
+	if (!MakeIcon(icon, folder, filIcon))
+		return;
+
+	for (int i = 0; i < SLOTS; ++i)
+	{
+		if (slots[i].used && SameIcon(slots[i].icon, icon))
+			return;
+	}
+
+	// Already queued;- move it up to its new place. Otherwise the least wanted old request makes room if needed.
+	int index;
+	for (index = requestsKept; index < requestCount; ++index)
+	{
+		if (SameIcon(requests[index], icon))
+			break;
+	}
+	if (index == requestCount)
+	{
+		if (requestCount == MAX_REQUESTS)
+			index--;
+		else
+			requestCount++;
+	}
+	memmove(requests + requestsKept + 1, requests + requestsKept, (index - requestsKept) * sizeof(Icon));
+	requests[requestsKept++] = icon;
+}
+
+bool IconCache::ServiceRequest()
+{
+	if (requestCount == 0)
+		return false;
+
+	Icon icon = requests[0];
+	requestCount--;
+	memmove(requests, requests + 1, requestCount * sizeof(Icon));
+
+	Slot* slot = FindSlot(icon);
+	if (slot == 0)
+		slot = Decode(icon);
+	return slot != 0;
+}
+
+IconCache::Slot* IconCache::Decode(const Icon& icon)
+{
+	const FILINFO& filIcon = icon.filIcon;
+	FIL fp;
+
+	// Opened by its full path;- the current directory may have changed since the request was made.
+	if (f_open(&fp, icon.path, FA_READ) != FR_OK)
+		return 0;
+
+	char* PNG = (char*)malloc(filIcon.fsize);
+	if (PNG == 0)
+	{
+		f_close(&fp);
+		return 0;
+	}
+
+	u32 bytesRead;
+	SetACTLed(true);
+	f_read(&fp, PNG, filIcon.fsize, &bytesRead);
+	SetACTLed(false);
+	f_close(&fp);
+
+	int w;
+	int h;
+	int channels_in_file;
+	stbi_uc* image = stbi_load_from_memory((stbi_uc const*)PNG, bytesRead, &w, &h, &channels_in_file, 4);
+	free(PNG);
+
+	if (image && (w != PNG_WIDTH || h != PNG_HEIGHT))
+	{
+		//DEBUG_LOG("Invalid PNG size %d x %d\r\n", w, h);
+		stbi_image_free(image);
+		image = 0;
+	}
+
+	// Evict the least recently used slot. Invalid icons are cached too so they are not decoded again.
+	Slot* slot = &slots[0];
+	for (int i = 1; i < SLOTS; ++i)
+	{
+		if (!slots[i].used || (slot->used && slots[i].lastUsed < slot->lastUsed))
+			slot = &slots[i];
+	}
+	if (slot->image)
+		stbi_image_free(slot->image);
+
+	slot->icon = icon;
+	slot->image = (u32*)image;
+	slot->lastUsed = ++useCount;
+	slot->used = true;
+	return slot;
+}
@@ -0,0 +1,83 @@
+// Pi1541 - A Commodore 1541 disk drive emulator
+// Copyright(C) 2018 Stephen White
+//
+// This file is part of Pi1541.
+//
+// Pi1541 is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Pi1541 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef IconCache_H
+#define IconCache_H
+
+#include "types.h"
+#include "ff.h"
+
+#define PNG_WIDTH 320
+#define PNG_HEIGHT 200
+
+// Keeps the most recently used disk image icons decoded so the browser does not run stb_image each time the highlight moves.
+// Decoding is cooperative;- the browser queues the icons it wants and services one per Update, when the user is not waiting.
+// Screens that are drawn once, like the disk info shown while emulating, Load theirs straight away instead.
+// Icons are keyed on their full path (folder is the directory filIcon was read from) so same named icons in different folders are kept apart.
+class IconCache
+{
+public:
+	IconCache();
+
+	// Returns true if filIcon has been decoded. image is 0 if the file was not a valid PNG_WIDTH x PNG_HEIGHT PNG.
+	bool Find(const char* folder, const FILINFO& filIcon, u32*& image);
+	// Like Find but decodes filIcon now if it has not been. The request queue is left alone.
+	bool Load(const char* folder, const FILINFO& filIcon, u32*& image);
+
+	// Each time the highlight moves the browser re-requests the icons around it between StartRequests and EndRequests.
+	// Requests still wanted keep their place in the order given, and only those the user has scrolled past are dropped.
+	void StartRequests() { requestsKept = 0; }
+	void Request(const char* folder, const FILINFO& filIcon);
+	void EndRequests() { requestCount = requestsKept; }
+	bool HasRequests() const { return requestCount > 0; }
+	// Decodes the oldest request. Returns true if an icon was decoded.
+	bool ServiceRequest();
+
+	static const int SLOTS = 8;
+	static const int MAX_REQUESTS = 5;
+	static const int PATH_SIZE = 512;
+
+private:
+	struct Icon
+	{
+		char path[PATH_SIZE];
+		FILINFO filIcon;
+	};
+
+	struct Slot
+	{
+		Icon icon;
+		u32* image;
+		u32 lastUsed;
+		bool used;
+	};
+
+	static bool SameIcon(const Icon& a, const Icon& b);
+	static bool MakeIcon(Icon& icon, const char* folder, const FILINFO& filIcon);
+	Slot* FindSlot(const Icon& icon);
+	Slot* Decode(const Icon& icon);
+
+	Slot slots[SLOTS];
+	u32 useCount;
+
+	Icon requests[MAX_REQUESTS];
+	int requestCount;
+	int requestsKept;
+};
+
+#endif
@@ -0,0 +1,249 @@
+// Pi1541 - A Commodore 1541 disk drive emulator
+// Copyright(C) 2018 Stephen White
+//
+// This file is part of Pi1541.
+//
+// Pi1541 is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Pi1541 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
+
+#include "ImageProfiles.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "debug.h"
+#include "ff.h"
+extern "C"
+{
+#include "rpi-gpio.h"
+}
+
+// Images known to need their outputs refreshed at the end of the cycle.
+// A profiles.txt entry for the same hash overrides these.
+static const struct
+{
+	u32 hash;
+	const char* name;
+} endOfCycleImages[] =
+{
+	{ 0x42c02586, "maniac_mansion_s1[lucasfilm_1989](ntsc).g64" },
+	{ 0x18651422, "aliens[electric_dreams_1987].g64" },
+	{ 0x2a7f4b77, "zak_mckracken_boot[activision_1988](manual)(!).g64" },
+	{ 0x97732c3e, "maniac_mansion_s1[activision_1987](!).g64" },
+	{ 0x63f809d2, "4x4_offroad_racing_s1[epyx_1988](ntsc)(!).g64" },
+};
+
+ImageProfiles::ImageProfiles()
+	: count(0)
+	, dirty(false)
+{
+	memset(profiles, 0, sizeof(profiles));
+
+	for (unsigned index = 0; index < sizeof(endOfCycleImages) / sizeof(endOfCycleImages[0]); ++index)
+	{
+		Profile* profile = Insert(endOfCycleImages[index].hash);
+		profile->fields |= FIELD_PHASE;
+		profile->refreshOutsAfterCPUStep = false;
+		strncpy(profile->imageName, endOfCycleImages[index].name, NAME_LENGTH - 1);
+	}
+}
+
+const ImageProfiles::Profile* ImageProfiles::Find(u32 hash) const
+{
+	if (hash == 0)
+		return 0;
+
+	u32 index = hash & (MAX_PROFILES - 1);
+	while (profiles[index].hash != 0)
+	{
+		if (profiles[index].hash == hash)
+			return &profiles[index];
+		index = (index + 1) & (MAX_PROFILES - 1);
+	}
+	return 0;
+}
+
+ImageProfiles::Profile* ImageProfiles::Insert(u32 hash)
+{
+	Profile* profile = (Profile*)Find(hash);
+	if (profile || hash == 0)
+		return profile;
+
+	// Keep a quarter of the slots free so the probes stay short.
+	if (count >= MAX_PROFILES * 3 / 4)
+		return 0;
+
+	u32 index = hash & (MAX_PROFILES - 1);
+	while (profiles[index].hash != 0)
+		index = (index + 1) & (MAX_PROFILES - 1);
+	profile = &profiles[index];
+	profile->hash = hash;
+	count++;
+	return profile;
+}
+
+void ImageProfiles::Process(char* buffer)
+{
+	Profile* profile = 0;
+	Profile ignored;
+
+	SetData(buffer);
+
+	char* pOption;
+	while ((pOption = GetToken()) != 0)
+	{
+		/*char* equals = */GetToken();
+		char* pValue = GetToken();
+		if (pValue == 0)
+			break;
+
+		if (strcasecmp(pOption, "Image") == 0)
+		{
+			profile = Insert(strtoul(pValue, 0, 16));
+			if (profile == 0)
+			{
+				DEBUG_LOG("Profile %s ignored\r\n", pValue);
+				profile = &ignored;
+			}
+			continue;
+		}
+		if (profile == 0)
+			continue;
+
+		unsigned value = strtoul(pValue, 0, 0);
+		if (strcasecmp(pOption, "RefreshOutsAfterCPUStep") == 0)
+		{
+			profile->fields |= FIELD_PHASE;
+			profile->refreshOutsAfterCPUStep = value != 0;
+		}
+		else if (strcasecmp(pOption, "Seed") == 0)
+		{
+			profile->fields |= FIELD_SEED;
+			profile->seed = value;
+		}
+		else if (strcasecmp(pOption, "FastBootCycles") == 0)
+		{
+			profile->fields |= FIELD_FAST_BOOT;
+			profile->fastBootCycles = value;
+		}
+		else if (strcasecmp(pOption, "ROM") == 0)
+		{
+			profile->fields |= FIELD_ROM;
+			strncpy(profile->ROMName, pValue, NAME_LENGTH - 1);
+		}
+		else if (strcasecmp(pOption, "AfterStepRuns") == 0)
+			profile->runs[PHASE_AFTER_CPU_STEP] = value;
+		else if (strcasecmp(pOption, "AfterStepCleanRuns") == 0)
+			profile->cleanRuns[PHASE_AFTER_CPU_STEP] = value;
+		else if (strcasecmp(pOption, "EndOfCycleRuns") == 0)
+			profile->runs[PHASE_END_OF_CYCLE] = value;
+		else if (strcasecmp(pOption, "EndOfCycleCleanRuns") == 0)
+			profile->cleanRuns[PHASE_END_OF_CYCLE] = value;
+	}
+	dirty = false;
+}
+
+bool ImageProfiles::Save(const char* fileName)
+{
+	FIL fp;
+	u32 bytesWritten;
+	char line[512];	// Room for the longest profile
+
+	SetACTLed(true);
+	bool opened = f_open(&fp, fileName, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK;
+	bool written = opened;
+	for (u32 index = 0; written && index < MAX_PROFILES; ++index)
+	{
+		const Profile& profile = profiles[index];
+		if (profile.hash == 0)
+			continue;
+
+		int length = snprintf(line, sizeof(line), "Image = %08x\t// %s\r\n", (unsigned)profile.hash, profile.imageName);
+		if (profile.fields & FIELD_PHASE)
+			length += snprintf(line + length, sizeof(line) - length, "RefreshOutsAfterCPUStep = %d\r\n", profile.refreshOutsAfterCPUStep);
+		if (profile.fields & FIELD_SEED)
+			length += snprintf(line + length, sizeof(line) - length, "Seed = 0x%08x\r\n", (unsigned)profile.seed);
+		if (profile.fields & FIELD_FAST_BOOT)
+			length += snprintf(line + length, sizeof(line) - length, "FastBootCycles = %u\r\n", (unsigned)profile.fastBootCycles);
+		if (profile.fields & FIELD_ROM)
+			length += snprintf(line + length, sizeof(line) - length, "ROM = %s\r\n", profile.ROMName);
+		if (profile.runs[PHASE_AFTER_CPU_STEP] || profile.runs[PHASE_END_OF_CYCLE])
+		{
+			length += snprintf(line + length, sizeof(line) - length, "AfterStepRuns = %d\r\nAfterStepCleanRuns = %d\r\nEndOfCycleRuns = %d\r\nEndOfCycleCleanRuns = %d\r\n",
+				profile.runs[PHASE_AFTER_CPU_STEP], profile.cleanRuns[PHASE_AFTER_CPU_STEP], profile.runs[PHASE_END_OF_CYCLE], profile.cleanRuns[PHASE_END_OF_CYCLE]);
+		}
+		length += snprintf(line + length, sizeof(line) - length, "\r\n");
+		if ((unsigned)length >= sizeof(line))
+			length = sizeof(line) - 1;
+
+		written = f_write(&fp, line, length, &bytesWritten) == FR_OK && bytesWritten == (u32)length;
+	}
+	if (opened)
+		f_close(&fp);
+	SetACTLed(false);
+
+	DEBUG_LOG("Profiles %s %d %s\r\n", fileName, count, written ? "written" : "failed");
+	if (written)
+		dirty = false;
+	return written;
+}
+
+bool ImageProfiles::RefreshOutsAfterCPUStep(const Profile* profile, bool learning)
+{
+	if (profile == 0)
+		return true;
+	if (profile->fields & FIELD_PHASE)
+		return profile->refreshOutsAfterCPUStep;
+
+	const u16* runs = profile->runs;
+	const u16* cleanRuns = profile->cleanRuns;
+	if (learning)
+	{
+		if (runs[PHASE_AFTER_CPU_STEP] == 0)
+			return true;
+		if (runs[PHASE_END_OF_CYCLE] == 0)
+			return false;
+	}
+	if (runs[PHASE_AFTER_CPU_STEP] == 0 || runs[PHASE_END_OF_CYCLE] == 0)
+		return true;
+
+	// Compare the clean ratios without dividing. A tie keeps the default.
+	return (u32)cleanRuns[PHASE_AFTER_CPU_STEP] * runs[PHASE_END_OF_CYCLE] >= (u32)cleanRuns[PHASE_END_OF_CYCLE] * runs[PHASE_AFTER_CPU_STEP];
+}
+
+bool ImageProfiles::Learn(u32 hash, const char* imageName, bool refreshOutsAfterCPUStep, bool clean)
+{
+	const Profile* before = Find(hash);
+	bool nextPhase = RefreshOutsAfterCPUStep(before, true);
+	bool settledPhase = RefreshOutsAfterCPUStep(before, false);
+
+	Profile* profile = Insert(hash);
+	if (profile == 0)
+		return false;
+
+	int phase = refreshOutsAfterCPUStep ? PHASE_AFTER_CPU_STEP : PHASE_END_OF_CYCLE;
+	if (profile->runs[phase] == 0xffff)
+	{
+		// Halve the history rather than overflow it.
+		profile->runs[phase] >>= 1;
+		profile->cleanRuns[phase] >>= 1;
+	}
+	profile->runs[phase]++;
+	if (clean)
+		profile->cleanRuns[phase]++;
+	if (profile->imageName[0] == 0 && imageName)
+		strncpy(profile->imageName, imageName, NAME_LENGTH - 1);
+	dirty = true;
+
+	return before == 0 || RefreshOutsAfterCPUStep(profile, true) != nextPhase || RefreshOutsAfterCPUStep(profile, false) != settledPhase;
+}
@@ -0,0 +1,89 @@
+// Pi1541 - A Commodore 1541 disk drive emulator
+// Copyright(C) 2018 Stephen White
+//
+// This file is part of Pi1541.
+//
+// Pi1541 is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Pi1541 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ImageProfiles_H
+#define ImageProfiles_H
+
+#include "types.h"
+#include "options.h"
+
+// Per image compatibility settings, keyed by DiskImage::GetHash and kept in profiles.txt on the SD card.
+// A profile can fix when the outputs are refreshed, the flux noise seed, how long the fast boot runs and which ROM to use.
+// With LearnProfiles = 1 each session also records whether it ran without lost cycles or disk errors that cleared on a retry
+// for the output phase it used, and images with no fixed phase then get whichever phase has run cleanly more often.
+//
+// Profiles live in an open addressed table so finding one when an image is mounted is a mask and, almost always, one compare.
+class ImageProfiles : public TextParser
+{
+public:
+	enum Fields
+	{
+		FIELD_PHASE = 1 << 0,
+		FIELD_SEED = 1 << 1,
+		FIELD_FAST_BOOT = 1 << 2,
+		FIELD_ROM = 1 << 3
+	};
+
+	// Indexes the learned counts
+	enum Phase
+	{
+		PHASE_END_OF_CYCLE,
+		PHASE_AFTER_CPU_STEP,
+		PHASE_COUNT
+	};
+
+	static const u32 MAX_PROFILES = 1024;	// Must be a power of two
+	static const u32 NAME_LENGTH = 64;
+
+	struct Profile
+	{
+		u32 hash;		// 0 for an empty slot
+		u32 fields;		// Which of the settings below were given
+		bool refreshOutsAfterCPUStep;
+		u32 seed;
+		u32 fastBootCycles;
+		char ROMName[NAME_LENGTH];
+		char imageName[NAME_LENGTH];	// Only written out as a comment
+		u16 runs[PHASE_COUNT];
+		u16 cleanRuns[PHASE_COUNT];
+	};
+
+	ImageProfiles();
+
+	// Adds the profiles in a profiles.txt read into buffer to the built in ones. buffer is modified.
+	void Process(char* buffer);
+	bool Save(const char* fileName);
+
+	const Profile* Find(u32 hash) const;
+
+	// The output phase to emulate an image with. When learning, a phase that has not been tried on this image is tried first.
+	static bool RefreshOutsAfterCPUStep(const Profile* profile, bool learning);
+	// Returns true when the run changes the phase the image will get, which is when the profile is worth saving.
+	bool Learn(u32 hash, const char* imageName, bool refreshOutsAfterCPUStep, bool clean);
+
+	inline bool IsDirty() const { return dirty; }
+
+private:
+	Profile* Insert(u32 hash);
+
+	Profile profiles[MAX_PROFILES];
+	u32 count;
+	bool dirty;
+};
+
+#endif
@@ -344,6 +344,10 @@ void InputMappings::CheckKeyboardEmulationMode(unsigned numberOfImages, unsigned
 		SetKeyboardFlag(AUTOLOAD_FLAG);
 	else if (keyboard->KeyHeld(KEY_R) && keyboard->KeyEitherAlt() )
 		SetKeyboardFlag(FAKERESET_FLAG);
+	else if (keyboard->KeyHeld(KEY_S) && keyboard->KeyEitherAlt() )
+		SetKeyboardFlag(SAVESTATE_FLAG);
+	else if (keyboard->KeyHeld(KEY_L) && keyboard->KeyEitherAlt() )
+		SetKeyboardFlag(RESTORESTATE_FLAG);
 	else if (numberOfImages > 1)
 	{
 		unsigned index;
@@ -46,6 +46,9 @@
 #define END_FLAG		(1 << 20)
 
 #define FUNCTION_FLAG		(1 << 21)
+
+#define SAVESTATE_FLAG		(1 << 22)
+#define RESTORESTATE_FLAG	(1 << 23)
 // dont exceed 32!!
 
 
@@ -138,6 +141,10 @@ public:
 
 	inline bool FakeReset() { return KeyboardFlag(FAKERESET_FLAG); }
 
+	inline bool SaveState() { return KeyboardFlag(SAVESTATE_FLAG); }
+
+	inline bool RestoreState() { return KeyboardFlag(RESTORESTATE_FLAG); }
+
 	inline bool BrowseSelect()
 	{
 		return KeyboardFlag(ENTER_FLAG)/* | UartFlag(ENTER_FLAG)*/ | ButtonFlag(ENTER_FLAG);
@@ -216,3 +216,29 @@ void Pi1541::Reset()
 	VIABortB->SetInput(VIAPORTPINS_ATNAOUT, true);
 }
 
+void Pi1541::SerialiseState(Snapshot& snapshot, bool includeCPU)
+{
+	// 2K of drive RAM, the 8K RAM board at 0x8000 or the 32K extra RAM mode
+	u32 ramSize = options.GetExtraRAM() ? 0x8000 : 0x800;
+	bool ramBoard = !options.GetExtraRAM() && options.GetRAMBOard();
+
+	if (snapshot.Value(ramSize) != ramSize || snapshot.Value(ramBoard) != ramBoard)
+		snapshot.Fail();
+
+	if (includeCPU)
+		m6502.SerialiseState(snapshot);
+	VIA[0].SerialiseState(snapshot);
+	VIA[1].SerialiseState(snapshot);
+	drive.SerialiseState(snapshot);
+	snapshot.Bytes(s_u8Memory, ramSize);
+	if (ramBoard)
+		snapshot.Bytes(s_u8Memory + 0x8000, 0x2000);
+
+	if (!snapshot.IsSaving() && !snapshot.Failed())
+	{
+		// The IEC bus outputs follow the VIA's port B output callback so drive them from the restored port.
+		IOPort* VIAPortB = VIA[0].GetPortB();
+		IEC_Bus::PortB_OnPortOut(0, VIAPortB->GetOutput() & VIAPortB->GetDirection());
+	}
+}
+
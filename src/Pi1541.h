@@ -35,6 +35,10 @@ public:
 
 	void Reset();
 
+	// CPU, VIAs, drive mechanics and RAM. Used to both save and restore.
+	// Without the CPU the state is portable between builds (see IECRecorder).
+	void SerialiseState(Snapshot& snapshot, bool includeCPU = true);
+
 	//void ConfigureOfExtraRAM(bool extraRAM);
 
 	Drive drive;
@@ -289,6 +289,25 @@ void Pi1581::Reset()
 	CIABPortB->SetInput(VIAPORTPINS_ATNAOUT, true);
 }
 
+void Pi1581::SerialiseState(Snapshot& snapshot, bool includeCPU)
+{
+	if (includeCPU)
+		m6502.SerialiseState(snapshot);
+	CIA.SerialiseState(snapshot);
+	wd177x.SerialiseState(snapshot);
+	snapshot.Field(fastSerialDirection);
+	snapshot.Field(RDYDelayCount);
+	snapshot.Field(LED);
+	snapshot.Bytes(s_u8Memory, 0x2000);
+
+	if (!snapshot.IsSaving() && !snapshot.Failed())
+	{
+		// The IEC bus outputs follow the CIA's port B output callback so drive them from the restored port.
+		IOPort* CIAPortB = CIA.GetPortB();
+		IEC_Bus::PortB_OnPortOut(0, CIAPortB->GetOutput() & CIAPortB->GetDirection());
+	}
+}
+
 void Pi1581::SetDeviceID(u8 id)
 {
 	CIA.GetPortA()->SetInput(PORTA_PINS_DEVSEL0, id & 1);
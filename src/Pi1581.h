@@ -37,6 +37,10 @@ public:
 
 	void Reset();
 
+	// CPU, CIA, WD177x and RAM. Insert the disk image before restoring.
+	// Without the CPU the state is portable between builds (see IECRecorder).
+	void SerialiseState(Snapshot& snapshot, bool includeCPU = true);
+
 	void SetDeviceID(u8 id);
 
 	void Insert(DiskImage* diskImage);
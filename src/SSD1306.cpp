@@ -17,6 +17,7 @@
 // along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
 
 #include "SSD1306.h"
+#include "defs.h"
 #include "debug.h"
 #include <string.h>
 #include "Petscii.h"
@@ -36,10 +37,23 @@ SSD1306::SSD1306(int BSCMaster, u8 address, unsigned width, unsigned height, int
 	, contrast(127)
 	, width(width)
 	, height(height)
+	, queueHead(0)
+	, queueTail(0)
+	, transferActive(false)
+	, refreshPending(0)
 {
 	sizeof_frame = width*height/8;
 	frame = (unsigned char *)malloc(sizeof_frame);
 	oldFrame = (unsigned char *)malloc(sizeof_frame);
+	memset(frame, 0, sizeof_frame);
+	memset(oldFrame, 0xff, sizeof_frame);	// first refresh sends everything
+	for (unsigned page = 0; page < SSD1306_MAX_PAGES; page++)
+	{
+		dirtyStart[page] = 0xff;
+		dirtyEnd[page] = 0;
+		if (page < height/8)
+			MarkDirty(page, 0, width - 1);
+	}
 	RPI_I2CInit(BSCMaster, 1);
 	InitHardware();
 }
@@ -96,42 +110,92 @@ void SSD1306::InitHardware()
 
 	if (type != LCD_1106_128x64)
 		SendCommand(SSD1306_CMD_DEACTIVATE_SCROLL);	// 0x2E
+
+	Flush();
 }
 
 void SSD1306::SendCommand(u8 command)
 {
-	char buffer[2];
-
-	buffer[0] = SSD1306_CONTROL_REG;
-	buffer[1] = command;
-
-	RPI_I2CWrite(BSCMaster, address, buffer, sizeof(buffer));
+	lock.Acquire();
+	QueueCommands(&command, 1);
+	ServiceTransfers();
+	lock.Release();
 }
 
-void SSD1306::SendData(u8 data)
+void SSD1306::QueueCommands(const u8* commands, u32 count)
 {
-	char buffer[2];
+	while (QueueSpace() == 0)
+		ServiceTransfers();
+
+	Transfer* transfer = &queue[queueHead];
+	transfer->data[0] = SSD1306_CONTROL_REG;
+	memcpy(&transfer->data[1], commands, count);
+	transfer->length = count + 1;
+	queueHead = (queueHead + 1) % TRANSFER_QUEUE_SIZE;
+}
 
-	buffer[0] = SSD1306_DATA_REG;
-	buffer[1] = data;
+void SSD1306::Service()
+{
+	lock.Acquire();
+	ServiceTransfers();
+	lock.Release();
+}
 
-	RPI_I2CWrite(BSCMaster, address, buffer, sizeof(buffer));
+void SSD1306::Flush()
+{
+	lock.Acquire();
+	while (transferActive || queueHead != queueTail || refreshPending)
+		ServiceTransfers();
+	lock.Release();
 }
 
-//We can send up to 16 bytes to the i2c bus
-void SSD1306::SendDataLong(void* data, u8 length)
+void SSD1306::ServiceTransfers()
 {
-	char buffer[15];
+	while (true)
+	{
+		if (transferActive)
+		{
+			// Errors (eg nothing on the bus) just drop the transfer.
+			if (RPI_I2CWritePoll(BSCMaster) == 0)
+				return;
+			transferActive = false;
+			queueTail = (queueTail + 1) % TRANSFER_QUEUE_SIZE;
+		}
 
-	buffer[0] = SSD1306_DATA_REG;
-	memcpy(&buffer[1], data, length);
+		QueuePendingPages();
+		if (queueHead == queueTail)
+			return;
 
-	RPI_I2CWrite(BSCMaster, address, buffer, ++length);
+		Transfer* transfer = &queue[queueTail];
+		transferActive = RPI_I2CWriteStart(BSCMaster, address, transfer->data, transfer->length) != 0;
+		if (!transferActive)
+			queueTail = (queueTail + 1) % TRANSFER_QUEUE_SIZE;
+	}
+}
+
+void SSD1306::MarkDirty(u32 page, u32 x1, u32 x2)
+{
+	if (page >= SSD1306_MAX_PAGES)
+		return;
+	if (x2 >= width)
+		x2 = width - 1;
+	if (dirtyStart[page] > dirtyEnd[page])
+	{
+		dirtyStart[page] = x1;
+		dirtyEnd[page] = x2;
+	}
+	else
+	{
+		if (x1 < dirtyStart[page]) dirtyStart[page] = x1;
+		if (x2 > dirtyEnd[page]) dirtyEnd[page] = x2;
+	}
 }
 
 void SSD1306::Home()
 {
+	lock.Acquire();
 	SetDataPointer(0, 0);
+	lock.Release();
 }
 
 void SSD1306::SetDataPointer(u8 page, u8 col)
@@ -142,18 +206,23 @@ void SSD1306::SetDataPointer(u8 page, u8 col)
 	if (type == LCD_1106_128x64)
 		col += 2;	// sh1106 uses columns 2..129
 
-	SendCommand(SSD1306_CMD_SET_PAGE | page);		// 0xB0 page address
-	SendCommand(SSD1306_CMD_SET_COLUMN_LOW | (col & 0xf));	// 0x00 column address lower bits
-	SendCommand(SSD1306_CMD_SET_COLUMN_HIGH | (col >> 4));	// 0x10 column address upper bits
+	u8 commands[3];
+	commands[0] = SSD1306_CMD_SET_PAGE | page;		// 0xB0 page address
+	commands[1] = SSD1306_CMD_SET_COLUMN_LOW | (col & 0xf);	// 0x00 column address lower bits
+	commands[2] = SSD1306_CMD_SET_COLUMN_HIGH | (col >> 4);	// 0x10 column address upper bits
+	QueueCommands(commands, sizeof(commands));
 }
 
 void SSD1306::RefreshScreen()
 {
-	unsigned i;
-	for (i = 0; i < height/8; i++)
-	{
-		RefreshPage(i);
-	}
+	lock.Acquire();
+	refreshPending |= (1 << (height/8)) - 1;
+	ServiceTransfers();
+	lock.Release();
+#if !defined(USE_MULTICORE)
+	// Nothing else pumps the queue while emulating on a single core.
+	Flush();
+#endif
 }
 
 // assumes a text row is 8 bit high
@@ -163,74 +232,119 @@ void SSD1306::RefreshTextRows(u32 start, u32 amountOfRows)
 
 	//start <<= 1;
 	//amountOfRows <<= 1;
-	for (i = start; i < start+amountOfRows; i++)
+	lock.Acquire();
+	for (i = start; i < start+amountOfRows && i < height/8; i++)
 	{
-		RefreshPage(i);
+		refreshPending |= 1 << i;
 	}
+	ServiceTransfers();
+	lock.Release();
+#if !defined(USE_MULTICORE)
+	Flush();
+#endif
 }
 
-// Some very basic optimisation is implemented.
-// it scans the page to work out the first (new_start) and last (new_end) changed bytes
-// Only update that window on the OLED
-// If someone is keen, a smarter algorithm could work out a series of ranges to update
 void SSD1306::RefreshPage(u32 page)
 {
 	if (page >= height/8)
 		return;
 
+	lock.Acquire();
+	refreshPending |= 1 << page;
+	ServiceTransfers();
+	lock.Release();
+#if !defined(USE_MULTICORE)
+	Flush();
+#endif
+}
+
+void SSD1306::QueuePendingPages()
+{
+	for (u32 page = 0; refreshPending && page < height/8; page++)
+	{
+		if (refreshPending & (1 << page))
+		{
+			if (!QueuePage(page))
+				break;	// Out of queue space; carry on from here next time
+			refreshPending &= ~(1 << page);
+		}
+	}
+}
+
+// Only the columns written since the page was last sent are compared against what the display holds.
+// Each run of changed columns (allowing short unchanged gaps) is sent with its own page/column address.
+bool SSD1306::QueuePage(u32 page)
+{
+	if (dirtyStart[page] > dirtyEnd[page])
+		return true;
+
 	// x32 displays use lower half (pages 2 and 3)
+	u32 devicePage = page;
 	if (type == LCD_1306_128x32)
 	{
-		page = page+4;	// 0,1,2,3 -> 4,5,6,7
-		page = page%4;	// and wrap it so 4,5 -> 0,1
+		devicePage = devicePage+4;	// 0,1,2,3 -> 4,5,6,7
+		devicePage = devicePage%4;	// and wrap it so 4,5 -> 0,1
 	}
 
-	int i;
-	int start = page*width;
-	int end = start + width;
-
-	int new_start = -1;
-	int new_end = -1;
-	for (i = start; i < end; i++)
+	unsigned char* newData = frame + page * width;
+	unsigned char* oldData = oldFrame + page * width;
+	u32 end = dirtyEnd[page];
+	u32 column = dirtyStart[page];
+	while (column <= end)
 	{
-		if (oldFrame[i] ^ frame[i])
+		if (newData[column] == oldData[column])
 		{
-			if (new_start == -1)
-				new_start = i;
-			new_end = i;
+			column++;
+			continue;
 		}
-	}
 
-	if (new_start >= 0)
-	{
-		SetDataPointer(page, new_start-start);
-		new_end++;
-		while (new_start < new_end)
+		u32 runEnd = column;
+		for (u32 scan = column + 1; scan <= end && scan - runEnd <= RUN_GAP; scan++)
+		{
+			if (newData[scan] != oldData[scan])
+				runEnd = scan;
+		}
+
+		if (QueueSpace() < 2)
 		{
-			i = (new_end-new_start < 15) ? new_end-new_start : 15;
-			if (i == 1)
-			{
-				SendData(frame[new_start]);
-				oldFrame[new_start] = frame[new_start];
-			}
-			else // Use the ability to send up to 16 byte in a row
-				 // (1 for command and 15 for data)
-			{
-				SendDataLong(&frame[new_start],i);
-				memcpy(&oldFrame[new_start], &frame[new_start],i);
-			}
-			new_start += i;
+			dirtyStart[page] = column;
+			return false;
 		}
+
+		SetDataPointer(devicePage, column);
+
+		u32 length = runEnd - column + 1;
+		Transfer* transfer = &queue[queueHead];
+		transfer->data[0] = SSD1306_DATA_REG;
+		memcpy(&transfer->data[1], &newData[column], length);
+		transfer->length = length + 1;
+		queueHead = (queueHead + 1) % TRANSFER_QUEUE_SIZE;
+		memcpy(&oldData[column], &newData[column], length);
+
+		column = runEnd + 1;
 	}
+
+	dirtyStart[page] = 0xff;
+	dirtyEnd[page] = 0;
+	return true;
 }
 
 void SSD1306::ClearScreen()
 {
-	memset(frame, 0, sizeof_frame);
+	ClearFrame();
 	//memset(oldFrame, 0xff, sizeof_frame);	// to force update
 	RefreshScreen();
 }
 
+void SSD1306::ClearFrame()
+{
+	lock.Acquire();
+	memset(frame, 0, sizeof_frame);
+	for (unsigned page = 0; page < height/8; page++)
+		MarkDirty(page, 0, width - 1);
+	lock.Release();
+}
+
 void SSD1306::DisplayOn()
 {
 	SendCommand(SSD1306_CMD_DISPLAY_ON);	// 0xAF
@@ -244,16 +358,22 @@ void SSD1306::DisplayOff()
 void SSD1306::SetContrast(u8 value)
 {
 	contrast = value;
-	SendCommand(SSD1306_CMD_SET_CONTRAST_CONTROL);
-	SendCommand(value);
+	u8 commands[2] = { SSD1306_CMD_SET_CONTRAST_CONTROL, value };
+	lock.Acquire();
+	QueueCommands(commands, sizeof(commands));
+	ServiceTransfers();
+	lock.Release();
 	if (type != LCD_1106_128x64)	// dont fiddle vcomdeselect on 1106 displays
 		SetVCOMDeselect( value >> 8);
 }
 
 void SSD1306::SetVCOMDeselect(u8 value)
 {
-	SendCommand(SSD1306_CMD_SET_VCOMH_DESELECT_LEVEL);
-	SendCommand( (value & 7) << 4 );
+	u8 commands[2] = { SSD1306_CMD_SET_VCOMH_DESELECT_LEVEL, (u8)((value & 7) << 4) };
+	lock.Acquire();
+	QueueCommands(commands, sizeof(commands));
+	ServiceTransfers();
+	lock.Release();
 }
 
 void SSD1306::PlotText(bool useCBMFont, bool petscii, int x, int y, char* str, bool inverse)
@@ -297,6 +417,7 @@ void transpose8(unsigned char* B, const unsigned char* A, bool inverse)
 void SSD1306::PlotCharacter(bool useCBMFont, bool petscii, int x, int y, char c, bool inverse)
 {
 	unsigned char a[8], b[8];
+	lock.Acquire();
 	if (useCBMFont && CBMFont)
 	{
 		if (! petscii)
@@ -304,6 +425,7 @@ void SSD1306::PlotCharacter(bool useCBMFont, bool petscii, int x, int y, char c,
 		c = petscii2screen(c);
 		transpose8(a, CBMFont + ((c+256) * 8), inverse); // 256 byte shift to use the maj/min bank
 		memcpy(frame + (y * 128) + (x * 8), a, 8);
+		MarkDirty(y, x * 8, x * 8 + 7);
 	}
 	else
 	{
@@ -311,22 +433,32 @@ void SSD1306::PlotCharacter(bool useCBMFont, bool petscii, int x, int y, char c,
 		transpose8(b, avpriv_vga16_font + (c * 16) + 8, inverse);
 		memcpy(frame + (y * 256) + (x * 8), a, 8);
 		memcpy(frame + (y * 256) + (x * 8) + 128, b, 8);
+		MarkDirty(y * 2, x * 8, x * 8 + 7);
+		MarkDirty(y * 2 + 1, x * 8, x * 8 + 7);
 	}
+	lock.Release();
 
 }
 
 void SSD1306::PlotPixel(int x, int y, int c)
 {
+	lock.Acquire();
 	switch (c)
 	{
 		case 1:   frame[x+ (y/8)*width] |=  (1 << (y&7)); break;
 		case 0:   frame[x+ (y/8)*width] &= ~(1 << (y&7)); break;
 		case -1:  frame[x+ (y/8)*width] ^=  (1 << (y&7)); break;
 	}
+	MarkDirty(y/8, x, x);
+	lock.Release();
 }
 
 // expects source in ssd1306 native vertical byte format
 void SSD1306::PlotImage(const unsigned char * source)
 {
+	lock.Acquire();
 	memcpy (frame, source, SSD1306_128x64_BYTES);
+	for (unsigned page = 0; page < height/8; page++)
+		MarkDirty(page, 0, width - 1);
+	lock.Release();
 }
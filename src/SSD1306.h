@@ -21,6 +21,7 @@
 
 #include <stdlib.h>
 #include "types.h"
+#include "SpinLock.h"
 extern "C"
 {
 #include "rpi-i2c.h"
@@ -69,6 +70,8 @@ extern "C"
 //________________________________________________________
 
 #define SSD1306_128x64_BYTES ((128 * 64) / 8)
+#define SSD1306_MAX_PAGES 8
+#define SSD1306_MAX_WIDTH 128
 
 class SSD1306
 {
@@ -88,6 +91,7 @@ public:
 	void SetVCOMDeselect(u8 value);
 
 	void ClearScreen();
+	void ClearFrame();
 	void RefreshScreen();
 	void RefreshPage(u32 page);
 	void RefreshTextRows(u32 start, u32 amountOfRows);
@@ -95,14 +99,48 @@ public:
 	void PlotPixel(int x, int y, int c);
 	void PlotImage(const unsigned char * source);
 
+	// Refreshes only queue I2C transfers. Service moves them onto the bus without waiting; Flush waits for all of them.
+	// The FIFO is topped up by polling on whichever core calls Service (core 0's UpdateScreen with USE_MULTICORE);- no DMA is used.
+	void Service();
+	void Flush();
+
 protected:
 	void SendCommand(u8 command);
-	void SendData(u8 data);
-	void SendDataLong(void* data, u8 length);
 
 	void Home();
 	void SetDataPointer(u8 row, u8 col);
 
+	// Callers of these hold lock.
+	void QueueCommands(const u8* commands, u32 count);
+	bool QueuePage(u32 page);
+	void QueuePendingPages();
+	void ServiceTransfers();
+	void MarkDirty(u32 page, u32 x1, u32 x2);
+	u32 QueueSpace() const { return TRANSFER_QUEUE_SIZE - 1 - ((queueHead - queueTail + TRANSFER_QUEUE_SIZE) % TRANSFER_QUEUE_SIZE); }
+
+	// A command or data write. Data writes carry a run of changed columns within one page.
+	struct Transfer
+	{
+		u32 length;
+		u8 data[1 + SSD1306_MAX_WIDTH];
+	};
+
+	static const u32 TRANSFER_QUEUE_SIZE = 16;
+	// Unchanged columns shorter than this are sent rather than paying for another page/column address.
+	static const u32 RUN_GAP = 6;
+
+	Transfer queue[TRANSFER_QUEUE_SIZE];
+	u32 queueHead;
+	u32 queueTail;
+	bool transferActive;
+
+	// Columns written since the page was last queued (clean when start > end)
+	u8 dirtyStart[SSD1306_MAX_PAGES];
+	u8 dirtyEnd[SSD1306_MAX_PAGES];
+	u8 refreshPending;
+
+	SpinLock lock;
+
 //	unsigned char frame[SSD1306_128x64_BYTES];
 //	unsigned char oldFrame[SSD1306_128x64_BYTES];
 	unsigned char * frame;
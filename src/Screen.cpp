@@ -17,6 +17,7 @@
 // along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
 
 #include "Screen.h"
+#include "defs.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -28,6 +29,8 @@ extern "C"
 {
 	#include "rpi-mailbox-interface.h"
 	#include "xga_font_data.h"
+	#include "rpiHardware.h"
+	#include "startup.h"
 }
 
 extern u32 RPi_CpuId;
@@ -37,6 +40,29 @@ extern unsigned char* CBMFont;
 static const int BitFontHt = 16;
 static const int BitFontWth = 8;
 
+// DMA channel used for clears, scrolls and page copies (0 is the head step sound, 4 the SD card)
+#define SCREEN_DMA_CHANNEL	5
+
+#if defined(RPI2) || defined(RPI3)
+#define DATA_CACHE_LINE_LENGTH	64
+#else
+#define DATA_CACHE_LINE_LENGTH	32
+#endif
+
+struct ScreenDMAControlBlock
+{
+	u32 transferInformation;
+	u32 sourceAddress;
+	u32 destinationAddress;
+	u32 transferLength;
+	u32 stride;
+	u32 nextControlBlock;
+	u32 res0, res1;
+	u32 fill;	// Source word for fills (read without incrementing)
+} __attribute__((aligned(DATA_CACHE_LINE_LENGTH)));
+
+static ScreenDMAControlBlock screenDMACB;
+
 void Screen::Open(u32 widthDesired, u32 heightDesired, u32 colourDepth)
 {
 	if (widthDesired < 320)
@@ -73,15 +99,20 @@ void Screen::Open(u32 widthDesired, u32 heightDesired, u32 colourDepth)
 
 	//DEBUG_LOG("width = %d height = %d depth = %d\r\n", width, height, depth);
 
+	// Ask for two pages so the browser can compose off screen. Fall back to one if the GPU will not give us the memory.
+	u32 virtualHeight = heightDesired * 2;
+	u32 virtualHeightGranted = 0;
+	u32 bufferSize = 0;
 	do
 	{
 		RPI_PropertyInit();
 		RPI_PropertyAddTag(TAG_ALLOCATE_BUFFER);
 		RPI_PropertyAddTag(TAG_SET_PHYSICAL_SIZE, widthDesired, heightDesired);
-		RPI_PropertyAddTag(TAG_SET_VIRTUAL_SIZE, widthDesired, heightDesired);	// Don't need to double buffer (yet).
+		RPI_PropertyAddTag(TAG_SET_VIRTUAL_SIZE, widthDesired, virtualHeight);
 		RPI_PropertyAddTag(TAG_SET_DEPTH, colourDepth);
 		RPI_PropertyAddTag(TAG_GET_PITCH);
 		RPI_PropertyAddTag(TAG_GET_PHYSICAL_SIZE);
+		RPI_PropertyAddTag(TAG_GET_VIRTUAL_SIZE);
 		RPI_PropertyAddTag(TAG_GET_DEPTH);
 		RPI_PropertyProcess();
 
@@ -97,11 +128,33 @@ void Screen::Open(u32 widthDesired, u32 heightDesired, u32 colourDepth)
 		if ((mp = RPI_PropertyGet(TAG_GET_PITCH)))
 			pitch = mp->data.buffer_32[0];
 
+		if ((mp = RPI_PropertyGet(TAG_GET_VIRTUAL_SIZE)))
+			virtualHeightGranted = mp->data.buffer_32[1];
+
 		if ((mp = RPI_PropertyGet(TAG_ALLOCATE_BUFFER)))
+		{
 			framebuffer = (unsigned char*)(mp->data.buffer_32[0] & 0x3FFFFFFF);
+			bufferSize = mp->data.buffer_32[1];
+		}
+
+		if (framebuffer == 0)
+			virtualHeight = heightDesired;
 	}
 	while (framebuffer == 0);
 
+	pages[0] = framebuffer;
+	pages[1] = framebuffer + pitch * height;
+	visiblePage = 0;
+	flipPending = false;
+	composeDepth = 0;
+	doubleBuffered = virtualHeightGranted >= height * 2 && bufferSize >= pitch * height * 2;
+	if (doubleBuffered)
+	{
+		RPI_PropertyInit();
+		RPI_PropertyAddTag(TAG_SET_VIRTUAL_OFFSET, 0, 0);
+		RPI_PropertyProcess();
+	}
+
 
 	//RPI_PropertyInit();
 	//RPI_PropertyAddTag(TAG_SET_PALETTE, palette);
@@ -124,6 +177,18 @@ void Screen::Open(u32 widthDesired, u32 heightDesired, u32 colourDepth)
 		break;
 	}
 
+	textColumns = width / BitFontWth;
+	textRows = height / BitFontHt;
+	free(textCells);
+	textCells = (TextCell*)calloc(textColumns * textRows, sizeof(TextCell));
+
+	if (glyphStrips == 0)
+		glyphStrips = (GlyphStrips*)malloc(GLYPH_STRIP_SETS * sizeof(GlyphStrips));
+	for (int i = 0; glyphStrips && i < GLYPH_STRIP_SETS; ++i)
+	{
+		glyphStrips[i].lastUsed = 0;
+	}
+
 	opened = true;
 }
 
@@ -154,18 +219,291 @@ void Screen::PlotPixel8(u32 pixel_offset, RGBA Colour)
 #endif
 }
 
+static void StartScreenDMA()
+{
+	// The engine reads the control block through the uncached alias so write it back first
+	for (u32 address = (u32)&screenDMACB; address < (u32)(&screenDMACB + 1); address += DATA_CACHE_LINE_LENGTH)
+		_clean_invalidate_dcache_mva((void*)address);
+	DataSyncBarrier();
+
+	u32 base = DMA_CHANNEL_BASE(SCREEN_DMA_CHANNEL);
+	write32(DMA_ENABLE, read32(DMA_ENABLE) | (1 << SCREEN_DMA_CHANNEL));
+	write32(base + DMA_CS, DMA_END | DMA_INT);
+	write32(base + DMA_CONBLK_AD, BUS_MEMORY_ADDRESS(&screenDMACB));
+	write32(base + DMA_CS, DMA_ACTIVE | DMA_WAIT_FOR_OUTSTANDING_WRITES | DMA_PRIORITY(1) | DMA_PANIC_PRIORITY(15));
+}
+
+void Screen::WaitForDMA()
+{
+	if (dmaActive)
+	{
+		u32 base = DMA_CHANNEL_BASE(SCREEN_DMA_CHANNEL);
+		while (read32(base + DMA_CS) & DMA_ACTIVE)
+		{
+		}
+		write32(base + DMA_CS, DMA_END);
+		dmaActive = false;
+	}
+}
+
+// Fills length bytes with colour. Returns false if the pixel format or alignment needs the CPU path.
+bool Screen::DMAFill(u8* dest, u32 length, RGBA colour)
+{
+	u32 word = 0;
+	StorePixel((u8*)&word, colour);
+	switch (bpp)
+	{
+		case 32:
+		break;
+		case 16:
+			word |= word << 16;
+		break;
+		case 8:
+			word *= 0x01010101;
+		break;
+		default:
+			return false;
+	}
+
+	if (((u32)dest | length) & 3)
+		return false;
+
+	WaitForDMA();
+	screenDMACB.transferInformation = DMA_WAIT_RESP | DMA_DEST_INC | DMA_BURST_LENGTH(4);
+	screenDMACB.sourceAddress = BUS_MEMORY_ADDRESS(&screenDMACB.fill);
+	screenDMACB.destinationAddress = BUS_MEMORY_ADDRESS(dest);
+	screenDMACB.transferLength = length;
+	screenDMACB.stride = 0;
+	screenDMACB.nextControlBlock = 0;
+	screenDMACB.fill = word;
+	StartScreenDMA();
+	dmaActive = true;
+	return true;
+}
+
+// Copies rows of rowBytes, pitch apart. Overlapping copies are fine as long as dest is below source;- the engine works forwards.
+bool Screen::DMACopy(u8* dest, const u8* source, u32 rowBytes, u32 rows)
+{
+	if (((u32)dest | (u32)source | rowBytes) & 3)
+		return false;
+
+	u32 ti = DMA_WAIT_RESP | DMA_SRC_INC | DMA_DEST_INC | DMA_BURST_LENGTH(4);
+	u32 length = rowBytes * rows;
+	u32 stride = 0;
+	if (rows > 1 && rowBytes != pitch)
+	{
+		if (rows > 0x4000 || rowBytes > 0xFFFF)
+			return false;
+		ti |= DMA_TDMODE;
+		length = DMA_TXFR_LEN_2D(rows, rowBytes);
+		stride = DMA_STRIDE_2D(pitch - rowBytes, pitch - rowBytes);
+	}
+
+	WaitForDMA();
+	screenDMACB.transferInformation = ti;
+	screenDMACB.sourceAddress = BUS_MEMORY_ADDRESS(source);
+	screenDMACB.destinationAddress = BUS_MEMORY_ADDRESS(dest);
+	screenDMACB.transferLength = length;
+	screenDMACB.stride = stride;
+	screenDMACB.nextControlBlock = 0;
+	StartScreenDMA();
+	dmaActive = true;
+	return true;
+}
+
+void Screen::BeginFrame()
+{
+	if (!doubleBuffered)
+		return;
+
+	lock.Acquire();
+	// A flip still waiting for core 0 will show the page we were drawing on, so keep adding to it.
+	if (composeDepth++ == 0 && !flipPending)
+	{
+		// Start the hidden page from what is on screen so unchanged text cells can still be skipped.
+		u8* visible = pages[visiblePage];
+		u8* hidden = pages[visiblePage ^ 1];
+		if (!DMACopy(hidden, visible, pitch * height, 1))
+		{
+			WaitForDMA();
+			memcpy(hidden, visible, pitch * height);
+		}
+		framebuffer = hidden;
+	}
+	lock.Release();
+}
+
+void Screen::EndFrame()
+{
+	if (!doubleBuffered)
+		return;
+
+	lock.Acquire();
+	bool finished = composeDepth > 0 && --composeDepth == 0;
+	if (finished)
+	{
+		WaitForDMA();
+		pendingPage = framebuffer == pages[1] ? 1 : 0;
+		flipPending = true;
+	}
+	lock.Release();
+
+	if (!finished)
+		return;
+#if defined(USE_MULTICORE)
+	// Wake core 0 so it flips on its next pass.
+	asm volatile ("sev");
+#else
+	ServiceFlip();
+#endif
+}
+
+void Screen::ServiceFlip()
+{
+	if (!flipPending)
+		return;
+
+	// Only EndFrame sets flipPending and only we clear it, so pendingPage holds still while the mailbox call runs unlocked.
+	lock.Acquire();
+	u32 page = pendingPage;
+	lock.Release();
+
+	RPI_PropertyInit();
+	RPI_PropertyAddTag(TAG_SET_VIRTUAL_OFFSET, 0, page * height);
+	RPI_PropertyAddTag(TAG_SET_VSYNC, 0);	// Firmware that does not know the tag just flips on the next frame
+	RPI_PropertyProcess();
+
+	lock.Acquire();
+	visiblePage = page;
+	flipPending = false;
+	lock.Release();
+}
+
+void Screen::StorePixel(u8* dest, RGBA colour)
+{
+	switch (bpp)
+	{
+		case 32:
+			*(RGBA*)dest = colour;
+		break;
+		case 24:
+			dest[0] = BLUE(colour);
+			dest[1] = GREEN(colour);
+			dest[2] = RED(colour);
+		break;
+		default:
+		case 16:
+			*(unsigned short*)dest = ((RED(colour) >> 3) << 11) | ((GREEN(colour) >> 2) << 5) | (BLUE(colour) >> 3);
+		break;
+		case 8:
+			*dest = RED(colour);
+		break;
+	}
+}
+
+void Screen::FillSpan(u8* dest, u32 count, RGBA colour)
+{
+#if not defined(EXPERIMENTALZERO)
+	switch (bpp)
+	{
+		case 32:
+		{
+			RGBA* dest32 = (RGBA*)dest;
+			while (count--)
+				*dest32++ = colour;
+		}
+		break;
+		case 24:
+			while (count--)
+			{
+				*dest++ = BLUE(colour);
+				*dest++ = GREEN(colour);
+				*dest++ = RED(colour);
+			}
+		break;
+		default:
+		case 16:
+		{
+			unsigned short pixel = ((RED(colour) >> 3) << 11) | ((GREEN(colour) >> 2) << 5) | (BLUE(colour) >> 3);
+			unsigned short* dest16 = (unsigned short*)dest;
+			while (count--)
+				*dest16++ = pixel;
+		}
+		break;
+		case 8:
+			memset(dest, RED(colour), count);
+		break;
+	}
+#endif
+}
+
+void Screen::CopySpan(u8* dest, const u32* source, u32 count)
+{
+#if not defined(EXPERIMENTALZERO)
+	if (bpp == 32)
+	{
+		memcpy(dest, source, count * sizeof(u32));
+	}
+	else
+	{
+		u32 bytesPerPixel = bpp >> 3;
+		while (count--)
+		{
+			StorePixel(dest, *source++);
+			dest += bytesPerPixel;
+		}
+	}
+#endif
+}
+
+void Screen::InvalidateCell(u32 x, u32 y)
+{
+	u32 column = x / BitFontWth;
+	u32 row = y / BitFontHt;
+	if (textCells && column < textColumns && row < textRows)
+		textCells[row * textColumns + column].valid = false;
+}
+
+void Screen::InvalidateCells(u32 x1, u32 y1, u32 x2, u32 y2)
+{
+	if (textCells == 0 || x2 <= x1 || y2 <= y1)
+		return;
+
+	u32 column2 = (x2 - 1) / BitFontWth;
+	u32 row2 = (y2 - 1) / BitFontHt;
+	if (column2 >= textColumns) column2 = textColumns - 1;
+	if (row2 >= textRows) row2 = textRows - 1;
+
+	for (u32 row = y1 / BitFontHt; row <= row2; ++row)
+	{
+		TextCell* cell = &textCells[row * textColumns];
+		for (u32 column = x1 / BitFontWth; column <= column2; ++column)
+		{
+			cell[column].valid = false;
+		}
+	}
+}
+
 void Screen::DrawRectangle(u32 x1, u32 y1, u32 x2, u32 y2, RGBA colour)
+{
+	lock.Acquire();
+	FillRectangle(x1, y1, x2, y2, colour);
+	lock.Release();
+}
+
+void Screen::FillRectangle(u32 x1, u32 y1, u32 x2, u32 y2, RGBA colour)
 {
 	ClipRect(x1, y1, x2, y2);
+	if (x2 <= x1)
+		return;
 
+	WaitForDMA();
+	InvalidateCells(x1, y1, x2, y2);
+
+	u32 bytesPerPixel = bpp >> 3;
 	for (u32 y = y1; y < y2; y++)
 	{
-		u32 line = y * pitch;
-		for (u32 x = x1; x < x2; x++)
-		{
-			u32 pixel_offset = (x * (bpp >> 3)) + line;
-			(this->*Screen::plotPixelFn)(pixel_offset, colour);
-		}
+		FillSpan(framebuffer + y * pitch + x1 * bytesPerPixel, x2 - x1, colour);
 	}
 }
 
@@ -176,31 +514,47 @@ void Screen::ScrollArea(u32 x1, u32 y1, u32 x2, u32 y2)
 	if (x2 - 1 <= x1)
 		return;
 
-	for (u32 y = y1; y < y2; y++)
+	lock.Acquire();
+	InvalidateCells(x1, y1, x2, y2);
+
+	u32 bytesPerPixel = bpp >> 3;
+	u8* line = framebuffer + y1 * pitch + x1 * bytesPerPixel;
+	if (!DMACopy(line, line + bytesPerPixel, (x2 - 1 - x1) * bytesPerPixel, y2 - y1))
 	{
-		u32 line = y * pitch;
-		for (u32 x = x1; x < (x2 - 1); x++)
+		WaitForDMA();
+		for (u32 y = y1; y < y2; y++)
 		{
-			u32 pixel_offset = ((x + 1) * (bpp >> 3)) + line;
-			u32 pixel_offsetDest = (x * (bpp >> 3)) + line;
-			*(unsigned short*)&framebuffer[pixel_offsetDest] = *(unsigned short*)&framebuffer[pixel_offset];
+			memmove(line, line + bytesPerPixel, (x2 - 1 - x1) * bytesPerPixel);
+			line += pitch;
 		}
 	}
+	lock.Release();
 }
 
 void Screen::ScrollUp(u32 pixels)
 {
-	memcpy(
-		framebuffer,
-		framebuffer + pixels * 2 * pitch,
-		(height - pixels * 2) * pitch
-	);
-	DrawRectangle(0, height - pixels, width, height, RGBA(0, 0, 0, 0xFF));
+	lock.Acquire();
+	InvalidateCells(0, 0, width, height);
+	if (!DMACopy(framebuffer, framebuffer + pixels * 2 * pitch, (height - pixels * 2) * pitch, 1))
+	{
+		WaitForDMA();
+		memmove(
+			framebuffer,
+			framebuffer + pixels * 2 * pitch,
+			(height - pixels * 2) * pitch
+		);
+	}
+	FillRectangle(0, height - pixels, width, height, RGBA(0, 0, 0, 0xFF));
+	lock.Release();
 }
 
 void Screen::Clear(RGBA colour)
 {
-	DrawRectangle(0, 0, width, height, colour);
+	lock.Acquire();
+	InvalidateCells(0, 0, width, height);
+	if (!DMAFill(framebuffer, pitch * height, colour))
+		FillRectangle(0, 0, width, height, colour);
+	lock.Release();
 }
 
 // HACK: I have a better fix for this coming when I commit support for other LCDs and screens (each screen can use its own character set/font)
@@ -229,6 +583,13 @@ static char vga2screen(char c)
 }
 
 void Screen::WriteChar(bool petscii, u32 x, u32 y, unsigned char c, RGBA colour)
+{
+	lock.Acquire();
+	PlotChar(petscii, x, y, c, colour);
+	lock.Release();
+}
+
+void Screen::PlotChar(bool petscii, u32 x, u32 y, unsigned char c, RGBA colour)
 {
 	if (opened)
 	{
@@ -247,6 +608,8 @@ void Screen::WriteChar(bool petscii, u32 x, u32 y, unsigned char c, RGBA colour)
 			fontBitMap = avpriv_vga16_font;
 			fontHeight = BitFontHt;
 		}
+		WaitForDMA();
+		InvalidateCells(x, y, x + BitFontWth, y + fontHeight);
 		for (u32 py = 0; py < fontHeight; ++py)
 		{
 			if (y + py > height)
@@ -272,13 +635,20 @@ void Screen::PlotPixel(u32 x, u32 y, RGBA colour)
 {
 	if (x < 0 || y < 0 || x >= width || y >= height)
 		return;
+	lock.Acquire();
+	WaitForDMA();
+	InvalidateCell(x, y);
 	int pixel_offset = (x * (bpp >> 3)) + (y * pitch);
 	(this->*Screen::plotPixelFn)(pixel_offset, colour);
+	lock.Release();
 }
 
 void Screen::DrawLine(u32 x1, u32 y1, u32 x2, u32 y2, RGBA colour)
 {
 	ClipRect(x1, y1, x2, y2);
+	lock.Acquire();
+	WaitForDMA();
+	InvalidateCells(Min(x1, x2), Min(y1, y2), MAX(x1, x2) + 1, MAX(y1, y2) + 1);
 
 	int dx0, dy0, ox, oy, eulerMax;
 	dx0 = (int)(x2 - x1);
@@ -292,15 +662,122 @@ void Screen::DrawLine(u32 x1, u32 y1, u32 x2, u32 y2, RGBA colour)
 		int pixel_offset = (ox * (bpp >> 3)) + (oy * pitch);
 		(this->*Screen::plotPixelFn)(pixel_offset, colour);
 	}
+	lock.Release();
 }
 
 void Screen::DrawLineV(u32 x, u32 y1, u32 y2, RGBA colour)
 {
 	//ClipRect(x, y1, x, y2);
+	lock.Acquire();
+	WaitForDMA();
+	InvalidateCells(x, y1, x + 1, y2 + 1);
+
+	u8 pixel[4];
+	u32 bytesPerPixel = bpp >> 3;
+	u8* dest = framebuffer + (x * bytesPerPixel) + (y1 * pitch);
+	StorePixel(pixel, colour);
 	for (u32 y = y1; y <= y2; ++y)
 	{
-		int pixel_offset = (x * (bpp >> 3)) + (y * pitch);
-		(this->*Screen::plotPixelFn)(pixel_offset, colour);
+#if not defined(EXPERIMENTALZERO)
+		for (u32 i = 0; i < bytesPerPixel; ++i)
+			dest[i] = pixel[i];
+#endif
+		dest += pitch;
+	}
+	lock.Release();
+}
+
+const u8* Screen::GetGlyphStrips(RGBA TxtColour, RGBA BkColour)
+{
+	GlyphStrips* strips = &glyphStrips[0];
+	for (int i = 0; i < GLYPH_STRIP_SETS; ++i)
+	{
+		GlyphStrips* candidate = &glyphStrips[i];
+		if (candidate->lastUsed != 0 && candidate->txtColour == TxtColour && candidate->bkColour == BkColour)
+		{
+			candidate->lastUsed = ++glyphStripsUseCount;
+			return &candidate->rows[0][0];
+		}
+		if (candidate->lastUsed < strips->lastUsed)
+			strips = candidate;
+	}
+
+	// Render all 256 rows for the colour pair into the least recently used set.
+	u32 bytesPerPixel = bpp >> 3;
+	for (u32 bits = 0; bits < 256; ++bits)
+	{
+		u8* dest = strips->rows[bits];
+		for (int px = 0; px < BitFontWth; ++px)
+		{
+			StorePixel(dest, (bits & (0x80 >> px)) ? TxtColour : BkColour);
+			dest += bytesPerPixel;
+		}
+	}
+	strips->txtColour = TxtColour;
+	strips->bkColour = BkColour;
+	strips->lastUsed = ++glyphStripsUseCount;
+	return &strips->rows[0][0];
+}
+
+// Draws a character with its background (what PrintText needs) using pre-rendered glyph rows.
+void Screen::DrawChar(bool petscii, u32 x, u32 y, unsigned char c, RGBA TxtColour, RGBA BkColour)
+{
+	u32 fontHeight;
+	const unsigned char* fontBitMap;
+	unsigned char glyph = c;
+	if (petscii && CBMFont)
+	{
+		fontBitMap = CBMFont;
+		fontHeight = 8;
+		glyph = petscii2screen(c);
+	}
+	else
+	{
+		if (petscii)
+			glyph = vga2screen(c);
+		fontBitMap = avpriv_vga16_font;
+		fontHeight = BitFontHt;
+	}
+
+	if (glyphStrips == 0 || x + BitFontWth > width || y + fontHeight > height)
+	{
+		FillRectangle(x, y, x + BitFontWth, y + fontHeight, BkColour);
+		PlotChar(petscii, x, y, c, TxtColour);
+		return;
+	}
+
+	WaitForDMA();
+	TextCell* cell = 0;
+	if (textCells && fontHeight == BitFontHt && (x % BitFontWth) == 0 && (y % BitFontHt) == 0)
+	{
+		cell = &textCells[(y / BitFontHt) * textColumns + (x / BitFontWth)];
+		if (cell->valid && cell->c == c && cell->petscii == petscii && cell->txtColour == TxtColour && cell->bkColour == BkColour)
+			return;
+	}
+	else
+	{
+		InvalidateCells(x, y, x + BitFontWth, y + fontHeight);
+	}
+
+#if not defined(EXPERIMENTALZERO)
+	const u8* strips = GetGlyphStrips(TxtColour, BkColour);
+	u32 stripSize = BitFontWth * (bpp >> 3);
+	u8* dest = framebuffer + y * pitch + x * (bpp >> 3);
+	const unsigned char* font = fontBitMap + glyph * fontHeight;
+	for (u32 py = 0; py < fontHeight; ++py)
+	{
+		memcpy(dest, strips + font[py] * sizeof(glyphStrips->rows[0]), stripSize);
+		dest += pitch;
+	}
+#endif
+
+	if (cell)
+	{
+		cell->c = c;
+		cell->petscii = petscii;
+		cell->txtColour = TxtColour;
+		cell->bkColour = BkColour;
+		cell->valid = true;
 	}
 }
 
@@ -316,16 +793,14 @@ u32 Screen::PrintText(bool petscii, u32 x, u32 y, char *ptr, RGBA TxtColour, RGB
 
 	if (width) *width = 0;
 
+	lock.Acquire();
 	while (*ptr != 0)
 	{
 		char c = *ptr++;
 		if ((c != '\r') && (c != '\n'))
 		{
 			if (!measureOnly)
-			{
-				DrawRectangle(xCursor, yCursor, xCursor + BitFontWth, yCursor + fontHeight, BkColour);
-				WriteChar(petscii, xCursor, yCursor, c, TxtColour);
-			}
+				DrawChar(petscii, xCursor, yCursor, c, TxtColour, BkColour);
 			xCursor += BitFontWth;
 			if (width) *width = MAX(*width, (u32)MAX(0, xCursor));
 		}
@@ -336,6 +811,7 @@ u32 Screen::PrintText(bool petscii, u32 x, u32 y, char *ptr, RGBA TxtColour, RGB
 		}
 		len++;
 	}
+	lock.Release();
 	if (height) *height = yCursor;
 
 	return len;
@@ -348,15 +824,22 @@ u32 Screen::MeasureText(bool petscii, char *ptr, u32* width, u32* height)
 
 void Screen::PlotImage(u32* image, int x, int y, int w, int h)
 {
-	int px;
-	int py;
-	int i = 0;
-	for (py = 0; py < h; ++py)
+	if (x < 0 || y < 0 || (u32)x >= width || (u32)y >= height)
+		return;
+
+	int columns = Min(w, (int)width - x);
+	int rows = Min(h, (int)height - y);
+	lock.Acquire();
+	WaitForDMA();
+	InvalidateCells(x, y, x + columns, y + rows);
+
+	u8* dest = framebuffer + y * pitch + x * (bpp >> 3);
+	for (int py = 0; py < rows; ++py)
 	{
-		for (px = 0; px < w; ++px)
-		{
-			PlotPixel(x + px, y + py, image[i++]);
-		}
+		CopySpan(dest, image, columns);
+		image += w;
+		dest += pitch;
 	}
+	lock.Release();
 }
 
@@ -20,6 +20,7 @@
 #define SCREEN_H
 
 #include "ScreenBase.h"
+#include "SpinLock.h"
 
 class Screen : public ScreenBase
 {
@@ -27,7 +28,20 @@ class Screen : public ScreenBase
 public:
 	Screen()
 		: ScreenBase()
+		, textCells(0)
+		, textColumns(0)
+		, textRows(0)
+		, glyphStrips(0)
+		, glyphStripsUseCount(0)
+		, visiblePage(0)
+		, pendingPage(0)
+		, flipPending(false)
+		, composeDepth(0)
+		, doubleBuffered(false)
+		, dmaActive(false)
 	{
+		pages[0] = 0;
+		pages[1] = 0;
 	}
 
 	void Open(u32 width, u32 height, u32 colourDepth);
@@ -58,6 +72,11 @@ public:
 	u32 GetFontHeightDirectoryDisplay();
 
 	void SwapBuffers() {}
+
+	void BeginFrame();
+	void EndFrame();
+	// Performs a flip queued by EndFrame. With USE_MULTICORE the browser composes on core 1 and core 0 flips, as it owns the mailbox.
+	void ServiceFlip();
 private:
 
 	typedef void (Screen::*PlotPixelFunction)(u32 pixel_offset, RGBA Colour);
@@ -69,6 +88,65 @@ private:
 	void PlotPixel16(u32 pixel_offset, RGBA Colour);
 	void PlotPixel8(u32 pixel_offset, RGBA Colour);
 
+	// Span helpers write whole runs of pixels in the framebuffer's format.
+	void StorePixel(u8* dest, RGBA colour);
+	void FillSpan(u8* dest, u32 count, RGBA colour);
+	void CopySpan(u8* dest, const u32* source, u32 count);
+
+	// The bodies of DrawRectangle and WriteChar, for callers that already hold lock.
+	void FillRectangle(u32 x1, u32 y1, u32 x2, u32 y2, RGBA colour);
+	void PlotChar(bool petscii, u32 x, u32 y, unsigned char c, RGBA colour);
+	void DrawChar(bool petscii, u32 x, u32 y, unsigned char c, RGBA TxtColour, RGBA BkColour);
+	const u8* GetGlyphStrips(RGBA TxtColour, RGBA BkColour);
+
+	// Text drawn on the 8x16 grid is remembered per cell so redrawing an unchanged screen writes nothing.
+	// Any other drawing over a cell forgets it.
+	void InvalidateCells(u32 x1, u32 y1, u32 x2, u32 y2);
+	void InvalidateCell(u32 x, u32 y);
+
+	struct TextCell
+	{
+		RGBA txtColour;
+		RGBA bkColour;
+		u8 c;
+		u8 petscii;
+		u8 valid;
+	};
+
+	TextCell* textCells;
+	u32 textColumns;
+	u32 textRows;
+
+	// Each glyph row is one byte of font data, so for a colour pair all 256 possible rows can be pre-rendered and copied.
+	struct GlyphStrips
+	{
+		RGBA txtColour;
+		RGBA bkColour;
+		u32 lastUsed;
+		u8 rows[256][8 * 4];
+	};
+	static const int GLYPH_STRIP_SETS = 6;
+	GlyphStrips* glyphStrips;
+	u32 glyphStripsUseCount;
+
+	// Clears, scrolls and page copies are handed to a DMA channel. Drawing waits for the last transfer before touching the framebuffer.
+	void WaitForDMA();
+	bool DMAFill(u8* dest, u32 length, RGBA colour);
+	bool DMACopy(u8* dest, const u8* source, u32 rowBytes, u32 rows);
+
+	// The virtual framebuffer is two pages high. framebuffer points at the page being drawn.
+	u8* pages[2];
+	u32 visiblePage;
+	u32 pendingPage;
+	volatile bool flipPending;
+	u32 composeDepth;
+	bool doubleBuffered;
+	bool dmaActive;
+
+	// Core 0 draws the status bar and flips while core 1 composes the browser.
+	// Every drawing call, DMA transfer and page change holds this so neither core sees the other half way through.
+	SpinLock lock;
+
 	float scaleX;
 	float scaleY;
 };
@@ -73,6 +73,10 @@ public:
 	virtual u32 GetFontHeightDirectoryDisplay() { return 16; }
 
 	virtual void SwapBuffers() = 0;
+	// Screens that can page flip compose everything drawn between BeginFrame and EndFrame off screen and show it in one go.
+	// Pairs may nest; only the outermost EndFrame presents.
+	virtual void BeginFrame() {}
+	virtual void EndFrame() {}
 	virtual void RefreshRows(u32 start, u32 amountOfRows) {}
 
 	virtual bool IsLCD() { return false; };
@@ -59,9 +59,10 @@ void ScreenLCD::ScrollArea(u32 x1, u32 y1, u32 x2, u32 y2)
 {
 }
 
+// Callers always follow with SwapBuffers so only the frame is cleared here; the display then receives just the difference.
 void ScreenLCD::Clear(RGBA colour)
 {
-	ssd1306->ClearScreen();
+	ssd1306->ClearFrame();
 }
 
 void ScreenLCD::ClearInit(RGBA colour)
@@ -141,6 +142,12 @@ void ScreenLCD::RefreshRows(u32 start, u32 amountOfRows)
 	}
 }
 
+void ScreenLCD::Service()
+{
+	if (ssd1306)
+		ssd1306->Service();
+}
+
 bool ScreenLCD::IsLCD()
 {
 	return true;
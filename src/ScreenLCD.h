@@ -59,6 +59,8 @@ public:
 	void RefreshScreen();
 
 	void RefreshRows(u32 start, u32 amountOfRows);
+	// Moves queued refreshes onto the I2C bus without waiting for it.
+	void Service();
 	bool IsLCD();
 	bool UseCBMFont();
 private:
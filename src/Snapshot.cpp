@@ -0,0 +1,111 @@
+// Pi1541 - A Commodore 1541 disk drive emulator
+// Copyright(C) 2018 Stephen White
+//
+// This file is part of Pi1541.
+//
+// Pi1541 is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Pi1541 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
+
+#include "Snapshot.h"
+#include <string.h>
+
+static const u32 SNAPSHOT_MAGIC = 0x53533150;	// "P1SS"
+
+Snapshot::Snapshot()
+	: size(0)
+	, position(0)
+	, saving(false)
+	, failed(false)
+{
+}
+
+void Snapshot::BeginSave(Machine machine)
+{
+	u32 magic = SNAPSHOT_MAGIC;
+	u32 version = VERSION;
+	u32 machineType = machine;
+
+	saving = true;
+	failed = false;
+	position = 0;
+	Field(magic);
+	Field(version);
+	Field(machineType);
+}
+
+bool Snapshot::BeginRestore(Machine machine)
+{
+	// Left as is if the snapshot is too short to hold them.
+	u32 magic = 0;
+	u32 version = 0;
+	u32 machineType = 0;
+
+	if (size == 0)
+		return false;
+
+	saving = false;
+	failed = false;
+	position = 0;
+	Field(magic);
+	Field(version);
+	Field(machineType);
+	if (magic != SNAPSHOT_MAGIC || version != VERSION || machineType != (u32)machine)
+		failed = true;
+	return !failed;
+}
+
+bool Snapshot::End()
+{
+	if (saving)
+	{
+		size = failed ? 0 : position;
+		saving = false;
+		return !failed;
+	}
+	return !failed && position == size;
+}
+
+bool Snapshot::Load(const void* bytes, u32 length)
+{
+	if (length > CAPACITY)
+		return false;
+	memcpy(data, bytes, length);
+	size = length;
+	return true;
+}
+
+void Snapshot::Bytes(void* bytes, u32 length)
+{
+	if (failed)
+		return;
+
+	if (saving)
+	{
+		if (position + length > CAPACITY)
+		{
+			failed = true;
+			return;
+		}
+		memcpy(data + position, bytes, length);
+	}
+	else
+	{
+		if (position + length > size)
+		{
+			failed = true;
+			return;
+		}
+		memcpy(bytes, data + position, length);
+	}
+	position += length;
+}
@@ -0,0 +1,72 @@
+// Pi1541 - A Commodore 1541 disk drive emulator
+// Copyright(C) 2018 Stephen White
+//
+// This file is part of Pi1541.
+//
+// Pi1541 is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Pi1541 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef Snapshot_H
+#define Snapshot_H
+
+#include "types.h"
+
+// A save-state of the emulated drive; CPU, VIA/CIA/WD177x registers and timers, head position and RAM.
+// Each chip lists its fields once in a SerialiseState(Snapshot&) function that is used to both save and restore,
+// so the order of the fields is the format. The disk is not copied here; DiskImage journals the tracks written after
+// a save so they can be rolled back.
+class Snapshot
+{
+public:
+	enum Machine
+	{
+		MACHINE_1541 = 1541,
+		MACHINE_1581 = 1581
+	};
+
+	Snapshot();
+
+	void BeginSave(Machine machine);
+	// Returns false if there is no snapshot of this machine to restore.
+	bool BeginRestore(Machine machine);
+	// Returns false if the snapshot overflowed or what was restored did not match what was saved.
+	bool End();
+
+	bool IsSaving() const { return saving; }
+	bool IsValid() const { return size != 0; }
+	bool Failed() const { return failed; }
+	void Fail() { failed = true; }
+	void Invalidate() { size = 0; }
+	u32 Size() const { return size; }
+	const u8* Data() const { return data; }
+	// Loads a snapshot that was saved elsewhere (eg into an IEC recording).
+	bool Load(const void* bytes, u32 length);
+
+	// Once the snapshot has failed nothing more is copied, so a mismatched restore stops before it corrupts anything else.
+	void Bytes(void* bytes, u32 length);
+	template <typename T> inline void Field(T& value) { Bytes(&value, sizeof(T)); }
+	// For bit fields and anything else that can not be referenced. Saves value or returns the restored value.
+	template <typename T> inline T Value(T value) { Field(value); return value; }
+
+	static const u32 VERSION = 4;
+	static const u32 CAPACITY = 40 * 1024;	// The 1541's 32K extra RAM mode is the largest.
+
+private:
+	u8 data[CAPACITY];
+	u32 size;
+	u32 position;
+	bool saving;
+	bool failed;
+};
+
+#endif
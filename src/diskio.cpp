@@ -8,7 +8,9 @@
 /*-----------------------------------------------------------------------*/
 
 #include "diskio.h"		/* FatFs lower layer API */
+#include "ff.h"
 #include "debug.h"
+#include "SpinLock.h"
 extern "C"
 {
 #include <uspi.h>
@@ -145,6 +147,15 @@ DRESULT disk_read (
 	//DEBUG_LOG("r pdrv = %d\r\n", pdrv);
 	if (pdrv == 0)
 	{
+		if (pEMMC->IsDMAEnabled())
+		{
+			// The DMA engine can take the whole run of sectors as one multi-block command
+			size_t bytes = count * SD_BLOCK_SIZE;
+			if (sd_read(buff, bytes, sector) != bytes)
+				return RES_ERROR;
+			return RES_OK;
+		}
+
 		for (UINT s = 0; s < count; ++s)
 		{
 			if (sd_read(buff, SD_BLOCK_SIZE, sector + s) < SD_BLOCK_SIZE)
@@ -184,6 +195,14 @@ DRESULT disk_write (
 	//DEBUG_LOG("w pdrv = %d\r\n", pdrv);
 	if (pdrv == 0)
 	{
+		if (pEMMC->IsDMAEnabled())
+		{
+			size_t bytes = count * SD_BLOCK_SIZE;
+			if (sd_write((uint8_t *)buff, bytes, sector) != bytes)
+				return RES_ERROR;
+			return RES_OK;
+		}
+
 		for (UINT s = 0; s < count; ++s)
 		{
 			if (sd_write((uint8_t *)buff, SD_BLOCK_SIZE, sector+s) < SD_BLOCK_SIZE)
@@ -246,3 +265,44 @@ DRESULT disk_ioctl (
 	return RES_PARERR;
 }
 
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Volume Locks                                                          */
+/*-----------------------------------------------------------------------*/
+// Core 0 serves TFTP while the emulation core browses and saves, so each
+// volume is held by a spin lock for the length of every FatFs call.
+
+static SpinLock volumeLocks[_VOLUMES];
+
+int ff_cre_syncobj (
+	BYTE vol,		/* Volume number the sync object is for */
+	_SYNC_t* sobj	/* Where to store the sync object */
+)
+{
+	*sobj = &volumeLocks[vol];
+	return 1;
+}
+
+int ff_req_grant (
+	_SYNC_t sobj
+)
+{
+	static_cast<SpinLock*>(sobj)->Acquire();
+	return 1;
+}
+
+void ff_rel_grant (
+	_SYNC_t sobj
+)
+{
+	static_cast<SpinLock*>(sobj)->Release();
+}
+
+int ff_del_syncobj (
+	_SYNC_t sobj
+)
+{
+	return 1;
+}
@@ -43,9 +43,12 @@
 //#include <circle/util.h>
 //#include <circle/stdarg.h>
 #include <assert.h>
+#include <string.h>
 extern "C"
 {
 	#include "rpiHardware.h"
+	#include "interrupt.h"
+	#include "startup.h"
 }
 
 //
@@ -83,6 +86,18 @@ extern "C"
 // Enable card interrupts
 //#define SD_CARD_INTERRUPTS
 
+// DMA channel used for data transfers (channel 0 is used for the head step sound)
+#define EMMC_DMA_CHANNEL	4
+
+// Unaligned buffers are staged through this many bytes of cache line aligned memory
+#define EMMC_DMA_BOUNCE_SIZE	(64 * 512)
+
+#if defined(RPI2) || defined(RPI3)
+#define DATA_CACHE_LINE_LENGTH	64
+#else
+#define DATA_CACHE_LINE_LENGTH	32
+#endif
+
 #define	EMMC_ARG2		(ARM_EMMC_BASE + 0x00)
 #define EMMC_BLKSIZECNT		(ARM_EMMC_BASE + 0x04)
 #define EMMC_ARG1		(ARM_EMMC_BASE + 0x08)
@@ -244,7 +259,7 @@ const u32 CEMMCDevice::sd_commands[] =
 	SD_CMD_INDEX(3) | SD_RESP_R6,
 	SD_CMD_INDEX(4),
 	SD_CMD_INDEX(5) | SD_RESP_R4,
-	SD_CMD_INDEX(6) | SD_RESP_R1,
+	SD_CMD_INDEX(6) | SD_RESP_R1 | SD_DATA_READ,
 	SD_CMD_INDEX(7) | SD_RESP_R1b,
 	SD_CMD_INDEX(8) | SD_RESP_R7,
 	SD_CMD_INDEX(9) | SD_RESP_R2,
@@ -319,7 +334,7 @@ const u32 CEMMCDevice::sd_acommands[] =
 	SD_CMD_RESERVED(10),
 	SD_CMD_RESERVED(11),
 	SD_CMD_RESERVED(12),
-	SD_CMD_INDEX(13) | SD_RESP_R1,
+	SD_CMD_INDEX(13) | SD_RESP_R1 | SD_DATA_READ,
 	SD_CMD_RESERVED(14),
 	SD_CMD_RESERVED(15),
 	SD_CMD_RESERVED(16),
@@ -424,11 +439,54 @@ const u32 CEMMCDevice::sd_acommands[] =
 
 #define SD_GET_CLOCK_DIVIDER_FAIL	0xffffffff
 
+// CMD6 arguments (PLSS 4.3.10) - access mode (function group 1) high speed/SDR25
+#define SD_SWITCH_CHECK		0x00fffff1
+#define SD_SWITCH_SET		0x80fffff1
+#define SD_SWITCH_STATUS_SIZE	64
+
 #define SD_BLOCK_SIZE		512
 
+static u8 s_dma_bounce[EMMC_DMA_BOUNCE_SIZE] __attribute__ ((aligned (DATA_CACHE_LINE_LENGTH)));
+
+static void CleanAndInvalidateDataCacheRange(void *buf, size_t length)
+{
+	u32 address = (u32) buf & ~(DATA_CACHE_LINE_LENGTH - 1);
+	u32 end = (u32) buf + length;
+	for (; address < end; address += DATA_CACHE_LINE_LENGTH)
+	{
+		_clean_invalidate_dcache_mva((void *) address);
+	}
+	DataSyncBarrier();
+}
+
+static void InvalidateDataCacheRange(void *buf, size_t length)
+{
+	u32 address = (u32) buf & ~(DATA_CACHE_LINE_LENGTH - 1);
+	u32 end = (u32) buf + length;
+	for (; address < end; address += DATA_CACHE_LINE_LENGTH)
+	{
+		_invalidate_dcache_mva((void *) address);
+	}
+	DataSyncBarrier();
+}
+
+static inline bool IsCacheLineAligned(const void *buf, size_t length)
+{
+	return (((u32) buf | length) & (DATA_CACHE_LINE_LENGTH - 1)) == 0;
+}
+
 CEMMCDevice::CEMMCDevice()
 :	m_ullOffset(0),
-	m_hci_ver(0)
+	m_hci_ver(0),
+	m_use_dma(false),
+	m_dma_irq(false),
+	m_dma_active(false),
+	m_dma_complete(false),
+	m_clock_rate(0),
+	m_bus_width(1),
+	m_high_speed(false),
+	m_transfer_bytes(0),
+	m_transfer_us(0)
 {
 }
 
@@ -471,6 +529,140 @@ bool CEMMCDevice::Initialize(void)
 	return true;
 }
 
+bool CEMMCDevice::EnableDMA(void)
+{
+	u32 base = DMA_CHANNEL_BASE(EMMC_DMA_CHANNEL);
+
+	write32(DMA_ENABLE, read32(DMA_ENABLE) | (1 << EMMC_DMA_CHANNEL));
+	delay_us(1000);
+
+	write32(base + DMA_CS, DMA_RESET);
+	if (TimeoutWait(base + DMA_CS, DMA_RESET, 0, 10000) < 0)
+	{
+		DEBUG_LOG("DMA channel %d did not reset\r\n", EMMC_DMA_CHANNEL);
+
+		return false;
+	}
+
+#if not defined(EXPERIMENTALZERO)
+	InterruptSystemConnectIRQ(ARM_IRQ_DMA0 + EMMC_DMA_CHANNEL, DMAInterruptHandler, this);
+	m_dma_irq = true;
+#endif
+	m_use_dma = true;
+
+	return true;
+}
+
+void CEMMCDevice::DMAStart(int is_write, void *buf, size_t length)
+{
+	// Write back anything the CPU has dirtied (and drop stale lines) so the
+	// engine sees the buffer and no eviction can land on top of incoming data
+	CleanAndInvalidateDataCacheRange(buf, length);
+
+	u32 ti = DMA_WAIT_RESP | DMA_PERMAP(DMA_PERMAP_EMMC);
+	if (m_dma_irq)
+	{
+		ti |= DMA_INTEN;
+	}
+
+	if (is_write)
+	{
+		m_dma_cb.nTransferInformation = ti | DMA_SRC_INC | DMA_DEST_DREQ;
+		m_dma_cb.nSourceAddress = BUS_MEMORY_ADDRESS(buf);
+		m_dma_cb.nDestinationAddress = BUS_PERIPHERAL_ADDRESS(EMMC_DATA);
+	}
+	else
+	{
+		m_dma_cb.nTransferInformation = ti | DMA_DEST_INC | DMA_SRC_DREQ;
+		m_dma_cb.nSourceAddress = BUS_PERIPHERAL_ADDRESS(EMMC_DATA);
+		m_dma_cb.nDestinationAddress = BUS_MEMORY_ADDRESS(buf);
+	}
+	m_dma_cb.nTransferLength = length;
+	m_dma_cb.n2DModeStride = 0;
+	m_dma_cb.nNextControlBlockAddress = 0;
+	m_dma_cb.nReserved[0] = 0;
+	m_dma_cb.nReserved[1] = 0;
+	CleanAndInvalidateDataCacheRange(&m_dma_cb, sizeof(m_dma_cb));
+
+	m_dma_complete = false;
+
+	u32 base = DMA_CHANNEL_BASE(EMMC_DMA_CHANNEL);
+	write32(base + DMA_CS, DMA_END | DMA_INT);
+	write32(base + DMA_CONBLK_AD, BUS_MEMORY_ADDRESS(&m_dma_cb));
+	write32(base + DMA_CS, DMA_ACTIVE | DMA_WAIT_FOR_OUTSTANDING_WRITES | DMA_PRIORITY(1) | DMA_PANIC_PRIORITY(15));
+}
+
+int CEMMCDevice::DMAWait(unsigned usec)
+{
+	u32 base = DMA_CHANNEL_BASE(EMMC_DMA_CHANNEL);
+	u32 start = read32(ARM_SYSTIMER_CLO);
+	unsigned spin = 0;
+
+	while (true)
+	{
+		if (m_dma_irq)
+		{
+			// The completion IRQ is taken on core 0; just watch the flag here
+			// rather than hammering the peripheral bus. The caller is still held
+			// up for the whole transfer.
+			if (m_dma_complete)
+			{
+				break;
+			}
+		}
+		else
+		{
+			u32 cs = read32(base + DMA_CS);
+			if ((cs & DMA_ACTIVE) == 0)
+			{
+				write32(base + DMA_CS, DMA_END);
+				break;
+			}
+		}
+
+		if ((++spin & 0x3ff) == 0 && (read32(ARM_SYSTIMER_CLO) - start) > usec)
+		{
+			DEBUG_LOG("DMA transfer timed out\r\n");
+			DMAAbort();
+
+			return -1;
+		}
+	}
+
+	if (read32(base + DMA_CS) & DMA_ERROR)
+	{
+		DEBUG_LOG("DMA error (debug %08x)\r\n", read32(base + DMA_DEBUG));
+		DMAAbort();
+
+		return -1;
+	}
+
+	DataMemBarrier();
+
+	return 0;
+}
+
+void CEMMCDevice::DMAAbort(void)
+{
+	u32 base = DMA_CHANNEL_BASE(EMMC_DMA_CHANNEL);
+
+	write32(base + DMA_CS, DMA_RESET);
+	TimeoutWait(base + DMA_CS, DMA_RESET, 0, 10000);
+	m_dma_complete = false;
+}
+
+void CEMMCDevice::DMAInterruptHandler(void *param)
+{
+	CEMMCDevice *pThis = (CEMMCDevice *) param;
+	u32 base = DMA_CHANNEL_BASE(EMMC_DMA_CHANNEL);
+
+	write32(base + DMA_CS, DMA_END | DMA_INT);
+
+	DataMemBarrier();
+	pThis->m_dma_complete = true;
+	DataSyncBarrier();
+}
+
 int CEMMCDevice::Read(void *pBuffer, unsigned nCount)
 {
 	if (m_ullOffset % SD_BLOCK_SIZE != 0)
@@ -586,55 +778,17 @@ u32 CEMMCDevice::GetClockDivider(u32 base_clock, u32 target_rate)
 {
 	// TODO: implement use of preset value registers
 
-	u32 targetted_divisor = 1;
-	if (target_rate <= base_clock)
-	{
-		targetted_divisor = base_clock / target_rate;
-		if (base_clock % target_rate)
-		{
-			targetted_divisor--;
-		}
-	}
-
 	// Decide on the clock mode to use
 	// Currently only 10-bit divided clock mode is supported
 
 	if (m_hci_ver >= 2)
 	{
 		// HCI version 3 or greater supports 10-bit divided clock mode
-		// This requires a power-of-two divider
-
-		// Find the first bit set
-		int divisor = -1;
-		for(int first_bit = 31; first_bit >= 0; first_bit--)
-		{
-			u32 bit_test =(1 << first_bit);
-			if (targetted_divisor & bit_test)
-			{
-				divisor = first_bit;
-				targetted_divisor &= ~bit_test;
-				if (targetted_divisor)
-				{
-					// The divisor is not a power-of-two, increase it
-					divisor++;
-				}
-
-				break;
-			}
-		}
-
-		if (divisor == -1)
-		{
-			divisor = 31;
-		}
-		if (divisor >= 32)
-		{
-			divisor = 31;
-		}
-
-		if (divisor != 0)
+		// SD clock = base clock / (2 * N) for any N up to 0x3ff (N = 0 passes the base clock through)
+		u32 divisor = 0;
+		if (target_rate < base_clock)
 		{
-			divisor =(1 <<(divisor - 1));
+			divisor =(base_clock + 2 * target_rate - 1) /(2 * target_rate);
 		}
 
 		if (divisor >= 0x400)
@@ -701,8 +855,11 @@ int CEMMCDevice::SwitchClockRate(u32 base_clock, u32 target_rate)
 	write32(EMMC_CONTROL1, control1);
 	delay_us(2000);
 
+	u32 n =((divider >> 8) & 0xff) |(((divider >> 6) & 0x3) << 8);
+	m_clock_rate = n ? base_clock /(2 * n) : base_clock;
+
 #ifdef EMMC_DEBUG2
-	DEBUG_LOG("Successfully set clock rate to %d Hz\r\n", target_rate);
+	DEBUG_LOG("Successfully set clock rate to %d Hz(requested %d Hz)\r\n", m_clock_rate, target_rate);
 #endif
 
 	return 0;
@@ -782,6 +939,13 @@ void CEMMCDevice::IssueCommandInt(u32 cmd_reg, u32 argument, int timeout)
 	u32 blksizecnt = m_block_size |(m_blocks_to_transfer << 16);
 	write32(EMMC_BLKSIZECNT, blksizecnt);
 
+	// Arm the DMA engine before the command so it is waiting on the DREQ
+	bool use_dma = m_dma_active && (cmd_reg & SD_CMD_ISDATA);
+	if (use_dma)
+	{
+		DMAStart(!(cmd_reg & SD_CMD_DAT_DIR_CH), m_buf, m_block_size * m_blocks_to_transfer);
+	}
+
 	// Set argument 1 reg
 	write32(EMMC_ARG1, argument);
 
@@ -805,6 +969,10 @@ void CEMMCDevice::IssueCommandInt(u32 cmd_reg, u32 argument, int timeout)
 #endif
 		m_last_error = irpts & 0xffff0000;
 		m_last_interrupt = irpts;
+		if (use_dma)
+		{
+			DMAAbort();
+		}
 
 		return;
 	}
@@ -848,47 +1016,68 @@ void CEMMCDevice::IssueCommandInt(u32 cmd_reg, u32 argument, int timeout)
 			DEBUG_LOG("Multi block transfer\r\n");
 		}
 #endif
-		TimeoutWait(EMMC_INTERRUPT, wr_irpt | 0x8000, 1, timeout);
-		irpts = read32(EMMC_INTERRUPT);
-		write32(EMMC_INTERRUPT, 0xffff0000 | wr_irpt);
+		if (use_dma)
+		{
+			// The DMA engine drains/fills the FIFO itself so the buffer ready
+			// interrupts are only of interest as errors
+			if (DMAWait(timeout) < 0)
+			{
+				m_last_error = read32(EMMC_INTERRUPT) & 0xffff0000;
+				m_last_interrupt = read32(EMMC_INTERRUPT);
 
-		if ((irpts &(0xffff0000 | wr_irpt)) != wr_irpt)
+				return;
+			}
+			write32(EMMC_INTERRUPT, SD_BUFFER_READ_READY | SD_BUFFER_WRITE_READY);
+
+			if (!is_write)
+			{
+				InvalidateDataCacheRange(m_buf, m_block_size * m_blocks_to_transfer);
+			}
+		}
+		else
 		{
+			TimeoutWait(EMMC_INTERRUPT, wr_irpt | 0x8000, 1, timeout);
+			irpts = read32(EMMC_INTERRUPT);
+			write32(EMMC_INTERRUPT, 0xffff0000 | wr_irpt);
+
+			if ((irpts &(0xffff0000 | wr_irpt)) != wr_irpt)
+			{
 #ifdef EMMC_DEBUG
-			DEBUG_LOG("Error occured whilst waiting for data ready interrupt\r\n");
+				DEBUG_LOG("Error occured whilst waiting for data ready interrupt\r\n");
 #endif
-			m_last_error = irpts & 0xffff0000;
-			m_last_interrupt = irpts;
+				m_last_error = irpts & 0xffff0000;
+				m_last_interrupt = irpts;
 
-			return;
-		}
+				return;
+			}
 
-		// Transfer the block
-		assert(m_block_size <= 1024);		// internal FIFO size of EMMC
-		size_t length = m_block_size * m_blocks_to_transfer;
+			// Transfer the block
+			assert(m_block_size <= 1024);		// internal FIFO size of EMMC
+			size_t length = m_block_size * m_blocks_to_transfer;
 
-		assert(((u32) m_buf & 3) == 0);
-		assert((length & 3) == 0);
+			assert(((u32) m_buf & 3) == 0);
+			assert((length & 3) == 0);
 
-		u32 *pData =(u32 *) m_buf;
-		if (is_write)
-		{
-			for(; length > 0; length -= 4)
+			u32 *pData =(u32 *) m_buf;
+			if (is_write)
 			{
-				write32(EMMC_DATA, *pData++);
+				for(; length > 0; length -= 4)
+				{
+					write32(EMMC_DATA, *pData++);
+				}
 			}
-		}
-		else
-		{
-			for(; length > 0; length -= 4)
+			else
 			{
-				*pData++ = read32(EMMC_DATA);
+				for(; length > 0; length -= 4)
+				{
+					*pData++ = read32(EMMC_DATA);
+				}
 			}
-		}
 
 #ifdef EMMC_DEBUG2
-		DEBUG_LOG("Block transfer complete\r\n");
+			DEBUG_LOG("Block transfer complete\r\n");
 #endif
+		}
 	}
 
 	// Wait for transfer complete(set if read/write transfer or with busy)
@@ -1280,6 +1469,9 @@ int CEMMCDevice::CardReset(void)
 	m_blocks_to_transfer = 0;
 	m_block_size = 0;
 	m_card_removal = 0;
+	m_dma_active = false;
+	m_bus_width = 1;
+	m_high_speed = false;
 	m_base_clock = 0;
 	// << Prepare the device structure
 	
@@ -1712,13 +1904,38 @@ int CEMMCDevice::CardReset(void)
 			// Re-enable card interrupt in host
 			write32(EMMC_IRPT_MASK, old_irpt_mask);
 
+			m_bus_width = 4;
+
+			// Not every card that advertises 4-bit support gets there; read the
+			// width back from the SD status and drop to 1-bit if it disagrees
+			if (!VerifyBusWidth())
+			{
+				DEBUG_LOG("4-bit data mode not confirmed, using 1-bit\r\n");
+
+				control0 = read32(EMMC_CONTROL0);
+				control0 &= ~0x2;
+				write32(EMMC_CONTROL0, control0);
+				ResetDat();
+				IssueCommand(SET_BUS_WIDTH, 0);
+				m_bus_width = 1;
+			}
 #ifdef EMMC_DEBUG2
-			DEBUG_LOG("switch to 4-bit complete\r\n");
+			else
+			{
+				DEBUG_LOG("switch to 4-bit complete\r\n");
+			}
 #endif
 		}
 #endif
 	}
 
+	if (SwitchHighSpeed() != 0)
+	{
+		// The card stays at default speed
+		SwitchClockRate(m_base_clock, SD_CLOCK_NORMAL);
+	}
+	DEBUG_LOG("SD clock %d Hz %s, %d-bit bus\r\n", m_clock_rate, m_high_speed ? "(high speed)" : "", m_bus_width);
+
 	DEBUG_LOG("Found a valid version %s SD card\r\n", sd_versions[m_SCR.sd_version]);
 #ifdef EMMC_DEBUG2
 	DEBUG_LOG("setup successful(status %d)\r\n", status);
@@ -1730,6 +1947,109 @@ int CEMMCDevice::CardReset(void)
 	return 0;
 }
 
+int CEMMCDevice::ReadStatusBlock(u32 command, u32 argument, u32 *buf)
+{
+	// 512 bit status blocks (CMD6 and ACMD13) come back over the data lines
+	m_buf = buf;
+	m_block_size = SD_SWITCH_STATUS_SIZE;
+	m_blocks_to_transfer = 1;
+	IssueCommand(command, argument);
+	m_block_size = SD_BLOCK_SIZE;
+
+	return FAIL ? -1 : 0;
+}
+
+bool CEMMCDevice::VerifyBusWidth(void)
+{
+	u32 status[SD_SWITCH_STATUS_SIZE / 4];
+
+	if (ReadStatusBlock(SD_STATUS, 0, status) != 0)
+	{
+		return false;
+	}
+
+	// DAT_BUS_WIDTH is SD status bits 511:510 (big-endian), 10b = 4-bit
+	u8 *bytes =(u8 *) status;
+	return ((bytes[0] >> 6) & 0x3) == 2;
+}
+
+int CEMMCDevice::SwitchHighSpeed(void)
+{
+	// CMD6 arrived with the 1.10 spec
+	if (m_SCR.sd_version < SD_VER_1_1)
+	{
+		return -1;
+	}
+
+	u32 status[SD_SWITCH_STATUS_SIZE / 4];
+	u8 *bytes =(u8 *) status;
+
+	// Ask whether function group 1 supports function 1(high speed) - bit 401
+	if (ReadStatusBlock(SWITCH_FUNC, SD_SWITCH_CHECK, status) != 0)
+	{
+		DEBUG_LOG("CMD6 check failed, staying at default speed\r\n");
+
+		return -1;
+	}
+	if ((bytes[13] & 0x02) == 0)
+	{
+#ifdef EMMC_DEBUG2
+		DEBUG_LOG("card does not support high speed\r\n");
+#endif
+		return -1;
+	}
+
+	// Switch; the result for group 1 comes back in bits 379:376
+	if (ReadStatusBlock(SWITCH_FUNC, SD_SWITCH_SET, status) != 0 ||(bytes[16] & 0xf) != 1)
+	{
+		DEBUG_LOG("CMD6 switch to high speed failed\r\n");
+
+		return -1;
+	}
+
+	// The card has switched within 8 clocks of the status block; now the host
+	u32 control0 = read32(EMMC_CONTROL0);
+	control0 |=(1 << 2);		// high speed enable
+	write32(EMMC_CONTROL0, control0);
+
+	if (SwitchClockRate(m_base_clock, SD_CLOCK_HIGH) != 0)
+	{
+		control0 &= ~(1 << 2);
+		write32(EMMC_CONTROL0, control0);
+
+		return -1;
+	}
+
+	// Make sure the card still talks to us at the new rate
+	if (!IssueCommand(SEND_STATUS, m_card_rca << 16) || ReadStatusBlock(SWITCH_FUNC, SD_SWITCH_CHECK, status) != 0)
+	{
+		DEBUG_LOG("card unstable at %d Hz, falling back\r\n", m_clock_rate);
+
+		control0 = read32(EMMC_CONTROL0);
+		control0 &= ~(1 << 2);
+		write32(EMMC_CONTROL0, control0);
+		ResetCmd();
+		ResetDat();
+		write32(EMMC_INTERRUPT, 0xffffffff);
+
+		return -1;
+	}
+
+	m_high_speed = true;
+
+	return 0;
+}
+
+u32 CEMMCDevice::GetThroughput(void) const
+{
+	u32 us = m_transfer_us;
+	if (us == 0)
+	{
+		return 0;
+	}
+	return (u32)(((u64) m_transfer_bytes * 1000000 / 1024) / us);
+}
+
 int CEMMCDevice::EnsureDataMode(void)
 {
 	if (m_card_rca == 0)
@@ -1826,6 +2146,40 @@ int CEMMCDevice::EnsureDataMode(void)
 }
 
 int CEMMCDevice::DoDataCommand(int is_write, u8 *buf, size_t buf_size, u32 block_no)
+{
+	if (!m_use_dma || IsCacheLineAligned(buf, buf_size))
+	{
+		return DoDataCommandInt(is_write, buf, buf_size, block_no);
+	}
+
+	// Cache maintenance works on whole lines so a buffer sharing a line with
+	// other data is staged through the aligned bounce buffer instead
+	while (buf_size > 0)
+	{
+		size_t length = buf_size < EMMC_DMA_BOUNCE_SIZE ? buf_size : EMMC_DMA_BOUNCE_SIZE;
+
+		if (is_write)
+		{
+			memcpy(s_dma_bounce, buf, length);
+		}
+		if (DoDataCommandInt(is_write, s_dma_bounce, length, block_no) < 0)
+		{
+			return -1;
+		}
+		if (!is_write)
+		{
+			memcpy(buf, s_dma_bounce, length);
+		}
+
+		buf += length;
+		buf_size -= length;
+		block_no += length / SD_BLOCK_SIZE;
+	}
+
+	return 0;
+}
+
+int CEMMCDevice::DoDataCommandInt(int is_write, u8 *buf, size_t buf_size, u32 block_no)
 {
 	// PLSS table 4.20 - SDSC cards use byte addresses rather than block addresses
 	if (!m_card_supports_sdhc)
@@ -1875,6 +2229,8 @@ int CEMMCDevice::DoDataCommand(int is_write, u8 *buf, size_t buf_size, u32 block
 		}
 	}
 
+	m_dma_active = m_use_dma;
+
 	int retry_count = 0;
 	int max_retries = 3;
 	while(retry_count < max_retries)
@@ -1899,6 +2255,8 @@ int CEMMCDevice::DoDataCommand(int is_write, u8 *buf, size_t buf_size, u32 block
 		}
 	}
 
+	m_dma_active = false;
+
 	if (retry_count == max_retries)
 	{
 		m_card_rca = 0;
@@ -1913,6 +2271,8 @@ int CEMMCDevice::DoRead(u8 *buf, size_t buf_size, u32 block_no)
 {
 //	g_pLogger->Write("\r\n", LogNotice, "DoRead %d\r\n", block_no);
 
+	u32 start = read32(ARM_SYSTIMER_CLO);
+
 	// Check the status of the card
 	if (EnsureDataMode() != 0)
 	{
@@ -1928,6 +2288,9 @@ int CEMMCDevice::DoRead(u8 *buf, size_t buf_size, u32 block_no)
 		return -1;
 	}
 
+	m_transfer_us += read32(ARM_SYSTIMER_CLO) - start;
+	m_transfer_bytes += buf_size;
+
 	//int y = 0;
 	//int index = 0;
 	//for(y = 0; y <(512 / 8); ++y)
@@ -1955,6 +2318,8 @@ int CEMMCDevice::DoRead(u8 *buf, size_t buf_size, u32 block_no)
 
 int CEMMCDevice::DoWrite(u8 *buf, size_t buf_size, u32 block_no)
 {
+	u32 start = read32(ARM_SYSTIMER_CLO);
+
 	// Check the status of the card
 	if (EnsureDataMode() != 0)
 	{
@@ -1970,6 +2335,9 @@ int CEMMCDevice::DoWrite(u8 *buf, size_t buf_size, u32 block_no)
 		return -1;
 	}
 
+	m_transfer_us += read32(ARM_SYSTIMER_CLO) - start;
+	m_transfer_bytes += buf_size;
+
 #ifdef EMMC_DEBUG2
 	DEBUG_LOG("Data write successful\r\n");
 #endif
@@ -1979,20 +2347,18 @@ int CEMMCDevice::DoWrite(u8 *buf, size_t buf_size, u32 block_no)
 
 int CEMMCDevice::TimeoutWait(unsigned reg, unsigned mask, int value, unsigned usec)
 {
-	unsigned nCount = usec / 1000;
+	// Poll continuously; sleeping a millisecond between checks cost every
+	// command up to 1ms which swamped the time spent actually moving data
+	u32 start = read32(ARM_SYSTIMER_CLO);
 
 	do
 	{
-		delay_us(1);
-
 		if ((read32(reg) & mask) ? value : !value)
 		{
 			return 0;
 		}
-
-		delay_us(999);
 	}
-	while(nCount--);
+	while((read32(ARM_SYSTIMER_CLO) - start) <= usec);
 
 	return -1;
 }
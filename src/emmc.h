@@ -14,6 +14,17 @@ struct TSCR			// SD configuration register
 	int	sd_version;
 };
 
+struct TDMAControlBlock
+{
+	u32	nTransferInformation;
+	u32	nSourceAddress;
+	u32	nDestinationAddress;
+	u32	nTransferLength;
+	u32	n2DModeStride;
+	u32	nNextControlBlockAddress;
+	u32	nReserved[2];
+} __attribute__ ((aligned (32)));
+
 class CEMMCDevice
 {
 public:
@@ -22,6 +33,19 @@ public:
 
 	bool Initialize(void);
 
+	// Move data through the DMA controller rather than the data port. Transfers are quicker, not
+	// asynchronous;- the caller still waits for each one in DMAWait.
+	// Call once the interrupt system is running so completion can be signalled by IRQ.
+	bool EnableDMA(void);
+	bool IsDMAEnabled(void) const { return m_use_dma; }
+
+	u32 GetClockRate(void) const { return m_clock_rate; }
+	u32 GetBusWidth(void) const { return m_bus_width; }
+	bool IsHighSpeed(void) const { return m_high_speed; }
+	// Average KB/s over all data transferred so far
+	u32 GetThroughput(void) const;
+	u32 GetTransferredBytes(void) const { return m_transfer_bytes; }
+
 	int Read(void *pBuffer, unsigned nCount);
 	int Write(const void *pBuffer, unsigned nCount);
 
@@ -50,8 +74,18 @@ private:
 	int CardReset(void);
 	int CardInit(void);
 
+	int ReadStatusBlock(u32 command, u32 argument, u32 *buf);
+	bool VerifyBusWidth(void);
+	int SwitchHighSpeed(void);
+
 	int EnsureDataMode(void);
 	int DoDataCommand(int is_write, u8 *buf, size_t buf_size, u32 block_no);
+	int DoDataCommandInt(int is_write, u8 *buf, size_t buf_size, u32 block_no);
+
+	void DMAStart(int is_write, void *buf, size_t length);
+	int DMAWait(unsigned usec);
+	void DMAAbort(void);
+	static void DMAInterruptHandler(void *param);
 
 	int TimeoutWait(unsigned reg, unsigned mask, int value, unsigned usec);
 
@@ -90,6 +124,18 @@ private:
 	int m_card_removal;
 	u32 m_base_clock;
 
+	bool m_use_dma;
+	bool m_dma_irq;
+	bool m_dma_active;
+	volatile bool m_dma_complete;
+	TDMAControlBlock m_dma_cb;
+
+	u32 m_clock_rate;
+	u32 m_bus_width;
+	bool m_high_speed;
+	volatile u32 m_transfer_bytes;
+	volatile u32 m_transfer_us;
+
 	static const char *sd_versions[];
 	static const char *err_irpts[];
 	static const u32 sd_commands[];
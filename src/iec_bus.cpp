@@ -18,6 +18,7 @@
 
 #include "iec_bus.h"
 #include "InputMappings.h"
+#include "IECRecorder.h"
 
 //#define REAL_XOR 1
 
@@ -35,6 +36,8 @@ bool IEC_Bus::PI_Atn = false;
 bool IEC_Bus::PI_Data = false;
 bool IEC_Bus::PI_Clock = false;
 bool IEC_Bus::PI_SRQ = false;
+bool IEC_Bus::FastSerialClocked = false;
+bool IEC_Bus::FastSerialSRQDriven = false;
 bool IEC_Bus::PI_Reset = false;
 
 bool IEC_Bus::VIA_Atna = false;
@@ -49,6 +52,7 @@ bool IEC_Bus::SRQSetToOut = false;
 m6522* IEC_Bus::VIA = 0;
 m8520* IEC_Bus::CIA = 0;
 IOPort* IEC_Bus::port = 0;
+IECRecorder* IEC_Bus::recorder = 0;
 
 bool IEC_Bus::OutputLED = false;
 bool IEC_Bus::OutputSound = false;
@@ -73,6 +77,10 @@ u32 IEC_Bus::inputRepeatPrev[5] = { 0 };
 u32 IEC_Bus::emulationModeCheckButtonIndex = 0;
 
 unsigned IEC_Bus::gplev0;
+unsigned IEC_Bus::activityLines = 0;
+volatile u32 IEC_Bus::AtnChanges = 0;
+volatile u32 IEC_Bus::ClockChanges = 0;
+volatile u32 IEC_Bus::DataChanges = 0;
 
 //ROTARY: Added for rotary encoder support - 09/05/2019 by Geo...
 RotaryEncoder IEC_Bus::rotaryEncoder;
@@ -142,6 +150,7 @@ void IEC_Bus::ReadGPIOUserInput()
 void IEC_Bus::ReadBrowseMode(void)
 {
 	gplev0 = read32(ARM_GPIO_GPLEV0);
+	CountActivity();
 	ReadGPIOUserInput();
 
 	bool ATNIn = (gplev0 & PIGPIO_MASK_IN_ATN) == (invertIECInputs ? PIGPIO_MASK_IN_ATN : 0);
@@ -176,6 +185,18 @@ void IEC_Bus::ReadBrowseMode(void)
 		PI_Clock = true;
 	}
 
+	// SRQ has its own input pin on split line hardware so we can watch the C128 clocking it even while we drive it.
+	if (splitIECLines)
+	{
+		bool SRQIn = (gplev0 & PIGPIO_MASK_IN_SRQ) == (invertIECInputs ? PIGPIO_MASK_IN_SRQ : 0);
+		if (PI_SRQ != SRQIn)
+		{
+			PI_SRQ = SRQIn;
+			if (!FastSerialSRQDriven)
+				FastSerialClocked = true;
+		}
+	}
+
 	Resetting = !ignoreReset && ((gplev0 & PIGPIO_MASK_IN_RESET) == (invertIECInputs ? PIGPIO_MASK_IN_RESET : 0));
 }
 
@@ -184,6 +205,9 @@ void IEC_Bus::ReadEmulationMode1541(void)
 	bool AtnaDataSetToOutOld = AtnaDataSetToOut;
 	IOPort* portB = 0;
 	gplev0 = read32(ARM_GPIO_GPLEV0);
+	CountActivity();
+	if (recorder)
+		recorder->Input(GetInputLines(gplev0));
 
 	portB = port;
 
@@ -279,6 +303,7 @@ void IEC_Bus::ReadEmulationMode1581(void)
 {
 	IOPort* portB = 0;
 	gplev0 = read32(ARM_GPIO_GPLEV0);
+	CountActivity();
 
 	portB = port;
 
@@ -357,6 +382,9 @@ void IEC_Bus::RefreshOuts1541(void)
 	unsigned clear = 0;
 	unsigned tmp;
 
+	if (recorder)
+		recorder->Output(GetOutputLines());
+
 	if (!splitIECLines)
 	{
 		unsigned outputs = 0;
@@ -393,6 +421,40 @@ void IEC_Bus::RefreshOuts1541(void)
 	write32(ARM_GPIO_GPSET0, set);
 }
 
+u8 IEC_Bus::GetInputLines(unsigned gplev0)
+{
+	u8 lines = 0;
+
+	if (gplev0 & PIGPIO_MASK_IN_ATN) lines |= IECRecorder::LINE_ATN;
+	if (gplev0 & PIGPIO_MASK_IN_DATA) lines |= IECRecorder::LINE_DATA;
+	if (gplev0 & PIGPIO_MASK_IN_CLOCK) lines |= IECRecorder::LINE_CLOCK;
+	if (gplev0 & PIGPIO_MASK_IN_SRQ) lines |= IECRecorder::LINE_SRQ;
+	if (gplev0 & PIGPIO_MASK_IN_RESET) lines |= IECRecorder::LINE_RESET;
+	return lines;
+}
+
+unsigned IEC_Bus::GetGPLEV0ForInputLines(u8 lines)
+{
+	unsigned gplev0 = 0;
+
+	if (lines & IECRecorder::LINE_ATN) gplev0 |= PIGPIO_MASK_IN_ATN;
+	if (lines & IECRecorder::LINE_DATA) gplev0 |= PIGPIO_MASK_IN_DATA;
+	if (lines & IECRecorder::LINE_CLOCK) gplev0 |= PIGPIO_MASK_IN_CLOCK;
+	if (lines & IECRecorder::LINE_SRQ) gplev0 |= PIGPIO_MASK_IN_SRQ;
+	if (lines & IECRecorder::LINE_RESET) gplev0 |= PIGPIO_MASK_IN_RESET;
+	return gplev0;
+}
+
+u8 IEC_Bus::GetOutputLines()
+{
+	u8 lines = 0;
+
+	if (AtnaDataSetToOut || DataSetToOut) lines |= IECRecorder::LINE_DATA;
+	if (ClockSetToOut) lines |= IECRecorder::LINE_CLOCK;
+	if (SRQSetToOut) lines |= IECRecorder::LINE_SRQ;
+	return lines;
+}
+
 void IEC_Bus::PortB_OnPortOut(void* pUserData, unsigned char status)
 {
 	bool oldDataSetToOut = DataSetToOut;
@@ -291,6 +291,8 @@ enum VIAPortPins
 
 typedef bool(*CheckStatus)();
 
+class IECRecorder;
+
 class IEC_Bus
 {
 public:
@@ -610,6 +612,17 @@ public:
 		}
 	}
 
+	// Drive both lines in one GPIO update (fast loaders place a bit on each line at the same instant).
+	static inline void SetClockAndData(bool clock, bool data)
+	{
+		if (ClockSetToOut != clock || DataSetToOut != data)
+		{
+			ClockSetToOut = clock;
+			DataSetToOut = data;
+			RefreshOuts1541();
+		}
+	}
+
 	static inline bool GetPI_SRQ() { return PI_SRQ; }
 	static inline bool GetPI_Atn() { return PI_Atn; }
 	static inline bool IsAtnAsserted() { return PI_Atn; }
@@ -626,6 +639,14 @@ public:
 	static inline bool IsClockSetToOut() { return ClockSetToOut; }
 	static inline bool IsReset() { return Resetting; }
 
+	// C128 fast serial in browse mode. SRQ is the shift clock and DATA carries the bits.
+	// Only split line hardware has an output for SRQ.
+	static inline bool IsFastSerialAvailable() { return splitIECLines; }
+	static inline bool IsFastSerialClocked() { return FastSerialClocked; }
+	static inline void ClearFastSerialClocked() { FastSerialClocked = false; }
+	// While we clock SRQ ourselves our own edges must not be taken for a fast host.
+	static inline void SetFastSerialSRQDriven(bool value) { FastSerialSRQDriven = value; }
+
 	static inline void WaitWhileAtnAsserted()
 	{
 		while (IsAtnAsserted())
@@ -692,6 +713,13 @@ public:
 	static m8520* CIA;
 	static IOPort* port;
 
+	// When set the 1541 emulation logs its bus inputs and outputs to it.
+	static IECRecorder* recorder;
+	// The lines as IECRecorder records them. The inputs are the raw pin levels so a replay can apply the same options.
+	static u8 GetInputLines(unsigned gplev0);
+	static unsigned GetGPLEV0ForInputLines(u8 lines);
+	static u8 GetOutputLines();
+
 	static void Reset(void);
 
 	static bool GetInputButtonPressed(int buttonIndex) { return InputButton[buttonIndex] && !InputButtonPrev[buttonIndex]; }
@@ -703,7 +731,26 @@ public:
 	static bool OutputLED;
 	static bool OutputSound;
 
+	// Edges seen on each line since power on, for telemetry (Pi 3 only)
+	static inline u32 GetAtnChanges() { return AtnChanges; }
+	static inline u32 GetClockChanges() { return ClockChanges; }
+	static inline u32 GetDataChanges() { return DataChanges; }
+
 private:
+	static inline void CountActivity()
+	{
+#if not defined(EXPERIMENTALZERO)
+		u32 changed = (gplev0 ^ activityLines) & (PIGPIO_MASK_IN_ATN | PIGPIO_MASK_IN_CLOCK | PIGPIO_MASK_IN_DATA);
+		if (changed)
+		{
+			activityLines = gplev0;
+			AtnChanges += (changed & PIGPIO_MASK_IN_ATN) != 0;
+			ClockChanges += (changed & PIGPIO_MASK_IN_CLOCK) != 0;
+			DataChanges += (changed & PIGPIO_MASK_IN_DATA) != 0;
+		}
+#endif
+	}
+
 	static u32 oldClears;
 	static u32 oldSets;
 
@@ -721,11 +768,17 @@ private:
 	static u32 emulationModeCheckButtonIndex;
 
 	static unsigned gplev0;
+	static unsigned activityLines;
+	static volatile u32 AtnChanges;
+	static volatile u32 ClockChanges;
+	static volatile u32 DataChanges;
 
 	static bool PI_Atn;
 	static bool PI_Data;
 	static bool PI_Clock;
 	static bool PI_SRQ;
+	static bool FastSerialClocked;
+	static bool FastSerialSRQDriven;
 	static bool PI_Reset;
 
 	static bool VIA_Atna;
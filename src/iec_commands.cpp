@@ -45,6 +45,21 @@
 #define EOI_RECVD       (1<<0)
 #define COMMAND_RECVD   (1<<1)
 
+// Each half of a fast serial bit. The C128's CIA latches on the rising edge of SRQ.
+#define FAST_SERIAL_HALF_BIT_US 3
+
+// Only a few channels move data at once (a real 1541 has buffers for three files plus the command channel)
+// so data channels borrow a buffer from this pool while they are open. Aligned so SD card DMA can land in it directly.
+#define CHANNEL_BUFFER_POOL_COUNT 4
+static u8 ChannelBufferPool[CHANNEL_BUFFER_POOL_COUNT][CHANNEL_BUFFER_SIZE] __attribute__((aligned(64)));
+static u32 ChannelBufferPoolUsed = 0;
+
+// Status bytes preceding each block of a burst fastload (1571 User's Guide, Burst Command Instruction Set)
+#define BURST_STATUS_OK 0x00
+#define BURST_STATUS_FILE_NOT_FOUND 0x02
+#define BURST_STATUS_READ_ERROR 0x05
+#define BURST_STATUS_EOI 0x1f
+
 extern unsigned versionMajor;
 extern unsigned versionMinor;
 
@@ -121,7 +136,7 @@ static void SetHeaderVersion()
 //20,READ ERROR,TT,SS		header not found
 //21,READ ERROR,TT,SS		sync not found
 //22,READ ERROR,TT,SS		header checksum fail
-//23,READ ERROR,TT,SS		data block checksum fail
+#define ERROR_23_READ_ERROR 23	//23,READ ERROR,TT,SS		data block checksum fail
 //24,READ ERROR,TT,SS
 #define ERROR_25_WRITE_ERROR 25	//25,WRITE ERROR,TT,SS		verify error
 //26,WRITE PROTECT ON,TT,SS
@@ -144,7 +159,7 @@ static void SetHeaderVersion()
 //65,NO BLOCK,TT,SS
 //66,ILLEGAL TRACK OR SECTOR,TT,SS	
 //67,ILLEGAL TRACK OR SECTOR,TT,SS
-//70,NO CHANNEL,00,00		An attempt was made to open more files than channels available
+#define ERROR_70_NO_CHANNEL 70		//70,NO CHANNEL,00,00		An attempt was made to open more files than channels available
 //71,DIR ERROR,TT,SS
 //72,DISK FULL,00,00
 #define ERROR_73_DOSVERSION 73		// 73,VERSION,00,00
@@ -159,6 +174,9 @@ void Error(u8 errorCode, u8 track = 0, u8 sector = 0)
 		case ERROR_00_OK:
 			msg = " OK";
 		break;
+		case ERROR_23_READ_ERROR:
+			msg = "READ ERROR";
+		break;
 		case ERROR_25_WRITE_ERROR:
 			msg = "WRITE ERROR";
 		break;
@@ -183,6 +201,9 @@ void Error(u8 errorCode, u8 track = 0, u8 sector = 0)
 		case ERROR_63_FILE_EXISTS:
 			msg = "FILE EXISTS";
 		break;
+		case ERROR_70_NO_CHANNEL:
+			msg = "NO CHANNEL";
+		break;
 		default:
 			DEBUG_LOG("EC=%d?\r\n", errorCode);
 		break;
@@ -211,13 +232,45 @@ void IEC_Commands::Channel::Close()
 	}
 	cursor = 0;
 	bytesSent = 0;
+
+	if (buffer >= ChannelBufferPool[0] && buffer < ChannelBufferPool[CHANNEL_BUFFER_POOL_COUNT])
+	{
+		ChannelBufferPoolUsed &= ~(1 << ((buffer - ChannelBufferPool[0]) / CHANNEL_BUFFER_SIZE));
+		buffer = 0;
+	}
+}
+
+bool IEC_Commands::Channel::AcquireBuffer()
+{
+	if (buffer)
+		return true;
+
+	for (int i = 0; i < CHANNEL_BUFFER_POOL_COUNT; ++i)
+	{
+		if ((ChannelBufferPoolUsed & (1 << i)) == 0)
+		{
+			ChannelBufferPoolUsed |= 1 << i;
+			buffer = ChannelBufferPool[i];
+			return true;
+		}
+	}
+	Error(ERROR_70_NO_CHANNEL);
+	return false;
 }
 
 IEC_Commands::IEC_Commands()
 {
+	for (int i = 0; i < 16; ++i)
+	{
+		channels[i].buffer = 0;
+		channels[i].open = false;
+	}
+	channels[15].buffer = commandBuffer;
+
 	deviceID = 8;
 	usingVIC20 = false;
 	autoBootFB128 = false;
+	jiffyDOSEnabled = true;
 	Reset();
 	starFileName = 0;
 	C128BootSectorName = 0;
@@ -230,6 +283,10 @@ void IEC_Commands::Reset(void)
 {
 	receivedCommand = false;
 	receivedEOI = false;
+	jiffyDOSActive = false;
+	jiffyDOSLoad = false;
+	fastSerialHost = false;
+	burstClock = false;
 	secondaryAddress = 0;
 	selectedImageName[0] = 0;
 	atnSequence = ATN_SEQUENCE_IDLE;
@@ -304,6 +361,9 @@ bool IEC_Commands::CheckATN(void)
 
 bool IEC_Commands::WriteIECSerialPort(u8 data, bool eoi)
 {
+	if (jiffyDOSActive)
+		return WriteJiffyDOS(data, eoi, !jiffyDOSLoad || eoi);
+
 	IEC_Bus::WaitMicroSeconds(50); //sidplay64-sd2iec needs this?
 
 	// When the talker is ready it releases the Clock line.
@@ -318,6 +378,15 @@ bool IEC_Commands::WriteIECSerialPort(u8 data, bool eoi)
 		WaitWhile(IEC_Bus::IsDataAsserted());
 	}
 
+	if (fastSerialHost)
+	{
+		// The ready and EOI handshakes are unchanged. Only the eight bits go out over SRQ/DATA, and the listener acknowledges as usual.
+		IEC_Bus::AssertClock();
+		WriteFastSerialByte(data);
+		WaitWhile(IEC_Bus::IsDataReleased());
+		return false;
+	}
+
 	IEC_Bus::AssertClock();
 	IEC_Bus::WaitMicroSeconds(40);
 	WaitWhile(IEC_Bus::IsDataAsserted());
@@ -348,6 +417,10 @@ bool IEC_Commands::ReadIECSerialPort(u8& byte)
 {
 	byte = 0;
 
+	// Bytes under ATN always use the standard protocol.
+	if (jiffyDOSActive && atnSequence != ATN_SEQUENCE_RECEIVE_COMMAND_CODE)
+		return ReadJiffyDOS(byte);
+
 	// When the talker is ready it releases the Clock line.
 	WaitWhile(IEC_Bus::IsClockAsserted());
 
@@ -360,6 +433,9 @@ bool IEC_Commands::ReadIECSerialPort(u8& byte)
 	{
 		IEC_Bus::ReadBrowseMode();
 		if (CheckATN()) return true;
+		// A fast host may send the byte over SRQ/DATA instead of starting the slow bits (SRQ low is the first bit's set up).
+		if (fastSerialHost && !IEC_Bus::GetPI_SRQ())
+			return ReadFastSerialByte(byte);
 	}
 	while (IEC_Bus::IsClockReleased() && !timer.Tick());
 
@@ -374,6 +450,27 @@ bool IEC_Commands::ReadIECSerialPort(u8& byte)
 
 	for (u8 i = 0; i < 8; ++i)
 	{
+		if (i == 7 && jiffyDOSEnabled && atnSequence == ATN_SEQUENCE_RECEIVE_COMMAND_CODE)
+		{
+			// A JiffyDOS computer holds back the last bit of a LISTEN/TALK byte for ~400us.
+			// If the addressed drive pulses Data during that gap, the data phase that follows uses JiffyDOS.
+			timer.Start(218);
+			do
+			{
+				IEC_Bus::ReadBrowseMode();
+				if (CheckATN()) return true;
+			}
+			while (IEC_Bus::IsClockAsserted() && !timer.Tick());
+
+			u8 command = byte >> 1;
+			if (timer.TimedOut() && (command & 0x1f) == deviceID && ((command & 0x60) == 0x20 || (command & 0x60) == 0x40))
+			{
+				IEC_Bus::AssertData();
+				IEC_Bus::WaitMicroSeconds(101);
+				IEC_Bus::ReleaseData();
+				jiffyDOSActive = true;
+			}
+		}
 		WaitWhile(IEC_Bus::IsClockAsserted());
 		byte = (byte >> 1) | (!!IEC_Bus::IsDataReleased() << 7);
 		WaitWhile(IEC_Bus::IsClockReleased());
@@ -383,6 +480,148 @@ bool IEC_Commands::ReadIECSerialPort(u8& byte)
 	return false;
 }
 
+// C128 fast serial
+// The C128 and the 1571/1581 connect their CIA serial ports over SRQ (CNT) and DATA (SP).
+// Bytes go MSB first. A bit is set up while SRQ is low and latched when SRQ rises.
+// We use the same line mapping as Pi1581::Update.
+void IEC_Commands::WriteFastSerialByte(u8 data)
+{
+	IEC_Bus::SetFastSerialSRQDriven(true);
+	for (int i = 7; i >= 0; --i)
+	{
+		IEC_Bus::SetFastSerialSRQ(false);
+		IEC_Bus::SetFastSerialData(!(data & (1 << i)));
+		IEC_Bus::RefreshOuts1581();
+		IEC_Bus::WaitMicroSeconds(FAST_SERIAL_HALF_BIT_US);
+		IEC_Bus::SetFastSerialSRQ(true);
+		IEC_Bus::RefreshOuts1581();
+		IEC_Bus::WaitMicroSeconds(FAST_SERIAL_HALF_BIT_US);
+	}
+	IEC_Bus::SetFastSerialData(false);
+	IEC_Bus::LetSRQBePulledHigh();
+	// Let the released line settle and sample it before edges count again.
+	IEC_Bus::WaitMicroSeconds(FAST_SERIAL_HALF_BIT_US);
+	IEC_Bus::ReadBrowseMode();
+	IEC_Bus::SetFastSerialSRQDriven(false);
+}
+
+bool IEC_Commands::ReadFastSerialByte(u8& byte)
+{
+	byte = 0;
+	for (u8 i = 0; i < 8; ++i)
+	{
+		WaitWhile(IEC_Bus::GetPI_SRQ());
+		WaitWhile(!IEC_Bus::GetPI_SRQ());
+		byte = (byte << 1) | !IEC_Bus::GetPI_Data();
+	}
+	IEC_Bus::AssertData();
+	return false;
+}
+
+// Burst handshake;- the host toggles Clock each time it wants the next byte.
+// Returns true if ATN or a reset ends the transfer instead.
+bool IEC_Commands::WriteBurstByte(u8 data)
+{
+	do
+	{
+		IEC_Bus::ReadBrowseMode();
+		if (CheckATN() || IEC_Bus::IsReset())
+			return true;
+	}
+	while (IEC_Bus::IsClockAsserted() == burstClock);
+	burstClock = !burstClock;
+	WriteFastSerialByte(data);
+	return false;
+}
+
+static inline void WaitUntilMicroSeconds(u32 start, u32 amount)
+{
+	while ((read32(ARM_SYSTIMER_CLO) - start) < amount);
+}
+
+// JiffyDOS moves two bits at a time, one on Clock and one on Data, at fixed offsets from a single handshake edge.
+// The computer picks the moment of that edge (away from VIC-II bad lines) so neither side needs a per bit handshake.
+// Line levels follow sd2iec;- the drive sends a 1 bit as a released line but receives a 1 bit as an asserted line.
+
+// Talker (drive -> computer)
+// The drive releases both lines and waits for the computer to release Data (byte mode) or assert it (LOAD mode).
+// Bit pairs (Clock, Data) are then placed at 10us (0,1), 20us (2,3), 31us (4,5) and 41us (6,7).
+// At 52us the drive signals EOI with Clock released and Data asserted, or more to come with the opposite,
+// and the computer acknowledges the latter by asserting Data.
+// In LOAD mode this status is only sent for the final byte of the file.
+bool IEC_Commands::WriteJiffyDOS(u8 data, bool eoi, bool sendStatus)
+{
+	IEC_Bus::SetClockAndData(false, false);
+	IEC_Bus::WaitMicroSeconds(3);
+
+	if (jiffyDOSLoad)
+	{
+		WaitWhile(IEC_Bus::IsDataAsserted());
+		WaitWhile(IEC_Bus::IsDataReleased());
+	}
+	else
+	{
+		WaitWhile(IEC_Bus::IsDataAsserted());
+	}
+
+	u32 start = read32(ARM_SYSTIMER_CLO);
+
+	WaitUntilMicroSeconds(start, 10);
+	IEC_Bus::SetClockAndData(!(data & 0x01), !(data & 0x02));
+	WaitUntilMicroSeconds(start, 20);
+	IEC_Bus::SetClockAndData(!(data & 0x04), !(data & 0x08));
+	WaitUntilMicroSeconds(start, 31);
+	IEC_Bus::SetClockAndData(!(data & 0x10), !(data & 0x20));
+	WaitUntilMicroSeconds(start, 41);
+	IEC_Bus::SetClockAndData(!(data & 0x40), !(data & 0x80));
+
+	if (sendStatus)
+	{
+		WaitUntilMicroSeconds(start, 52);
+		IEC_Bus::SetClockAndData(!eoi, eoi);
+		IEC_Bus::WaitMicroSeconds(3);
+		if (!eoi)
+			WaitWhile(IEC_Bus::IsDataReleased());
+	}
+
+	IEC_Bus::WaitMicroSeconds(10);
+	return false;
+}
+
+// Listener (computer -> drive)
+// The drive releases both lines and the computer releases Clock when it starts the byte.
+// Bit pairs (Clock, Data) are sampled at 17us (4,5), 30us (6,7), 41us (3,1) and 54us (2,0).
+// At 67us Clock asserted means this was the last byte (EOI). The drive then asserts Data until it is ready again.
+bool IEC_Commands::ReadJiffyDOS(u8& byte)
+{
+	static const u8 clockBits[4] = { 4, 6, 3, 2 };
+	static const u8 dataBits[4] = { 5, 7, 1, 0 };
+	static const u8 sampleTimes[4] = { 17, 30, 41, 54 };
+
+	byte = 0;
+	IEC_Bus::SetClockAndData(false, false);
+	WaitWhile(IEC_Bus::IsClockAsserted());
+
+	u32 start = read32(ARM_SYSTIMER_CLO);
+
+	for (int pair = 0; pair < 4; ++pair)
+	{
+		WaitUntilMicroSeconds(start, sampleTimes[pair]);
+		IEC_Bus::ReadBrowseMode();
+		if (IEC_Bus::IsClockAsserted()) byte |= 1 << clockBits[pair];
+		if (IEC_Bus::IsDataAsserted()) byte |= 1 << dataBits[pair];
+	}
+
+	WaitUntilMicroSeconds(start, 67);
+	IEC_Bus::ReadBrowseMode();
+	if (IEC_Bus::IsClockAsserted())
+		receivedEOI = true;
+
+	IEC_Bus::AssertData();
+	IEC_Bus::WaitMicroSeconds(10);
+	return false;
+}
+
 void IEC_Commands::SimulateIECBegin(void)
 {
 	SetHeaderVersion();
@@ -451,6 +690,8 @@ IEC_Commands::UpdateAction IEC_Commands::SimulateIECUpdate(void)
 			deviceRole = DEVICE_ROLE_PASSIVE;
 			atnSequence = ATN_SEQUENCE_RECEIVE_COMMAND_CODE;
 			receivedEOI = false;
+			jiffyDOSActive = false;
+			jiffyDOSLoad = false;
 
 			// Wait until the computer is ready to talk
 			// TODO: should set a timer here and if it times out (before the clock is released) go back to IDLE?
@@ -505,6 +746,7 @@ IEC_Commands::UpdateAction IEC_Commands::SimulateIECUpdate(void)
 			{
 				secondaryAddress = commandCode & 0x0f;
 				deviceRole = DEVICE_ROLE_LISTEN;
+				fastSerialHost = IEC_Bus::IsFastSerialAvailable() && IEC_Bus::IsFastSerialClocked();
 				if (IEC_Bus::IsAtnAsserted()) atnSequence = ATN_SEQUENCE_RECEIVE_COMMAND_CODE;
 				else atnSequence = ATN_SEQUENCE_HANDLE_COMMAND_CODE;
 			}
@@ -517,6 +759,7 @@ IEC_Commands::UpdateAction IEC_Commands::SimulateIECUpdate(void)
 			{
 				secondaryAddress = commandCode & 0x0f;
 				deviceRole = DEVICE_ROLE_TALK;
+				fastSerialHost = IEC_Bus::IsFastSerialAvailable() && IEC_Bus::IsFastSerialClocked();
 				if (IEC_Bus::IsAtnAsserted()) atnSequence = ATN_SEQUENCE_RECEIVE_COMMAND_CODE;
 				else atnSequence = ATN_SEQUENCE_HANDLE_COMMAND_CODE;
 			}
@@ -528,6 +771,12 @@ IEC_Commands::UpdateAction IEC_Commands::SimulateIECUpdate(void)
 			else if ((commandCode & 0x60) == 0x60)	// Set secondary addresses for 6*, e* and f* commands
 			{
 				secondaryAddress = commandCode & 0x0f;
+				if (jiffyDOSActive && deviceRole == DEVICE_ROLE_TALK && commandCode == 0x61)
+				{
+					// JiffyDOS LOAD talks on secondary 1 to select its block mode but reads the file opened on channel 0.
+					jiffyDOSLoad = true;
+					secondaryAddress = 0;
+				}
 				if ((commandCode & 0xf0) == 0xe0)	// Close
 				{
 					CloseFile(secondaryAddress);
@@ -590,6 +839,8 @@ IEC_Commands::UpdateAction IEC_Commands::SimulateIECUpdate(void)
 				// Command has been processed so reset it now.
 				receivedCommand = false;
 			}
+			// A C128 announces itself again by clocking SRQ when it next asserts ATN.
+			IEC_Bus::ClearFastSerialClocked();
 			atnSequence = ATN_SEQUENCE_IDLE;
 		break;
 	}
@@ -1291,6 +1542,11 @@ void IEC_Commands::User(void)
 				updateAction = DEVICEID_CHANGED;
 				DEBUG_LOG("Changed deviceID to %d\r\n", channel.buffer[3]);
 			}
+			else if ((channel.buffer[2] & 0x1f) == 0x1f && fastSerialHost)
+			{
+				//OPEN1,8,15,"U0"+CHR$(31)+"FILENAME"
+				BurstFastload();
+			}
 			else
 			{
 				Error(ERROR_31_SYNTAX_ERROR);
@@ -1302,6 +1558,84 @@ void IEC_Commands::User(void)
 	}
 }
 
+// Burst fastload. Each block of the file goes out as a status byte and 254 data bytes.
+// The last block's status is BURST_STATUS_EOI, followed by a count of the bytes that remain.
+// The file type bit (bit 7 of the command byte) is ignored because every file on the SD card is loadable.
+void IEC_Commands::BurstFastload(void)
+{
+	Channel& channelCommand = channels[15];
+	char filename[256];
+	DIR dir;
+	FILINFO filInfo;
+	FIL file;
+	u32 index;
+	bool found = false;
+
+	for (index = 3; index < channelCommand.cursor && channelCommand.buffer[index] != 0 && index - 3 < sizeof(filename) - 1; ++index)
+	{
+		filename[index - 3] = petscii2ascii(channelCommand.buffer[index]);
+	}
+	filename[index - 3] = 0;
+
+	IEC_Bus::ReadBrowseMode();
+	burstClock = IEC_Bus::IsClockAsserted();
+
+	if (FindFirst(dir, filename, filInfo))
+	{
+		FRESULT res = FR_OK;
+		while (res == FR_OK && filInfo.fname[0] != 0 && IsDirectory(filInfo))
+		{
+			res = f_findnext(&dir, &filInfo);
+		}
+		found = res == FR_OK && filInfo.fname[0] != 0 && f_open(&file, filInfo.fname, FA_READ) == FR_OK;
+	}
+
+	if (!found)
+	{
+		Error(ERROR_62_FILE_NOT_FOUND);
+		WriteBurstByte(BURST_STATUS_FILE_NOT_FOUND);
+		return;
+	}
+
+	u8 block[254];
+	u32 sizeRemaining = (u32)f_size(&file);
+	u32 bytesRead;
+
+	do
+	{
+		// A block that can't be read ends the load with a read error rather than an empty block.
+		if (f_read(&file, block, sizeof(block), &bytesRead) != FR_OK || (bytesRead == 0 && sizeRemaining != 0))
+		{
+			Error(ERROR_23_READ_ERROR);
+			WriteBurstByte(BURST_STATUS_READ_ERROR);
+			break;
+		}
+		sizeRemaining -= bytesRead;
+
+		if (sizeRemaining == 0)
+		{
+			if (WriteBurstByte(BURST_STATUS_EOI) || WriteBurstByte((u8)bytesRead))
+				break;
+		}
+		else if (WriteBurstByte(BURST_STATUS_OK))
+		{
+			break;
+		}
+
+		for (u32 i = 0; i < bytesRead; ++i)
+		{
+			if (WriteBurstByte(block[i]))
+			{
+				sizeRemaining = 0;
+				break;
+			}
+		}
+	}
+	while (sizeRemaining > 0 && bytesRead > 0);
+
+	f_close(&file);
+}
+
 void IEC_Commands::Extended(void)
 {
 	Channel& channel = channels[15];
@@ -1543,17 +1877,20 @@ void IEC_Commands::LoadFile()
 {
 	Channel& channel = channels[secondaryAddress];
 
+	// No buffer was free; OpenFile has already reported 70,NO CHANNEL.
+	if (!channel.buffer)
+		return;
+
 	//DEBUG_LOG("LoadFile %s %s\r\n", channel.buffer, channel.filInfo.fname);
 
-	if (channel.filInfo.fname[0] != 0)
+	if (channel.open && channel.filInfo.fname[0] != 0)
 	{
-		FSIZE_t size = f_size(&channel.file);
-		FSIZE_t sizeRemaining = size;
+		FSIZE_t sizeRemaining = f_size(&channel.file);
 		u32 bytesRead;
 		channel.fileSize = (u32)channel.filInfo.fsize;
 
 		char* ext = strrchr((char*)channel.filInfo.fname, '.');
-		if (toupper((char)ext[1]) == 'P' && isdigit(ext[2]) && isdigit(ext[3]))
+		if (ext && toupper((char)ext[1]) == 'P' && isdigit(ext[2]) && isdigit(ext[3]))
 		{
 			bool validP00 = false;
 
@@ -1571,13 +1908,14 @@ void IEC_Commands::LoadFile()
 					f_lseek(&channel.file, 0);
 			}
 		}
-		else if (toupper((char)ext[1]) == 'T' && ext[2] == '6' && ext[3] == '4')
+		else if (ext && toupper((char)ext[1]) == 'T' && ext[2] == '6' && ext[3] == '4')
 		{
 			bool validT64 = false;
 
-			f_read(&channel.file, channel.buffer, sizeof(channel.buffer), &bytesRead);
+			// Only the header and the first directory entry are needed (we only load the first file).
+			f_read(&channel.file, channel.buffer, 0x40 + 32, &bytesRead);
 
-			if (bytesRead > 0)
+			if (bytesRead == 0x40 + 32)
 			{
 				if ((memcmp(channel.buffer, "C64 tape image file", 20) == 0) || (memcmp(channel.buffer, "C64s tape image file", 21) == 0))
 				{
@@ -1590,12 +1928,10 @@ void IEC_Commands::LoadFile()
 
 					DEBUG_LOG("%x %d %d %s\r\n", version, entries, entriesUsed, name);
 
-					u16 entryIndex;
-
-					for (entryIndex = 0; entryIndex < entriesUsed; ++entryIndex)
+					if (entriesUsed > 0)
 					{
 						char nameEntry[17] = { 0 };
-						int offset = 0x40 + entryIndex * 32;
+						int offset = 0x40;
 						u8 type = channel.buffer[offset];
 						u8 fileType = channel.buffer[offset + 1];
 						u16 startAddress = channel.buffer[offset + 2] | (channel.buffer[offset + 3] << 8);
@@ -1605,42 +1941,46 @@ void IEC_Commands::LoadFile()
 
 						DEBUG_LOG("%d %02x %04x %04x %0x8 %s\r\n", type, fileType, startAddress, endAddress, fileOffset, nameEntry);
 
-						channel.bytesSent = 0;
 						channel.buffer[0] = startAddress & 0xff;
 						channel.buffer[1] = (startAddress >> 8) & 0xff;
-	
+
 						validT64 = true;
 						sizeRemaining = endAddress - startAddress;
 						channel.fileSize = sizeRemaining + 2;
 						channel.bytesSent = 0;
 						channel.cursor = 2;
 
-						SendBuffer(channel, false);
+						if (SendBuffer(channel, false))
+							return;
 
 						f_lseek(&channel.file, fileOffset);
-
-						break; // For now only load the first file.
 					}
 				}
-
-				if (!validT64)
-					f_lseek(&channel.file, 0);
 			}
+
+			if (!validT64)
+				f_lseek(&channel.file, 0);
 		}
 
-		do
+		// Stream the payload through the channel buffer.
+		// The first read stops on a sector boundary of the file, so every read after it is whole sectors.
+		// FatFs hands whole sectors to the SD driver straight into the buffer instead of copying them through the FIL window.
+		u32 readSize = CHANNEL_BUFFER_SIZE - (u32)(f_tell(&channel.file) % _MAX_SS);
+		while (sizeRemaining > 0)
 		{
-			f_read(&channel.file, channel.buffer, sizeof(channel.buffer), &bytesRead);
-			if (bytesRead > 0)
-			{
-				//DEBUG_LOG("%d %d %d\r\n", (int)size, bytesRead, (int)sizeRemaining);
-				sizeRemaining -= bytesRead;
-				channel.cursor = bytesRead;
-				if (SendBuffer(channel, sizeRemaining <= 0))
-					return;
-			}
+			if (readSize > sizeRemaining)
+				readSize = (u32)sizeRemaining;
+
+			if (f_read(&channel.file, channel.buffer, readSize, &bytesRead) != FR_OK || bytesRead == 0)
+				break;
+
+			//DEBUG_LOG("%d %d\r\n", bytesRead, (int)sizeRemaining);
+			sizeRemaining -= bytesRead;
+			channel.cursor = bytesRead;
+			if (SendBuffer(channel, sizeRemaining == 0))
+				return;
+			readSize = CHANNEL_BUFFER_SIZE;
 		}
-		while (bytesRead > 0);
 	}
 	else
 	{
@@ -1662,7 +2002,7 @@ void IEC_Commands::SaveFile()
 			channel.buffer[channel.cursor++] = byte;
 			if (channel.WriteFull())
 			{
-				if (f_write(&channel.file, channel.buffer, sizeof(channel.buffer), &bytesWritten) != FR_OK)
+				if (f_write(&channel.file, channel.buffer, CHANNEL_BUFFER_SIZE, &bytesWritten) != FR_OK)
 				{
 				}
 				channel.cursor = 0;
@@ -1784,6 +2124,8 @@ void IEC_Commands::LoadDirectory()
 	FRESULT res;
 
 	Channel& channel = channels[0];
+	if (!channel.AcquireBuffer())
+		return;
 
 	memcpy(channel.buffer, DirectoryHeader, sizeof(DirectoryHeader));
 	channel.cursor = sizeof(DirectoryHeader);
@@ -1893,7 +2235,7 @@ void IEC_Commands::OpenFile()
 
 		// Direct acces is unsupported. Without a mounted disk image tracks and sectors have no meaning.
 		//DEBUG_LOG("Driect access\r\n");
-		if (strcmp((char*)channelCommand.buffer, "U1:13 0 01 00") == 0)
+		if (strcmp((char*)channelCommand.buffer, "U1:13 0 01 00") == 0 && channel.AcquireBuffer())
 		{
 			// This is a 128 trying to auto boot
 			memset(channel.buffer, 0, 256);
@@ -1966,7 +2308,7 @@ void IEC_Commands::OpenFile()
 	}
 	else
 	{
-		if (!channel.open)
+		if (!channel.open && channel.AcquireBuffer())
 		{
 			bool found = false;
 			DIR dir;
@@ -24,6 +24,8 @@
 #include "debug.h"
 #include "DiskImage.h"
 
+#define CHANNEL_BUFFER_SIZE 0x1000
+
 struct TimerMicroSeconds
 {
 	TimerMicroSeconds()
@@ -74,6 +76,7 @@ public:
 	u8 GetDeviceId() { return deviceID; }
 
 	void SetLowercaseBrowseModeFilenames(bool value) { lowercaseBrowseModeFilenames = value; }
+	void SetJiffyDOS(bool value) { jiffyDOSEnabled = value; }
 	void SetNewDiskType(DiskImage::DiskType type) { newDiskType = type; }
 	void SetAutoBootFB128(bool autoBootFB128) { this->autoBootFB128 = autoBootFB128; }
 	void Set128BootSectorName(const char* SectorName) 
@@ -115,7 +118,7 @@ protected:
 
 	struct Channel
 	{
-		u8 buffer[0x1000];
+		u8* buffer;	// Borrowed from the channel buffer pool while the channel is in use (the command channel owns commandBuffer).
 		u8 command[0x100];
 
 		FILINFO filInfo;
@@ -127,13 +130,19 @@ protected:
 		u32 fileSize;
 
 		void Close();
-		bool WriteFull() const { return cursor >= sizeof(buffer); }
-		bool CanFit(u32 bytes) const { return bytes <= sizeof(buffer) - cursor; }
+		bool AcquireBuffer();
+		bool WriteFull() const { return cursor >= CHANNEL_BUFFER_SIZE; }
+		bool CanFit(u32 bytes) const { return bytes <= CHANNEL_BUFFER_SIZE - cursor; }
 	};
 
 	bool CheckATN(void);
 	bool WriteIECSerialPort(u8 data, bool eoi);
 	bool ReadIECSerialPort(u8& byte);
+	bool WriteJiffyDOS(u8 data, bool eoi, bool sendStatus);
+	bool ReadJiffyDOS(u8& byte);
+	void WriteFastSerialByte(u8 data);
+	bool ReadFastSerialByte(u8& byte);
+	bool WriteBurstByte(u8 data);
 
 	void Listen();
 	void Talk();
@@ -164,6 +173,7 @@ protected:
 
 	void Memory(void);
 	void User(void);
+	void BurstFastload(void);
 	void Extended(void);
 
 	void ProcessCommand(void);
@@ -180,6 +190,11 @@ protected:
 	bool receivedEOI : 1;	// End Or Identify
 	bool usingVIC20 : 1;	// When sending data we need to wait longer for the 64 as its VICII may be stealing its cycles. VIC20 does not have this problem and can accept data faster.
 	bool autoBootFB128 : 1;
+	bool jiffyDOSEnabled : 1;
+	bool jiffyDOSActive : 1;	// The computer answered the JiffyDOS handshake during this ATN sequence.
+	bool jiffyDOSLoad : 1;	// JiffyDOS LOAD (secondary 0x61) uses the block framed variant of the byte protocol.
+	bool fastSerialHost : 1;	// A C128 clocked SRQ at the start of this ATN sequence so it can take bytes over fast serial.
+	bool burstClock : 1;	// Last Clock level seen in the burst handshake (the host toggles it to request each byte).
 
 	u8 deviceID;
 	u8 secondaryAddress;
@@ -189,6 +204,7 @@ protected:
 	TimerMicroSeconds timer;
 
 	Channel channels[16];
+	u8 commandBuffer[CHANNEL_BUFFER_SIZE];
 
 	char selectedImageName[256];
 	FILINFO filInfoSelectedImage;
@@ -17,6 +17,7 @@
 // along with Pi1541. If not, see <http://www.gnu.org/licenses/>.
 
 #include "m6502.h"
+#include "Snapshot.h"
 
 M6502::OpcodeCycleFunction M6502::opcodeFunctions[256] =
 {
@@ -351,6 +352,53 @@ void M6502::Reset(void)
 	Reset_T0();
 }
 
+// The cycle function pointers are saved as they are. They are only meaningful to the build that saved them so the
+// snapshot also carries the address of InstructionFetch and is rejected if this build's differs.
+void M6502::SerialiseState(Snapshot& snapshot)
+{
+	AddressModeCycleFunction instructionFetch = &M6502::InstructionFetch;
+	snapshot.Field(instructionFetch);
+	if (!snapshot.IsSaving() && instructionFetch != &M6502::InstructionFetch)
+	{
+		snapshot.Fail();
+		return;
+	}
+
+	snapshot.Field(ea);
+	snapshot.Field(ia);
+	snapshot.Field(value);
+	snapshot.Field(pc);
+	snapshot.Field(opcode);
+	snapshot.Field(a);
+	snapshot.Field(x);
+	snapshot.Field(y);
+	snapshot.Field(status);
+	snapshot.Field(sp);
+	CLIMaskingInterrupt = snapshot.Value<u8>(CLIMaskingInterrupt);
+	BranchTakenMaskingInterrupt = snapshot.Value<u8>(BranchTakenMaskingInterrupt);
+#ifdef  SUPPORT_IRQ
+	IRQPending = snapshot.Value<u8>(IRQPending);
+	if (snapshot.Value(IRQ.IsAsserted()))
+		IRQ.Assert();
+	else
+		IRQ.Release();
+#endif //  SUPPORT_IRQ
+#ifdef  SUPPORT_NMI
+	NMIPending = snapshot.Value<u8>(NMIPending);
+	if (snapshot.Value(NMI.IsAsserted()))
+		NMI.Assert();
+	else
+		NMI.Release();
+#endif //  SUPPORT_NMI
+#ifdef  SUPPORT_RDY_HALTING
+	RDYCounter = snapshot.Value<u8>(RDYCounter);
+	RDYAsserted = snapshot.Value<u8>(RDYAsserted);
+	RDYHalted = snapshot.Value<u8>(RDYHalted);
+#endif //  SUPPORT_RDY_HALTING
+	snapshot.Field(addressModeCycleFn);
+	snapshot.Field(opcodeCycleFn);
+}
+
 #ifdef  SUPPORT_RDY_HALTING
 void M6502::RDY(bool asserted)
 {
@@ -108,6 +108,8 @@ private:
 };
 #endif //  SUPPORT_IRQ
 
+class Snapshot;
+
 class M6502
 {
 private:
@@ -510,6 +512,7 @@ public:
 	void SetBusFunctions(DataBusReadFn dataBusReadFn, DataBusWriteFn dataBusWriteFn) {this->dataBusReadFn = dataBusReadFn; this->dataBusWriteFn = dataBusWriteFn; status = FLAG_CONSTANT; Reset(); }
 	void Reset(void);
 	void Step(void);
+	void SerialiseState(Snapshot& snapshot);
 #ifdef  SUPPORT_RDY_HALTING
 	void RDY(bool asserted);
 	bool Halted() { return RDYHalted != 0; }
@@ -86,6 +86,59 @@ void m6522::Reset()
 	OutputIRQ();
 }
 
+void m6522::SerialiseState(Snapshot& snapshot)
+{
+	snapshot.Field(functionControlRegister);
+	snapshot.Field(auxiliaryControlRegister);
+
+	portA.SerialiseState(snapshot);
+	snapshot.Field(latchPortA);
+	snapshot.Field(latchedValueA);
+	snapshot.Field(ca1);
+	snapshot.Field(ca2);
+	snapshot.Field(pulseCA2);
+
+	portB.SerialiseState(snapshot);
+	snapshot.Field(latchPortB);
+	snapshot.Field(latchedValueB);
+	snapshot.Field(cb1);
+	snapshot.Field(cb1Old);
+	snapshot.Field(cb2);
+	snapshot.Field(pulseCB2);
+
+	snapshot.Field(t1c.value);
+	snapshot.Field(t1l.value);
+	snapshot.Field(t1Ticking);
+	snapshot.Field(t1Reload);
+	snapshot.Field(t1OutPB7);
+	snapshot.Field(t1FreeRun);
+	snapshot.Field(t1FreeRunIRQsOn);
+	snapshot.Field(t1TimedOut);
+	snapshot.Field(t1_pb7);
+	snapshot.Field(t1OneShotTriggeredIRQ);
+
+	snapshot.Field(t2c.value);
+	snapshot.Field(t2Latch);
+	snapshot.Field(t2Reload);
+	snapshot.Field(t2CountingDown);
+	snapshot.Field(t2CountingPB6ModeOld);
+	snapshot.Field(t2CountingPB6Mode);
+	snapshot.Field(t2TimedOut);
+	snapshot.Field(t2LowTimedOut);
+	snapshot.Field(t2OneShotTriggeredIRQ);
+	snapshot.Field(t2TimedOutCount);
+	snapshot.Field(pb6Old);
+
+	snapshot.Field(interruptFlagRegister);
+	snapshot.Field(interruptEnabledRegister);
+
+	snapshot.Field(shiftRegister);
+	snapshot.Field(bitsShiftedSoFar);
+	snapshot.Field(cb1OutputShiftClock);
+	snapshot.Field(cb2Shift);
+	snapshot.Field(cb1OutputShiftClockPositiveEdge);
+}
+
 void m6522::InputCA1(bool value)
 {
 	if (ca1 != value && ((functionControlRegister & FCR_CA1) != 0) == value) // CA1 is an input?
@@ -200,6 +200,8 @@ FCR/PCR
 
 	void Reset();
 	void ConnectIRQ(Interrupt* irq) { this->irq = irq; }
+	// The IRQ line is part of the CPU's state.
+	void SerialiseState(Snapshot& snapshot);
 
 	inline IOPort* GetPortA() { return &portA; }
 	inline bool GetLatchPortA() const { return latchPortA; }
@@ -148,6 +148,58 @@ void m8520::Reset()
 	//OutputIRQ();
 }
 
+void m8520::SerialiseState(Snapshot& snapshot)
+{
+	portA.SerialiseState(snapshot);
+	portB.SerialiseState(snapshot);
+
+	snapshot.Field(ICRMask);
+	snapshot.Field(ICRData);
+
+	snapshot.Field(CRARegister);
+	snapshot.Field(CRBRegister);
+
+	snapshot.Field(PCAsserted);
+	snapshot.Field(FLAGPin);
+	snapshot.Field(CNTPin);
+	snapshot.Field(CNTPinOld);
+	snapshot.Field(SPPin);
+	snapshot.Field(TODPin);
+
+	snapshot.Field(timerACounter);
+	snapshot.Field(timerALatch);
+	snapshot.Field(timerAActive);
+	snapshot.Field(timerAOutputOnPB6);
+	snapshot.Field(timerAToggle);
+	snapshot.Field(timerAOneShot);
+	timerAMode = (TimerAMode)snapshot.Value<u32>(timerAMode);
+	snapshot.Field(timerA50Hz);
+	snapshot.Field(ta_pb6);
+	snapshot.Field(timerAReloaded);
+
+	snapshot.Field(timerBCounter);
+	snapshot.Field(timerBLatch);
+	snapshot.Field(timerBActive);
+	snapshot.Field(timerBOutputOnPB7);
+	snapshot.Field(timerBToggle);
+	snapshot.Field(timerBOneShot);
+	timerBMode = (TimerBMode)snapshot.Value<u32>(timerBMode);
+	snapshot.Field(timerBAlarm);
+	snapshot.Field(tb_pb7);
+	snapshot.Field(timerBReloaded);
+
+	snapshot.Field(TODActive);
+	snapshot.Field(TODAlarm);
+	snapshot.Field(TODClock);
+	snapshot.Field(TODLatch);
+
+	serialPortMode = (SerialPortMode)snapshot.Value<u32>(serialPortMode);
+	snapshot.Field(serialPortRegister);
+	snapshot.Field(serialShiftRegister);
+	snapshot.Field(serialBitsShiftedSoFar);
+	snapshot.Field(serialShiftingEnabled);
+}
+
 extern u16 pc;
 
 // Update for a single cycle
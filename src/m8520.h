@@ -127,6 +127,8 @@ public:
 
 	void Reset();
 	void ConnectIRQ(Interrupt* irq) { this->irq = irq; }
+	// The IRQ line is part of the CPU's state.
+	void SerialiseState(Snapshot& snapshot);
 
 	inline IOPort* GetPortA() { return &portA; }
 	inline IOPort* GetPortB() { return &portB; }
@@ -48,6 +48,9 @@ extern "C"
 #include "FileBrowser.h"
 #include "ScreenLCD.h"
 #include "SpinLock.h"
+#include "Snapshot.h"
+#include "IECRecorder.h"
+#include "ImageProfiles.h"
 
 #include "logo.h"
 #include "sample.h"
@@ -58,6 +61,9 @@ extern "C"
 #include "net-icmp.h"
 #include "net-arp.h"
 #include "net-ipv4.h"
+#include "net-control.h"
+#include "net-dhcp.h"
+#include "net-telemetry.h"
 
 unsigned versionMajor = 1;
 unsigned versionMinor = 23;
@@ -116,6 +122,13 @@ Pi1541 pi1541;
 #if defined(PI1581SUPPORT)
 Pi1581 pi1581;
 #endif
+Snapshot snapshot;
+IECRecorder iecRecorder;
+// Totals since power on kept by the emulation loops for the telemetry core 0 sends.
+// Cycles are added every 4096 so the loops only touch shared memory now and then.
+static volatile u32 emulatedCycles = 0;
+static volatile u32 lostCyclesTotal = 0;
+ImageProfiles imageProfiles;
 CEMMCDevice	m_EMMC;
 Screen screen;
 ScreenLCD* screenLCD = 0;
@@ -383,6 +396,8 @@ void UpdateScreen()
 	u32 textColour = COLOUR_BLACK;
 	u32 bgColour = COLOUR_WHITE;
 	u32 oldTemp = 0;
+	u32 oldSDThroughput = 0;
+	u32 oldNetFrames = 0;
 
 	RGBA atnColour = COLOUR_YELLOW;
 	RGBA dataColour = COLOUR_GREEN;
@@ -409,6 +424,9 @@ void UpdateScreen()
 		bool value;
 		u32 y = screen.ScaleY(STATUS_BAR_POSITION_Y);
 
+		// Show any page the browser has finished composing on core 1.
+		screen.ServiceFlip();
+
 		//RPI_UpdateTouch();
 		//refreshUartStatusDisplay = false;
 
@@ -556,6 +574,24 @@ void UpdateScreen()
 			}
 		}
 
+		u32 sdThroughput = m_EMMC.GetThroughput();
+		if (sdThroughput != oldSDThroughput)
+		{
+			oldSDThroughput = sdThroughput;
+			snprintf(tempBuffer, tempBufferSize, "%5d", sdThroughput);
+			screen.PrintText(false, 62 * 8, y, tempBuffer, textColour, bgColour);
+		}
+
+		u32 netFrames = 0;
+		for (unsigned protocol = 0; protocol < static_cast<unsigned>(Net::Protocol::Count); ++protocol)
+			netFrames += Net::GetCounters(static_cast<Net::Protocol>(protocol)).received;
+		if (netFrames != oldNetFrames)
+		{
+			oldNetFrames = netFrames;
+			Net::FormatCounters(tempBuffer, tempBufferSize);
+			screen.PrintText(false, STATUS_BAR_NET_X, y, tempBuffer, textColour, bgColour);
+		}
+
 		u32 track;
 		if (emulating == EMULATING_1541)
 		{
@@ -631,6 +667,41 @@ void UpdateScreen()
 		//if (options.GetSupportUARTInput())
 		//	UpdateUartControls(refreshUartStatusDisplay, oldLED, oldMotor, oldATN, oldDATA, oldCLOCK, oldTrack, romIndex);
 
+		if (screenLCD)
+			screenLCD->Service();
+
+		if (Net::Telemetry::Due())
+		{
+			Net::Telemetry::Status status;
+			const DiskImage* diskImage = 0;
+			if (emulating == EMULATING_1541)
+			{
+				status.flags |= Net::Telemetry::TELEMETRY_FLAG_1541;
+				status.track = pi1541.drive.Track();
+				diskImage = pi1541.drive.GetDiskImage();
+			}
+			else if (emulating == EMULATING_1581)
+			{
+				status.flags |= Net::Telemetry::TELEMETRY_FLAG_1581;
+				status.track = pi1581.wd177x.GetCurrentTrack();
+				diskImage = pi1581.GetDiskImage();
+			}
+			if (motor)
+				status.flags |= Net::Telemetry::TELEMETRY_FLAG_MOTOR;
+			if (led)
+				status.flags |= Net::Telemetry::TELEMETRY_FLAG_LED;
+			status.deviceId = deviceID;
+			status.imageHash = diskImage ? diskImage->GetHash() : 0;
+			status.cycles = emulatedCycles;
+			status.lostCycles = lostCyclesTotal;
+			status.atnChanges = IEC_Bus::GetAtnChanges();
+			status.clockChanges = IEC_Bus::GetClockChanges();
+			status.dataChanges = IEC_Bus::GetDataChanges();
+			status.sdBytes = m_EMMC.GetTransferredBytes();
+			status.sdRate = sdThroughput;
+			Net::Telemetry::Send(status);
+		}
+
 		Net::Update();
 
 		// Go back to sleep. The USB irq will wake us up again.
@@ -736,7 +807,7 @@ DMA_ControlBlock dmaSoundCB =
 static void PlaySoundDMA()
 {
 	write32(PWM_DMAC, PWM_ENAB + 0x0001);
-	write32(DMA_ENABLE, 1);	// DMA_EN0
+	write32(DMA_ENABLE, read32(DMA_ENABLE) | 1);	// DMA_EN0 (leave the SD card and screen channels enabled)
 	write32(DMA0_BASE + DMA_CONBLK_AD, (u32)&dmaSoundCB);
 	write32(DMA0_BASE + DMA_CS, DMA_ACTIVE);
 }
@@ -773,13 +844,370 @@ void CheckAutoMountImage(EXIT_TYPE reset_reason , FileBrowser* fileBrowser)
 	}
 }
 
+// Save-states are kept in RAM for the emulation session. They refer to the images in the caddy and are dropped when the caddy is emptied.
+static void EndSaveStates()
+{
+	snapshot.Invalidate();
+	for (unsigned caddyIndex = 0; caddyIndex < diskCaddy.GetNumberOfImages(); ++caddyIndex)
+		diskCaddy.GetImage(caddyIndex)->EndJournal();
+}
+
+static bool SaveState(Snapshot::Machine machine)
+{
+	u32 caddyIndex = diskCaddy.GetSelectedIndex();
+
+	snapshot.BeginSave(machine);
+	snapshot.Field(caddyIndex);
+#if defined(PI1581SUPPORT)
+	if (machine == Snapshot::MACHINE_1581)
+		pi1581.SerialiseState(snapshot);
+	else
+#endif
+		pi1541.SerialiseState(snapshot);
+	if (!snapshot.End())
+		return false;
+
+	for (caddyIndex = 0; caddyIndex < diskCaddy.GetNumberOfImages(); ++caddyIndex)
+	{
+		if (!diskCaddy.GetImage(caddyIndex)->BeginJournal())
+		{
+			EndSaveStates();
+			return false;
+		}
+	}
+	DEBUG_LOG("Saved state %d bytes\r\n", snapshot.Size());
+	return true;
+}
+
+static bool RestoreState(Snapshot::Machine machine)
+{
+	u32 caddyIndex = 0;
+
+	if (!snapshot.BeginRestore(machine))
+		return false;
+	snapshot.Field(caddyIndex);
+	if (snapshot.Failed() || caddyIndex >= diskCaddy.GetNumberOfImages())
+		return false;
+
+	for (unsigned index = 0; index < diskCaddy.GetNumberOfImages(); ++index)
+		diskCaddy.GetImage(index)->RollbackJournal();
+
+	diskCaddy.SelectImage(caddyIndex);
+	DiskImage* diskImage = diskCaddy.GetImage(caddyIndex);
+#if defined(PI1581SUPPORT)
+	if (machine == Snapshot::MACHINE_1581)
+	{
+		pi1581.Insert(diskImage);
+		pi1581.SerialiseState(snapshot);
+	}
+	else
+#endif
+	{
+		pi1541.drive.Insert(diskImage);
+		pi1541.SerialiseState(snapshot);
+	}
+#if defined(EXPERIMENTALZERO)
+	diskCaddy.Update();
+#endif
+	return snapshot.End();
+}
+
+// The recording starts once the 1541 has been reset, with the state it was reset to, and is written out when emulation ends.
+static void BeginIECRecording(bool refreshOutsAfterCPUStep, u32 fastBootCycles)
+{
+	IECRecorder::Header header;
+	unsigned caddyIndex;
+
+	memset(&header, 0, sizeof(header));
+#if defined(EXPERIMENTALZERO)
+	header.flags |= IECRecorder::FLAG_INTEGER_DRIVE_MODEL;
+#endif
+	if (refreshOutsAfterCPUStep) header.flags |= IECRecorder::FLAG_REFRESH_OUTS_AFTER_CPU_STEP;
+	if (options.GetExtraRAM()) header.flags |= IECRecorder::FLAG_EXTRA_RAM;
+	if (options.GetRAMBOard()) header.flags |= IECRecorder::FLAG_RAM_BOARD;
+	if (options.InvertIECInputs()) header.flags |= IECRecorder::FLAG_INVERT_IEC_INPUTS;
+	if (options.IgnoreReset()) header.flags |= IECRecorder::FLAG_IGNORE_RESET;
+	header.seed = pi1541.drive.GetSeed();
+	header.fastBootCycles = fastBootCycles;
+	header.ROMHash = HashBuffer(roms.ROMImages[roms.currentROMIndex], ROMs::ROM_SIZE);
+	strncpy(header.ROMName, roms.GetSelectedROMName(), IECRecorder::NAME_LENGTH - 1);
+
+	header.imageCount = diskCaddy.GetNumberOfImages();
+	if (header.imageCount > IECRecorder::MAX_IMAGES)
+		header.imageCount = IECRecorder::MAX_IMAGES;
+	header.firstImage = diskCaddy.GetSelectedIndex();
+	for (caddyIndex = 0; caddyIndex < header.imageCount; ++caddyIndex)
+	{
+		DiskImage* diskImage = diskCaddy.GetImage(caddyIndex);
+		header.imageHashes[caddyIndex] = diskImage->HashTracks();
+		if (diskImage->GetReadOnly())
+			header.readOnlyImages |= 1 << caddyIndex;
+		strncpy(header.imageNames[caddyIndex], diskImage->GetName(), IECRecorder::NAME_LENGTH - 1);
+	}
+
+	// The save-state slot is empty at the start of a session so it can hold the start state while it is copied.
+	snapshot.BeginSave(Snapshot::MACHINE_1541);
+	pi1541.SerialiseState(snapshot, false);
+	if (snapshot.End() && iecRecorder.Begin(header, snapshot))
+		IEC_Bus::recorder = &iecRecorder;
+	snapshot.Invalidate();
+}
+
+static void EndIECRecording()
+{
+	if (IEC_Bus::recorder)
+	{
+		IEC_Bus::recorder = 0;
+		iecRecorder.End("/iec_recording.bin");
+	}
+}
+
+static void RecordDiskInsert()
+{
+	if (IEC_Bus::recorder)
+		IEC_Bus::recorder->Insert(diskCaddy.GetSelectedIndex());
+}
+
+#if not defined(EXPERIMENTALZERO)
+// How many images a remote MOUNT can put in the caddy
+#define REMOTE_MAX_IMAGES 32
+
+// A remote MOUNT's arguments are a path, then more names in the same folder separated by |.
+// Changes to the path's folder and leaves the names in names.
+static unsigned RemoteMountNames(char* arguments, const char** names, const char*& error)
+{
+	unsigned count = 0;
+	for (char* name = strtok(arguments, "|"); name && count < REMOTE_MAX_IMAGES; name = strtok(0, "|"))
+		names[count++] = name;
+	if (count == 0)
+	{
+		error = "no image";
+		return 0;
+	}
+
+	char* slash = strrchr((char*)names[0], '/');
+	if (slash)
+	{
+		*slash = 0;
+		if (f_chdir(slash == names[0] ? "/" : names[0]) != FR_OK)
+		{
+			error = "no such folder";
+			return 0;
+		}
+		names[0] = slash + 1;
+	}
+	return count;
+}
+
+static void RemoteStatus(char* buffer, unsigned size)
+{
+	if (emulating == IEC_COMMANDS)
+	{
+		snprintf(buffer, size, "browsing device %d rom %s", deviceID, roms.GetSelectedROMName());
+		return;
+	}
+
+	const DiskImage* diskImage;
+	unsigned track;
+	if (emulating == EMULATING_1541)
+	{
+		diskImage = pi1541.drive.GetDiskImage();
+		track = pi1541.drive.Track();
+		snprintf(buffer, size, "1541 device %d rom %s track %d.%d", deviceID, roms.GetSelectedROMName(), (track >> 1) + 1, track & 1 ? 5 : 0);
+	}
+	else
+	{
+		diskImage = pi1581.GetDiskImage();
+		track = pi1581.wd177x.GetCurrentTrack();
+		snprintf(buffer, size, "1581 device %d track %d", deviceID, track + 1);
+	}
+	unsigned length = strlen(buffer);
+	snprintf(buffer + length, size - length, " disk %d/%d %s %08x",
+		diskCaddy.GetSelectedIndex() + 1, diskCaddy.GetNumberOfImages(), diskImage ? diskImage->GetName() : "", diskImage ? diskImage->GetHash() : 0);
+}
+
+static bool RemoteSelectROM(FileBrowser* fileBrowser, const char* name)
+{
+	unsigned number = atoi(name);
+	if (number == 0)
+	{
+		for (unsigned index = 0; index < ROMs::MAX_ROMS; ++index)
+		{
+			if (roms.ROMValid[index] && strcasecmp(roms.ROMNames[index], name) == 0)
+				number = index + 1;
+		}
+	}
+	return number >= 1 && number <= ROMs::MAX_ROMS && fileBrowser->SelectROMOrDevice(number);
+}
+
+// Runs a remote control command (net-control.h) while browsing. MOUNT starts emulating.
+// Browsing is also when the network core's FatFs work gets done, as nothing else is using it.
+static void RemoteCommandBrowsing(FileBrowser* fileBrowser)
+{
+	Net::Dhcp::WriteLease();
+
+	Net::Control::Command* command = Net::Control::Next();
+	if (command == 0)
+		return;
+
+	bool ok = true;
+	const char* message = "";
+	char buffer[Net::Control::NET_CONTROL_MAX_REPLY];
+	switch (command->opcode)
+	{
+		case Net::Control::Opcode::Mount:
+		{
+			const char* names[REMOTE_MAX_IMAGES];
+			unsigned count = RemoteMountNames(command->arguments, names, message);
+			if (count == 0)
+				ok = false;
+			else if (count == 1 && DiskImage::IsLSTExtention(names[0]))
+			{
+				fileBrowser->FolderChanged();
+				ok = fileBrowser->SelectLST(names[0]);
+			}
+			else
+				ok = fileBrowser->SelectImages(names, count);
+
+			if (ok)
+			{
+				emulating = BeginEmulating(fileBrowser, names[0]);
+				ok = emulating != IEC_COMMANDS;
+			}
+			if (!ok && message[0] == 0)
+				message = "can not mount";
+			break;
+		}
+		case Net::Control::Opcode::Rom:
+			ok = RemoteSelectROM(fileBrowser, command->arguments);
+			if (!ok)
+				message = "no such ROM";
+			break;
+		case Net::Control::Opcode::Device:
+		{
+			unsigned device = atoi(command->arguments);
+			ok = device >= 8 && device <= 11 && fileBrowser->SelectROMOrDevice(device);
+			if (!ok)
+				message = "device must be 8 to 11";
+			break;
+		}
+		case Net::Control::Opcode::Reset:
+			if (!options.GetDisableSD2IECCommands())
+			{
+				IEC_Bus::Reset();
+				m_IEC_Commands.SimulateIECBegin();
+			}
+			break;
+		case Net::Control::Opcode::Status:
+			RemoteStatus(buffer, sizeof(buffer));
+			message = buffer;
+			break;
+		default:
+			ok = false;
+			message = "not emulating";
+			break;
+	}
+	Net::Control::Complete(command, ok, message);
+}
+
+// Runs a remote control command while emulating, setting exitReason if emulation should stop.
+// A MOUNT is left queued for the browser to pick up once emulation has stopped.
+static void RemoteCommandEmulating(FileBrowser* fileBrowser, Net::Control::Command* command, EXIT_TYPE& exitReason)
+{
+	bool ok = true;
+	const char* message = "";
+	char buffer[Net::Control::NET_CONTROL_MAX_REPLY];
+	switch (command->opcode)
+	{
+		case Net::Control::Opcode::Mount:
+			exitReason = EXIT_KEYBOARD;
+			return;
+		case Net::Control::Opcode::Exit:
+			exitReason = EXIT_KEYBOARD;
+			break;
+		case Net::Control::Opcode::Disk:
+		{
+			unsigned index = atoi(command->arguments) - 1;
+			ok = index < diskCaddy.GetNumberOfImages();
+			if (!ok)
+				message = "no such disk";
+			else if (index != diskCaddy.GetSelectedIndex())
+			{
+				DiskImage* diskImage = diskCaddy.SelectImage(index);
+				if (emulating == EMULATING_1541)
+				{
+					pi1541.drive.Insert(diskImage);
+					RecordDiskInsert();
+				}
+				else
+					pi1581.Insert(diskImage);
+			}
+			break;
+		}
+		case Net::Control::Opcode::Rom:
+			ok = emulating == EMULATING_1541 && RemoteSelectROM(fileBrowser, command->arguments);
+			if (ok)
+				pi1541.Reset();
+			else
+				message = emulating == EMULATING_1541 ? "no such ROM" : "not on a 1581";
+			break;
+		case Net::Control::Opcode::Reset:
+			if (emulating == EMULATING_1541)
+				pi1541.Reset();
+			else
+				pi1581.Reset();
+			break;
+		case Net::Control::Opcode::Status:
+			RemoteStatus(buffer, sizeof(buffer));
+			message = buffer;
+			break;
+		default:
+			ok = false;
+			message = "not while emulating";
+			break;
+	}
+	Net::Control::Complete(command, ok, message);
+}
+#endif
+
+static const unsigned JOB_SECTORS = 42 * 21;
+
+// Looks at the 1541's job queue for a sector that failed earlier and has now been read or written.
+// A sector that fails every time is more likely a protected original's deliberate error, which no profile
+// can fix, so only errors that go away again count against the output phase.
+static bool DiskJobRecovered(u32* failedSectors)
+{
+	bool recovered = false;
+	for (int job = 0; job < 6; ++job)
+	{
+		u8 code = s_u8Memory[job];
+		u8 track = s_u8Memory[6 + job * 2];
+		u8 sector = s_u8Memory[7 + job * 2];
+		if (track == 0 || track > 42 || sector >= 21)
+			continue;
+
+		unsigned index = (track - 1) * 21 + sector;
+		u32 bit = 1 << (index & 31);
+		if (code >= 0x02 && code <= 0x0b)
+		{
+			failedSectors[index >> 5] |= bit;
+		}
+		else if (code == 0x01 && (failedSectors[index >> 5] & bit))
+		{
+			failedSectors[index >> 5] &= ~bit;
+			recovered = true;
+		}
+	}
+	return recovered;
+}
+
 EXIT_TYPE Emulate1541(FileBrowser* fileBrowser)
 {
 	EXIT_TYPE exitReason = EXIT_UNKNOWN;
 	bool oldLED = false;
 	unsigned ctBefore = 0;
 	unsigned ctAfter = 0;
-	int cycleCount = 0;
+	u32 cycleCount = 0;
 	unsigned caddyIndex;
 	int headSoundCounter = 0;
 	int headSoundFreqCounter = 0;
@@ -788,6 +1216,11 @@ EXIT_TYPE Emulate1541(FileBrowser* fileBrowser)
 	unsigned char oldHeadDir = 0;
 	int resetCount = 0;
 	bool refreshOutsAfterCPUStep = true;
+	u32 fastBootCycles = FAST_BOOT_CYCLES;
+	bool learning = options.LearnProfiles() != 0;
+	unsigned lostCycles = 0;
+	bool diskJobRecovered = false;
+	u32 failedSectors[(JOB_SECTORS + 31) / 32] = { 0 };
 	unsigned numberOfImages = diskCaddy.GetNumberOfImages();
 	unsigned numberOfImagesMax = numberOfImages;
 	if (numberOfImagesMax > 10)
@@ -802,6 +1235,7 @@ EXIT_TYPE Emulate1541(FileBrowser* fileBrowser)
 #endif
 
 	inputMappings->directDiskSwapRequest = 0;
+	EndSaveStates();
 	// Force an update on all the buttons now before we start emulation mode.
 	IEC_Bus::ReadBrowseMode();
 
@@ -810,6 +1244,27 @@ EXIT_TYPE Emulate1541(FileBrowser* fileBrowser)
 	DataBusWriteFn dataBusWrite = extraRAM ? write6502ExtraRAM : write6502;
 	pi1541.m6502.SetBusFunctions(dataBusRead, dataBusWrite);
 
+	DiskImage* profiledImage = pi1541.drive.GetDiskImage();
+	u32 hash = profiledImage->GetHash();
+	const ImageProfiles::Profile* profile = imageProfiles.Find(hash);
+	refreshOutsAfterCPUStep = ImageProfiles::RefreshOutsAfterCPUStep(profile, learning);
+	unsigned ROMIndex = roms.currentROMIndex;
+	unsigned profileROMIndex = ROMIndex;
+	if (profile)
+	{
+		// The ROM has to be in place before the reset vector is fetched.
+		if (profile->fields & ImageProfiles::FIELD_ROM)
+		{
+			roms.SelectROM(profile->ROMName);
+			profileROMIndex = roms.currentROMIndex;
+		}
+		if (profile->fields & ImageProfiles::FIELD_SEED)
+			pi1541.drive.SetSeed(profile->seed);
+		if (profile->fields & ImageProfiles::FIELD_FAST_BOOT)
+			fastBootCycles = profile->fastBootCycles;
+	}
+	DEBUG_LOG("Image %08x %s outputs %s\r\n", hash, profile ? "profiled" : "", refreshOutsAfterCPUStep ? "after CPU step" : "end of cycle");
+
 	IEC_Bus::VIA = &pi1541.VIA[0];
 	IEC_Bus::port = pi1541.VIA[0].GetPortB();
 	pi1541.Reset();	// will call IEC_Bus::Reset();
@@ -819,22 +1274,14 @@ EXIT_TYPE Emulate1541(FileBrowser* fileBrowser)
 	//resetWhileEmulating = false;
 	selectedViaIECCommands = false;
 
-	u32 hash = pi1541.drive.GetDiskImage()->GetHash();
-	// 0x42c02586 = maniac_mansion_s1[lucasfilm_1989](ntsc).g64
-	// 0x18651422 = aliens[electric_dreams_1987].g64
-	// 0x2a7f4b77 = zak_mckracken_boot[activision_1988](manual)(!).g64
-	// 0x97732c3e = maniac_mansion_s1[activision_1987](!).g64
-	// 0x63f809d2 = 4x4_offroad_racing_s1[epyx_1988](ntsc)(!).g64
-	if (hash == 0x42c02586 || hash == 0x18651422 || hash == 0x2a7f4b77 || hash == 0x97732c3e || hash == 0x63f809d2)
-	{
-		refreshOutsAfterCPUStep = false;
-	}
+	if (options.RecordIEC())
+		BeginIECRecording(refreshOutsAfterCPUStep, fastBootCycles);
 
 	// Quickly get through 1541's self test code.
 	// This will make the emulated 1541 responsive to commands asap.
 	// During this time we don't need to set outputs.
 
-	while (cycleCount < FAST_BOOT_CYCLES)
+	while (cycleCount < fastBootCycles)
 	{
 		IEC_Bus::ReadEmulationMode1541();
 
@@ -846,6 +1293,8 @@ EXIT_TYPE Emulate1541(FileBrowser* fileBrowser)
 
 		cycleCount++;
 	}
+	emulatedCycles += cycleCount;
+	cycleCount = 0;
 
 	// Self test code done. Begin realtime emulation.
 
@@ -927,6 +1376,14 @@ EXIT_TYPE Emulate1541(FileBrowser* fileBrowser)
 		bool exitEmulation = inputMappings->Exit();
 		bool exitDoAutoLoad = inputMappings->AutoLoad();
 
+		if (inputMappings->SaveState())
+			SaveState(Snapshot::MACHINE_1541);
+		else if (inputMappings->RestoreState())
+		{
+			EndIECRecording();
+			RestoreState(Snapshot::MACHINE_1541);
+		}
+
 		// We have now output so HERE is where the next phi2 cycle starts.
 		pi1541.Update();
 
@@ -962,6 +1419,8 @@ EXIT_TYPE Emulate1541(FileBrowser* fileBrowser)
 				// If this ever occurs then we have taken too long (ie >1us) and lost a cycle.
 				// Cycle accuracy is now in jeopardy. If this occurs during critical communication loops then emulation can fail!
 				//DEBUG_LOG("!");
+				lostCycles++;
+				lostCyclesTotal++;
 			}
 		} while (ctAfter == ctBefore);
 #endif
@@ -972,6 +1431,18 @@ EXIT_TYPE Emulate1541(FileBrowser* fileBrowser)
 			IEC_Bus::ReadEmulationMode1541();
 			IEC_Bus::RefreshOuts1541();	// Now output all outputs.
 		}
+
+		// Results stay in the job queue until the next job so a look every few ms catches them.
+		if ((++cycleCount & 0xfff) == 0)
+		{
+			emulatedCycles += 0x1000;
+			if (learning)
+				diskJobRecovered |= DiskJobRecovered(failedSectors);
+#if not defined(EXPERIMENTALZERO)
+			if (Net::Control::Command* command = Net::Control::Next())
+				RemoteCommandEmulating(fileBrowser, command, exitReason);
+#endif
+		}
 #if not defined(EXPERIMENTALZERO)
 		if (options.SoundOnGPIO() && headSoundCounter > 0)
 		{
@@ -992,6 +1463,7 @@ EXIT_TYPE Emulate1541(FileBrowser* fileBrowser)
 			if (nextDisk)
 			{
 				pi1541.drive.Insert(diskCaddy.PrevDisk());
+				RecordDiskInsert();
 #if defined(EXPERIMENTALZERO)
 				diskCaddy.Update();
 #endif
@@ -999,6 +1471,7 @@ EXIT_TYPE Emulate1541(FileBrowser* fileBrowser)
 			else if (prevDisk)
 			{
 				pi1541.drive.Insert(diskCaddy.NextDisk());
+				RecordDiskInsert();
 #if defined(EXPERIMENTALZERO)
 				diskCaddy.Update();
 #endif
@@ -1014,6 +1487,7 @@ EXIT_TYPE Emulate1541(FileBrowser* fileBrowser)
 						if (diskImage && diskImage != pi1541.drive.GetDiskImage())
 						{
 							pi1541.drive.Insert(diskImage);
+							RecordDiskInsert();
 							break;
 						}
 					}
@@ -1023,6 +1497,19 @@ EXIT_TYPE Emulate1541(FileBrowser* fileBrowser)
 #endif
 		}
 	}
+	EndIECRecording();
+
+	// The profile's ROM was only for this image, unless another was chosen while it ran.
+	if (roms.currentROMIndex == profileROMIndex)
+		roms.currentROMIndex = ROMIndex;
+
+	if (learning)
+	{
+		bool changed = imageProfiles.Learn(hash, profiledImage->GetName(), refreshOutsAfterCPUStep, lostCycles == 0 && !diskJobRecovered);
+		DEBUG_LOG("Learned %08x lost cycles %d disk errors %d\r\n", hash, lostCycles, diskJobRecovered);
+		if (changed)
+			imageProfiles.Save("/profiles.txt");
+	}
 	return exitReason;
 }
 
@@ -1033,7 +1520,7 @@ EXIT_TYPE Emulate1581(FileBrowser* fileBrowser)
 	bool oldLED = false;
 	unsigned ctBefore = 0;
 	unsigned ctAfter = 0;
-	int cycleCount = 0;
+	u32 cycleCount = 0;
 	unsigned caddyIndex;
 	int headSoundCounter = 0;
 	int headSoundFreqCounter = 0;
@@ -1056,6 +1543,7 @@ EXIT_TYPE Emulate1581(FileBrowser* fileBrowser)
 #endif
 
 	inputMappings->directDiskSwapRequest = 0;
+	EndSaveStates();
 	// Force an update on all the buttons now before we start emulation mode.
 	IEC_Bus::ReadBrowseMode();
 
@@ -1143,6 +1631,10 @@ EXIT_TYPE Emulate1581(FileBrowser* fileBrowser)
 		bool exitEmulation = inputMappings->Exit();
 		bool exitDoAutoLoad = inputMappings->AutoLoad();
 
+		if (inputMappings->SaveState())
+			SaveState(Snapshot::MACHINE_1581);
+		else if (inputMappings->RestoreState())
+			RestoreState(Snapshot::MACHINE_1581);
 
 		bool reset = IEC_Bus::IsReset();
 		if (reset)
@@ -1175,11 +1667,22 @@ EXIT_TYPE Emulate1581(FileBrowser* fileBrowser)
 				// If this ever occurs then we have taken too long (ie >1us) and lost a cycle.
 				// Cycle accuracy is now in jeopardy. If this occurs during critical communication loops then emulation can fail!
 				//DEBUG_LOG("!");
+				lostCyclesTotal++;
 			}
 		} while (ctAfter == ctBefore);
 #endif
 		ctBefore = ctAfter;
 
+		// Each pass runs two 2MHz cycles.
+		if ((++cycleCount & 0xfff) == 0)
+		{
+			emulatedCycles += 0x2000;
+#if not defined(EXPERIMENTALZERO)
+			if (Net::Control::Command* command = Net::Control::Next())
+				RemoteCommandEmulating(fileBrowser, command, exitReason);
+#endif
+		}
+
 #if not defined(EXPERIMENTALZERO)
 		if (options.SoundOnGPIO() && headSoundCounter > 0)
 		{
@@ -1253,6 +1756,7 @@ void emulator()
 	m_IEC_Commands.SetAutoBootFB128(options.AutoBootFB128());
 	m_IEC_Commands.Set128BootSectorName(options.Get128BootSectorName());
 	m_IEC_Commands.SetLowercaseBrowseModeFilenames(options.LowercaseBrowseModeFilenames());
+	m_IEC_Commands.SetJiffyDOS(options.JiffyDOS());
 	m_IEC_Commands.SetNewDiskType(options.GetNewDiskType());
 
 	emulating = IEC_COMMANDS;
@@ -1376,6 +1880,10 @@ void emulator()
 						default:
 							break;
 					}
+#if not defined(EXPERIMENTALZERO)
+					if (emulating == IEC_COMMANDS)
+						RemoteCommandBrowsing(fileBrowser);
+#endif
 					usDelay(1);
 				}
 			}
@@ -1386,6 +1894,10 @@ void emulator()
 					fileBrowser->Update();
 					if (fileBrowser->SelectionsMade())
 						emulating = BeginEmulating(fileBrowser, fileBrowser->LastSelectionName());
+#if not defined(EXPERIMENTALZERO)
+					else
+						RemoteCommandBrowsing(fileBrowser);
+#endif
 					usDelay(1);
 				}
 			}
@@ -1520,6 +2032,25 @@ static void LoadOptions()
 	}
 }
 
+static void LoadImageProfiles()
+{
+	FIL fp;
+	FRESULT res;
+
+	res = f_open(&fp, "profiles.txt", FA_READ);
+	if (res == FR_OK)
+	{
+		u32 bytesRead;
+		SetACTLed(true);
+		f_read(&fp, s_u8Memory, sizeof(s_u8Memory) - 1, &bytesRead);
+		SetACTLed(false);
+		f_close(&fp);
+
+		s_u8Memory[bytesRead] = 0;
+		imageProfiles.Process((char*)s_u8Memory);
+	}
+}
+
 void DisplayOptions(int y_pos)
 {
 #if not defined(EXPERIMENTALZERO)
@@ -1902,6 +2433,7 @@ extern "C"
 		f_mount(&fileSystemSD, "SD:", 1);
 
 		LoadOptions();
+		LoadImageProfiles();
 
 		InitialiseHardware();
 		enable_MMU_and_IDCaches();
@@ -1929,6 +2461,9 @@ extern "C"
 #endif
 
 		InterruptSystemInitialize();
+
+		if (options.SDDMA())
+			m_EMMC.EnableDMA();
 #if not defined(EXPERIMENTALZERO)
 		TimerSystemInitialize();
 
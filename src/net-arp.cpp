@@ -93,17 +93,22 @@ namespace Net
 
 			Ethernet::Header ethernetHeader(targetMac, senderMac, Ethernet::EtherType::Arp);
 
-			uint8_t buffer[USPI_FRAME_BUFFER_SIZE];
+			const auto frame = Ethernet::AllocateFrame();
+			if (frame == nullptr)
+			{
+				DEBUG_LOG("Dropped ARP packet (no free frame)\r\n");
+				return;
+			}
+
 			size_t size = 0;
-			size += ethernetHeader.Serialize(buffer + size, sizeof(buffer) - size);
-			size += arpPacket.Serialize(buffer + size, sizeof(buffer) - size);
+			size += ethernetHeader.Serialize(frame->data + size, sizeof(frame->data) - size);
+			size += arpPacket.Serialize(frame->data + size, sizeof(frame->data) - size);
 
 			const auto expectedSize =
 				ethernetHeader.SerializedLength() + arpPacket.SerializedLength();
 			assert(size == expectedSize);
-			assert(size <= sizeof(buffer));
 
-			USPiSendFrame(buffer, size);
+			Ethernet::SendFrame(frame, size);
 		}
 
 		void SendRequest(
@@ -129,7 +134,7 @@ namespace Net
 			SendReply(Utils::MacBroadcast, mac, ip, ip);
 		}
 
-		void HandlePacket(
+		bool HandlePacket(
 			const Ethernet::Header ethernetHeader, const uint8_t* buffer, const size_t bufferSize)
 		{
 			const auto macAddress = Utils::GetMacAddress();
@@ -142,7 +147,7 @@ namespace Net
 					"Dropped ARP packet (invalid buffer size %u, expected %u)\r\n",
 					bufferSize,
 					arpPacket.SerializedLength());
-				return;
+				return false;
 			}
 
 			if (arpPacket.hardwareType != 1 ||
@@ -151,25 +156,80 @@ namespace Net
 			{
 				// Might want to disable because of spamminess
 				DEBUG_LOG("Dropped ARP packet (invalid parameters)\r\n");
-				return;
+				return false;
 			}
 
 			switch (arpPacket.operation)
 			{
 			case ARP_OPERATION_REQUEST:
+				// Whoever asks is about to talk to us, so remember them too.
+				Learn(arpPacket.senderIp, arpPacket.senderMac);
 				SendReply(arpPacket.senderMac, macAddress, arpPacket.senderIp, Utils::Ipv4Address);
-				break;
+				return true;
 
 			case ARP_OPERATION_REPLY:
-				ArpTable.insert(std::make_pair(arpPacket.senderIp, arpPacket.senderMac));
-				break;
+				Learn(arpPacket.senderIp, arpPacket.senderMac);
+				return true;
 
 			default:
 				DEBUG_LOG("Dropped ARP packet (invalid operation %d)\r\n", arpPacket.operation);
-				break;
+				return false;
 			}
 		}
 
-		std::unordered_map<uint32_t, Utils::MacAddress> ArpTable;
+		struct CacheEntry
+		{
+			uint32_t ip; // 0 for an unused entry
+			Utils::MacAddress mac;
+			uint32_t lastUsed;
+		};
+
+		static CacheEntry cache[ARP_CACHE_SIZE];
+		static uint32_t useCounter = 0;
+
+		void Learn(const uint32_t ip, const Utils::MacAddress& mac)
+		{
+			if (ip == 0)
+				return;
+
+			auto entry = &cache[0];
+			for (auto& candidate : cache)
+			{
+				if (candidate.ip == ip)
+				{
+					entry = &candidate;
+					break;
+				}
+				if (candidate.lastUsed < entry->lastUsed)
+					entry = &candidate;
+			}
+
+			entry->ip = ip;
+			entry->mac = mac;
+			entry->lastUsed = ++useCounter;
+		}
+
+		bool Resolve(const uint32_t ip, Utils::MacAddress& mac)
+		{
+			if (ip == Utils::Ipv4Broadcast)
+			{
+				mac = Utils::MacBroadcast;
+				return true;
+			}
+
+			for (auto& entry : cache)
+			{
+				if (entry.ip == ip && ip != 0)
+				{
+					mac = entry.mac;
+					entry.lastUsed = ++useCounter;
+					return true;
+				}
+			}
+
+			DEBUG_LOG("ARP cache miss for %08lx\r\n", ip);
+			SendRequest(Utils::MacBroadcast, Utils::GetMacAddress(), ip, Utils::Ipv4Address);
+			return false;
+		}
 	} // namespace Arp
 } // namespace Net
@@ -1,6 +1,4 @@
 #pragma once
-#include <unordered_map>
-
 #include "net-ethernet.h"
 #include "net-utils.h"
 
@@ -41,7 +39,8 @@ namespace Net
 			size_t Deserialize(const uint8_t* buffer, const size_t bufferSize);
 		};
 
-		void
+		// Returns false when the packet was dropped.
+		bool
 		HandlePacket(const Ethernet::Header header, const uint8_t* buffer, const size_t bufferSize);
 
 		void SendPacket(
@@ -65,6 +64,14 @@ namespace Net
 
 		void SendAnnouncement(const Utils::MacAddress mac, const uint32_t ip);
 
-		extern std::unordered_map<uint32_t, Utils::MacAddress> ArpTable;
+		const size_t ARP_CACHE_SIZE = 16;
+
+		// Remembers the MAC address last seen for ip. When the cache is full the entry used
+		// least recently makes way.
+		void Learn(const uint32_t ip, const Utils::MacAddress& mac);
+
+		// Looks ip up in the cache. On a miss it asks who has ip and returns false, so the
+		// caller drops its packet and the reply is there when it tries again.
+		bool Resolve(const uint32_t ip, Utils::MacAddress& mac);
 	} // namespace Arp
 } // namespace Net
@@ -0,0 +1,172 @@
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
+
+#include "net-control.h"
+#include "net-ethernet.h"
+#include "net-udp.h"
+#include "net-utils.h"
+
+#include "debug.h"
+
+namespace Net
+{
+	namespace Control
+	{
+		struct Name
+		{
+			const char* name;
+			Opcode opcode;
+		};
+
+		static const Name names[] = {
+			{"MOUNT", Opcode::Mount},
+			{"DISK", Opcode::Disk},
+			{"ROM", Opcode::Rom},
+			{"DEVICE", Opcode::Device},
+			{"RESET", Opcode::Reset},
+			{"EXIT", Opcode::Exit},
+			{"STATUS", Opcode::Status},
+		};
+
+		// The network core fills slots at queued and sends replies from replied. The emulation
+		// core works through them at done. Each counter has one writer.
+		static Command queue[NET_CONTROL_QUEUE_LENGTH];
+		static volatile unsigned queued = 0;
+		static volatile unsigned done = 0;
+		static unsigned replied = 0;
+		static bool enabled = false;
+
+		static const char* nameOf(const Opcode opcode)
+		{
+			for (const auto& name : names)
+				if (name.opcode == opcode)
+					return name.name;
+			return "";
+		}
+
+		static void sendReply(const uint32_t ip, const Udp::Port port, const char* reply)
+		{
+			const auto size = strlen(reply);
+			Ethernet::Frame* frame;
+			auto buffer = Udp::BeginPacket(frame, ip, Udp::Port::Control, port, size);
+			if (buffer == nullptr)
+			{
+				DEBUG_LOG("Control reply to %08lx not sent\r\n", ip);
+				return;
+			}
+
+			memcpy(buffer, reply, size);
+			Udp::SendPacket(frame, size);
+		}
+
+		void Enable()
+		{
+			enabled = true;
+		}
+
+		//
+		// The emulation core
+		//
+		Command* Next()
+		{
+			if (done == queued)
+			{
+				return nullptr;
+			}
+
+			// The slot was filled before queued moved on.
+			__sync_synchronize();
+			return &queue[done % NET_CONTROL_QUEUE_LENGTH];
+		}
+
+		void Complete(Command* command, const bool ok, const char* message)
+		{
+			snprintf(
+				command->reply,
+				sizeof(command->reply),
+				"%s %s%s%s",
+				ok ? "OK" : "ERR",
+				nameOf(command->opcode),
+				message[0] ? " " : "",
+				message);
+			__sync_synchronize();
+			done = done + 1;
+		}
+
+		//
+		// The network core
+		//
+		void Update()
+		{
+			while (replied != done)
+			{
+				__sync_synchronize();
+				const auto& command = queue[replied % NET_CONTROL_QUEUE_LENGTH];
+				sendReply(command.ip, command.port, command.reply);
+				replied++;
+			}
+		}
+
+		void HandlePacket(
+			const Ipv4::Header& ipv4Header,
+			const Udp::Header& udpHeader,
+			const uint8_t* buffer,
+			const size_t size)
+		{
+			if (!enabled)
+			{
+				return;
+			}
+
+			// The command's name, then its arguments after any spaces. A trailing newline (as
+			// nc sends) is dropped.
+			char text[NET_CONTROL_MAX_ARGUMENTS];
+			auto length = size < sizeof(text) - 1 ? size : sizeof(text) - 1;
+			memcpy(text, buffer, length);
+			while (length && (text[length - 1] == '\n' || text[length - 1] == '\r'))
+				length--;
+			text[length] = 0;
+
+			auto arguments = text;
+			while (*arguments && *arguments != ' ')
+				arguments++;
+			const auto nameLength = arguments - text;
+			while (*arguments == ' ')
+				arguments++;
+
+			const Name* found = nullptr;
+			for (const auto& name : names)
+				if (strlen(name.name) == nameLength && strncasecmp(name.name, text, nameLength) == 0)
+					found = &name;
+
+			char reply[NET_CONTROL_MAX_REPLY];
+			if (found == nullptr)
+			{
+				snprintf(
+					reply,
+					sizeof(reply),
+					"ERR %.*s unknown command",
+					static_cast<int>(nameLength),
+					text);
+				sendReply(ipv4Header.sourceIp, udpHeader.sourcePort, reply);
+				return;
+			}
+			if (queued - replied == NET_CONTROL_QUEUE_LENGTH)
+			{
+				snprintf(reply, sizeof(reply), "ERR %s busy", found->name);
+				sendReply(ipv4Header.sourceIp, udpHeader.sourcePort, reply);
+				return;
+			}
+
+			DEBUG_LOG("Control %s %s\r\n", found->name, arguments);
+			auto& command = queue[queued % NET_CONTROL_QUEUE_LENGTH];
+			command.opcode = found->opcode;
+			strcpy(command.arguments, arguments);
+			command.ip = ipv4Header.sourceIp;
+			command.port = udpHeader.sourcePort;
+			__sync_synchronize();
+			queued = queued + 1;
+		}
+	} // namespace Control
+} // namespace Net
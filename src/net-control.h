@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "net-ipv4.h"
+#include "net-udp.h"
+
+// Remote control lets a test rig drive a unit without anyone at the buttons. Each UDP datagram
+// to port 6542 is one text command; the reply goes back to the sender and starts with OK or ERR
+// followed by the command's name. Replies come back in the order the commands were sent.
+//
+//   MOUNT path[|name...]   Leave emulation if need be, then mount the image (or .lst) at path
+//                          and start emulating. Further names, separated by |, are images in
+//                          the same folder that fill the caddy behind it.
+//   DISK n                 Swap to the caddy's nth image (from 1)
+//   ROM name|n             Select a drive ROM by name or by its number (1-7). While emulating
+//                          the drive is reset onto it.
+//   DEVICE n               Change the device number (8-11) while browsing
+//   RESET                  Reset the emulated drive, or the IEC command state while browsing
+//   EXIT                   Leave emulation, writing changed images back
+//   STATUS                 What the unit is doing
+//
+// The network core only parses commands and queues them. The emulation core takes them from
+// the queue when it gets to them, so its timing is undisturbed, and the network core sends the
+// replies it leaves behind.
+namespace Net
+{
+	namespace Control
+	{
+		const size_t NET_CONTROL_QUEUE_LENGTH = 8;
+		const size_t NET_CONTROL_MAX_ARGUMENTS = 256;
+		const size_t NET_CONTROL_MAX_REPLY = 256;
+
+		enum class Opcode : uint8_t
+		{
+			Mount,
+			Disk,
+			Rom,
+			Device,
+			Reset,
+			Exit,
+			Status,
+		};
+
+		struct Command
+		{
+			Opcode opcode;
+			// What followed the command's name, with leading spaces removed
+			char arguments[NET_CONTROL_MAX_ARGUMENTS];
+			char reply[NET_CONTROL_MAX_REPLY];
+
+			// Who to reply to
+			uint32_t ip;
+			Udp::Port port;
+		};
+
+		// Commands are ignored until this is called (RemoteControl in options.txt).
+		void Enable();
+
+		// The emulation core's side. Next returns the oldest command not yet done, or nullptr;
+		// it only compares two counters so it can be polled often. Complete hands the reply
+		// (OK or ERR then the command's name then message) back to be sent.
+		Command* Next();
+		void Complete(Command* command, const bool ok, const char* message);
+
+		void Update();
+		void HandlePacket(
+			const Ipv4::Header& ipv4Header,
+			const Udp::Header& udpHeader,
+			const uint8_t* buffer,
+			const size_t size);
+	} // namespace Control
+} // namespace Net
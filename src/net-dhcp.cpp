@@ -1,6 +1,7 @@
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
-#include <random>
 
 #include "net-dhcp.h"
 #include "net-ethernet.h"
@@ -8,8 +9,13 @@
 #include "net-udp.h"
 
 #include "debug.h"
+#include "ff.h"
 #include "types.h"
-#include <uspi.h>
+
+extern "C"
+{
+#include "rpiHardware.h"
+}
 
 namespace Net
 {
@@ -23,7 +29,7 @@ namespace Net
 			hops(0),
 			transactionId(transactionId),
 			secondsElapsed(0),
-			flags(0), // TODO assumption
+			flags(0),
 			clientIpAddress(0),
 			yourIpAddress(0),
 			serverIpAddress(0),
@@ -66,6 +72,10 @@ namespace Net
 			buffer[i++] = yourIpAddress >> 16;
 			buffer[i++] = yourIpAddress >> 8;
 			buffer[i++] = yourIpAddress;
+			buffer[i++] = serverIpAddress >> 24;
+			buffer[i++] = serverIpAddress >> 16;
+			buffer[i++] = serverIpAddress >> 8;
+			buffer[i++] = serverIpAddress;
 			buffer[i++] = relayIpAddress >> 24;
 			buffer[i++] = relayIpAddress >> 16;
 			buffer[i++] = relayIpAddress >> 8;
@@ -117,126 +127,429 @@ namespace Net
 			return 240;
 		}
 
+		enum class State
+		{
+			Stopped,
+			InitReboot,
+			Selecting,
+			Requesting,
+			Bound,
+			Renewing,
+			Rebinding,
+		};
+
+		// BOOTP relays may drop anything shorter, so the options are padded out to this.
+		static const size_t MESSAGE_LENGTH = 300;
+
+		static const uint32_t FIRST_RETRY_US = 1000000;
+		static const uint32_t MAX_RETRY_US = 32000000;
+		// Asking for the cached lease is given 1 + 2 seconds before discovering instead, and
+		// a server that offered an address but doesn't answer requests for it 1 + 2 + 4 + 8.
+		static const unsigned INIT_REBOOT_ATTEMPTS = 2;
+		static const unsigned REQUEST_ATTEMPTS = 4;
+		// Used when an ACK carries no lease time.
+		static const uint32_t DEFAULT_LEASE_SECONDS = 3600;
+		static const uint32_t INFINITE_LEASE = 0xFFFFFFFF;
+
+		static const uint8_t parameterRequestList[] = {
+			static_cast<uint8_t>(Option::SubnetMask),
+			static_cast<uint8_t>(Option::Router),
+			static_cast<uint8_t>(Option::LeaseTime),
+			static_cast<uint8_t>(Option::RenewalTime),
+			static_cast<uint8_t>(Option::RebindingTime),
+		};
+
+		struct Lease
+		{
+			uint32_t ip;
+			uint32_t server;
+		};
+
+		// What a reply's options said. Times are in seconds and 0 when absent.
+		struct Reply
+		{
+			MessageType type;
+			uint32_t server;
+			uint32_t leaseTime;
+			uint32_t renewalTime;
+			uint32_t rebindingTime;
+		};
+
+		static State state = State::Stopped;
+		static void (*boundCallback)() = nullptr;
+		static Lease lease = {0, 0};
+		static uint32_t offeredIp;
+		static uint32_t offeredServer;
+
 		static uint32_t transactionId;
-		static std::vector<uint32_t> offeredIpAddresses;
-		static std::vector<uint32_t> serverIpAddresses;
-		static std::vector<Utils::MacAddress> serverMacAddresses;
-		static bool serverSelected;
+		static uint64_t startedAt;
+		static uint64_t nextSendAt;
+		static uint32_t retryUs;
+		static unsigned attempts;
+
+		// When the lease was obtained and, from then, when to renew it, rebind it and give it up.
+		static uint64_t boundAt;
+		static uint64_t renewUs;
+		static uint64_t rebindUs;
+		static uint64_t leaseUs;
+
+		// FatFs isn't reentrant, so the network core only leaves the lease's text here and the
+		// emulation core writes it. The version is odd while the text is being changed.
+		static char leaseText[64];
+		static volatile unsigned leaseVersion = 0;
+		static unsigned writtenVersion = 0;
+
+		// Lease times run to days, longer than the low timer word lasts.
+		static uint64_t now()
+		{
+			return static_cast<uint64_t>(read32(ARM_SYSTIMER_CHI)) << 32 |
+				read32(ARM_SYSTIMER_CLO);
+		}
+
+		static bool parseIp(const char* text, uint32_t& address)
+		{
+			unsigned int ip[4];
+			if (sscanf(text, "%u.%u.%u.%u", &ip[0], &ip[1], &ip[2], &ip[3]) != 4)
+			{
+				return false;
+			}
+
+			address = ip[0] << 24 | ip[1] << 16 | ip[2] << 8 | ip[3];
+			return true;
+		}
+
+		static void loadLease()
+		{
+			FIL file;
+			if (f_open(&file, DHCP_LEASE_FILE, FA_READ) != FR_OK)
+			{
+				return;
+			}
+
+			char text[64];
+			UINT bytesRead = 0;
+			f_read(&file, text, sizeof(text) - 1, &bytesRead);
+			f_close(&file);
+			text[bytesRead] = 0;
+
+			auto server = strchr(text, ' ');
+			if (server == nullptr || !parseIp(text, lease.ip) || !parseIp(server + 1, lease.server))
+			{
+				DEBUG_LOG("Ignored %s\r\n", DHCP_LEASE_FILE);
+				lease = {0, 0};
+			}
+		}
 
-		void sendRequest(
-			uint32_t clientIpAddress, Utils::MacAddress serverMacAddress, uint32_t serverIpAddress)
+		// The lease only changes when the unit moves to another network or the server hands out
+		// a different address.
+		static void saveLease()
 		{
-			const Header dhcpHeader(Opcode::BootRequest, transactionId);
-
-			size_t udpLength = dhcpHeader.SerializedLength() + Udp::Header::SerializedLength();
-			const Udp::Header udpHeader(Udp::Port::DhcpClient, Udp::Port::DhcpServer, udpLength);
-
-			size_t ipv4Length = udpLength + Ipv4::Header::SerializedLength();
-			const Ipv4::Header ipv4Header(
-				Ipv4::Protocol::Udp, clientIpAddress, serverIpAddress, ipv4Length);
-			const Ethernet::Header ethernetHeader(
-				serverMacAddress, Utils::GetMacAddress(), Ethernet::EtherType::Ipv4);
-
-			uint8_t buffer[USPI_FRAME_BUFFER_SIZE];
-			size_t size = 0;
-			size += ethernetHeader.Serialize(buffer + size, sizeof(buffer) - size);
-			size += ipv4Header.Serialize(buffer + size, sizeof(buffer) - size);
-			size += udpHeader.Serialize(buffer + size, sizeof(buffer) - size);
-			size += dhcpHeader.Serialize(buffer + size, sizeof(buffer) - size);
-
-			const auto expectedSize = ethernetHeader.SerializedLength() +
-				ipv4Header.SerializedLength() + udpHeader.SerializedLength() +
-				dhcpHeader.SerializedLength();
-			assert(size == expectedSize);
-			assert(size <= sizeof(buffer));
-
-			USPiSendFrame(buffer, size);
+			leaseVersion = leaseVersion + 1;
+			__sync_synchronize();
+			snprintf(
+				leaseText,
+				sizeof(leaseText),
+				"%lu.%lu.%lu.%lu %lu.%lu.%lu.%lu\r\n",
+				lease.ip >> 24,
+				(lease.ip >> 16) & 0xFF,
+				(lease.ip >> 8) & 0xFF,
+				lease.ip & 0xFF,
+				lease.server >> 24,
+				(lease.server >> 16) & 0xFF,
+				(lease.server >> 8) & 0xFF,
+				lease.server & 0xFF);
+			__sync_synchronize();
+			leaseVersion = leaseVersion + 1;
 		}
 
-		void discoverTimerHandler(unsigned int, void* callbackVoid, void*)
+		void WriteLease()
 		{
-			if (transactionId == 0 || offeredIpAddresses.empty())
+			const unsigned version = leaseVersion;
+			if (version == writtenVersion || (version & 1))
 			{
-				// TODO retry every minute or so?
 				return;
 			}
 
-			// Select the first IP address
-			Utils::Ipv4Address = offeredIpAddresses[0];
+			__sync_synchronize();
+			char text[sizeof(leaseText)];
+			std::memcpy(text, leaseText, sizeof(text));
+			__sync_synchronize();
+			if (leaseVersion != version)
+			{
+				// Changed while it was being copied, so try again next time.
+				return;
+			}
+			writtenVersion = version;
 
-			// Send DHCP Requests to every server with that IP address.
-			for (size_t i = 0; i < serverIpAddresses.size(); i++)
+			FIL file;
+			if (f_open(&file, DHCP_LEASE_FILE, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
 			{
-				sendRequest(Utils::Ipv4Address, serverMacAddresses[i], serverIpAddresses[i]);
+				DEBUG_LOG("Can not write %s\r\n", DHCP_LEASE_FILE);
+				return;
 			}
 
-			// Run the callback indicating an IP has been obtained
-			if (callbackVoid != nullptr)
+			UINT bytesWritten;
+			f_write(&file, text, std::strlen(text), &bytesWritten);
+			f_close(&file);
+		}
+
+		static void enter(const State newState)
+		{
+			// A request for an offered address carries on the exchange the discover began.
+			if (newState != State::Requesting)
 			{
-				const auto& callback = *static_cast<std::function<void()>*>(callbackVoid);
-				callback();
+				transactionId = std::rand();
+				startedAt = now();
 			}
+			state = newState;
+			nextSendAt = now();
+			retryUs = FIRST_RETRY_US;
+			attempts = 0;
 		}
 
-		void sendDiscover()
+		static size_t putOption(
+			uint8_t* buffer, const Option option, const uint8_t* data, const size_t length)
 		{
-			transactionId = std::rand();
-			offeredIpAddresses.clear();
-			const Header dhcpHeader(Opcode::BootRequest, transactionId);
+			buffer[0] = static_cast<uint8_t>(option);
+			buffer[1] = length;
+			std::memcpy(buffer + 2, data, length);
+			return length + 2;
+		}
 
-			size_t udpLength = dhcpHeader.SerializedLength() + Udp::Header::SerializedLength();
-			const Udp::Header udpHeader(Udp::Port::DhcpClient, Udp::Port::DhcpServer, udpLength);
+		static size_t putOption32(uint8_t* buffer, const Option option, const uint32_t value)
+		{
+			const uint8_t data[] = {
+				static_cast<uint8_t>(value >> 24),
+				static_cast<uint8_t>(value >> 16),
+				static_cast<uint8_t>(value >> 8),
+				static_cast<uint8_t>(value),
+			};
+			return putOption(buffer, option, data, sizeof(data));
+		}
 
-			size_t ipv4Length = udpLength + Ipv4::Header::SerializedLength();
-			const Ipv4::Header ipv4Header(Ipv4::Protocol::Udp, 0, 0xFFFFFFFF, ipv4Length);
-			const Ethernet::Header ethernetHeader(
-				Utils::GetMacAddress(), Ethernet::EtherType::Ipv4);
+		// Sends what the state calls for: a DISCOVER while selecting and a REQUEST otherwise,
+		// broadcast unless renewing with the server that granted the lease.
+		static void send()
+		{
+			const auto renewing = state == State::Renewing;
+			const auto destination = renewing ? lease.server : Utils::Ipv4Broadcast;
 
-			uint8_t buffer[USPI_FRAME_BUFFER_SIZE];
-			size_t size = 0;
+			Ethernet::Frame* frame;
+			auto buffer = Udp::BeginPacket(
+				frame, destination, Udp::Port::DhcpClient, Udp::Port::DhcpServer, MESSAGE_LENGTH);
+			if (buffer == nullptr)
+			{
+				DEBUG_LOG("DHCP message not sent\r\n");
+				return;
+			}
 
-			size += ethernetHeader.Serialize(buffer + size, sizeof(buffer) - size);
-			size += ipv4Header.Serialize(buffer + size, sizeof(buffer) - size);
-			size += udpHeader.Serialize(buffer + size, sizeof(buffer) - size);
-			size += dhcpHeader.Serialize(buffer + size, sizeof(buffer) - size);
+			Header header(Opcode::BootRequest, transactionId);
+			const auto elapsed = (now() - startedAt) / 1000000;
+			header.secondsElapsed = elapsed < 0xFFFF ? elapsed : 0xFFFF;
+			if (renewing || state == State::Rebinding)
+			{
+				header.clientIpAddress = lease.ip;
+			}
+			else
+			{
+				header.flags = DHCP_FLAG_BROADCAST;
+			}
 
-			const auto expectedSize = ethernetHeader.SerializedLength() +
-				ipv4Header.SerializedLength() + udpHeader.SerializedLength() +
-				dhcpHeader.SerializedLength();
-			assert(size == expectedSize);
-			assert(size <= sizeof(buffer));
+			std::memset(buffer, 0, MESSAGE_LENGTH);
+			auto i = header.Serialize(buffer, MESSAGE_LENGTH);
 
-			USPiSendFrame(buffer, size);
+			const auto type = static_cast<uint8_t>(
+				state == State::Selecting ? MessageType::Discover : MessageType::Request);
+			i += putOption(buffer + i, Option::MessageType, &type, sizeof(type));
+			if (state == State::InitReboot)
+			{
+				i += putOption32(buffer + i, Option::RequestedIpAddress, lease.ip);
+			}
+			else if (state == State::Requesting)
+			{
+				i += putOption32(buffer + i, Option::RequestedIpAddress, offeredIp);
+				i += putOption32(buffer + i, Option::ServerIdentifier, offeredServer);
+			}
+			i += putOption(
+				buffer + i,
+				Option::ParameterRequestList,
+				parameterRequestList,
+				sizeof(parameterRequestList));
+			buffer[i++] = static_cast<uint8_t>(Option::End);
+			assert(i <= MESSAGE_LENGTH);
+
+			Udp::SendPacket(frame, MESSAGE_LENGTH);
 		}
 
-		void ObtainIp(std::function<void()>& callback)
+		static void bind(const Header& header, const Reply& reply)
 		{
-			sendDiscover();
+			const auto server = reply.server ? reply.server : header.serverIpAddress;
+			const auto changed = lease.ip != header.yourIpAddress || lease.server != server;
+			const auto hadAddress = Utils::Ipv4Address == header.yourIpAddress;
+
+			lease.ip = header.yourIpAddress;
+			lease.server = server;
+			state = State::Bound;
+			boundAt = now();
 
-			// Wait three seconds for responses
-			// const auto callbackVoid = static_cast<void*>(&callback);
-			// StartKernelTimer(3 * HZ, discoverTimerHandler, callbackVoid, nullptr);
+			const auto leaseTime = reply.leaseTime ? reply.leaseTime : DEFAULT_LEASE_SECONDS;
+			if (leaseTime == INFINITE_LEASE)
+			{
+				// Far enough off never to come, without overflowing boundAt + leaseUs.
+				leaseUs = renewUs = rebindUs = ~0ull >> 2;
+			}
+			else
+			{
+				leaseUs = leaseTime * 1000000ull;
+				renewUs = reply.renewalTime ? reply.renewalTime * 1000000ull : leaseUs / 2;
+				rebindUs = reply.rebindingTime ? reply.rebindingTime * 1000000ull : leaseUs / 8 * 7;
+			}
+
+			DEBUG_LOG("DHCP lease for %lu seconds\r\n", leaseTime);
+			if (changed)
+			{
+				saveLease();
+			}
+
+			Utils::Ipv4Address = lease.ip;
+			if (!hadAddress && boundCallback != nullptr)
+			{
+				boundCallback();
+			}
 		}
 
-		static void
-		handleOfferPacket(const Ethernet::Header ethernetHeader, const Header dhcpHeader)
+		static void parseOptions(const uint8_t* buffer, const size_t size, Reply& reply)
 		{
-			offeredIpAddresses.push_back(dhcpHeader.yourIpAddress);
-			serverIpAddresses.push_back(dhcpHeader.serverIpAddress);
-			serverMacAddresses.push_back(ethernetHeader.macSource);
+			std::memset(&reply, 0, sizeof(reply));
+
+			size_t i = 0;
+			while (i < size)
+			{
+				const auto option = static_cast<Option>(buffer[i++]);
+				if (option == Option::End)
+					break;
+				if (option == Option::Pad)
+					continue;
+				if (i == size || i + 1 + buffer[i] > size)
+					break;
+
+				const auto length = buffer[i++];
+				const auto data = buffer + i;
+				i += length;
+
+				const auto value32 = length == 4
+					? static_cast<uint32_t>(data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3])
+					: 0;
+				switch (option)
+				{
+				case Option::MessageType:
+					if (length == 1)
+						reply.type = static_cast<MessageType>(data[0]);
+					break;
+				case Option::ServerIdentifier:
+					reply.server = value32;
+					break;
+				case Option::LeaseTime:
+					reply.leaseTime = value32;
+					break;
+				case Option::RenewalTime:
+					reply.renewalTime = value32;
+					break;
+				case Option::RebindingTime:
+					reply.rebindingTime = value32;
+					break;
+				default:
+					break;
+				}
+			}
+		}
+
+		void Initialize(void (*bound)())
+		{
+			boundCallback = bound;
+			loadLease();
+			if (lease.ip)
+			{
+				DEBUG_LOG(
+					"Cached lease %ld.%ld.%ld.%ld\r\n",
+					lease.ip >> 24,
+					(lease.ip >> 16) & 0xFF,
+					(lease.ip >> 8) & 0xFF,
+					lease.ip & 0xFF);
+			}
 		}
 
-		static void handleAckPacket(const Ethernet::Header ethernetHeader, const Header dhcpHeader)
+		void Start()
 		{
-			Utils::Ipv4Address = dhcpHeader.yourIpAddress;
+			// Units powered on together would otherwise pick the same transaction IDs.
+			static bool seeded = false;
+			if (!seeded)
+			{
+				const auto mac = Utils::GetMacAddress();
+				std::srand(read32(ARM_SYSTIMER_CLO) ^ mac[2] << 24 ^ mac[3] << 16 ^ mac[4] << 8 ^ mac[5]);
+				seeded = true;
+			}
 
-			// TODO Schedule handler for end of lease.
+			// The address is only ours again once the server says so.
+			Utils::Ipv4Address = 0;
+			enter(lease.ip ? State::InitReboot : State::Selecting);
+		}
 
-			transactionId = 0;
-			offeredIpAddresses.clear();
-			serverIpAddresses.clear();
-			serverMacAddresses.clear();
-			serverSelected = false;
+		void Stop()
+		{
+			state = State::Stopped;
+		}
+
+		void Update()
+		{
+			if (state == State::Stopped)
+			{
+				return;
+			}
+
+			const auto time = now();
+			if (state == State::Bound || state == State::Renewing || state == State::Rebinding)
+			{
+				if (time - boundAt >= leaseUs)
+				{
+					DEBUG_LOG("DHCP lease expired\r\n");
+					Utils::Ipv4Address = 0;
+					enter(State::Selecting);
+				}
+				else if (state != State::Rebinding && time - boundAt >= rebindUs)
+				{
+					enter(State::Rebinding);
+				}
+				else if (state == State::Bound && time - boundAt >= renewUs)
+				{
+					enter(State::Renewing);
+				}
+				else if (state == State::Bound)
+				{
+					return;
+				}
+			}
+
+			if (time < nextSendAt)
+			{
+				return;
+			}
+
+			if ((state == State::InitReboot && attempts == INIT_REBOOT_ATTEMPTS) ||
+				(state == State::Requesting && attempts == REQUEST_ATTEMPTS))
+			{
+				DEBUG_LOG("DHCP request unanswered, discovering\r\n");
+				enter(State::Selecting);
+			}
+
+			send();
+			attempts++;
+
+			// Up to a quarter either side of the interval.
+			const auto jitter = static_cast<int32_t>(std::rand() % (retryUs / 2)) -
+				static_cast<int32_t>(retryUs / 4);
+			nextSendAt = time + static_cast<uint32_t>(static_cast<int32_t>(retryUs) + jitter);
+			retryUs = retryUs * 2 < MAX_RETRY_US ? retryUs * 2 : MAX_RETRY_US;
 		}
 
 		void
@@ -261,14 +574,32 @@ namespace Net
 				return;
 			if (header.transactionId != transactionId)
 				return;
+			if (state == State::Stopped || state == State::Bound)
+				return;
+			const auto mac = Utils::GetMacAddress();
+			if (std::memcmp(header.clientHardwareAddress.data(), mac.data(), mac.size()) != 0)
+				return;
+
+			Reply reply;
+			parseOptions(buffer + dhcpSize, size - dhcpSize, reply);
 
-			if (!serverSelected)
+			if (reply.type == MessageType::Offer && state == State::Selecting)
 			{
-				handleOfferPacket(ethernetHeader, header);
+				// The first offer is taken; waiting for more would only slow booting.
+				offeredIp = header.yourIpAddress;
+				offeredServer = reply.server ? reply.server : header.serverIpAddress;
+				enter(State::Requesting);
 			}
-			else
+			else if (reply.type == MessageType::Ack && state != State::Selecting)
+			{
+				bind(header, reply);
+			}
+			else if (reply.type == MessageType::Nak && state != State::Selecting)
 			{
-				handleAckPacket(ethernetHeader, header);
+				DEBUG_LOG("DHCP request refused\r\n");
+				Utils::Ipv4Address = 0;
+				lease = {0, 0};
+				enter(State::Selecting);
 			}
 		}
 	} // namespace Dhcp
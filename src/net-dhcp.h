@@ -1,19 +1,58 @@
 #pragma once
-#include <functional>
-
 #include "net-ethernet.h"
 #include "net.h"
 
+// The DHCP client runs from Net::Update, so nothing waits on it. A unit that had an address
+// before asks for it again straight away (INIT-REBOOT) and falls back to discovering a server
+// if that isn't answered. Unanswered messages are repeated after 1, 2, 4... up to 32 seconds,
+// give or take a little so a rack of units powered on together doesn't send in step.
+//
+// The lease is kept in DHCP_LEASE_FILE on the SD card and only rewritten when the address or
+// the server changes.
 namespace Net
 {
 	namespace Dhcp
 	{
+		const char* const DHCP_LEASE_FILE = "/dhcp_lease.txt";
+
 		enum class Opcode : uint8_t
 		{
 			BootRequest = 1,
 			BootReply = 2,
 		};
 
+		enum class MessageType : uint8_t
+		{
+			Discover = 1,
+			Offer = 2,
+			Request = 3,
+			Decline = 4,
+			Ack = 5,
+			Nak = 6,
+			Release = 7,
+			Inform = 8,
+		};
+
+		// The options (RFC 2132) that are sent or looked at.
+		enum class Option : uint8_t
+		{
+			Pad = 0,
+			SubnetMask = 1,
+			Router = 3,
+			RequestedIpAddress = 50,
+			LeaseTime = 51,
+			MessageType = 53,
+			ServerIdentifier = 54,
+			ParameterRequestList = 55,
+			RenewalTime = 58,
+			RebindingTime = 59,
+			End = 255,
+		};
+
+		// Asks the server to broadcast its replies, as IPv4 drops anything addressed to an
+		// address we don't have yet.
+		const uint16_t DHCP_FLAG_BROADCAST = 0x8000;
+
 		struct Header
 		{
 			/// Message op code / message type. 1 = BOOTREQUEST, 2 = BOOTREPLY
@@ -81,7 +120,20 @@ namespace Net
 			static size_t Deserialize(Header& out, const uint8_t* buffer, const size_t size);
 		};
 
-		void ObtainIp(std::function<void()>& callback);
+		// Reads the cached lease. Call it before the emulation core starts as it uses FatFs.
+		// bound is called whenever an address is obtained, but not when a lease is renewed.
+		void Initialize(void (*bound)());
+
+		// Called on the emulation core when it isn't using FatFs itself. Writes the lease if it
+		// has changed since it was last written.
+		void WriteLease();
+
+		// The link came up or went down. The lease is kept while the link is down and asked
+		// for again when it comes back, as the unit may have been moved to another network.
+		void Start();
+		void Stop();
+
+		void Update();
 		void
 		HandlePacket(const Ethernet::Header& ethernetHeader, const uint8_t* buffer, size_t size);
 	} // namespace Dhcp
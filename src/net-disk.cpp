@@ -0,0 +1,665 @@
+#include <cstring>
+
+#include "net-disk.h"
+#include "net-ethernet.h"
+#include "net-udp.h"
+#include "net-utils.h"
+
+#include "debug.h"
+#include "types.h"
+
+extern "C"
+{
+#include "rpiHardware.h"
+}
+
+namespace Net
+{
+	namespace Disk
+	{
+		// How long to wait for a reply before asking again, and how many times to ask.
+		static const uint32_t TIMEOUT_US = 100000;
+		static const unsigned MAX_RETRIES = 5;
+		// Once the server stops answering it is left alone this long.
+		static const uint32_t OFFLINE_US = 5000000;
+		// How long the drive waits for the track under its head. It has just stepped, so the computer
+		// is waiting on it and a stall about as long as the head takes to settle goes unnoticed.
+		// Longer and the emulation falls behind the bus, so the drive carries on over a blank
+		// track instead, and the track turns up in it when it arrives.
+		static const uint32_t FETCH_WAIT_US = 20000;
+		static const unsigned NO_TRACK = ~0u;
+
+		struct Image
+		{
+			DiskImage* diskImage; // nullptr for a free slot
+			uint16_t handle;
+			// The track being fetched or written back and how far it has got
+			unsigned track;
+			uint16_t offset;
+			// Tracks nearest this one are fetched first
+			unsigned nearTrack;
+			bool releasing;
+			bool writeFailed;
+		};
+
+		enum class Command : uint8_t
+		{
+			None,
+			Mount,
+			Attach,
+			Release,
+		};
+
+		// Requests from the emulation core, which posts one and waits until it is done.
+		struct Mailbox
+		{
+			volatile Command command;
+			volatile bool done;
+			bool result;
+			DiskImage* diskImage;
+			char name[NET_DISK_MAX_NAME_LENGTH];
+
+			// From the Mount reply
+			uint16_t handle;
+			bool readOnly;
+			uint32_t hash;
+			unsigned short lengths[HALF_TRACK_COUNT];
+			unsigned char densities[HALF_TRACK_COUNT];
+			bool used[HALF_TRACK_COUNT];
+		};
+
+		// There is only ever one request waiting for its reply.
+		struct Request
+		{
+			bool active;
+			Header header;
+			Image* image;
+			uint32_t sentAt;
+			unsigned retries;
+		};
+
+		class Source : public TrackSource
+		{
+		public:
+			bool FetchTrack(DiskImage* diskImage, unsigned track) override;
+			bool Release(DiskImage* diskImage) override;
+		};
+
+		static Image images[NET_DISK_MAX_IMAGES];
+		static unsigned lastImageIndex = 0;
+		static Mailbox mailbox;
+		static Request request;
+		static Source source;
+		static uint32_t serverIp = 0;
+		static uint16_t nextSequence = 0;
+		static volatile bool offline = false;
+		static uint32_t offlineSince;
+		static bool linkUp = false;
+		// The track the drive is waiting for
+		static DiskImage* volatile wantedImage = nullptr;
+		static volatile unsigned wantedTrack;
+
+		//
+		// Header
+		//
+		Header::Header() {}
+
+		Header::Header(Opcode opcode, uint16_t sequence, uint16_t handle) :
+			opcode(opcode),
+			status(Status::Ok),
+			sequence(sequence),
+			handle(handle),
+			track(0),
+			flags(0),
+			offset(0),
+			length(0)
+		{
+		}
+
+		size_t Header::Serialize(uint8_t* buffer, const size_t bufferSize) const
+		{
+			if (bufferSize < SerializedLength())
+			{
+				return 0;
+			}
+
+			size_t i = 0;
+			buffer[i++] = static_cast<uint8_t>(opcode);
+			buffer[i++] = static_cast<uint8_t>(status);
+			buffer[i++] = sequence >> 8;
+			buffer[i++] = sequence;
+			buffer[i++] = handle >> 8;
+			buffer[i++] = handle;
+			buffer[i++] = track;
+			buffer[i++] = flags;
+			buffer[i++] = offset >> 8;
+			buffer[i++] = offset;
+			buffer[i++] = length >> 8;
+			buffer[i++] = length;
+			return i;
+		}
+
+		size_t Header::Deserialize(const uint8_t* buffer, const size_t bufferSize)
+		{
+			if (bufferSize < SerializedLength())
+			{
+				return 0;
+			}
+
+			opcode = static_cast<Opcode>(buffer[0]);
+			status = static_cast<Status>(buffer[1]);
+			sequence = buffer[2] << 8 | buffer[3];
+			handle = buffer[4] << 8 | buffer[5];
+			track = buffer[6];
+			flags = buffer[7];
+			offset = buffer[8] << 8 | buffer[9];
+			length = buffer[10] << 8 | buffer[11];
+			return SerializedLength();
+		}
+
+		void SetServer(const uint32_t ip)
+		{
+			serverIp = ip;
+		}
+
+		//
+		// The network core
+		//
+		static void finish(const bool result)
+		{
+			mailbox.result = result;
+			__sync_synchronize();
+			mailbox.done = true;
+		}
+
+		static Image* findImage(const DiskImage* diskImage)
+		{
+			for (auto& image : images)
+				if (image.diskImage && image.diskImage == diskImage)
+					return &image;
+			return nullptr;
+		}
+
+		static Image* freeImage()
+		{
+			for (auto& image : images)
+				if (image.diskImage == nullptr)
+					return &image;
+			return nullptr;
+		}
+
+		static void sendRequest()
+		{
+			request.sentAt = read32(ARM_SYSTIMER_CLO);
+
+			// A read's length is what it wants back, so only mounts and writes carry data.
+			const size_t dataSize =
+				request.header.opcode == Opcode::Read ? 0 : request.header.length;
+			const auto size = Header::SerializedLength() + dataSize;
+
+			Ethernet::Frame* frame;
+			auto buffer =
+				Udp::BeginPacket(frame, serverIp, Udp::Port::NetDisk, Udp::Port::NetDisk, size);
+			if (buffer == nullptr)
+			{
+				// Sent again when it times out
+				return;
+			}
+
+			buffer += request.header.Serialize(buffer, size);
+			if (request.header.opcode == Opcode::Mount)
+			{
+				std::memcpy(buffer, mailbox.name, dataSize);
+			}
+			else if (request.header.opcode == Opcode::Write)
+			{
+				const auto track = request.image->diskImage->TrackData(request.header.track);
+				std::memcpy(buffer, track + request.header.offset, dataSize);
+			}
+			Udp::SendPacket(frame, size);
+		}
+
+		static void startRequest(
+			const Opcode opcode,
+			Image* image,
+			const unsigned track = 0,
+			const uint16_t offset = 0,
+			const uint16_t length = 0)
+		{
+			request.active = true;
+			request.header = Header(opcode, ++nextSequence, image ? image->handle : 0);
+			request.header.track = track;
+			request.header.offset = offset;
+			request.header.length = length;
+			request.image = image;
+			request.retries = 0;
+			sendRequest();
+		}
+
+		// Reads the next piece of the track being fetched.
+		static void startRead(Image& image)
+		{
+			const auto trackLength = image.diskImage->TrackLength(image.track);
+			const auto remaining = trackLength - image.offset;
+			const auto length = remaining < NET_DISK_CHUNK_SIZE ? remaining : NET_DISK_CHUNK_SIZE;
+			startRequest(Opcode::Read, &image, image.track, image.offset, length);
+		}
+
+		// Writes the next piece of a track the drive changed, or closes the image after the last.
+		static void continueRelease(Image& image)
+		{
+			const auto diskImage = image.diskImage;
+			while (image.track < HALF_TRACK_COUNT &&
+				(!diskImage->IsTrackDirty(image.track) ||
+				 image.offset >= diskImage->TrackLength(image.track)))
+			{
+				image.track++;
+				image.offset = 0;
+			}
+
+			if (image.track == HALF_TRACK_COUNT)
+			{
+				startRequest(Opcode::Close, &image);
+				return;
+			}
+
+			const auto remaining = diskImage->TrackLength(image.track) - image.offset;
+			const auto length = remaining < NET_DISK_CHUNK_SIZE ? remaining : NET_DISK_CHUNK_SIZE;
+			startRequest(Opcode::Write, &image, image.track, image.offset, length);
+		}
+
+		static void forget(Image& image)
+		{
+			image.diskImage = nullptr;
+		}
+
+		static unsigned nearestMissingTrack(const Image& image)
+		{
+			for (unsigned distance = 0; distance < HALF_TRACK_COUNT; ++distance)
+			{
+				const auto above = image.nearTrack + distance;
+				if (above < HALF_TRACK_COUNT && !image.diskImage->IsTrackLoaded(above))
+					return above;
+				const auto below = image.nearTrack - distance;
+				if (distance <= image.nearTrack && !image.diskImage->IsTrackLoaded(below))
+					return below;
+			}
+			return NO_TRACK;
+		}
+
+		// Takes on the emulation core's request, if there is one.
+		static bool startCommand()
+		{
+			if (mailbox.command == Command::None || mailbox.done)
+				return false;
+			__sync_synchronize();
+
+			switch (mailbox.command)
+			{
+			case Command::Mount:
+				if (serverIp == 0 || !linkUp || freeImage() == nullptr)
+				{
+					finish(false);
+					return false;
+				}
+				startRequest(
+					Opcode::Mount, nullptr, 0, 0, strnlen(mailbox.name, sizeof(mailbox.name)));
+				return true;
+
+			case Command::Attach:
+			{
+				// Mount made sure there was room.
+				auto image = freeImage();
+				image->diskImage = mailbox.diskImage;
+				image->handle = mailbox.handle;
+				image->track = NO_TRACK;
+				image->offset = 0;
+				image->nearTrack = 18 * 2;
+				image->releasing = false;
+				image->writeFailed = false;
+				finish(true);
+				return false;
+			}
+
+			case Command::Release:
+			{
+				auto image = findImage(mailbox.diskImage);
+				if (image == nullptr)
+				{
+					finish(true);
+					return false;
+				}
+				if (!linkUp)
+				{
+					DEBUG_LOG("Lost changes to a network disk (no link)\r\n");
+					forget(*image);
+					finish(false);
+					return false;
+				}
+				if (!image->releasing)
+				{
+					image->releasing = true;
+					image->track = 0;
+					image->offset = 0;
+				}
+				continueRelease(*image);
+				return true;
+			}
+
+			default:
+				return false;
+			}
+		}
+
+		static void startNext()
+		{
+			if (request.active || startCommand() || offline)
+				return;
+
+			// The drive is waiting, so its track comes next.
+			const auto wanted = wantedImage;
+			if (wanted)
+			{
+				wantedImage = nullptr;
+				__sync_synchronize();
+				const auto track = wantedTrack;
+				auto image = findImage(wanted);
+				if (image && !image->releasing && !wanted->IsTrackLoaded(track))
+				{
+					if (image->track != track)
+					{
+						image->track = track;
+						image->offset = 0;
+					}
+					image->nearTrack = track;
+				}
+			}
+
+			// Otherwise fill in the images' tracks a piece at a time, taking turns.
+			for (unsigned n = 1; n <= NET_DISK_MAX_IMAGES; ++n)
+			{
+				const auto index = (lastImageIndex + n) % NET_DISK_MAX_IMAGES;
+				auto& image = images[index];
+				if (image.diskImage == nullptr || image.releasing)
+					continue;
+
+				if (image.track == NO_TRACK || image.diskImage->IsTrackLoaded(image.track))
+				{
+					image.track = nearestMissingTrack(image);
+					image.offset = 0;
+				}
+				while (image.track != NO_TRACK && image.diskImage->TrackLength(image.track) == 0)
+				{
+					image.diskImage->SetTrackLoaded(image.track);
+					image.track = nearestMissingTrack(image);
+				}
+				if (image.track == NO_TRACK)
+					continue;
+
+				lastImageIndex = index;
+				startRead(image);
+				return;
+			}
+		}
+
+		static void handleMountReply(const Header& header, const uint8_t* data)
+		{
+			if (header.status != Status::Ok || header.length < NET_DISK_LAYOUT_LENGTH)
+			{
+				DEBUG_LOG("Network disk %s not mounted (%u)\r\n", mailbox.name, header.status);
+				finish(false);
+				return;
+			}
+
+			mailbox.handle = header.handle;
+			mailbox.readOnly = (header.flags & NET_DISK_FLAG_READ_ONLY) != 0;
+			mailbox.hash = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
+			data += 4;
+			for (unsigned track = 0; track < HALF_TRACK_COUNT; ++track)
+			{
+				mailbox.lengths[track] = data[0] << 8 | data[1];
+				mailbox.densities[track] = data[2];
+				mailbox.used[track] = data[3] != 0;
+				data += 4;
+			}
+			finish(true);
+		}
+
+		static void handleReadReply(const Header& header, const uint8_t* data)
+		{
+			auto& image = *request.image;
+			const auto diskImage = image.diskImage;
+			// A reply that does not fit the track asked for is treated as unreadable.
+			const auto track = request.header.track;
+			const auto offset = request.header.offset;
+			if (diskImage->IsTrackLoaded(track) || diskImage->IsTrackDirty(track))
+			{
+				// The drive owns the track now, so don't copy over what it wrote.
+				image.track = NO_TRACK;
+				return;
+			}
+			if (header.status == Status::Ok && header.track == track && header.offset == offset &&
+				header.length == request.header.length &&
+				offset + header.length <= diskImage->TrackLength(track))
+			{
+				std::memcpy(diskImage->TrackData(track) + offset, data, header.length);
+				image.offset += header.length;
+				if (image.offset < diskImage->TrackLength(track))
+					return;
+			}
+			else
+			{
+				// Leave it blank rather than ask for it forever.
+				DEBUG_LOG("Network disk track %u unreadable (%u)\r\n", track, header.status);
+			}
+			diskImage->SetTrackLoaded(track);
+			image.track = NO_TRACK;
+		}
+
+		static void handleWriteReply(const Header& header)
+		{
+			auto& image = *request.image;
+			if (header.status == Status::Ok)
+			{
+				image.offset += header.length;
+				return;
+			}
+
+			// Skip to closing the image.
+			DEBUG_LOG("Network disk track %u not written (%u)\r\n", header.track, header.status);
+			image.writeFailed = true;
+			image.track = HALF_TRACK_COUNT;
+		}
+
+		static void handleCloseReply(const Header& header)
+		{
+			auto& image = *request.image;
+			const auto written = !image.writeFailed && header.status == Status::Ok;
+			forget(image);
+			finish(written);
+		}
+
+		void HandlePacket(
+			const Ipv4::Header& ipv4Header,
+			const Udp::Header& udpHeader,
+			const uint8_t* buffer,
+			const size_t size)
+		{
+			if (ipv4Header.sourceIp != serverIp)
+				return;
+
+			Header header;
+			if (header.Deserialize(buffer, size) == 0 ||
+				header.length > size - Header::SerializedLength())
+			{
+				DEBUG_LOG("Dropped network disk packet (invalid size %u)\r\n", size);
+				return;
+			}
+
+			// Anything else is a late reply to a request that was already asked again.
+			if (!request.active || header.sequence != request.header.sequence ||
+				header.opcode != request.header.opcode)
+			{
+				return;
+			}
+			request.active = false;
+			offline = false;
+
+			const auto data = buffer + Header::SerializedLength();
+			switch (header.opcode)
+			{
+			case Opcode::Mount:
+				handleMountReply(header, data);
+				break;
+			case Opcode::Read:
+				handleReadReply(header, data);
+				break;
+			case Opcode::Write:
+				handleWriteReply(header);
+				break;
+			case Opcode::Close:
+				handleCloseReply(header);
+				break;
+			}
+
+			// Don't wait for the next update to ask for more.
+			startNext();
+		}
+
+		// Fails whatever the emulation core is waiting on the request for.
+		static void abandonRequest(const uint32_t now, const char* why)
+		{
+			request.active = false;
+			offline = true;
+			offlineSince = now;
+
+			if (request.header.opcode == Opcode::Mount)
+			{
+				finish(false);
+			}
+			else if (request.image->releasing)
+			{
+				DEBUG_LOG("Lost changes to a network disk (%s)\r\n", why);
+				forget(*request.image);
+				finish(false);
+			}
+		}
+
+		void SetLinkUp(const bool up)
+		{
+			linkUp = up;
+			if (up)
+			{
+				offline = false;
+				return;
+			}
+
+			const auto now = read32(ARM_SYSTIMER_CLO);
+			if (request.active)
+			{
+				abandonRequest(now, "no link");
+			}
+			offline = true;
+			offlineSince = now;
+		}
+
+		void Update()
+		{
+			const auto now = read32(ARM_SYSTIMER_CLO);
+			if (request.active)
+			{
+				if (now - request.sentAt < TIMEOUT_US)
+					return;
+				if (request.retries++ < MAX_RETRIES)
+				{
+					sendRequest();
+					return;
+				}
+
+				DEBUG_LOG("Network disk server not answering\r\n");
+				abandonRequest(now, "server not answering");
+			}
+
+			if (offline && linkUp && now - offlineSince >= OFFLINE_US)
+				offline = false;
+
+			startNext();
+		}
+
+		//
+		// The emulation core
+		//
+		static bool post(const Command command)
+		{
+			mailbox.done = false;
+			__sync_synchronize();
+			mailbox.command = command;
+
+			// The network core may be asleep until the next interrupt otherwise.
+			while (!mailbox.done)
+				__asm volatile("SEV");
+
+			__sync_synchronize();
+			mailbox.command = Command::None;
+			return mailbox.result;
+		}
+
+		bool Mount(DiskImage* diskImage, const FILINFO* fileInfo, const char* name, bool& readOnly)
+		{
+			if (serverIp == 0)
+			{
+				DEBUG_LOG("Can't mount %s without a NetDiskServer\r\n", name);
+				return false;
+			}
+
+			strncpy(mailbox.name, name, sizeof(mailbox.name) - 1);
+			mailbox.name[sizeof(mailbox.name) - 1] = 0;
+			if (!post(Command::Mount))
+				return false;
+
+			diskImage->OpenRemote(
+				fileInfo,
+				&source,
+				mailbox.hash,
+				mailbox.lengths,
+				mailbox.densities,
+				mailbox.used);
+			readOnly = mailbox.readOnly;
+
+			mailbox.diskImage = diskImage;
+			return post(Command::Attach);
+		}
+
+		bool Source::FetchTrack(DiskImage* diskImage, unsigned track)
+		{
+			if (offline)
+				return false;
+
+			wantedTrack = track;
+			__sync_synchronize();
+			wantedImage = diskImage;
+
+			const auto start = read32(ARM_SYSTIMER_CLO);
+			while (!diskImage->IsTrackLoaded(track))
+			{
+				if (offline || read32(ARM_SYSTIMER_CLO) - start >= FETCH_WAIT_US)
+				{
+					DEBUG_LOG("Network disk track %u didn't arrive\r\n", track);
+					return false;
+				}
+				// The network core takes the hint once, so give it again if it moved on.
+				if (wantedImage == nullptr)
+					wantedImage = diskImage;
+				__asm volatile("SEV");
+			}
+			__sync_synchronize();
+			return true;
+		}
+
+		bool Source::Release(DiskImage* diskImage)
+		{
+			mailbox.diskImage = diskImage;
+			return post(Command::Release);
+		}
+	} // namespace Disk
+} // namespace Net
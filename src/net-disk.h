@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+
+#include "DiskImage.h"
+#include "net-udp.h"
+
+// Network disks are images that stay on a server on the LAN (host/netdiskd) rather than being
+// copied to the SD card. A .net file on the card holds the name of the image on the server.
+//
+// Mounting one asks the server for the image's track layout. The tracks themselves are fetched
+// in the background, nearest the head first, and the drive only waits a moment when it steps
+// onto one that hasn't arrived yet. Until it has, the drive reads what there is of the track
+// and its writes there are dropped, as the network core is still filling it in. The tracks the drive wrote to are sent back
+// when the image is closed, and the server writes them into the image file.
+//
+// The emulation core only posts requests to this core and waits for them. Everything on the
+// wire happens in Update and HandlePacket on the core that runs the network.
+namespace Net
+{
+	namespace Disk
+	{
+		// Tracks go over the wire in pieces of up to this many bytes.
+		const uint16_t NET_DISK_CHUNK_SIZE = 1024;
+		const size_t NET_DISK_MAX_IMAGES = 16;
+		const size_t NET_DISK_MAX_NAME_LENGTH = 256;
+
+		enum class Opcode : uint8_t
+		{
+			Mount = 1,  // Data is the image's name. The reply's is its hash and track layout.
+			Read = 2,   // The reply's data is length bytes of the track from offset.
+			Write = 3,  // Data is length bytes of the track from offset.
+			Close = 4,  // The server writes the image if it was written to.
+		};
+
+		enum class Status : uint8_t
+		{
+			Ok = 0,
+			NotFound = 1,
+			ReadOnly = 2,
+			BadRequest = 3,
+			IoError = 4,
+		};
+
+		// Set in the Mount reply when the server won't take writes to the image.
+		const uint8_t NET_DISK_FLAG_READ_ONLY = 1 << 0;
+
+		// Every packet starts with this. A reply repeats its request's header with the status
+		// filled in. Multi-byte fields are big endian.
+		struct Header
+		{
+			Opcode opcode;
+			Status status;
+			uint16_t sequence;
+			uint16_t handle; // The image, as given by the Mount reply
+			uint8_t track;   // A half track index
+			uint8_t flags;
+			uint16_t offset;
+			uint16_t length; // Of the data after the header
+
+			Header();
+			Header(Opcode opcode, uint16_t sequence, uint16_t handle);
+
+			static constexpr size_t SerializedLength()
+			{
+				return sizeof(opcode) + sizeof(status) + sizeof(sequence) + sizeof(handle) +
+					sizeof(track) + sizeof(flags) + sizeof(offset) + sizeof(length);
+			}
+
+			size_t Serialize(uint8_t* buffer, const size_t bufferSize) const;
+			size_t Deserialize(const uint8_t* buffer, const size_t bufferSize);
+		};
+
+		// The Mount reply's data: the image's hash (u32), then for each of the HALF_TRACK_COUNT
+		// half tracks its length (u16), density (u8) and whether it is used (u8).
+		const size_t NET_DISK_LAYOUT_LENGTH = 4 + HALF_TRACK_COUNT * 4;
+
+		// Where the images are. 0 turns network disks off.
+		void SetServer(const uint32_t ip);
+
+		// Called on the emulation core. Opens diskImage as the image called name on the server.
+		bool Mount(DiskImage* diskImage, const FILINFO* fileInfo, const char* name, bool& readOnly);
+
+		// Without a link nothing can be sent, so what the emulation core asks for fails at once
+		// rather than after the retries. Update still has to run to tell it so.
+		void SetLinkUp(const bool up);
+
+		void Update();
+		void HandlePacket(
+			const Ipv4::Header& ipv4Header,
+			const Udp::Header& udpHeader,
+			const uint8_t* buffer,
+			const size_t size);
+	} // namespace Disk
+} // namespace Net
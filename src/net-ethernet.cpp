@@ -1,11 +1,51 @@
+#include <cassert>
 #include <cstring>
 
 #include "net-ethernet.h"
 
+#include "types.h"
+#include <uspi.h>
+
 namespace Net
 {
 	namespace Ethernet
 	{
+		static_assert(FRAME_BUFFER_SIZE == USPI_FRAME_BUFFER_SIZE, "frames must fit USPi's");
+		static_assert(FRAME_POOL_SIZE <= 32, "the free frames are kept in a bit mask");
+
+		static Frame framePool[FRAME_POOL_SIZE];
+		static uint32_t framesInUse = 0;
+
+		Frame* AllocateFrame()
+		{
+			for (size_t i = 0; i < FRAME_POOL_SIZE; i++)
+			{
+				if ((framesInUse & (1u << i)) == 0)
+				{
+					framesInUse |= 1u << i;
+					return &framePool[i];
+				}
+			}
+			return nullptr;
+		}
+
+		void FreeFrame(Frame* frame)
+		{
+			if (frame == nullptr)
+				return;
+
+			const size_t i = frame - framePool;
+			assert(i < FRAME_POOL_SIZE);
+			framesInUse &= ~(1u << i);
+		}
+
+		void SendFrame(Frame* frame, const size_t size)
+		{
+			assert(size <= sizeof(frame->data));
+			USPiSendFrame(frame->data, size);
+			FreeFrame(frame);
+		}
+
 		Header::Header() {}
 
 		Header::Header(EtherType type) :
@@ -9,6 +9,23 @@ namespace Net
 	{
 		using Utils::MacAddress;
 
+		// The same as USPI_FRAME_BUFFER_SIZE, which USPiReceiveFrame needs.
+		const size_t FRAME_BUFFER_SIZE = 1600;
+		const size_t FRAME_POOL_SIZE = 4;
+
+		// Frames are taken from a small fixed pool, so sending and receiving never touch the
+		// heap or put a frame sized buffer on the stack.
+		struct Frame
+		{
+			uint8_t data[FRAME_BUFFER_SIZE] __attribute__((aligned(4)));
+		};
+
+		// Returns nullptr when every frame is in use.
+		Frame* AllocateFrame();
+		void FreeFrame(Frame* frame);
+		// Sends the first size bytes and frees the frame.
+		void SendFrame(Frame* frame, const size_t size);
+
 		enum class EtherType : uint16_t
 		{
 			Ipv4 = 0x0800,
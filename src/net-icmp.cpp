@@ -107,23 +107,30 @@ namespace Net
 
 			Ethernet::Header ethernetHeader(mac, Utils::GetMacAddress(), Ethernet::EtherType::Ipv4);
 
-			uint8_t buffer[USPI_FRAME_BUFFER_SIZE];
-			size_t size = 0;
+			const auto frame = Ethernet::AllocateFrame();
+			if (frame == nullptr)
+			{
+				DEBUG_LOG("Dropped ICMP echo request (no free frame)\r\n");
+				return;
+			}
 
-			const uint8_t emptyBuffer[1] = {};
+			// The echo header is the ICMP header's data, so the checksum covers it.
+			uint8_t pingBuffer[EchoHeader::SerializedLength()];
+			pingHeader.Serialize(pingBuffer, sizeof(pingBuffer));
 
-			size += ethernetHeader.Serialize(buffer + size, sizeof(buffer) - size);
-			size += ipv4Header.Serialize(buffer + size, sizeof(buffer) - size);
-			size += pingHeader.Serialize(buffer + size, sizeof(buffer) - size);
-			size += icmpHeader.Serialize(buffer + size, sizeof(buffer) - size, emptyBuffer, 0);
+			auto buffer = frame->data;
+			size_t size = 0;
+			size += ethernetHeader.Serialize(buffer + size, sizeof(frame->data) - size);
+			size += ipv4Header.Serialize(buffer + size, sizeof(frame->data) - size);
+			size += icmpHeader.Serialize(
+				buffer + size, sizeof(frame->data) - size, pingBuffer, sizeof(pingBuffer));
 
 			const auto expectedSize = ethernetHeader.SerializedLength() +
 				ipv4Header.SerializedLength() + pingHeader.SerializedLength() +
 				icmpHeader.SerializedLength();
 			assert(size == expectedSize);
-			assert(size <= sizeof(buffer));
 
-			USPiSendFrame(buffer, size);
+			Ethernet::SendFrame(frame, size);
 		}
 
 		static void handleEchoRequest(
@@ -147,25 +154,29 @@ namespace Net
 
 			DEBUG_LOG("payloadSize: %u\r\n", payloadSize);
 
-			std::array<uint8_t, USPI_FRAME_BUFFER_SIZE> respBuffer;
+			const auto frame = Ethernet::AllocateFrame();
+			if (frame == nullptr)
+			{
+				DEBUG_LOG("Dropped ICMP echo reply (no free frame)\r\n");
+				return;
+			}
 
+			auto respBuffer = frame->data;
+			const auto respBufferSize = sizeof(frame->data);
 			size_t respSize = 0;
-			respSize += respEthernetHeader.Serialize(
-				respBuffer.data() + respSize, respBuffer.size() - respSize);
-			respSize += respIpv4Header.Serialize(
-				respBuffer.data() + respSize, respBuffer.size() - respSize);
+			respSize += respEthernetHeader.Serialize(respBuffer + respSize, respBufferSize - respSize);
+			respSize += respIpv4Header.Serialize(respBuffer + respSize, respBufferSize - respSize);
 			respSize += respIcmpHeader.Serialize(
-				respBuffer.data() + respSize, respBuffer.size() - respSize, reqBuffer, payloadSize);
+				respBuffer + respSize, respBufferSize - respSize, reqBuffer, payloadSize);
 
 			const auto expectedRespSize = respEthernetHeader.SerializedLength() +
 				respIpv4Header.SerializedLength() + respIcmpHeader.SerializedLength() + payloadSize;
 			assert(respSize == expectedRespSize);
-			assert(respSize <= respBuffer.size());
 
-			USPiSendFrame(respBuffer.data(), respSize);
+			Ethernet::SendFrame(frame, respSize);
 		}
 
-		void HandlePacket(
+		bool HandlePacket(
 			Ethernet::Header ethernetHeader,
 			Ipv4::Header ipv4Header,
 			const uint8_t* buffer,
@@ -179,6 +190,7 @@ namespace Net
 					"Dropped ICMP packet (invalid buffer size %u, expected at least %u)\r\n",
 					bufferSize,
 					Icmp::Header::SerializedLength());
+				return false;
 			}
 
 			DEBUG_LOG("Got ICMP header type %u\r\n", static_cast<uint8_t>(icmpHeader.type));
@@ -191,7 +203,9 @@ namespace Net
 					icmpHeader,
 					buffer + headerSize,
 					bufferSize - headerSize);
+				return true;
 			}
+			return false;
 		}
 	} // namespace Icmp
 } // namespace Net
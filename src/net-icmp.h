@@ -50,7 +50,8 @@ namespace Net::Icmp
 	};
 
 	void SendEchoRequest(const Utils::MacAddress mac, const uint32_t ip);
-	void HandlePacket(
+	// Returns false when the packet was dropped.
+	bool HandlePacket(
 		Ethernet::Header ethernetHeader,
 		Ipv4::Header ipv4Header,
 		const uint8_t* buffer,
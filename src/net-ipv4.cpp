@@ -105,7 +105,7 @@ namespace Net
 			return 20;
 		}
 
-		void HandlePacket(
+		bool HandlePacket(
 			const Ethernet::Header& ethernetHeader, const uint8_t* buffer, const size_t bufferSize)
 		{
 			Header header;
@@ -116,7 +116,7 @@ namespace Net
 					"Dropped IPv4 header (invalid buffer size %u, expected at least %u)\r\n",
 					bufferSize,
 					headerSize);
-				return;
+				return false;
 			}
 			DEBUG_LOG(
 				"IPv4 { src=%08lx, dst=%08lx, len=%u, protocol=%u }\r\n",
@@ -130,31 +130,34 @@ namespace Net
 					"Dropped IPv4 packet (invalid buffer size %u, expected at least %u)\r\n",
 					bufferSize,
 					header.totalLength);
-				return;
+				return false;
 			}
 
-			// Update ARP table
-			Arp::ArpTable.insert(std::make_pair(header.sourceIp, ethernetHeader.macSource));
+			// Update ARP cache
+			Arp::Learn(header.sourceIp, ethernetHeader.macSource);
 
 			if (header.version != 4)
 			{
 				DEBUG_LOG(
 					"Dropped IPv4 packet (invalid header version %u, expected 4)\r\n",
 					header.version);
-				return;
+				return false;
 			}
 			if (header.ihl != 5)
 			{
 				// Not supported
 				DEBUG_LOG("Dropped IPv4 packet (unsupported IHL %u, expected 5)\r\n", header.ihl);
-				return;
+				return false;
 			}
-			if (header.destinationIp != Utils::Ipv4Address)
+			// DHCP replies are broadcast until we have an address.
+			const auto broadcastUdp =
+				header.destinationIp == Utils::Ipv4Broadcast && header.protocol == Protocol::Udp;
+			if (header.destinationIp != Utils::Ipv4Address && !broadcastUdp)
 			{
 				DEBUG_LOG(
 					"Dropped IPv4 packet (invalid destination IP address %08lx)\r\n",
 					header.destinationIp);
-				return;
+				return false;
 			}
 			if (header.fragmentOffset != 0)
 			{
@@ -162,21 +165,22 @@ namespace Net
 				DEBUG_LOG(
 					"Dropped IPv4 packet (unexpected fragment offset %u, expected 0)\r\n",
 					header.fragmentOffset);
-				return;
+				return false;
 			}
 
 			if (header.protocol == Ipv4::Protocol::Icmp)
 			{
 				DEBUG_LOG("Ethernet -> IPv4 -> ICMP\r\n");
-				Icmp::HandlePacket(
+				return Icmp::HandlePacket(
 					ethernetHeader, header, buffer + headerSize, bufferSize - headerSize);
 			}
 			else if (header.protocol == Ipv4::Protocol::Udp)
 			{
 				DEBUG_LOG("Ethernet -> IPv4 -> UDP\r\n");
-				Udp::HandlePacket(
+				return Udp::HandlePacket(
 					ethernetHeader, header, buffer + headerSize, bufferSize - headerSize);
 			}
+			return false;
 		}
 	} // namespace Ipv4
 } // namespace Net
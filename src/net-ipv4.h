@@ -45,7 +45,8 @@ namespace Net
 			static size_t Deserialize(Header& out, const uint8_t* buffer, const size_t bufferSize);
 		};
 
-		void HandlePacket(
+		// Returns false when the packet was dropped here or by the protocol above.
+		bool HandlePacket(
 			const Ethernet::Header& ethernetHeader, const uint8_t* buffer, const size_t bufferSize);
 	} // namespace Ipv4
 } // namespace Net
@@ -0,0 +1,120 @@
+#include "net-telemetry.h"
+#include "net-ethernet.h"
+#include "net-udp.h"
+#include "net-utils.h"
+
+#include "debug.h"
+#include "types.h"
+
+extern "C"
+{
+#include "rpiHardware.h"
+}
+
+namespace Net
+{
+	namespace Telemetry
+	{
+		static uint32_t targetIp = 0;
+		static uint32_t intervalUs = 0;
+		static uint32_t lastSent;
+		static uint32_t nextSequence = 0;
+
+		Status::Status() :
+			version(TELEMETRY_VERSION),
+			flags(0),
+			deviceId(0),
+			track(0),
+			sequence(0),
+			uptime(0),
+			imageHash(0),
+			cycles(0),
+			lostCycles(0),
+			atnChanges(0),
+			clockChanges(0),
+			dataChanges(0),
+			sdBytes(0),
+			sdRate(0)
+		{
+		}
+
+		static size_t serialize32(uint8_t* buffer, const uint32_t value)
+		{
+			buffer[0] = value >> 24;
+			buffer[1] = value >> 16;
+			buffer[2] = value >> 8;
+			buffer[3] = value;
+			return 4;
+		}
+
+		size_t Status::Serialize(uint8_t* buffer, const size_t bufferSize) const
+		{
+			if (bufferSize < SerializedLength())
+			{
+				return 0;
+			}
+
+			size_t i = 0;
+			buffer[i++] = version;
+			buffer[i++] = flags;
+			buffer[i++] = deviceId;
+			buffer[i++] = track;
+			i += serialize32(buffer + i, sequence);
+			i += serialize32(buffer + i, uptime);
+			i += serialize32(buffer + i, imageHash);
+			i += serialize32(buffer + i, cycles);
+			i += serialize32(buffer + i, lostCycles);
+			i += serialize32(buffer + i, atnChanges);
+			i += serialize32(buffer + i, clockChanges);
+			i += serialize32(buffer + i, dataChanges);
+			i += serialize32(buffer + i, sdBytes);
+			i += serialize32(buffer + i, sdRate);
+			return i;
+		}
+
+		void SetTarget(const uint32_t ip, const uint32_t intervalMs)
+		{
+			targetIp = ip;
+			intervalUs = intervalMs * 1000;
+			lastSent = read32(ARM_SYSTIMER_CLO);
+		}
+
+		bool Due()
+		{
+			if (targetIp == 0 || intervalUs == 0 || Utils::Ipv4Address == 0)
+			{
+				return false;
+			}
+
+			// A send that fails (no frame, or the target's MAC still being asked for) waits for
+			// the next interval too, so an unanswered ARP request isn't repeated every pass.
+			const auto now = read32(ARM_SYSTIMER_CLO);
+			if (now - lastSent < intervalUs)
+			{
+				return false;
+			}
+			lastSent = now;
+			return true;
+		}
+
+		void Send(Status& status)
+		{
+			status.version = TELEMETRY_VERSION;
+			status.sequence = nextSequence++;
+			const uint64_t now =
+				static_cast<uint64_t>(read32(ARM_SYSTIMER_CHI)) << 32 | read32(ARM_SYSTIMER_CLO);
+			status.uptime = now / 1000;
+
+			Ethernet::Frame* frame;
+			auto payload = Udp::BeginPacket(
+				frame, targetIp, Udp::Port::Telemetry, Udp::Port::Telemetry, Status::SerializedLength());
+			if (payload == nullptr)
+			{
+				return;
+			}
+
+			status.Serialize(payload, Status::SerializedLength());
+			Udp::SendPacket(frame, Status::SerializedLength());
+		}
+	} // namespace Telemetry
+} // namespace Net
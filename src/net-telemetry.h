@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Telemetry is a small UDP datagram the screen core sends every TelemetryInterval ms to
+// TelemetryHost, so a rack of units can be watched from one PC (host/telemetry). It is fire
+// and forget: nothing is acknowledged and a lost datagram only leaves a gap in the sequence.
+namespace Net
+{
+	namespace Telemetry
+	{
+		const uint8_t TELEMETRY_VERSION = 1;
+
+		// Bits in Status::flags
+		const uint8_t TELEMETRY_FLAG_MOTOR = 1 << 0;
+		const uint8_t TELEMETRY_FLAG_LED = 1 << 1;
+		const uint8_t TELEMETRY_FLAG_1541 = 1 << 2;
+		const uint8_t TELEMETRY_FLAG_1581 = 1 << 3;
+
+		// What a datagram carries. Multi-byte fields are big endian on the wire and the counters
+		// are running totals since power on, so a listener takes differences between datagrams.
+		struct Status
+		{
+			uint8_t version;
+			uint8_t flags;
+			uint8_t deviceId;
+			uint8_t track;        // Half track on a 1541, track on a 1581
+			uint32_t sequence;
+			uint32_t uptime;      // Milliseconds
+			uint32_t imageHash;   // 0 when no image is in the drive
+			uint32_t cycles;      // Emulated drive cycles
+			uint32_t lostCycles;  // Cycles that overran their microsecond
+			uint32_t atnChanges;  // Edges seen on each IEC line
+			uint32_t clockChanges;
+			uint32_t dataChanges;
+			uint32_t sdBytes;     // Moved between the SD card and FatFs
+			uint32_t sdRate;      // KB/s while transferring
+
+			Status();
+
+			static constexpr size_t SerializedLength()
+			{
+				return sizeof(version) + sizeof(flags) + sizeof(deviceId) + sizeof(track) +
+					sizeof(sequence) + sizeof(uptime) + sizeof(imageHash) + sizeof(cycles) +
+					sizeof(lostCycles) + sizeof(atnChanges) + sizeof(clockChanges) +
+					sizeof(dataChanges) + sizeof(sdBytes) + sizeof(sdRate);
+			}
+
+			size_t Serialize(uint8_t* buffer, const size_t bufferSize) const;
+		};
+
+		// Where datagrams go and how often. An interval of 0 turns telemetry off.
+		void SetTarget(const uint32_t ip, const uint32_t intervalMs);
+
+		// Whether a datagram is due. The caller then fills in a Status and passes it to Send,
+		// which sets the version, sequence and uptime.
+		bool Due();
+		void Send(Status& status);
+	} // namespace Telemetry
+} // namespace Net
@@ -1,6 +1,8 @@
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
-#include <memory>
+#include <strings.h>
 
 #include "net-arp.h"
 #include "net-ethernet.h"
@@ -14,22 +16,286 @@
 #include "types.h"
 #include <uspi.h>
 
+extern "C"
+{
+#include "rpiHardware.h"
+}
+
 namespace Net
 {
 	namespace Tftp
 	{
-		// TODO Allow multiple files open
-		static FIL outFile;
+		// A write is collected and a read is fetched this much at a time, as FatFs moves whole
+		// sectors straight to and from the caller's buffer but goes through its window for
+		// partial ones.
+		static const size_t READ_AHEAD_SIZE = 32 * 1024;
+		static const size_t MAX_TRANSFERS = 4;
+		static const uint32_t TIMEOUT_US = 1000000;
+		static const unsigned MAX_RETRIES = 5;
+
+		// A transfer is known by the client's address and port.
+		struct Client
+		{
+			uint32_t ip;
+			Udp::Port port;
+			Udp::Port serverPort; // The port the client sent to, which we answer from
+		};
+
+		struct Transfer
+		{
+			bool active;
+			bool fileOpen; // false while a finished transfer waits to repeat its last ACK
+			bool reading;  // true for RRQ, where we send the file
+			Client client;
+			FIL file;
+			size_t blockSize;
+			size_t windowSize;
+			uint32_t lastActivity;
+			unsigned retries;
+			bool failed;
+
+			// Writing: the last block received in order and how many have come in since we
+			// last acknowledged.
+			uint16_t currentBlockNumber;
+			size_t blocksSinceAcknowledgement;
+
+			// Reading: blocks are counted from 1 without wrapping. The file size decides the
+			// last block, which is short (maybe empty) so the client knows it is the last.
+			uint32_t acknowledgedBlocks;
+			uint32_t sentBlocks;
+			uint32_t finalBlock;
+
+			// Holds file bytes [bufferOffset, bufferOffset + bufferSize). When reading it
+			// keeps the unacknowledged window so it can be sent again.
+			uint8_t buffer[READ_AHEAD_SIZE + TFTP_MAX_WINDOW_SIZE * TFTP_MAX_BLOCK_SIZE]
+				__attribute__((aligned(4)));
+			uint32_t bufferOffset;
+			size_t bufferSize;
+			size_t flushSize;
+		};
+
+		static Transfer transfers[MAX_TRANSFERS];
 		static bool shouldReboot = false;
-		static uint32_t currentBlockNumber = -1;
 
 		Packet::Packet() : opcode(static_cast<Opcode>(0)) {}
 		Packet::Packet(const Opcode opcode) : opcode(opcode) {}
 
-		static std::unique_ptr<Packet>
-		handleTftpWriteRequest(const uint8_t* buffer, const size_t bufferSize)
+		// Serialises the packet straight into a frame from the pool and sends it.
+		static void sendPacket(const Client& client, const Packet& packet)
+		{
+			Utils::MacAddress mac;
+			if (!Arp::Resolve(client.ip, mac))
+			{
+				DEBUG_LOG("Dropped TFTP packet (no MAC address for the client yet)\r\n");
+				return;
+			}
+
+			const auto frame = Ethernet::AllocateFrame();
+			if (frame == nullptr)
+			{
+				DEBUG_LOG("Dropped TFTP packet (no free frame)\r\n");
+				return;
+			}
+
+			Udp::Header udpRespHeader(
+				client.serverPort,
+				client.port,
+				packet.SerializedLength() + Udp::Header::SerializedLength());
+			Ipv4::Header ipv4RespHeader(
+				Ipv4::Protocol::Udp,
+				Utils::Ipv4Address,
+				client.ip,
+				udpRespHeader.length + Ipv4::Header::SerializedLength());
+			Ethernet::Header ethernetRespHeader(
+				mac, Utils::GetMacAddress(), Ethernet::EtherType::Ipv4);
+
+			auto buffer = frame->data;
+			size_t size = 0;
+			size += ethernetRespHeader.Serialize(buffer + size, sizeof(frame->data) - size);
+			size += ipv4RespHeader.Serialize(buffer + size, sizeof(frame->data) - size);
+			size += udpRespHeader.Serialize(buffer + size, sizeof(frame->data) - size);
+			size += packet.Serialize(buffer + size, sizeof(frame->data) - size);
+
+			const auto expectedSize = ethernetRespHeader.SerializedLength() +
+				ipv4RespHeader.SerializedLength() + udpRespHeader.SerializedLength() +
+				packet.SerializedLength();
+			assert(size == expectedSize);
+
+			Ethernet::SendFrame(frame, size);
+		}
+
+		static Transfer* findTransfer(const Client& client)
+		{
+			for (auto& transfer : transfers)
+				if (transfer.active && transfer.client.ip == client.ip &&
+					transfer.client.port == client.port)
+					return &transfer;
+			return nullptr;
+		}
+
+		static void closeFile(Transfer& transfer)
+		{
+			if (transfer.fileOpen)
+			{
+				f_close(&transfer.file);
+				transfer.fileOpen = false;
+			}
+			transfer.bufferSize = 0;
+		}
+
+		static void closeTransfer(Transfer& transfer)
+		{
+			closeFile(transfer);
+			transfer.active = false;
+		}
+
+		// Writes the first size bytes of the buffer and keeps the rest for the next flush.
+		static bool flushWriteBehind(Transfer& transfer, const size_t size)
+		{
+			if (size == 0)
+				return true;
+
+			unsigned int bytesWritten;
+			const auto result = f_write(&transfer.file, transfer.buffer, size, &bytesWritten);
+			transfer.bufferSize -= size;
+			std::memmove(transfer.buffer, transfer.buffer + size, transfer.bufferSize);
+			return result == FR_OK && bytesWritten == size;
+		}
+
+		// Accepts the options we support, clamped to what we can handle, into the OACK.
+		// Anything else is left out so the client falls back to the default.
+		static void negotiateOptions(
+			Transfer& transfer,
+			const WriteReadRequestPacket& request,
+			OptionAcknowledgementPacket& accepted)
+		{
+			transfer.blockSize = TFTP_BLOCK_SIZE;
+			transfer.windowSize = 1;
+
+			for (size_t i = 0; i < request.optionCount; i++)
+			{
+				const auto& option = request.options[i];
+				const auto value = strtoul(option.value, nullptr, 10);
+				if (strcasecmp(option.name, "blksize") == 0 && value >= 8)
+				{
+					transfer.blockSize = value < TFTP_MAX_BLOCK_SIZE ? value : TFTP_MAX_BLOCK_SIZE;
+					accepted.Add(option.name, transfer.blockSize);
+				}
+				else if (strcasecmp(option.name, "windowsize") == 0 && value >= 1)
+				{
+					transfer.windowSize =
+						value < TFTP_MAX_WINDOW_SIZE ? value : TFTP_MAX_WINDOW_SIZE;
+					accepted.Add(option.name, transfer.windowSize);
+				}
+				else if (strcasecmp(option.name, "tsize") == 0)
+				{
+					// RFC 2349: a reader learns the size, a writer's size is echoed.
+					accepted.Add(option.name, transfer.reading ? f_size(&transfer.file) : value);
+				}
+			}
+		}
+
+		// Sends the window after the last acknowledged block, reading ahead as needed.
+		static bool sendWindow(Transfer& transfer)
+		{
+			const uint32_t fileSize = f_size(&transfer.file);
+			const uint32_t acknowledgedOffset = transfer.acknowledgedBlocks * transfer.blockSize;
+			DataPacket packet;
+
+			transfer.sentBlocks = transfer.acknowledgedBlocks;
+			while (transfer.sentBlocks < transfer.acknowledgedBlocks + transfer.windowSize &&
+				transfer.sentBlocks < transfer.finalBlock)
+			{
+				const uint32_t offset = transfer.sentBlocks * transfer.blockSize;
+				const uint32_t length =
+					fileSize - offset < transfer.blockSize ? fileSize - offset : transfer.blockSize;
+
+				if (offset + length > transfer.bufferOffset + transfer.bufferSize)
+				{
+					// Drop what has been acknowledged and read the next chunk behind the rest.
+					const auto drop = acknowledgedOffset - transfer.bufferOffset;
+					transfer.bufferSize -= drop;
+					std::memmove(transfer.buffer, transfer.buffer + drop, transfer.bufferSize);
+					transfer.bufferOffset = acknowledgedOffset;
+
+					unsigned int bytesRead;
+					const auto result = f_read(
+						&transfer.file,
+						transfer.buffer + transfer.bufferSize,
+						transfer.flushSize,
+						&bytesRead);
+					transfer.bufferSize += bytesRead;
+					if (result != FR_OK ||
+						offset + length > transfer.bufferOffset + transfer.bufferSize)
+					{
+						return false;
+					}
+				}
+
+				// The block goes from the read-ahead buffer straight into the frame.
+				packet.blockNumber = ++transfer.sentBlocks;
+				packet.data = transfer.buffer + offset - transfer.bufferOffset;
+				packet.dataSize = length;
+				sendPacket(transfer.client, packet);
+			}
+
+			transfer.lastActivity = read32(ARM_SYSTIMER_CLO);
+			return true;
+		}
+
+		static Transfer* startTransfer(const Client& client, const WriteReadRequestPacket& packet)
 		{
-			DEBUG_LOG("Received TFTP write request\r\n");
+			// A new request from the same port replaces the old transfer.
+			auto transfer = findTransfer(client);
+			if (transfer)
+				closeTransfer(*transfer);
+			for (auto& candidate : transfers)
+				if (!candidate.active)
+					transfer = &candidate;
+			if (transfer == nullptr)
+			{
+				// Cut short a finished transfer's wait rather than turn this one away.
+				for (auto& candidate : transfers)
+					if (!candidate.fileOpen)
+						transfer = &candidate;
+				if (transfer == nullptr)
+					return nullptr;
+				closeTransfer(*transfer);
+			}
+
+			const auto reading = packet.opcode == Opcode::ReadRequest;
+			char path[256];
+			snprintf(path, sizeof(path), "/%s", packet.filename);
+			const auto mode = reading ? FA_READ : FA_CREATE_ALWAYS | FA_WRITE;
+			if (f_open(&transfer->file, path, mode) != FR_OK)
+				return nullptr;
+
+			transfer->active = true;
+			transfer->fileOpen = true;
+			transfer->reading = reading;
+			transfer->client = client;
+			transfer->retries = 0;
+			transfer->failed = false;
+			transfer->currentBlockNumber = 0;
+			transfer->blocksSinceAcknowledgement = 0;
+			transfer->acknowledgedBlocks = 0;
+			transfer->sentBlocks = 0;
+			transfer->bufferOffset = 0;
+			transfer->bufferSize = 0;
+			transfer->lastActivity = read32(ARM_SYSTIMER_CLO);
+
+			// Flush on a cluster boundary when the cluster fits in the buffer.
+			const size_t clusterSize = transfer->file.obj.fs->csize * _MIN_SS;
+			transfer->flushSize = READ_AHEAD_SIZE - READ_AHEAD_SIZE % clusterSize;
+			if (transfer->flushSize == 0)
+				transfer->flushSize = READ_AHEAD_SIZE;
+			return transfer;
+		}
+
+		static void
+		handleTftpRequest(const Client& client, const uint8_t* buffer, const size_t bufferSize)
+		{
+			DEBUG_LOG("Received TFTP read or write request\r\n");
 			WriteReadRequestPacket packet;
 			const auto size = packet.Deserialize(buffer, bufferSize);
 			if (size == 0)
@@ -38,58 +304,66 @@ namespace Net
 					"Dropped TFTP packet (invalid buffer size %u, expected at least %u)\r\n",
 					bufferSize,
 					sizeof(WriteReadRequestPacket::opcode) + 2);
-				return nullptr;
+				return;
 			}
 
 			// TODO Implement netscii, maybe
-			if (packet.mode != "octet")
+			if (strcasecmp(packet.mode, "octet") != 0)
 			{
-				const auto pointer = new ErrorPacket(0, "please use mode octet");
-				return std::unique_ptr<ErrorPacket>(pointer);
+				sendPacket(client, ErrorPacket(0, "please use mode octet"));
+				return;
 			}
 
-			currentBlockNumber = 0;
-
-			// TODO Return to the original working directory.
-			char workingDirectory[256];
-			f_getcwd(workingDirectory, sizeof(workingDirectory));
+			auto transfer = startTransfer(client, packet);
+			if (transfer == nullptr)
+			{
+				if (packet.opcode == Opcode::ReadRequest)
+					sendPacket(client, ErrorPacket(1, "file not found"));
+				else
+					sendPacket(client, ErrorPacket(0, "error opening target file"));
+				return;
+			}
 
-			// Try opening the file
-			auto separator = packet.filename.rfind('/', packet.filename.size());
-			if (separator != std::string::npos)
+			OptionAcknowledgementPacket options;
+			negotiateOptions(*transfer, packet, options);
+			if (transfer->reading)
 			{
-				auto path = "/" + packet.filename.substr(0, separator);
-				f_chdir(path.c_str());
+				transfer->finalBlock = f_size(&transfer->file) / transfer->blockSize + 1;
+				if (transfer->finalBlock > 0xffff)
+				{
+					closeTransfer(*transfer);
+					sendPacket(client, ErrorPacket(0, "file too large, use a bigger blksize"));
+					return;
+				}
 			}
 			else
 			{
-				f_chdir("/");
-				separator = 0;
+				shouldReboot = strcmp(packet.filename, "kernel.img") == 0 ||
+					strcmp(packet.filename, "options.txt") == 0;
 			}
 
-			// Open the output file.
-			auto filename = packet.filename.substr(separator + 1);
-			const auto result = f_open(&outFile, filename.c_str(), FA_CREATE_ALWAYS | FA_WRITE);
-
-			std::unique_ptr<Packet> response;
-			if (result != FR_OK)
+			// With options the client waits for the OACK. Without, a reader gets the first
+			// block and a writer gets ACK 0.
+			if (options.optionCount != 0)
 			{
-				response =
-					std::unique_ptr<ErrorPacket>(new ErrorPacket(0, "error opening target file"));
+				sendPacket(client, options);
+			}
+			else if (transfer->reading)
+			{
+				if (!sendWindow(*transfer))
+				{
+					closeTransfer(*transfer);
+					sendPacket(client, ErrorPacket(0, "io error"));
+				}
 			}
 			else
 			{
-				shouldReboot = packet.filename == "kernel.img" || packet.filename == "options.txt";
-				response = std::unique_ptr<AcknowledgementPacket>(
-					new AcknowledgementPacket(currentBlockNumber));
+				sendPacket(client, AcknowledgementPacket(transfer->currentBlockNumber));
 			}
-
-			// TODO Return to the original working directory here
-
-			return response;
 		}
 
-		static std::unique_ptr<Packet> handleTftpData(const uint8_t* buffer, size_t size)
+		static void handleTftpData(
+			const Client& client, Transfer* transfer, const uint8_t* buffer, size_t size)
 		{
 			DEBUG_LOG("Received TFTP data\r\n");
 			DataPacket packet;
@@ -100,34 +374,109 @@ namespace Net
 					"Dropped TFTP data packet (invalid buffer size %u, expected at least %u)\r\n",
 					size,
 					sizeof(packet.opcode) + sizeof(packet.blockNumber));
-				return nullptr;
+				return;
 			}
 
-			if (packet.blockNumber != currentBlockNumber + 1)
+			if (transfer == nullptr || transfer->reading)
 			{
-				f_close(&outFile);
-				return std::unique_ptr<ErrorPacket>(new ErrorPacket(0, "invalid block number"));
+				sendPacket(client, ErrorPacket(5, "unknown transfer ID"));
+				return;
+			}
+			if (!transfer->fileOpen)
+			{
+				// A repeat of the last block means our final ACK was lost.
+				if (packet.blockNumber == transfer->currentBlockNumber)
+					sendPacket(client, AcknowledgementPacket(transfer->currentBlockNumber));
+				return;
 			}
-			currentBlockNumber = packet.blockNumber;
 
-			unsigned int bytesWritten;
-			const auto result =
-				f_write(&outFile, packet.data.data(), packet.data.size(), &bytesWritten);
+			if (packet.blockNumber != static_cast<uint16_t>(transfer->currentBlockNumber + 1) ||
+				packet.dataSize > transfer->blockSize)
+			{
+				// A block went missing or our ACK did. Acknowledge the last block we have so the
+				// client resends the window from there (RFC 7440), but only once per window, or
+				// when a resent window reaches that block, so late blocks don't each get an ACK.
+				if (transfer->blocksSinceAcknowledgement == 0 &&
+					packet.blockNumber != transfer->currentBlockNumber)
+				{
+					return;
+				}
+				transfer->blocksSinceAcknowledgement = 0;
+				sendPacket(client, AcknowledgementPacket(transfer->currentBlockNumber));
+				return;
+			}
+			transfer->currentBlockNumber = packet.blockNumber;
+			transfer->lastActivity = read32(ARM_SYSTIMER_CLO);
+			transfer->retries = 0;
+
+			// The buffer has room for one block past the flush size.
+			std::memcpy(transfer->buffer + transfer->bufferSize, packet.data, packet.dataSize);
+			transfer->bufferSize += packet.dataSize;
+
+			const auto lastBlock = packet.dataSize < transfer->blockSize;
+			if (lastBlock)
+				transfer->failed |= !flushWriteBehind(*transfer, transfer->bufferSize);
+			else if (transfer->bufferSize >= transfer->flushSize)
+				transfer->failed |= !flushWriteBehind(*transfer, transfer->flushSize);
+
+			if (transfer->failed)
+			{
+				closeTransfer(*transfer);
+				sendPacket(client, ErrorPacket(3, "io error"));
+				return;
+			}
 
-			if (result != FR_OK || bytesWritten != packet.data.size())
+			if (lastBlock)
+			{
+				// Close the file for the last packet, but hold on to the transfer until it
+				// times out in case the client didn't get this ACK.
+				closeFile(*transfer);
+			}
+			else if (++transfer->blocksSinceAcknowledgement < transfer->windowSize)
+			{
+				return;
+			}
+
+			transfer->blocksSinceAcknowledgement = 0;
+			sendPacket(client, AcknowledgementPacket(transfer->currentBlockNumber));
+		}
+
+		static void handleTftpAcknowledgement(
+			const Client& client, Transfer* transfer, const uint8_t* buffer, size_t size)
+		{
+			if (size < 4)
+				return;
+			if (transfer == nullptr || !transfer->reading)
 			{
-				f_close(&outFile);
-				return std::unique_ptr<ErrorPacket>(new ErrorPacket(0, "io error"));
+				sendPacket(client, ErrorPacket(5, "unknown transfer ID"));
+				return;
 			}
 
-			if (packet.data.size() < TFTP_BLOCK_SIZE)
+			// Block numbers on the wire wrap at 16 bits. Only an ACK within what we have
+			// sent moves the window on. A duplicate is left to the timeout, as answering
+			// each one doubles the traffic from then on (RFC 1123's Sorcerer's Apprentice).
+			const uint16_t blockNumber = buffer[2] << 8 | buffer[3];
+			const uint16_t advance =
+				blockNumber - static_cast<uint16_t>(transfer->acknowledgedBlocks);
+			const auto unacknowledged = transfer->sentBlocks - transfer->acknowledgedBlocks;
+			if (advance > unacknowledged || (advance == 0 && unacknowledged != 0))
+				return;
+			transfer->acknowledgedBlocks += advance;
+			transfer->retries = 0;
+
+			if (transfer->acknowledgedBlocks == transfer->finalBlock)
 			{
-				// Close the file for the last packet.
-				f_close(&outFile);
+				DEBUG_LOG("TFTP read complete\r\n");
+				closeTransfer(*transfer);
+				return;
 			}
 
-			return std::unique_ptr<AcknowledgementPacket>(
-				new AcknowledgementPacket(currentBlockNumber));
+			// A partial ACK means the client lost a block; resend from there.
+			if (!sendWindow(*transfer))
+			{
+				closeTransfer(*transfer);
+				sendPacket(client, ErrorPacket(0, "io error"));
+			}
 		}
 
 		void HandlePacket(
@@ -137,81 +486,108 @@ namespace Net
 			const uint8_t* reqBuffer,
 			const size_t reqBufferSize)
 		{
-			const auto opcode = static_cast<Opcode>(reqBuffer[0] << 8 | reqBuffer[1]);
-			DEBUG_LOG("Received TFTP %u packet\r\n", static_cast<uint16_t>(opcode));
-			std::unique_ptr<Packet> response;
-
 			const auto payloadSize = udpReqHeader.length - udpReqHeader.SerializedLength();
-			if (reqBufferSize < payloadSize)
+			if (reqBufferSize < payloadSize || payloadSize < sizeof(uint16_t))
 			{
 				DEBUG_LOG(
 					"Dropped TFTP packet (invalid buffer size %u, expected at least %u)\r\n",
 					reqBufferSize,
 					payloadSize);
+				return;
 			}
 
-			if (opcode == Opcode::WriteRequest)
+			const auto opcode = static_cast<Opcode>(reqBuffer[0] << 8 | reqBuffer[1]);
+			DEBUG_LOG("Received TFTP %u packet\r\n", static_cast<uint16_t>(opcode));
+
+			const Client client = {
+				ipv4ReqHeader.sourceIp, udpReqHeader.sourcePort, udpReqHeader.destinationPort};
+			const auto transfer = findTransfer(client);
+			if (opcode == Opcode::WriteRequest || opcode == Opcode::ReadRequest)
 			{
-				response = handleTftpWriteRequest(reqBuffer, payloadSize);
+				handleTftpRequest(client, reqBuffer, payloadSize);
 			}
 			else if (opcode == Opcode::Data)
 			{
-				response = handleTftpData(reqBuffer, payloadSize);
+				handleTftpData(client, transfer, reqBuffer, payloadSize);
 			}
-			else
+			else if (opcode == Opcode::Acknowledgement)
 			{
-				response = std::unique_ptr<ErrorPacket>(new ErrorPacket(4, "not implemented yet"));
-			}
-
-			if (response != nullptr)
-			{
-				DEBUG_LOG("Sending TFTP response\r\n");
-				Udp::Header udpRespHeader(
-					udpReqHeader.destinationPort,
-					udpReqHeader.sourcePort,
-					response->SerializedLength() + Udp::Header::SerializedLength());
-				Ipv4::Header ipv4RespHeader(
-					Ipv4::Protocol::Udp,
-					Utils::Ipv4Address,
-					ipv4ReqHeader.sourceIp,
-					udpRespHeader.length + Ipv4::Header::SerializedLength());
-				Ethernet::Header ethernetRespHeader(
-					Arp::ArpTable[ipv4RespHeader.destinationIp],
-					Utils::GetMacAddress(),
-					Ethernet::EtherType::Ipv4);
-
-				size_t size = 0;
-				uint8_t buffer[USPI_FRAME_BUFFER_SIZE];
-				size += ethernetRespHeader.Serialize(buffer + size, sizeof(buffer) - size);
-				size += ipv4RespHeader.Serialize(buffer + size, sizeof(buffer) - size);
-				size += udpRespHeader.Serialize(buffer + size, sizeof(buffer) - size);
-				size += response->Serialize(buffer + size, sizeof(buffer) - size);
-
-				const auto expectedSize = ethernetRespHeader.SerializedLength() +
-					ipv4RespHeader.SerializedLength() + udpRespHeader.SerializedLength() +
-					response->SerializedLength();
-				assert(size == expectedSize);
-				assert(size <= sizeof(buffer));
-
-				USPiSendFrame(buffer, size);
+				handleTftpAcknowledgement(client, transfer, reqBuffer, payloadSize);
+			}
+			else if (opcode == Opcode::Error)
+			{
+				// The client gave up, so don't leave the file open.
+				DEBUG_LOG("TFTP transfer aborted by the client\r\n");
+				if (transfer)
+					closeTransfer(*transfer);
 			}
 			else
 			{
-				DEBUG_LOG("TFTP response was nullptr\r\n");
+				sendPacket(client, ErrorPacket(4, "not implemented yet"));
 			}
 
 			// TODO Reboot the Pi when a system file was received
 		}
 
+		void Update()
+		{
+			const auto now = read32(ARM_SYSTIMER_CLO);
+			for (auto& transfer : transfers)
+			{
+				if (!transfer.active || now - transfer.lastActivity < TIMEOUT_US)
+					continue;
+
+				if (!transfer.fileOpen)
+				{
+					transfer.active = false;
+					continue;
+				}
+				if (transfer.retries++ == MAX_RETRIES)
+				{
+					DEBUG_LOG("TFTP transfer timed out\r\n");
+					closeTransfer(transfer);
+					continue;
+				}
+
+				// Prompt the client: a reader gets the window again, a writer our last ACK.
+				transfer.lastActivity = now;
+				if (transfer.reading)
+				{
+					if (!sendWindow(transfer))
+						closeTransfer(transfer);
+				}
+				else
+				{
+					sendPacket(
+						transfer.client, AcknowledgementPacket(transfer.currentBlockNumber));
+				}
+			}
+		}
+
 		//
 		// WriteReadRequestPacket
 		//
-		WriteReadRequestPacket::WriteReadRequestPacket() : Packet() {}
-		WriteReadRequestPacket::WriteReadRequestPacket(const Opcode opcode) : Packet(opcode) {}
+		WriteReadRequestPacket::WriteReadRequestPacket() :
+			Packet(), filename(""), mode(""), optionCount(0)
+		{
+		}
+
+		WriteReadRequestPacket::WriteReadRequestPacket(const Opcode opcode) :
+			Packet(opcode), filename(""), mode(""), optionCount(0)
+		{
+		}
 
 		size_t WriteReadRequestPacket::SerializedLength() const
 		{
-			return sizeof(opcode) + filename.size() + 1 + mode.size() + 1;
+			return sizeof(opcode) + strlen(filename) + 1 + strlen(mode) + 1;
+		}
+
+		// Copies a string with its terminator and returns how many bytes that took.
+		static size_t serializeString(uint8_t* buffer, const char* string)
+		{
+			const auto length = strlen(string) + 1;
+			std::memcpy(buffer, string, length);
+			return length;
 		}
 
 		size_t WriteReadRequestPacket::Serialize(uint8_t* buffer, const size_t bufferSize) const
@@ -225,11 +601,8 @@ namespace Net
 			buffer[i++] = static_cast<uint16_t>(opcode) >> 8;
 			buffer[i++] = static_cast<uint16_t>(opcode);
 
-			i += filename.copy(reinterpret_cast<char*>(buffer + i), filename.size());
-			buffer[i++] = 0;
-
-			i += mode.copy(reinterpret_cast<char*>(buffer + i), mode.size());
-			buffer[i++] = 0;
+			i += serializeString(buffer + i, filename);
+			i += serializeString(buffer + i, mode);
 
 			return i;
 		}
@@ -253,8 +626,8 @@ namespace Net
 			if (j == bufferSize)
 				return 0;
 
-			filename = std::string(reinterpret_cast<const char*>(buffer + i));
-			i += filename.size() + 1;
+			filename = reinterpret_cast<const char*>(buffer + i);
+			i = j + 1;
 
 			// Check if there's a null terminator within the remaining buffer
 			for (j = i; j < bufferSize; j++)
@@ -263,8 +636,29 @@ namespace Net
 			if (j == bufferSize)
 				return 0;
 
-			mode = std::string(reinterpret_cast<const char*>(buffer + i));
-			i += mode.size() + 1;
+			mode = reinterpret_cast<const char*>(buffer + i);
+			i = j + 1;
+
+			// Options (RFC 2347) follow as name and value pairs. A truncated pair is ignored,
+			// as are any past the ones we have room for.
+			optionCount = 0;
+			while (i < bufferSize && optionCount < TFTP_MAX_OPTIONS)
+			{
+				const auto name = reinterpret_cast<const char*>(buffer + i);
+				const auto nameLength = strnlen(name, bufferSize - i);
+				if (i + nameLength + 1 >= bufferSize)
+					break;
+
+				const auto value = name + nameLength + 1;
+				const auto valueLength = strnlen(value, bufferSize - i - nameLength - 1);
+				if (i + nameLength + 1 + valueLength == bufferSize)
+					break;
+
+				options[optionCount].name = name;
+				options[optionCount].value = value;
+				optionCount++;
+				i += nameLength + 1 + valueLength + 1;
+			}
 
 			return i;
 		}
@@ -272,15 +666,15 @@ namespace Net
 		//
 		// ErrorPacket
 		//
-		ErrorPacket::ErrorPacket() : Packet(Opcode::Error) {}
-		ErrorPacket::ErrorPacket(uint16_t errorCode, std::string message) :
+		ErrorPacket::ErrorPacket() : Packet(Opcode::Error), errorCode(0), message("") {}
+		ErrorPacket::ErrorPacket(uint16_t errorCode, const char* message) :
 			Packet(Opcode::Error), errorCode(errorCode), message(message)
 		{
 		}
 
 		size_t ErrorPacket::SerializedLength() const
 		{
-			return sizeof(opcode) + sizeof(errorCode) + message.size() + 1;
+			return sizeof(opcode) + sizeof(errorCode) + strlen(message) + 1;
 		}
 
 		size_t ErrorPacket::Serialize(uint8_t* buffer, const size_t bufferSize) const
@@ -296,8 +690,7 @@ namespace Net
 			buffer[i++] = errorCode >> 8;
 			buffer[i++] = errorCode;
 
-			i += message.copy(reinterpret_cast<char*>(buffer + i), message.size());
-			buffer[i++] = 0;
+			i += serializeString(buffer + i, message);
 
 			return i;
 		}
@@ -332,19 +725,69 @@ namespace Net
 			return i;
 		}
 
+		//
+		// OptionAcknowledgementPacket
+		//
+		OptionAcknowledgementPacket::OptionAcknowledgementPacket() :
+			Packet(Opcode::OptionAcknowledgement), optionCount(0)
+		{
+		}
+
+		void OptionAcknowledgementPacket::Add(const char* name, uint32_t value)
+		{
+			if (optionCount == TFTP_MAX_OPTIONS)
+				return;
+
+			snprintf(values[optionCount], sizeof(values[optionCount]), "%lu", (unsigned long)value);
+			options[optionCount].name = name;
+			options[optionCount].value = values[optionCount];
+			optionCount++;
+		}
+
+		size_t OptionAcknowledgementPacket::SerializedLength() const
+		{
+			size_t length = sizeof(opcode);
+			for (size_t i = 0; i < optionCount; i++)
+				length += strlen(options[i].name) + 1 + strlen(options[i].value) + 1;
+			return length;
+		}
+
+		size_t OptionAcknowledgementPacket::Serialize(
+			uint8_t* buffer, const size_t bufferSize) const
+		{
+			if (bufferSize < SerializedLength())
+			{
+				return 0;
+			}
+
+			size_t i = 0;
+			buffer[i++] = static_cast<uint16_t>(opcode) >> 8;
+			buffer[i++] = static_cast<uint16_t>(opcode);
+
+			for (size_t option = 0; option < optionCount; option++)
+			{
+				i += serializeString(buffer + i, options[option].name);
+				i += serializeString(buffer + i, options[option].value);
+			}
+
+			return i;
+		}
+
 		//
 		// DataPacket
 		//
-		DataPacket::DataPacket() : Packet(Opcode::Data), blockNumber(0) {}
+		DataPacket::DataPacket() : Packet(Opcode::Data), blockNumber(0), data(nullptr), dataSize(0)
+		{
+		}
 
 		size_t DataPacket::SerializedLength() const
 		{
-			return sizeof(opcode) + sizeof(blockNumber) + data.size();
+			return sizeof(opcode) + sizeof(blockNumber) + dataSize;
 		}
 
 		size_t DataPacket::Serialize(uint8_t* buffer, const size_t bufferSize) const
 		{
-			if (bufferSize <= SerializedLength())
+			if (bufferSize < SerializedLength())
 			{
 				return 0;
 			}
@@ -355,8 +798,10 @@ namespace Net
 			buffer[i++] = blockNumber >> 8;
 			buffer[i++] = blockNumber;
 
-			std::memcpy(buffer + i, data.data(), data.size());
-			i += data.size();
+			// The last block of a file that fills its blocks exactly is empty.
+			if (dataSize != 0)
+				std::memcpy(buffer + i, data, dataSize);
+			i += dataSize;
 
 			return i;
 		}
@@ -370,7 +815,8 @@ namespace Net
 
 			opcode = static_cast<Opcode>(buffer[0] << 8 | buffer[1]);
 			blockNumber = buffer[2] << 8 | buffer[3];
-			data = std::vector<uint8_t>(buffer + 4, buffer + bufferSize);
+			data = buffer + 4;
+			dataSize = bufferSize - 4;
 			return bufferSize;
 		}
 	} // namespace Tftp
@@ -1,13 +1,16 @@
 #pragma once
 #include <cstdint>
-#include <string>
-#include <vector>
 
 #include "net-udp.h"
 
 namespace Net::Tftp
 {
 	const size_t TFTP_BLOCK_SIZE = 512;
+	// The largest block that still fits in one ethernet frame (RFC 2348)
+	const size_t TFTP_MAX_BLOCK_SIZE = 1500 - 20 - 8 - 4;
+	// How many blocks a client may send before waiting for an acknowledgement (RFC 7440)
+	const size_t TFTP_MAX_WINDOW_SIZE = 16;
+	const size_t TFTP_MAX_OPTIONS = 8;
 
 	enum class Opcode : uint16_t
 	{
@@ -16,6 +19,15 @@ namespace Net::Tftp
 		Data = 3,
 		Acknowledgement = 4,
 		Error = 5,
+		OptionAcknowledgement = 6,
+	};
+
+	// Packets don't own their strings or data. Received ones point into the frame they came
+	// in, so they are only valid while it is being handled.
+	struct Option
+	{
+		const char* name;
+		const char* value;
 	};
 
 	struct Packet
@@ -24,14 +36,17 @@ namespace Net::Tftp
 
 		Packet();
 		Packet(Opcode opcode);
+		virtual ~Packet() = default;
 		virtual size_t SerializedLength() const = 0;
 		virtual size_t Serialize(uint8_t* buffer, const size_t bufferSize) const = 0;
 	};
 
 	struct WriteReadRequestPacket : public Packet
 	{
-		std::string filename;
-		std::string mode;
+		const char* filename;
+		const char* mode;
+		Option options[TFTP_MAX_OPTIONS];
+		size_t optionCount;
 
 		WriteReadRequestPacket();
 		WriteReadRequestPacket(const Opcode opcode);
@@ -43,10 +58,10 @@ namespace Net::Tftp
 	struct ErrorPacket : public Packet
 	{
 		uint16_t errorCode;
-		std::string message;
+		const char* message;
 
 		ErrorPacket();
-		ErrorPacket(uint16_t errorCode, std::string message);
+		ErrorPacket(uint16_t errorCode, const char* message);
 		size_t SerializedLength() const override;
 		size_t Serialize(uint8_t* buffer, const size_t bufferSize) const override;
 	};
@@ -61,10 +76,26 @@ namespace Net::Tftp
 		size_t Serialize(uint8_t* buffer, const size_t bufferSize) const override;
 	};
 
+	struct OptionAcknowledgementPacket : public Packet
+	{
+		Option options[TFTP_MAX_OPTIONS];
+		size_t optionCount;
+
+		OptionAcknowledgementPacket();
+		// Acknowledges an option with a number, formatting it into the packet.
+		void Add(const char* name, uint32_t value);
+		size_t SerializedLength() const override;
+
+	private:
+		char values[TFTP_MAX_OPTIONS][11];
+		size_t Serialize(uint8_t* buffer, const size_t bufferSize) const override;
+	};
+
 	struct DataPacket : public Packet
 	{
 		uint16_t blockNumber;
-		std::vector<uint8_t> data;
+		const uint8_t* data;
+		size_t dataSize;
 
 		DataPacket();
 		size_t SerializedLength() const override;
@@ -78,4 +109,7 @@ namespace Net::Tftp
 		const Udp::Header udpReqHeader,
 		const uint8_t* data,
 		const size_t dataSize);
+
+	// Resends on timeouts and drops transfers whose client has gone away.
+	void Update();
 } // namespace Net::Tftp
@@ -1,8 +1,12 @@
 #include "net-udp.h"
+#include "net-arp.h"
+#include "net-control.h"
 #include "net-dhcp.h"
+#include "net-disk.h"
 #include "net-tftp.h"
 
 #include "debug.h"
+#include <cassert>
 
 namespace Net
 {
@@ -48,7 +52,52 @@ namespace Net
 			return 8;
 		}
 
-		void HandlePacket(
+		static const size_t HEADERS_LENGTH = Ethernet::Header::SerializedLength() +
+			Ipv4::Header::SerializedLength() + Header::SerializedLength();
+
+		uint8_t* BeginPacket(
+			Ethernet::Frame*& frame,
+			const uint32_t ip,
+			const Port sourcePort,
+			const Port destinationPort,
+			const size_t payloadSize)
+		{
+			Utils::MacAddress mac;
+			if (!Arp::Resolve(ip, mac))
+			{
+				return nullptr;
+			}
+
+			frame = Ethernet::AllocateFrame();
+			if (frame == nullptr)
+			{
+				return nullptr;
+			}
+
+			Header udpHeader(sourcePort, destinationPort, payloadSize + Header::SerializedLength());
+			Ipv4::Header ipv4Header(
+				Ipv4::Protocol::Udp,
+				Utils::Ipv4Address,
+				ip,
+				udpHeader.length + Ipv4::Header::SerializedLength());
+			Ethernet::Header ethernetHeader(mac, Utils::GetMacAddress(), Ethernet::EtherType::Ipv4);
+
+			auto buffer = frame->data;
+			size_t size = 0;
+			size += ethernetHeader.Serialize(buffer + size, sizeof(frame->data) - size);
+			size += ipv4Header.Serialize(buffer + size, sizeof(frame->data) - size);
+			size += udpHeader.Serialize(buffer + size, sizeof(frame->data) - size);
+			assert(size == HEADERS_LENGTH);
+
+			return buffer + size;
+		}
+
+		void SendPacket(Ethernet::Frame* frame, const size_t payloadSize)
+		{
+			Ethernet::SendFrame(frame, HEADERS_LENGTH + payloadSize);
+		}
+
+		bool HandlePacket(
 			const Ethernet::Header ethernetHeader,
 			const Ipv4::Header ipv4Header,
 			const uint8_t* buffer,
@@ -62,7 +111,7 @@ namespace Net
 					"Dropped UDP header (invalid buffer size %u, expected at least %u)\r\n",
 					bufferSize,
 					Header::SerializedLength());
-				return;
+				return false;
 			}
 
 			DEBUG_LOG(
@@ -77,7 +126,12 @@ namespace Net
 					"Dropped UDP packet (invalid buffer size %u, expected at least %u)\r\n",
 					bufferSize,
 					udpHeader.length);
-				return;
+				return false;
+			}
+			if (udpHeader.length < udpHeader.SerializedLength())
+			{
+				DEBUG_LOG("Dropped UDP packet (invalid length %u)\r\n", udpHeader.length);
+				return false;
 			}
 
 			if (udpHeader.destinationPort == Port::DhcpClient)
@@ -86,6 +140,7 @@ namespace Net
 					ethernetHeader,
 					buffer + udpHeader.SerializedLength(),
 					bufferSize - udpHeader.SerializedLength());
+				return true;
 			}
 			else if (udpHeader.destinationPort == Port::Tftp)
 			{
@@ -95,7 +150,27 @@ namespace Net
 					udpHeader,
 					buffer + udpHeader.SerializedLength(),
 					bufferSize - udpHeader.SerializedLength());
+				return true;
+			}
+			else if (udpHeader.destinationPort == Port::Control)
+			{
+				Control::HandlePacket(
+					ipv4Header,
+					udpHeader,
+					buffer + udpHeader.SerializedLength(),
+					bufferSize - udpHeader.SerializedLength());
+				return true;
+			}
+			else if (udpHeader.destinationPort == Port::NetDisk)
+			{
+				Disk::HandlePacket(
+					ipv4Header,
+					udpHeader,
+					buffer + udpHeader.SerializedLength(),
+					bufferSize - udpHeader.SerializedLength());
+				return true;
 			}
+			return false;
 		}
 	} // namespace Udp
 } // namespace Net
@@ -15,6 +15,9 @@ namespace Net
 			DhcpServer = 67,
 			DhcpClient = 68,
 			Tftp = 69, // nice
+			NetDisk = 6464,
+			Telemetry = 6541,
+			Control = 6542,
 		};
 
 		struct Header
@@ -37,7 +40,20 @@ namespace Net
 			size_t Deserialize(const uint8_t* buffer, const size_t size);
 		};
 
-		void HandlePacket(
+		// Returns false when the packet was dropped, including when nothing listens on its port.
+		// Starts a datagram in a frame from the pool with its Ethernet, IPv4 and UDP headers
+		// written for a payload of payloadSize bytes. Returns where the payload goes, or nullptr
+		// when no frame is free or ip has no MAC address yet (an ARP request is sent).
+		uint8_t* BeginPacket(
+			Ethernet::Frame*& frame,
+			const uint32_t ip,
+			const Port sourcePort,
+			const Port destinationPort,
+			const size_t payloadSize);
+		// Sends a datagram started by BeginPacket and frees its frame.
+		void SendPacket(Ethernet::Frame* frame, const size_t payloadSize);
+
+		bool HandlePacket(
 			const Ethernet::Header ethernetHeader,
 			const Ipv4::Header ipv4Header,
 			const uint8_t* buffer,
@@ -1,3 +1,4 @@
+#pragma once
 #include <array>
 #include <cstddef>
 #include <cstdint>
@@ -8,6 +9,7 @@ namespace Net
 	{
 		typedef std::array<uint8_t, 6> MacAddress;
 		extern const MacAddress MacBroadcast;
+		const uint32_t Ipv4Broadcast = 0xFFFFFFFF;
 		extern uint32_t Ipv4Address;
 
 		uint32_t Crc32(const uint8_t* buffer, size_t size);
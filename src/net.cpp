@@ -1,10 +1,15 @@
 #include "net.h"
+#include "net-control.h"
+#include "net-disk.h"
+#include "net-telemetry.h"
+#include "net-tftp.h"
 
 #include "debug.h"
 #include "options.h"
 #include "types.h"
 #include <uspi.h>
 #include <uspios.h>
+#include <strings.h>
 
 extern "C"
 {
@@ -13,25 +18,68 @@ extern "C"
 
 namespace Net
 {
-	static uint32_t postInitializeTime = 0;
+	// Reading the PHY takes a few USB transfers, so the link is looked at this often: quickly
+	// while waiting for a cable or autonegotiation and seldom once it is up.
+	static const uint32_t LINK_CHECK_DOWN_US = 100000;
+	static const uint32_t LINK_CHECK_UP_US = 1000000;
+
 	static Options* options;
+	static Counters counters[static_cast<size_t>(Protocol::Count)];
+	static bool linkUp = false;
+	static uint32_t lastLinkCheck;
 
-	static void postInitialize();
+	static void linkChanged();
 	static void ipObtained();
 
 	void Initialize(Options& options)
 	{
-		// Wait for ethernet to become available.
-		DEBUG_LOG("Waiting for ethernet\r\n");
-		while (!USPiEthernetAvailable())
+		// Nothing waits here. Update watches the link and obtains an address once it is up, so
+		// a unit without ethernet or with the cable out boots as quickly as any other.
+		Net::options = &options;
+		if (options.GetDHCPEnable())
 		{
-			MsDelay(500);
+			Dhcp::Initialize(ipObtained);
 		}
+		lastLinkCheck = read32(ARM_SYSTIMER_CLO) - LINK_CHECK_DOWN_US;
+	}
 
-		// Wait 3 seconds, then run postInitialize
-		DEBUG_LOG("Scheduled post-init\r\n");
-		Net::options = &options;
-		postInitializeTime = read32(ARM_SYSTIMER_CLO) + 30000;
+	const Counters& GetCounters(const Protocol protocol)
+	{
+		return counters[static_cast<size_t>(protocol)];
+	}
+
+	void FormatCounters(char* buffer, const size_t bufferSize)
+	{
+		uint32_t dropped = 0;
+		for (const auto& counter : counters)
+			dropped += counter.dropped;
+
+		snprintf(
+			buffer,
+			bufferSize,
+			"ARP %5lu ICMP %5lu UDP %6lu Drop %5lu",
+			GetCounters(Protocol::Arp).received,
+			GetCounters(Protocol::Icmp).received,
+			GetCounters(Protocol::Udp).received,
+			dropped);
+	}
+
+	static Protocol
+	classify(const Ethernet::Header& ethernetHeader, const uint8_t* payload, const size_t size)
+	{
+		if (ethernetHeader.type == Ethernet::EtherType::Arp)
+			return Protocol::Arp;
+		if (ethernetHeader.type != Ethernet::EtherType::Ipv4 ||
+			size < Ipv4::Header::SerializedLength())
+			return Protocol::Other;
+
+		// Peek at the IPv4 protocol field; Ipv4::HandlePacket checks the rest.
+		const auto ipv4Protocol = static_cast<Ipv4::Protocol>(payload[9]);
+		if (ipv4Protocol == Ipv4::Protocol::Icmp)
+			return Protocol::Icmp;
+		if (ipv4Protocol == Ipv4::Protocol::Udp)
+			return Protocol::Udp;
+		return Protocol::Other;
 	}
 
 	void HandlePacket(const uint8_t* buffer, const size_t bufferSize)
@@ -42,67 +90,133 @@ namespace Net
 		{
 			DEBUG_LOG(
 				"Dropped ethernet packet (invalid buffer size %u, expected at least %u)\r\n",
-				headerSize,
+				bufferSize,
 				Ethernet::Header::SerializedLength());
+			auto& other = counters[static_cast<size_t>(Protocol::Other)];
+			other.received++;
+			other.dropped++;
 			return;
 		}
 
+		const auto payload = buffer + headerSize;
+		const auto payloadSize = bufferSize - headerSize;
+		const auto protocol = classify(ethernetHeader, payload, payloadSize);
+		auto& counter = counters[static_cast<size_t>(protocol)];
+		counter.received++;
+
+		bool handled = false;
 		switch (ethernetHeader.type)
 		{
 		case Ethernet::EtherType::Arp:
-			Arp::HandlePacket(ethernetHeader, buffer + headerSize, bufferSize - headerSize);
+			handled = Arp::HandlePacket(ethernetHeader, payload, payloadSize);
 			break;
 		case Ethernet::EtherType::Ipv4:
-			Ipv4::HandlePacket(ethernetHeader, buffer + headerSize, bufferSize - headerSize);
+			handled = Ipv4::HandlePacket(ethernetHeader, payload, payloadSize);
 			break;
 		}
+
+		if (handled)
+			counter.handled++;
+		else
+			counter.dropped++;
 	}
 
 	void Update()
 	{
-		if (postInitializeTime && read32(ARM_SYSTIMER_CLO) > postInitializeTime)
+		if (options == nullptr)
+		{
+			return;
+		}
+
+		const auto now = read32(ARM_SYSTIMER_CLO);
+		if (now - lastLinkCheck >= (linkUp ? LINK_CHECK_UP_US : LINK_CHECK_DOWN_US))
 		{
-			postInitialize();
-			postInitializeTime = 0;
+			lastLinkCheck = now;
+			const auto up = USPiEthernetAvailable() && USPiEthernetIsLinkUp();
+			if (up != linkUp)
+			{
+				linkUp = up;
+				linkChanged();
+			}
 		}
 
-		unsigned int bufferSize = 0;
-		uint8_t buffer[USPI_FRAME_BUFFER_SIZE];
-		if (!USPiReceiveFrame(buffer, &bufferSize))
+		// The emulation core can be waiting on these, so they carry on without a link and fail
+		// what they can't send.
+		Disk::Update();
+		Control::Update();
+		if (!linkUp)
 		{
 			return;
 		}
 
-		HandlePacket(buffer, sizeof(buffer));
+		Dhcp::Update();
+		Tftp::Update();
+
+		// Empty the queue rather than take one frame per call, or a busy LAN or an upload
+		// fills it and the driver starts dropping. The budget keeps the screen responsive.
+		const auto start = read32(ARM_SYSTIMER_CLO);
+		const auto budget = options->NetReceiveBudget();
+		do
+		{
+			const auto frame = Ethernet::AllocateFrame();
+			if (frame == nullptr)
+			{
+				return;
+			}
+
+			unsigned int bufferSize = 0;
+			const auto received = USPiReceiveFrame(frame->data, &bufferSize);
+			if (received)
+			{
+				HandlePacket(frame->data, bufferSize);
+			}
+			Ethernet::FreeFrame(frame);
+			if (!received)
+			{
+				break;
+			}
+		} while (read32(ARM_SYSTIMER_CLO) - start < budget);
+	}
+
+	static bool parseIp(const char* text, uint32_t& address)
+	{
+		unsigned int ip[4];
+		if (sscanf(text, "%u.%u.%u.%u", &ip[0], &ip[1], &ip[2], &ip[3]) != 4)
+		{
+			return false;
+		}
+
+		address = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			address <<= 8;
+			address |= ip[i];
+		}
+		return true;
 	}
 
-	static void postInitialize()
+	static void linkChanged()
 	{
-		DEBUG_LOG("Running network post-init\r\n");
+		DEBUG_LOG("Link %s\r\n", linkUp ? "up" : "down");
+		Disk::SetLinkUp(linkUp);
 
 		if (options->GetDHCPEnable())
 		{
-			DEBUG_LOG("DHCP enabled, trying to obtain IP\r\n");
-			std::function<void()> callback = ipObtained;
-			Dhcp::ObtainIp(callback);
+			if (linkUp)
+			{
+				Dhcp::Start();
+			}
+			else
+			{
+				Dhcp::Stop();
+			}
 		}
-		else
+		else if (linkUp)
 		{
 			// Try parsing the IP address in the options.
-			unsigned int ip[4];
-			int scanned =
-				sscanf(options->GetIPAddress(), "%u.%u.%u.%u", &ip[0], &ip[1], &ip[2], &ip[3]);
-
-			if (scanned == 4)
+			if (parseIp(options->GetIPAddress(), Utils::Ipv4Address))
 			{
-				DEBUG_LOG("Setting IP address %u.%u.%u.%u\r\n", ip[0], ip[1], ip[2], ip[3]);
-				Utils::Ipv4Address = 0;
-				for (int i = 0; i < 4; i++)
-				{
-					Utils::Ipv4Address <<= 8;
-					Utils::Ipv4Address |= ip[i];
-				}
-
+				DEBUG_LOG("Setting IP address %s\r\n", options->GetIPAddress());
 				ipObtained();
 			}
 			else
@@ -121,5 +235,33 @@ namespace Net
 			(Utils::Ipv4Address >> 8) & 0xFF,
 			Utils::Ipv4Address & 0xFF);
 		Arp::SendAnnouncement(Utils::GetMacAddress(), Utils::Ipv4Address);
+
+		uint32_t server;
+		if (options->GetNetDiskServer()[0] && parseIp(options->GetNetDiskServer(), server))
+		{
+			DEBUG_LOG("Network disks from %s\r\n", options->GetNetDiskServer());
+			Disk::SetServer(server);
+		}
+
+		uint32_t telemetryHost;
+		if (strcasecmp(options->GetTelemetryHost(), "broadcast") == 0)
+		{
+			telemetryHost = Utils::Ipv4Broadcast;
+		}
+		else if (!parseIp(options->GetTelemetryHost(), telemetryHost))
+		{
+			telemetryHost = 0;
+		}
+		if (telemetryHost != 0)
+		{
+			DEBUG_LOG("Telemetry to %s\r\n", options->GetTelemetryHost());
+			Telemetry::SetTarget(telemetryHost, options->TelemetryInterval());
+		}
+
+		if (options->RemoteControl())
+		{
+			DEBUG_LOG("Remote control on port %d\r\n", static_cast<int>(Udp::Port::Control));
+			Control::Enable();
+		}
 	}
 } // namespace Net
@@ -9,7 +9,30 @@
 
 namespace Net
 {
+	// What received frames are counted by. IPv4 frames count under the protocol they carry.
+	enum class Protocol
+	{
+		Arp,
+		Icmp,
+		Udp,
+		Other,
+		Count,
+	};
+
+	// A received frame is either handled or dropped, the latter when it is malformed, isn't
+	// for us or nothing here speaks its protocol.
+	struct Counters
+	{
+		uint32_t received;
+		uint32_t handled;
+		uint32_t dropped;
+	};
+
 	void Initialize(Options& options);
 	void HandlePacket(const uint8_t* buffer, const size_t bufferSize);
+	// Handles the frames waiting in the USPi queue for up to NetReceiveBudget microseconds.
 	void Update();
+	const Counters& GetCounters(const Protocol protocol);
+	// The status bar's summary: frames received per protocol and how many were dropped.
+	void FormatCounters(char* buffer, const size_t bufferSize);
 } // namespace Net
@@ -139,9 +139,13 @@ Options::Options(void)
 	, invertIECOutputs(1)
 	, splitIECLines(0)
 	, ignoreReset(0)
+	, recordIEC(0)
+	, learnProfiles(0)
 	, autoBootFB128(0)
 	, displayTemperature(0)
+	, sdDMA(1)
 	, lowercaseBrowseModeFilenames(0)
+	, jiffyDOS(1)
 	, screenWidth(1024)
 	, screenHeight(768)
 	, i2cBusMaster(1)
@@ -162,6 +166,11 @@ Options::Options(void)
 	, rotaryEncoderInvert(0) //ROTARY:
 	, dhcpEnable(1)
 	, ipAddress{}
+	, netReceiveBudget(500)
+	, netDiskServer{}
+	, telemetryHost{}
+	, telemetryInterval(1000)
+	, remoteControl(0)
 {
 	autoMountImageName[0] = 0;
 	strcpy(ROMFontName, "chargen");
@@ -232,9 +241,13 @@ void Options::Process(char* buffer)
 		ELSE_CHECK_DECIMAL_OPTION(invertIECOutputs)
 		ELSE_CHECK_DECIMAL_OPTION(splitIECLines)
 		ELSE_CHECK_DECIMAL_OPTION(ignoreReset)
+		ELSE_CHECK_DECIMAL_OPTION(recordIEC)
+		ELSE_CHECK_DECIMAL_OPTION(learnProfiles)
 		ELSE_CHECK_DECIMAL_OPTION(lowercaseBrowseModeFilenames)
+		ELSE_CHECK_DECIMAL_OPTION(jiffyDOS)
 		ELSE_CHECK_DECIMAL_OPTION(autoBootFB128)
 		ELSE_CHECK_DECIMAL_OPTION(displayTemperature)
+		ELSE_CHECK_DECIMAL_OPTION(sdDMA)
 		ELSE_CHECK_DECIMAL_OPTION(screenWidth)
 		ELSE_CHECK_DECIMAL_OPTION(screenHeight)
 		ELSE_CHECK_DECIMAL_OPTION(i2cBusMaster)
@@ -255,6 +268,9 @@ void Options::Process(char* buffer)
 		ELSE_CHECK_DECIMAL_OPTION(rotaryEncoderEnable) //ROTARY:
 		ELSE_CHECK_DECIMAL_OPTION(rotaryEncoderInvert) //ROTARY:
 		ELSE_CHECK_DECIMAL_OPTION(dhcpEnable)
+		ELSE_CHECK_DECIMAL_OPTION(netReceiveBudget)
+		ELSE_CHECK_DECIMAL_OPTION(telemetryInterval)
+		ELSE_CHECK_DECIMAL_OPTION(remoteControl)
 		else if ((strcasecmp(pOption, "AutoBaseName") == 0))
 		{
 			strncpy(autoBaseName, pValue, 255);
@@ -325,6 +341,14 @@ void Options::Process(char* buffer)
 		{
 			strncpy(ipAddress, pValue, sizeof(ipAddress) - 1);
 		}
+		else if (strcasecmp(pOption, "NetDiskServer") == 0)
+		{
+			strncpy(netDiskServer, pValue, sizeof(netDiskServer) - 1);
+		}
+		else if (strcasecmp(pOption, "TelemetryHost") == 0)
+		{
+			strncpy(telemetryHost, pValue, sizeof(telemetryHost) - 1);
+		}
 	}
 
 	if (!SplitIECLines())
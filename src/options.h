@@ -75,13 +75,18 @@ public:
 	inline unsigned int InvertIECInputs() const { return invertIECInputs; }
 	inline unsigned int InvertIECOutputs() const { return invertIECOutputs; }
 	inline unsigned int IgnoreReset() const { return ignoreReset; }
+	inline unsigned int RecordIEC() const { return recordIEC; }
+	inline unsigned int LearnProfiles() const { return learnProfiles; }
 
 	inline unsigned int AutoBootFB128() const { return autoBootFB128; }
 	inline const char* Get128BootSectorName() const { return C128BootSectorName; }
 
 	inline unsigned int DisplayTemperature() const { return displayTemperature; }
 
+	inline unsigned int SDDMA() const { return sdDMA; }
+
 	inline unsigned int LowercaseBrowseModeFilenames() const { return lowercaseBrowseModeFilenames; }
+	inline unsigned int JiffyDOS() const { return jiffyDOS; }
 	DiskImage::DiskType GetNewDiskType() const;
 
 	inline unsigned int ScreenWidth() const { return screenWidth; }
@@ -125,6 +130,11 @@ public:
 
 	constexpr int GetDHCPEnable() const { return dhcpEnable; }
 	constexpr const char* GetIPAddress() const { return ipAddress; }
+	inline unsigned int NetReceiveBudget() const { return netReceiveBudget; }
+	constexpr const char* GetNetDiskServer() const { return netDiskServer; }
+	constexpr const char* GetTelemetryHost() const { return telemetryHost; }
+	inline unsigned int TelemetryInterval() const { return telemetryInterval; }
+	inline unsigned int RemoteControl() const { return remoteControl; }
 
 private:
 	unsigned int deviceID;
@@ -145,11 +155,16 @@ private:
 	unsigned int invertIECOutputs;
 	unsigned int splitIECLines;
 	unsigned int ignoreReset;
+	unsigned int recordIEC;
+	unsigned int learnProfiles;
 	unsigned int autoBootFB128;
 
 	unsigned int displayTemperature;
 
+	unsigned int sdDMA;
+
 	unsigned int lowercaseBrowseModeFilenames;
+	unsigned int jiffyDOS;
 
 	unsigned int screenWidth;
 	unsigned int screenHeight;
@@ -201,6 +216,11 @@ private:
 
 	int dhcpEnable;
 	char ipAddress[16];
+	unsigned int netReceiveBudget;
+	char netDiskServer[16];
+	char telemetryHost[16];
+	unsigned int telemetryInterval;
+	unsigned int remoteControl;
 
 };
 #endif
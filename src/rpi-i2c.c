@@ -185,6 +185,81 @@ int RPI_I2CWrite(int BSCMaster, unsigned char slaveAddress, void* buffer, unsign
 	return success;
 }
 
+// State of the non-blocking write in progress on each BSC master
+typedef struct
+{
+	const unsigned char* data;
+	unsigned count;
+	int active;
+} I2CAsyncWrite;
+
+static I2CAsyncWrite asyncWrite[2];
+
+int RPI_I2CWriteStart(int BSCMaster, unsigned char slaveAddress, const void* buffer, unsigned count)
+{
+	I2CAsyncWrite* transfer = &asyncWrite[BSCMaster != 0];
+
+	if (slaveAddress >= 0x80 || count == 0 || transfer->active)
+		return 0;
+
+	unsigned baseAddress = GetBaseAddress(BSCMaster);
+	const unsigned char* data = (const unsigned char*)buffer;
+
+	write32(baseAddress + I2C_BSC_A, slaveAddress);
+	write32(baseAddress + I2C_BSC_C, CONTROL_BIT_CLEAR1);
+	write32(baseAddress + I2C_BSC_S, STATUS_BIT_CLKT | STATUS_BIT_ERR | STATUS_BIT_DONE);
+	write32(baseAddress + I2C_BSC_DLEN, count);
+
+	for (unsigned i = 0; count > 0 && i < FIFO_SIZE; i++)
+	{
+		write32(baseAddress + I2C_BSC_FIFO, *data++);
+		count--;
+	}
+
+	transfer->data = data;
+	transfer->count = count;
+	transfer->active = 1;
+
+	write32(baseAddress + I2C_BSC_C, CONTROL_BIT_I2CEN | CONTROL_BIT_ST);
+	return 1;
+}
+
+// Tops up the FIFO and returns without waiting. The controller holds the clock while the FIFO is empty so gaps between polls are safe.
+// Returns 0 while the write is in progress, 1 once it has completed and -1 if it failed (or no write was started).
+int RPI_I2CWritePoll(int BSCMaster)
+{
+	I2CAsyncWrite* transfer = &asyncWrite[BSCMaster != 0];
+
+	if (!transfer->active)
+		return -1;
+
+	unsigned baseAddress = GetBaseAddress(BSCMaster);
+
+	while (transfer->count > 0 && (read32(baseAddress + I2C_BSC_S) & STATUS_BIT_TXD))
+	{
+		write32(baseAddress + I2C_BSC_FIFO, *transfer->data++);
+		transfer->count--;
+	}
+
+	unsigned status = read32(baseAddress + I2C_BSC_S);
+	if (!(status & STATUS_BIT_DONE))
+		return 0;
+
+	int success = -1;
+	if (status & STATUS_BIT_ERR)
+	{
+		write32(baseAddress + I2C_BSC_S, STATUS_BIT_ERR);
+	}
+	else if ((status & STATUS_BIT_CLKT) == 0 && transfer->count == 0)
+	{
+		success = 1;
+	}
+
+	write32(baseAddress + I2C_BSC_S, STATUS_BIT_DONE);
+	transfer->active = 0;
+	return success;
+}
+
 int RPI_I2CScan(int BSCMaster, unsigned char slaveAddress)
 {
 	int success = 1;
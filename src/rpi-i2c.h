@@ -9,4 +9,9 @@ extern int RPI_I2CRead(int BSCMaster, unsigned char slaveAddress, void* buffer,
 extern int RPI_I2CWrite(int BSCMaster, unsigned char slaveAddress, void* buffer, unsigned count);
 extern int RPI_I2CScan(int BSCMaster, unsigned char slaveAddress);
 
+// Non-blocking write; start it then keep polling until the result is non zero.
+// There is no DMA or interrupt behind it;- each poll refills the 16 byte FIFO from the CPU, so the bytes only move as fast as it is polled.
+extern int RPI_I2CWriteStart(int BSCMaster, unsigned char slaveAddress, const void* buffer, unsigned count);
+extern int RPI_I2CWritePoll(int BSCMaster);
+
 #endif
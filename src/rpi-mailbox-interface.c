@@ -139,12 +139,14 @@ void RPI_PropertyAddTag( rpi_mailbox_tag_t tag, ... )
         case TAG_GET_PIXEL_ORDER:
         case TAG_SET_PIXEL_ORDER:
         case TAG_GET_PITCH:
+        case TAG_SET_VSYNC:
             pt[pt_index++] = 4;
             pt[pt_index++] = 0; /* Request */
 
             if( ( tag == TAG_SET_DEPTH ) ||
                 ( tag == TAG_SET_PIXEL_ORDER ) ||
-                ( tag == TAG_SET_ALPHA_MODE ) )
+                ( tag == TAG_SET_ALPHA_MODE ) ||
+                ( tag == TAG_SET_VSYNC ) )
             {
                 /* Colour Depth, bits-per-pixel \ Pixel Order State */
                 pt[pt_index++] = va_arg( vl, int );
@@ -35,6 +35,44 @@
 #define DMA_SRC_INC 0x100
 #define DMA_PERMAP_5 0x50000
 
+#define DMA_CHANNEL_BASE(channel) (DMA0_BASE + ((channel) * 0x100))
+#define DMA_TI 8			// DMA Channel 0..14 Transfer Information
+#define DMA_SOURCE_AD 0xC	// DMA Channel 0..14 Source Address
+#define DMA_DEST_AD 0x10	// DMA Channel 0..14 Destination Address
+#define DMA_TXFR_LEN 0x14	// DMA Channel 0..14 Transfer Length
+#define DMA_DEBUG 0x20		// DMA Channel 0..14 Debug
+
+// DMA_CS bits
+#define DMA_INT 4
+#define DMA_ERROR 0x100
+#define DMA_WAIT_FOR_OUTSTANDING_WRITES 0x10000000
+#define DMA_ABORT 0x40000000
+#define DMA_RESET 0x80000000
+#define DMA_PRIORITY(n) ((n) << 16)
+#define DMA_PANIC_PRIORITY(n) ((n) << 20)
+
+// DMA_TI bits
+#define DMA_INTEN 1
+#define DMA_TDMODE 2		// 2D mode; TXFR_LEN holds YLENGTH:XLENGTH and the control block stride is applied after each row
+#define DMA_WAIT_RESP 8
+#define DMA_DEST_INC 0x10
+#define DMA_SRC_DREQ 0x400
+#define DMA_PERMAP(n) ((n) << 16)
+#define DMA_PERMAP_EMMC 11
+#define DMA_BURST_LENGTH(n) ((n) << 12)
+
+// DMA_TXFR_LEN and stride fields in 2D mode
+#define DMA_TXFR_LEN_2D(rows, rowBytes) ((((rows) - 1) << 16) | (rowBytes))
+#define DMA_STRIDE_2D(destStride, sourceStride) ((((destStride) & 0xFFFF) << 16) | ((sourceStride) & 0xFFFF))
+
+// Addresses as seen by the DMA engine (the VideoCore bus)
+#define BUS_PERIPHERAL_ADDRESS(addr) (((addr) - PERIPHERAL_BASE) + 0x7E000000)
+#if defined(RPI2) || defined(RPI3)
+#define BUS_MEMORY_ADDRESS(addr) (((u32)(addr)) | 0xC0000000)	// L2 is in the ARM cluster so use the uncached alias
+#else
+#define BUS_MEMORY_ADDRESS(addr) (((u32)(addr)) | 0x40000000)	// L2 cached (coherent) alias
+#endif
+
 #define ARM_GPIO_GPFSEL0	(RPI_GPIO_BASE + 0x00)
 #define ARM_GPIO_GPFSEL1	(RPI_GPIO_BASE + 0x04)
 #define ARM_GPIO_GPFSEL4	(RPI_GPIO_BASE + 0x10)
@@ -136,6 +174,21 @@ extern "C" {
 #endif
 #include "rpi-mailbox-interface.h"
 
+#if defined(HOST_BUILD)
+	// The host tools (see host/) build the emulation core for a PC and supply the registers it touches.
+	extern u32 HostRead32(unsigned int nAddress);
+	extern void HostWrite32(unsigned int nAddress, u32 nValue);
+
+	static inline u32 read32(unsigned int nAddress)
+	{
+		return HostRead32(nAddress);
+	}
+
+	static inline void write32(unsigned int nAddress, u32 nValue)
+	{
+		HostWrite32(nAddress, nValue);
+	}
+#else
 	static inline u32 read32(unsigned int nAddress)
 	{
 		return *(u32 volatile *)nAddress;
@@ -145,6 +198,7 @@ extern "C" {
 	{
 		*(u32 volatile *)nAddress = nValue;
 	}
+#endif
 
 	static inline void delay_us(u32 amount)
 	{
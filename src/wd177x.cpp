@@ -89,6 +89,50 @@ void WD177x::Reset()
 	delayTimer = 0;
 }
 
+void WD177x::SerialiseState(Snapshot& snapshot)
+{
+	snapshot.Field(trackRegister);
+	snapshot.Field(sectorRegister);
+	snapshot.Field(statusRegister);
+	snapshot.Field(dataRegister);
+	snapshot.Field(currentByteRead);
+	snapshot.Field(sectorFromHeader);
+
+	snapshot.Field(commandRegister);
+	snapshot.Field(commandRegisterPrevious);
+	snapshot.Field(commandType);
+
+	snapshot.Field(motorSpinCount);
+
+	snapshot.Field(currentTrack);
+	snapshot.Field(currentSide);
+	snapshot.Field(externalMotorAsserted);
+	snapshot.Field(writeProtectAsserted);
+
+	snapshot.Field(stepDirection);
+
+	snapshot.Field(command);
+	snapshot.Field(commandValue);
+	snapshot.Field(commandStage);
+
+	snapshot.Field(headDataOffset);
+	snapshot.Field(lastByteWasASync);
+
+	snapshot.Field(rotationCountForSeekError);
+	snapshot.Field(rotationCycle);
+	snapshot.Field(byteRotationCycle);
+	snapshot.Field(inactiveRotationCount);
+	snapshot.Field(settleCycleDelay);
+
+	snapshot.Field(readAddressState);
+	snapshot.Field(sectorByteIndex);
+
+	snapshot.Field(delayTimer);
+
+	snapshot.Field(crc);
+	snapshot.Field(dataAddressMark);
+}
+
 bool WD177x::GetWPRTPin() const	// active low
 {
 	// This input is sampled whenever a Write Command is received A logic low on this line will prevent any Write Command from executing(internal pull up)
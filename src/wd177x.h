@@ -161,6 +161,8 @@ public:
 	void Insert(DiskImage* diskImage);
 
 	void Reset();
+	// The disk image and IRQ line are not part of the state.
+	void SerialiseState(Snapshot& snapshot);
 
 	void Execute();
 
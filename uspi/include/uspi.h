@@ -125,6 +125,10 @@ unsigned USPiMassStorageDeviceGetCapacity (unsigned nDeviceIndex);
 // returns != 0 if available
 int USPiEthernetAvailable (void);
 
+// reads the PHY, so do not call it for every frame
+// returns != 0 if the Ethernet link is up
+int USPiEthernetIsLinkUp (void);
+
 void USPiGetMACAddress (unsigned char Buffer[6]);
 
 // returns 0 on failure
@@ -53,7 +53,12 @@ boolean SMSC951xDeviceSendFrame (TSMSC951xDevice *pThis, const void *pBuffer, un
 // pBuffer must have size FRAME_BUFFER_SIZE
 boolean SMSC951xDeviceReceiveFrame (TSMSC951xDevice *pThis, void *pBuffer, unsigned *pResultLength);
 
+boolean SMSC951xDeviceIsLinkUp (TSMSC951xDevice *pThis);
+
 // private:
+boolean SMSC951xDevicePHYRead (TSMSC951xDevice *pThis, u8 uchIndex, u16 *pValue);
+boolean SMSC951xDeviceWaitMII (TSMSC951xDevice *pThis);
+
 boolean SMSC951xDeviceWriteReg (TSMSC951xDevice *pThis, u32 nIndex, u32 nValue);
 boolean SMSC951xDeviceReadReg (TSMSC951xDevice *pThis, u32 nIndex, u32 *pValue);
 
@@ -73,7 +73,9 @@
 	#define MII_WRITE			0x02
 	#define PHY_ID_MASK			0x1F
 	#define PHY_ID_INTERNAL			0x01
+	#define PHY_ID_SHIFT			11
 	#define REG_NUM_MASK			0x1F
+	#define REG_NUM_SHIFT			6
 #define MII_DATA			0x118
 #define FLOW				0x11C
 #define VLAN1				0x120
@@ -408,6 +410,72 @@ boolean SMSC951xDeviceReceiveFrame (TSMSC951xDevice *pThis, void *pBuffer, unsig
 	return TRUE;
 }
 
+boolean SMSC951xDeviceIsLinkUp (TSMSC951xDevice *pThis)
+{
+	assert (pThis != 0);
+
+	u16 usPHYModeStatus;
+	if (!SMSC951xDevicePHYRead (pThis, 0x01, &usPHYModeStatus))
+	{
+		return FALSE;
+	}
+
+	return usPHYModeStatus & (1 << 2) ? TRUE : FALSE;
+}
+
+boolean SMSC951xDevicePHYRead (TSMSC951xDevice *pThis, u8 uchIndex, u16 *pValue)
+{
+	assert (pThis != 0);
+	assert (uchIndex <= 30);
+
+	if (!SMSC951xDeviceWaitMII (pThis))
+	{
+		return FALSE;
+	}
+
+	// set the PHY & index, direction is read (MII_WRITE clear)
+	u32 nMIIAddress  = (PHY_ID_INTERNAL & PHY_ID_MASK) << PHY_ID_SHIFT;
+	    nMIIAddress |= ((u32) uchIndex & REG_NUM_MASK) << REG_NUM_SHIFT;
+	    nMIIAddress |= MII_BUSY;
+
+	u32 nValue;
+	if (   !SMSC951xDeviceWriteReg (pThis, MII_ADDR, nMIIAddress)
+	    || !SMSC951xDeviceWaitMII (pThis)
+	    || !SMSC951xDeviceReadReg (pThis, MII_DATA, &nValue))
+	{
+		return FALSE;
+	}
+
+	assert (pValue != 0);
+	*pValue = nValue & 0xFFFF;
+
+	return TRUE;
+}
+
+// wait until the MII is not busy, checking each millisecond, timeout after 100ms
+boolean SMSC951xDeviceWaitMII (TSMSC951xDevice *pThis)
+{
+	assert (pThis != 0);
+
+	for (unsigned nTries = 0; nTries < 100; nTries++)
+	{
+		u32 nValue;
+		if (!SMSC951xDeviceReadReg (pThis, MII_ADDR, &nValue))
+		{
+			return FALSE;
+		}
+
+		if (!(nValue & MII_BUSY))
+		{
+			return TRUE;
+		}
+
+		MsDelay (1);
+	}
+
+	return FALSE;
+}
+
 boolean SMSC951xDeviceWriteReg (TSMSC951xDevice *pThis, u32 nIndex, u32 nValue)
 {
 	assert (pThis != 0);